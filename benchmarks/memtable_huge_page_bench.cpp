@@ -0,0 +1,66 @@
+// 比较memtable的arena使用普通页和2MB大页时跳表点查的延迟
+// 用法: memtable_huge_page_bench [key个数(默认4000000)] [查找次数(默认2000000)]
+// 需要系统预留大页才能走MAP_HUGETLB，例如: echo 2048 > /proc/sys/vm/nr_hugepages，
+// 否则退回透明大页(/sys/kernel/mm/transparent_hugepage/enabled为always或madvise时生效)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "memory/arena.h"
+#include "memory/huge_page.h"
+#include "memtable/skiplist.h"
+
+using namespace tinykv;
+
+namespace {
+struct KeyComparator {
+	int operator()(const char* a, const char* b) const { return strcmp(a, b); }
+};
+typedef SkipList<const char*, KeyComparator, ConcurrentArena> Table;
+
+void Run(const char* name, size_t huge_page_size, int num_keys, int num_lookups) {
+	ConcurrentArena arena(Arena::kBlockSize, huge_page_size);
+	Table table(KeyComparator(), &arena);
+	std::mt19937_64 rnd(301);
+	std::vector<uint64_t> keys(num_keys);
+	char buf[32];
+	for (int i = 0; i < num_keys; i++) {
+		keys[i] = rnd();
+		int n = snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(keys[i]));
+		// 和memtable一样，key和跳表节点都从同一个arena分配
+		char* key = arena.Allocate(n + 1);
+		memcpy(key, buf, n + 1);
+		table.Insert(key);
+	}
+
+	std::vector<std::string> targets(num_lookups);
+	for (int i = 0; i < num_lookups; i++) {
+		snprintf(buf, sizeof(buf), "%016llx",
+			 static_cast<unsigned long long>(keys[rnd() % num_keys]));
+		targets[i] = buf;
+	}
+	int found = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < num_lookups; i++) {
+		found += table.Contains(targets[i].c_str()) ? 1 : 0;
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - start).count();
+	printf("%-10s : %8.1f ns/lookup, found %d, memory %zu MB, hugetlb %zu MB\n", name,
+	       static_cast<double>(elapsed) / num_lookups, found, arena.MemoryReserved() >> 20,
+	       arena.HugePageUsage() >> 20);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+	int num_keys = argc > 1 ? atoi(argv[1]) : 4000000;
+	int num_lookups = argc > 2 ? atoi(argv[2]) : 2000000;
+	Run("4KB pages", 0, num_keys, num_lookups);
+	Run("2MB pages", kDefaultHugePageSize, num_keys, num_lookups);
+	return 0;
+}
@@ -9,16 +9,23 @@
 
 #include "lru.h"
 #include "cache_policy.h"
+#include "../memory/memory_allocator.h"
 
 namespace tinykv {
 
-#define constexpr const
 template <typename KeyType, typename ValueType>
 class Cache {
 public:
-	Cache(uint32_t capacity) {
-		cache_.resize(kSharedNum);
-		for (int32_t index = 0; index < kSharedNum; index++) {
+	// 设置5个分片， 也就是5个LRU Holder， 一定程度上可以减少碰撞
+	// 此外分片还可以减少锁的粒度（将锁的范围减少到原来的1/kShardNum），提高了并发性
+	static constexpr uint64_t kShardNum = 5;
+
+	// capacity是每个分片的容量
+	// allocator不为nullptr时，作为block cache使用的Cache从它分配block的数据，例如NewHugePageAllocator()
+	Cache(uint32_t capacity, std::shared_ptr<MemoryAllocator> allocator = nullptr)
+		: allocator_(std::move(allocator)) {
+		cache_.resize(kShardNum);
+		for (uint64_t index = 0; index < kShardNum; index++) {
 			cache_[index] = std::make_shared<LruCachePolicy<KeyType, ValueType, MutexLock>>(capacity);
 		}
 	}
@@ -28,6 +35,7 @@ public:
 	const char* Name() const {
 		return "shared.cache";
 	}
+	const std::shared_ptr<MemoryAllocator>& memory_allocator() const { return allocator_; }
 	void Insert(const KeyType& key, ValueType* value, uint32_t ttl = 0) {
 		uint64_t shard_num = std::hash<KeyType>{}(key) % kShardNum;
 		cache_[shard_num]->Insert(key, value, ttl);
@@ -41,7 +49,7 @@ public:
 		return cache_[shard_num]->Release(node);
 	}
 	void Prune() {
-		for (int32_t index = 0; index < kSharedNum; ++index) {
+		for (uint64_t index = 0; index < kShardNum; ++index) {
 			cache_[index]->Prune();
 		}
 	}
@@ -51,16 +59,14 @@ public:
 	}
 	void RegistCleanHandle(
       		std::function<void(const KeyType& key, ValueType* value)> destructor) {
-    		for (int32_t index = 0; index < kSharedNum; ++index) {
+    		for (uint64_t index = 0; index < kShardNum; ++index) {
       			cache_[index]->RegistCleanHandle(destructor);
     		}
   	}
 
 private:
-	// 设置5个分片， 也就是5个LRU Holder， 一定程度上可以减少碰撞
-	// 此外分片还可以减少锁的粒度（将锁的范围减少到原来的1/kSharedNum），提高了并发性
-	static constexpr uint64_t kSharedNum = 5;
 	std::vector<std::shared_ptr<CachePolicy<KeyType, ValueType> > > cache_;
+	const std::shared_ptr<MemoryAllocator> allocator_;
 
 };
 
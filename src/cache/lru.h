@@ -14,13 +14,13 @@
 
 namespace tinykv {
 template <typename KeyType, typename ValueType, typename LockType = NullLock>
-class LruCachePolicy final : public CacheNode<KeyType, ValueType> {
+class LruCachePolicy final : public CachePolicy<KeyType, ValueType> {
 public:
 	LruCachePolicy(uint32_t capacity) : capacity_(capacity) {}
 	~LruCachePolicy() = default;	// 程序结束，LRU析构，内存会被系统回收
 
 	// 插入节点
-	void Insert(const KeyType& key, ValueType* value, uint32_t ttl = 0) {
+	void Insert(const KeyType& key, ValueType* value, uint32_t ttl = 0) override {
 		ScopedLockImple<LockType> lock_guard(cache_lock_);
 		CacheNode<KeyType,ValueType>* new_node = new CacheNode<KeyType, ValueType>();
 		new_node->key = key;
@@ -46,14 +46,17 @@ public:
 			nodes_.push_front(new_node);
 			index_[key] = nodes_.begin();
 		} else {	// 说明cache中已经存在值为key的节点
-			// 更新节点的值， 并将其加到链表头部
-			nodes_.splice(nodes_.begin(), nodes_, index[key]);
-			index_[key] = nodes_.begin();
+			// 用新节点替换旧节点，旧节点在使用者Release之后销毁
+			CacheNode<KeyType, ValueType>* node = *(iter->second);
+			nodes_.erase(iter->second);
+			FinishErase(node);
+			nodes_.push_front(new_node);
+			iter->second = nodes_.begin();
 		}
 	}
 
 	// 查询
-	CacheNode<KeyType, ValueType>* Get(const KeyType& key) {
+	CacheNode<KeyType, ValueType>* Get(const KeyType& key) override {
 		ScopedLockImple<LockType> lock_guard(cache_lock_);
 		typename std::unordered_map<KeyType, ListIter>::iterator iter = index_.find(key);
 		if(iter == index_.end()) {
@@ -69,19 +72,21 @@ public:
 	}
 
 	// 注册销毁节点的回调函数
-	void RegistCleanHandle(std::function<void(const KeyType& key, ValueType* value)> destructor) {
+	// Table每次读block都会调用，可能和其他线程中的Unref同时发生，所以也要加锁
+	void RegistCleanHandle(std::function<void(const KeyType& key, ValueType* value)> destructor) override {
+		ScopedLockImple<LockType> lock_guard(cache_lock_);
 		destructor_ = destructor;
 	}
 
 	// 释放节点
 	// 也就是外部不用这个节点了
-	void Release(CacheNode<KeyType, ValueType>* node) {
+	void Release(CacheNode<KeyType, ValueType>* node) override {
 		ScopedLockImple<LockType> lock_guard(cache_lock_);
 		Unref(node);
 	}
 
 	// 定期进行回收
-	void Prune() {
+	void Prune() override {
 		ScopedLockImple<LockType> lock_guard(cache_lock_);
 		for (auto it = wait_erase_.begin(); it != wait_erase_.end(); ++it) {
 			Unref((it->second));
@@ -89,7 +94,7 @@ public:
 	}
 
 	// 删除某个key对应的节点
-	void Erase(const KeyType& key) {
+	void Erase(const KeyType& key) override {
 		ScopedLockImple<LockType> lock_guard(cache_lock_);
 		typename std::unordered_map<KeyType, ListIter>::iterator iter = index_.find(key);
 		if (iter == index_.end()) {
@@ -114,8 +119,10 @@ private:
 			--node->refs;
 			if(node->refs <= 0) {
 				destructor_(node->key, node->value);
-				if (wait_erase_.count(node->key) > 0) {
-					wait_erase_.erase(node->key);
+				// 同一个key被替换多次时，待删除列表中可能是另一个节点，不能把它删掉
+				auto iter = wait_erase_.find(node->key);
+				if (iter != wait_erase_.end() && iter->second == node) {
+					wait_erase_.erase(iter);
 				}
 				delete node;
 				node = nullptr;
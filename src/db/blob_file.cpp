@@ -0,0 +1,120 @@
+#include "blob_file.h"
+#include "filename.h"
+#include "../file/file_reader.h"
+#include "../file/file_writer.h"
+#include "../utils/codec.h"
+#include "../utils/crc32c.h"
+
+namespace tinykv {
+void BlobIndex::EncodeTo(std::string* dst) const {
+	PutVarint64(dst, file_number);
+	PutVarint64(dst, offset);
+	PutVarint64(dst, size);
+}
+
+DBStatus BlobIndex::DecodeFrom(const Slice& src) {
+	Slice input = src;
+	if (GetVarint64(&input, &file_number) && GetVarint64(&input, &offset) &&
+	    GetVarint64(&input, &size) && input.empty()) {
+		return Status::kSuccess;
+	}
+	return Status::kCorruption;
+}
+
+BlobFile::BlobFile() = default;
+
+BlobFile::~BlobFile() = default;
+
+DBStatus BlobFile::Read(const Slice& user_key, const BlobIndex& index,
+			std::string* value) const {
+	if (index.size < 4 || index.offset + index.size > meta.total_bytes) {
+		return Status::kCorruption;
+	}
+	std::string record(index.size, '\0');
+	DBStatus s = file->Read(index.offset, record.size(), &record[0]);
+	if (s != Status::kSuccess) {
+		return s;
+	}
+	const uint32_t expected = crc32c::Unmask(DecodeFixed32(record.data()));
+	if (crc32c::Value(record.data() + 4, record.size() - 4) != expected) {
+		return Status::kCorruption;
+	}
+	Slice input(record.data() + 4, record.size() - 4);
+	uint32_t key_size, value_size;
+	if (!GetVarint32(&input, &key_size) || !GetVarint32(&input, &value_size) ||
+	    input.size() != static_cast<size_t>(key_size) + value_size ||
+	    Slice(input.data(), key_size) != user_key) {
+		return Status::kCorruption;
+	}
+	value->assign(input.data() + key_size, value_size);
+	return Status::kSuccess;
+}
+
+BlobFileBuilder::BlobFileBuilder(const std::string& dbname, uint64_t number,
+				 size_t min_blob_size)
+	: fname_(BlobFileName(dbname, number)), min_blob_size_(min_blob_size) {
+	meta_.number = number;
+}
+
+BlobFileBuilder::~BlobFileBuilder() {
+	// 没有调用Finish说明出错了
+	if (file_ != nullptr) {
+		Abandon();
+	}
+}
+
+DBStatus BlobFileBuilder::Add(const Slice& user_key, const Slice& value,
+			      std::string* index) {
+	if (file_ == nullptr) {
+		file_.reset(new FileWriter(fname_));
+		file_->SetRateLimiter(rate_limiter_, io_priority_);
+	}
+	record_.assign(4, '\0');
+	PutVarint32(&record_, static_cast<uint32_t>(user_key.size()));
+	PutVarint32(&record_, static_cast<uint32_t>(value.size()));
+	record_.append(user_key.data(), user_key.size());
+	record_.append(value.data(), value.size());
+	EncodeFixed32(&record_[0],
+		      crc32c::Mask(crc32c::Value(record_.data() + 4, record_.size() - 4)));
+	DBStatus s = file_->Append(record_.data(), static_cast<int32_t>(record_.size()));
+	if (s != Status::kSuccess) {
+		return s;
+	}
+
+	BlobIndex blob_index;
+	blob_index.file_number = meta_.number;
+	blob_index.offset = meta_.total_bytes;
+	blob_index.size = record_.size();
+	index->clear();
+	blob_index.EncodeTo(index);
+	meta_.total_count++;
+	meta_.total_bytes += record_.size();
+	return Status::kSuccess;
+}
+
+DBStatus BlobFileBuilder::Finish() {
+	if (file_ == nullptr) {
+		return Status::kSuccess;
+	}
+	DBStatus s = file_->Sync();
+	file_->Close();
+	file_.reset();
+	if (s != Status::kSuccess) {
+		FileTool::RemoveFile(fname_);
+	}
+	return s;
+}
+
+void BlobFileBuilder::Abandon() {
+	const bool created = (file_ != nullptr || !Empty());
+	if (file_ != nullptr) {
+		file_->Close();
+		file_.reset();
+	}
+	if (created) {
+		FileTool::RemoveFile(fname_);
+	}
+	meta_.total_count = 0;
+	meta_.total_bytes = 0;
+}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+#include "version_edit.h"
+#include "../file/rate_limiter.h"
+#include "../include/tinykv/slice.h"
+#include "../include/tinykv/status.h"
+
+namespace tinykv {
+class FileReader;
+class FileWriter;
+
+// kv分离: 大value在刷盘或compaction时追加写到blob文件中，sst中只保存指向它的BlobIndex，
+// 这样compaction重写sst的时候只需要搬动很小的BlobIndex，不需要一遍遍地重写大value
+//
+// blob文件由依次追加的record组成，每个record的格式为:
+//   | crc32c(fixed32) | key size(varint32) | value size(varint32) | user key | value |
+// crc覆盖crc之后的所有内容，保存user key是为了读取时校验BlobIndex没有指错地方
+struct BlobIndex {
+	uint64_t file_number = 0;	// blob文件的编号
+	uint64_t offset = 0;		// record在文件中的起始位置
+	uint64_t size = 0;		// record的大小
+
+	void EncodeTo(std::string* dst) const;
+	// 格式不对时返回kCorruption
+	DBStatus DecodeFrom(const Slice& src);
+};
+
+// 一个打开的blob文件，不同Version中同一个文件的垃圾统计不同，但是共用同一个FileReader
+struct BlobFile {
+	BlobFileMetaData meta;
+	std::shared_ptr<FileReader> file;
+
+	BlobFile();
+	~BlobFile();
+
+	// 读取index指向的record，校验user key之后把value放到*value中，可以在多个线程中同时调用
+	DBStatus Read(const Slice& user_key, const BlobIndex& index,
+		      std::string* value) const;
+};
+
+// 写一个新的blob文件，第一次Add时才创建文件，没有大value时不会留下空文件
+class BlobFileBuilder final {
+public:
+	// 长度不小于min_blob_size的value才会写入blob文件，min_blob_size为0表示不做kv分离
+	BlobFileBuilder(const std::string& dbname, uint64_t number, size_t min_blob_size);
+	~BlobFileBuilder();
+
+	BlobFileBuilder(const BlobFileBuilder&) = delete;
+	BlobFileBuilder& operator=(const BlobFileBuilder&) = delete;
+
+	bool ShouldSeparate(const Slice& value) const {
+		return min_blob_size_ > 0 && value.size() >= min_blob_size_;
+	}
+
+	// 写文件时使用的限速器和优先级，必须在第一次Add之前调用
+	void SetRateLimiter(RateLimiter* rate_limiter, IOPriority priority) {
+		rate_limiter_ = rate_limiter;
+		io_priority_ = priority;
+	}
+
+	// 把user_key和value追加到文件中，*index返回编码后的BlobIndex
+	DBStatus Add(const Slice& user_key, const Slice& value, std::string* index);
+
+	// 把写入的数据Sync到磁盘，必须在引用它的sst生效之前调用
+	DBStatus Finish();
+	// 出错时放弃已经写入的数据，删除文件
+	void Abandon();
+
+	bool Empty() const { return meta_.total_count == 0; }
+	const BlobFileMetaData& meta() const { return meta_; }
+
+private:
+	const std::string fname_;
+	const size_t min_blob_size_;
+	std::unique_ptr<FileWriter> file_;
+	RateLimiter* rate_limiter_ = nullptr;
+	IOPriority io_priority_ = kIOLow;
+	BlobFileMetaData meta_;
+	std::string record_;
+};
+}
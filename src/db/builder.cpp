@@ -0,0 +1,128 @@
+#include "builder.h"
+#include "blob_file.h"
+#include "filename.h"
+#include "options.h"
+#include "../file/file_writer.h"
+#include "../include/tinykv/iterator.h"
+#include "../table/table_builder.h"
+
+#include <algorithm>
+
+namespace tinykv {
+DBStatus BuildTable(const std::string& dbname, const Options& options,
+		    Iterator* iter, Iterator* range_del_iter, FileMetaData* meta,
+		    BlobFileBuilder* blob) {
+	DBStatus s = Status::kSuccess;
+	meta->file_size = 0;
+	iter->SeekToFirst();
+	if (range_del_iter != nullptr) {
+		range_del_iter->SeekToFirst();
+	}
+	if (!iter->Valid() && (range_del_iter == nullptr || !range_del_iter->Valid())) {
+		return iter->status();
+	}
+
+	// 先写到临时文件中，写完之后再改名，这样崩溃时目录下不会留下写了一半的sst
+	const std::string tmp_name = TempFileName(dbname, meta->number);
+	const std::string fname = TableFileName(dbname, meta->number);
+	{
+		FileWriter file(tmp_name);
+		file.SetRateLimiter(options.rate_limiter.get(), kIOMid);
+		TableBuilder builder(options, &file);
+		// sst迭代器Next之后原来的key就失效了，所以要拷贝一份
+		std::string last_key;
+		std::string blob_index;
+		bool first = true;
+		meta->smallest_seq = kMaxSequenceNumber;
+		meta->largest_seq = 0;
+		ParsedInternalKey ikey;
+		for (; iter->Valid(); iter->Next()) {
+			last_key = iter->key().ToString();
+			Slice value = iter->value();
+			if (ParseInternalKey(iter->key(), &ikey)) {
+				meta->smallest_seq = std::min(meta->smallest_seq, ikey.sequence);
+				meta->largest_seq = std::max(meta->largest_seq, ikey.sequence);
+				if (blob != nullptr && ikey.type == kTypeValue &&
+				    blob->ShouldSeparate(value)) {
+					// 值类型是内部键的一部分，sst中的key也要换成kTypeBlobIndex
+					s = blob->Add(ikey.user_key, value, &blob_index);
+					if (s != Status::kSuccess) {
+						break;
+					}
+					last_key.clear();
+					AppendInternalKey(&last_key, ParsedInternalKey(ikey.user_key, ikey.sequence,
+										       kTypeBlobIndex));
+					value = blob_index;
+				}
+			}
+			if (first) {
+				meta->smallest.DecodeFrom(last_key);
+				first = false;
+			}
+			builder.Add(last_key, value.ToString());
+		}
+		if (!first) {
+			meta->largest.DecodeFrom(last_key);
+		}
+		// 范围删除的起点和终点也要算进文件的key范围，否则查找时会跳过这个文件
+		// 终点不包含在范围内，用(end, kMaxSequenceNumber)作为largest，它比end的所有版本都小
+		const InternalKeyComparator* icmp =
+			static_cast<const InternalKeyComparator*>(options.comparator.get());
+		for (; s == Status::kSuccess && range_del_iter != nullptr && range_del_iter->Valid();
+		     range_del_iter->Next()) {
+			if (!ParseInternalKey(range_del_iter->key(), &ikey)) {
+				s = Status::kCorruption;
+				break;
+			}
+			builder.AddRangeTombstone(range_del_iter->key().ToString(),
+						  range_del_iter->value().ToString());
+			meta->smallest_seq = std::min(meta->smallest_seq, ikey.sequence);
+			meta->largest_seq = std::max(meta->largest_seq, ikey.sequence);
+			InternalKey start;
+			start.DecodeFrom(range_del_iter->key());
+			InternalKey end(range_del_iter->value(), kMaxSequenceNumber, kTypeRangeDeletion);
+			if (first || icmp->Compare(start, meta->smallest) < 0) {
+				meta->smallest = start;
+			}
+			if (first || icmp->Compare(end, meta->largest) > 0) {
+				meta->largest = end;
+			}
+			first = false;
+		}
+		builder.Finish();
+		if (s == Status::kSuccess && !builder.Success()) {
+			s = Status::kWriteFileFailed;
+		}
+		// 关闭前Sync，保证数据已经落盘
+		if (s == Status::kSuccess) {
+			s = file.Sync();
+		}
+		file.Close();
+	}
+	// sst中的BlobIndex指向的数据必须先落盘
+	if (s == Status::kSuccess && blob != nullptr) {
+		s = blob->Finish();
+	}
+	if (s == Status::kSuccess) {
+		meta->file_size = FileTool::GetFileSize(tmp_name);
+	}
+
+	if (s == Status::kSuccess) {
+		s = iter->status();
+	}
+	if (s == Status::kSuccess && range_del_iter != nullptr) {
+		s = range_del_iter->status();
+	}
+	if (s == Status::kSuccess && !FileTool::Rename(tmp_name, fname)) {
+		s = Status::kIOError;
+	}
+	if (s != Status::kSuccess || meta->file_size == 0) {
+		FileTool::RemoveFile(tmp_name);
+		meta->file_size = 0;
+		if (blob != nullptr) {
+			blob->Abandon();
+		}
+	}
+	return s;
+}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "dbformat.h"
+#include "version_edit.h"
+#include "../include/tinykv/status.h"
+
+namespace tinykv {
+struct Options;
+class BlobFileBuilder;
+class Iterator;
+
+// 把iter中的所有数据写到编号为meta->number的sst文件中，iter必须是按内部键有序的
+// 成功时填充meta的其余字段；如果iter和range_del_iter中都没有数据，meta->file_size为0，不会生成文件
+// options中的comparator必须是InternalKeyComparator
+// blob不为nullptr时，大value写到blob中，sst中保存BlobIndex；sst写成功之前blob已经Finish
+// range_del_iter不为nullptr时，其中的范围删除也写到sst中，meta的key范围会覆盖所有的范围删除
+// 写sst时按memtable刷盘的优先级(kIOMid)向options.rate_limiter申请令牌
+DBStatus BuildTable(const std::string& dbname, const Options& options,
+		    Iterator* iter, Iterator* range_del_iter, FileMetaData* meta,
+		    BlobFileBuilder* blob);
+}
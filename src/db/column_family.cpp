@@ -0,0 +1,51 @@
+#include "column_family.h"
+#include "table_cache.h"
+#include "version_set.h"
+#include "../memtable/memtable.h"
+#include "../include/tinykv/compaction_filter.h"
+
+namespace tinykv {
+uint32_t ColumnFamilyHandle::GetID() const { return cfd_->id; }
+
+const std::string& ColumnFamilyHandle::GetName() const { return cfd_->name; }
+
+ColumnFamilyData::ColumnFamilyData(uint32_t id, const std::string& name,
+				   const std::string& dbname, const Options& options)
+	: id(id)
+	, name(name)
+	, dbname(dbname)
+	, options(options)
+	, internal_comparator(options.comparator ? options.comparator.get()
+						 : BytewiseComparator())
+	, compaction_filter(options.ttl > 0 ? std::shared_ptr<const CompactionFilter>(
+						      std::make_shared<TtlCompactionFilter>(options.ttl))
+					    : options.compaction_filter)
+	, table_options(options)
+	, table_cache(new TableCache(dbname, &table_options, options.max_open_files))
+	, versions(new VersionSet(dbname, &this->options, table_cache, &internal_comparator))
+	, handle(this) {
+	table_options.comparator = std::make_shared<InternalKeyComparator>(
+		internal_comparator.user_comparator());
+	if (options.filter_policy != nullptr) {
+		// sst中是内部键，过滤器只对用户键构建，点查时才能用上
+		table_options.filter_policy =
+			std::make_shared<InternalFilterPolicy>(options.filter_policy);
+	}
+	if (options.prefix_extractor != nullptr) {
+		table_options.prefix_extractor =
+			std::make_shared<InternalKeySliceTransform>(options.prefix_extractor);
+	}
+}
+
+MemTable* ColumnFamilyData::NewMemTable() const {
+	return new MemTable(internal_comparator, options.memtable_huge_page_size,
+			    options.memtable_factory.get(), options.prefix_extractor.get());
+}
+
+ColumnFamilyData::~ColumnFamilyData() {
+	if (mem != nullptr) mem->Unref();
+	if (imm != nullptr) imm->Unref();
+	delete versions;
+	delete table_cache;
+}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <set>
+#include <string>
+
+#include "dbformat.h"
+#include "options.h"
+
+namespace tinykv {
+class MemTable;
+class TableCache;
+class VersionSet;
+struct ColumnFamilyData;
+
+// 默认column family的名字，编号是0，任何DB都有
+static const char* const kDefaultColumnFamilyName = "default";
+
+// 打开DB时要打开的一个column family
+struct ColumnFamilyDescriptor {
+	ColumnFamilyDescriptor(const std::string& n, const Options& o) : name(n), options(o) {}
+
+	std::string name;
+	Options options;
+};
+
+// 读写时用来指定column family，由DB持有，DB析构之前一直有效
+class ColumnFamilyHandle final {
+public:
+	explicit ColumnFamilyHandle(ColumnFamilyData* cfd) : cfd_(cfd) {}
+
+	ColumnFamilyHandle(const ColumnFamilyHandle&) = delete;
+	ColumnFamilyHandle& operator=(const ColumnFamilyHandle&) = delete;
+
+	uint32_t GetID() const;
+	const std::string& GetName() const;
+
+	ColumnFamilyData* cfd() const { return cfd_; }
+
+private:
+	ColumnFamilyData* const cfd_;
+};
+
+// 一个column family的全部状态: 自己的配置、memtable和sst集合(VersionSet)
+// 非默认column family的文件放在ColumnFamilyDirName目录下，有自己的MANIFEST和文件编号
+// 所有column family共用DB的mutex、WAL、顺序号和快照，除了构造时确定的成员以外都需要在mutex保护下访问
+struct ColumnFamilyData {
+	ColumnFamilyData(uint32_t id, const std::string& name, const std::string& dbname,
+			 const Options& options);
+	~ColumnFamilyData();
+
+	ColumnFamilyData(const ColumnFamilyData&) = delete;
+	ColumnFamilyData& operator=(const ColumnFamilyData&) = delete;
+
+	// 按这个column family的配置创建一个空的memtable，调用者负责Ref
+	MemTable* NewMemTable() const;
+
+	const uint32_t id;
+	const std::string name;
+	// 这个column family的文件所在的目录
+	const std::string dbname;
+	const Options options;
+	const InternalKeyComparator internal_comparator;
+	// compaction时使用的过滤器，开启了TTL时是内置的TtlCompactionFilter，否则是options.compaction_filter
+	const std::shared_ptr<const CompactionFilter> compaction_filter;
+	// 传给TableBuilder/Table的配置，comparator换成了InternalKeyComparator，
+	// filter_policy换成了InternalFilterPolicy，prefix_extractor换成了InternalKeySliceTransform
+	Options table_options;
+	// 打开的sst，这个column family的所有Version共用
+	TableCache* const table_cache;
+	// 每一层都有哪些sst，以及文件编号的分配
+	VersionSet* const versions;
+
+	MemTable* mem = nullptr;
+	MemTable* imm = nullptr;
+	// mem中最早的数据所在的WAL，imm刷盘之后更早的WAL中就没有这个column family需要的数据了
+	uint64_t mem_log_number = 0;
+	// 正在生成、还没有加入Version的sst和blob文件，不能被RemoveObsoleteFiles删除
+	std::set<uint64_t> pending_outputs;
+
+	ColumnFamilyHandle handle;
+};
+}
@@ -0,0 +1,2106 @@
+#include "db.h"
+#include "blob_file.h"
+#include "builder.h"
+#include "column_family.h"
+#include "db_iter.h"
+#include "filename.h"
+#include "merge_context.h"
+#include "range_tombstone.h"
+#include "table_cache.h"
+#include "version_edit.h"
+#include "version_set.h"
+#include "write_batch.h"
+#include "write_batch_internal.h"
+#include "../file/file_reader.h"
+#include "../file/file_writer.h"
+#include "../include/tinykv/compaction_filter.h"
+#include "../include/tinykv/iterator.h"
+#include "../log/log_format.h"
+#include "../log/log_read.h"
+#include "../log/log_write.h"
+#include "../logger/log.h"
+#include "../memtable/memtable.h"
+#include "../table/merger.h"
+#include "../table/table.h"
+#include "../table/table_builder.h"
+#include "../utils/codec.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace tinykv {
+// 回放WAL时每一段的最小长度，太小的话每一段生成的sst也很小
+static const uint64_t kMinRecoverySegmentSize = 1 << 20;
+
+struct DB::SubcompactionState {
+	// 负责的user key范围[start, end)，第一个subcompaction没有下界，最后一个没有上界
+	std::string start;
+	bool has_start = false;
+	std::string end;
+	bool has_end = false;
+	std::unique_ptr<Iterator> input;
+	DBStatus status = Status::kSuccess;
+
+	// 已经写完的输出文件
+	std::vector<FileMetaData> outputs;
+
+	// 正在写的输出文件
+	FileMetaData current_output;
+	std::unique_ptr<FileWriter> outfile;
+	std::unique_ptr<TableBuilder> builder;
+
+	// 这个范围所有输出文件共用的blob文件，第一次需要写blob时才创建
+	std::unique_ptr<BlobFileBuilder> blob;
+	// 改写之后的key和value
+	std::string blob_key;
+	std::string blob_value;
+	std::string blob_index;
+	// 变成垃圾的blob record的(文件编号, 大小)，合并完成之后再记录到edit中
+	std::vector<std::pair<uint64_t, uint64_t>> blob_garbage;
+	// CompactionFilter改写之后的key和value，以及从blob文件中读出来交给它的value
+	std::string filter_key;
+	std::string filter_value;
+	std::string filter_new_value;
+	// 合并merge操作数时收集到的操作数，合并之后的key和value，以及读出来的旧值
+	MergeContext merge_context;
+	std::string merge_key;
+	std::string merge_value;
+	std::string merge_base;
+
+	// 当前输出文件中的范围删除从这个user key开始，第一个输出文件的下界是start
+	std::string range_del_lower;
+	bool has_range_del_lower = false;
+	// Compaction::IsBaseLevelForKey的查找位置
+	std::vector<size_t> level_ptrs;
+};
+
+struct DB::CompactionState {
+	CompactionState(ColumnFamilyData* cfd, Compaction* c) : cfd(cfd), compaction(c) {}
+
+	ColumnFamilyData* const cfd;
+	Compaction* const compaction;
+	// 比这个顺序号小的旧版本不会再被任何读操作看到，可以丢弃
+	SequenceNumber smallest_snapshot = 0;
+	// 最新的快照，顺序号比它大的版本不会被任何快照读到，可以交给CompactionFilter，没有快照时为0
+	SequenceNumber newest_snapshot = 0;
+	// 所有输入文件中的范围删除，没有时为nullptr，合并期间只读
+	std::unique_ptr<FragmentedRangeTombstoneList> range_del;
+	// 按key范围从小到大排列，至少有一个
+	std::vector<std::unique_ptr<SubcompactionState>> subcompactions;
+};
+
+struct DB::WriteGroup {
+	// 组中的writer，第一个是leader
+	std::vector<PendingWriter*> writers;
+	// 合并之后的batch，只有一个writer时是它自己的batch
+	WriteBatch* batch = nullptr;
+	// 流水线写入时合并用的batch
+	WriteBatch tmp_batch;
+	// 按column family的编号索引，流水线写入时切换memtable之前会等前面的组都插入完成
+	std::vector<MemTable*> mems;
+	// 这一组分配到的最大顺序号
+	SequenceNumber last_sequence = 0;
+};
+
+struct DB::PendingWriter {
+	explicit PendingWriter(WriteBatch* b, bool sync)
+		: batch(b), sync(sync), done(false), status(Status::kSuccess) {}
+
+	WriteBatch* batch;
+	bool sync;
+	bool done;
+	DBStatus status;
+	std::condition_variable cv;
+	// 被合并到的写入组，还没有被合并时为nullptr
+	WriteGroup* group = nullptr;
+	// 并发写memtable时leader设置，follower把自己的batch插入mems之后清零
+	const std::vector<MemTable*>* mems = nullptr;
+	PendingWriter* leader = nullptr;
+	// leader还在等待多少个follower插入完成
+	int pending_inserts = 0;
+};
+
+DB::DB(const Options& options, const std::string& dbname)
+	: dbname_(dbname)
+	, options_(options)
+	, tmp_batch_(new WriteBatch)
+	, default_cf_(new ColumnFamilyData(0, kDefaultColumnFamilyName, dbname, options))
+	, versions_(default_cf_->versions) {
+	column_families_[0] = default_cf_;
+	UpdateTtlColumnFamilies();
+}
+
+DB::~DB() {
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		shutting_down_ = true;
+		background_work_cv_.notify_all();
+	}
+	if (bg_thread_.joinable()) {
+		bg_thread_.join();
+	}
+
+	delete log_;
+	if (logfile_ != nullptr) {
+		logfile_->Close();
+		delete logfile_;
+	}
+	delete tmp_batch_;
+	for (auto& cf : column_families_) {
+		delete cf.second;
+	}
+}
+
+DBStatus DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
+	std::vector<ColumnFamilyHandle*> handles;
+	return Open(options, dbname, std::vector<ColumnFamilyDescriptor>(), &handles, dbptr);
+}
+
+DBStatus DB::Open(const Options& options, const std::string& dbname,
+		  const std::vector<ColumnFamilyDescriptor>& column_families,
+		  std::vector<ColumnFamilyHandle*>* handles, DB** dbptr) {
+	*dbptr = nullptr;
+	handles->clear();
+	DB* db = new DB(options, dbname);
+	std::unique_lock<std::mutex> lock(db->mutex_);
+	std::map<uint32_t, VersionEdit> edits;
+	DBStatus s = db->Recover(column_families, &edits, lock);
+	if (s == Status::kSuccess) {
+		db->last_allocated_sequence_ = db->versions_->LastSequence();
+		s = db->NewLogFile();
+	}
+	for (const auto& cf : db->column_families_) {
+		if (s != Status::kSuccess) {
+			break;
+		}
+		// 之前的WAL都已经刷成sst了
+		ColumnFamilyData* cfd = cf.second;
+		VersionEdit& edit = edits[cfd->id];
+		edit.SetLogNumber(db->logfile_number_);
+		cfd->mem_log_number = db->logfile_number_;
+		s = db->LogAndApply(cfd, &edit, lock);
+	}
+	for (const auto& desc : column_families) {
+		if (s != Status::kSuccess) {
+			break;
+		}
+		ColumnFamilyData* cfd = db->FindColumnFamily(desc.name);
+		if (cfd == nullptr) {
+			s = db->CreateColumnFamilyLocked(desc.options, desc.name, &cfd, lock);
+		}
+		if (s == Status::kSuccess) {
+			handles->push_back(&cfd->handle);
+		}
+	}
+	if (s == Status::kSuccess) {
+		db->RemoveObsoleteFiles();
+	}
+	lock.unlock();
+	if (s != Status::kSuccess) {
+		handles->clear();
+		delete db;
+		return s;
+	}
+	db->bg_thread_ = std::thread(&DB::BackgroundCall, db);
+	*dbptr = db;
+	return s;
+}
+
+DBStatus DB::NewDB(ColumnFamilyData* cfd) {
+	VersionEdit new_db;
+	new_db.SetComparatorName(cfd->internal_comparator.user_comparator()->Name());
+	new_db.SetLogNumber(0);
+	new_db.SetNextFile(2);
+	new_db.SetLastSequence(0);
+
+	const std::string manifest = DescriptorFileName(cfd->dbname, 1);
+	DBStatus s = Status::kSuccess;
+	{
+		FileWriter file(manifest);
+		Writer log(&file);
+		std::string record;
+		new_db.EncodeTo(&record);
+		s = log.AddRecord(record);
+		if (s == Status::kSuccess) {
+			s = file.Sync();
+		}
+		file.Close();
+	}
+	if (s == Status::kSuccess) {
+		s = SetCurrentFile(cfd->dbname, 1);
+	} else {
+		FileTool::RemoveFile(manifest);
+	}
+	return s;
+}
+
+DBStatus DB::Recover(const std::vector<ColumnFamilyDescriptor>& column_families,
+		     std::map<uint32_t, VersionEdit>* edits,
+		     std::unique_lock<std::mutex>& lock) {
+	if (!FileTool::CreateDir(dbname_)) {
+		return Status::kIOError;
+	}
+	if (!FileTool::Exist(CurrentFileName(dbname_))) {
+		DBStatus s = NewDB(default_cf_);
+		if (s != Status::kSuccess) {
+			return s;
+		}
+	}
+	// 从MANIFEST中恢复每一层都有哪些sst，不需要扫描sst的内容
+	DBStatus s = versions_->Recover();
+	if (s != Status::kSuccess) {
+		return s;
+	}
+	// 默认column family的MANIFEST中记录了其他column family，它们各自的sst记录在自己的MANIFEST中
+	for (const auto& cf : versions_->ColumnFamilies()) {
+		const ColumnFamilyDescriptor* desc = nullptr;
+		for (const auto& d : column_families) {
+			if (d.name == cf.second) {
+				desc = &d;
+				break;
+			}
+		}
+		if (desc == nullptr) {
+			LOG(ERROR, "column family %s is not opened", cf.second.c_str());
+			return Status::kInvalidArgument;
+		}
+		ColumnFamilyData* cfd = new ColumnFamilyData(
+			cf.first, cf.second, ColumnFamilyDirName(dbname_, cf.first), desc->options);
+		column_families_[cf.first] = cfd;
+		UpdateTtlColumnFamilies();
+		s = cfd->versions->Recover();
+		if (s != Status::kSuccess) {
+			return s;
+		}
+	}
+
+	// 任何一个column family还没有刷盘的WAL都要回放
+	uint64_t min_log_number = versions_->LogNumber();
+	SequenceNumber max_sequence = 0;
+	for (const auto& cf : column_families_) {
+		ColumnFamilyData* cfd = cf.second;
+		min_log_number = std::min(min_log_number, cfd->versions->LogNumber());
+		max_sequence = std::max(max_sequence, cfd->versions->LastSequence());
+		cfd->mem = cfd->NewMemTable();
+		cfd->mem->Ref();
+	}
+	std::vector<uint64_t> logs;
+	for (const auto& cf : column_families_) {
+		ColumnFamilyData* cfd = cf.second;
+		std::vector<std::string> filenames;
+		if (!FileTool::GetChildren(cfd->dbname, &filenames)) {
+			return Status::kIOError;
+		}
+		uint64_t number;
+		FileType type;
+		for (const auto& filename : filenames) {
+			if (!ParseFileName(filename, &number, &type)) {
+				continue;
+			}
+			cfd->versions->MarkFileNumberUsed(number);
+			// WAL只在数据库目录下，编号小于LogNumber的WAL已经刷成sst了
+			if (cfd == default_cf_ && type == kLogFile && number >= min_log_number) {
+				logs.push_back(number);
+			}
+		}
+	}
+
+	// 每个WAL按block对齐切成若干段，每一段回放到自己的memtable中再刷成L0的sst
+	// 每条记录都带着自己的顺序号，所以各段之间不需要按顺序回放，各段生成的sst的顺序号范围也不会重叠
+	struct LogSegment {
+		uint64_t log_number;
+		uint64_t start;
+		uint64_t end;
+		DBStatus status;
+		SequenceNumber max_sequence;
+		std::map<uint32_t, std::vector<FileMetaData>> files;
+		std::map<uint32_t, std::vector<BlobFileMetaData>> blob_files;
+	};
+	const uint64_t num_threads = std::max<uint32_t>(1, options_.recovery_threads);
+	std::vector<LogSegment> segments;
+	std::sort(logs.begin(), logs.end());
+	for (uint64_t log_number : logs) {
+		const uint64_t size = FileTool::GetFileSize(LogFileName(dbname_, log_number));
+		uint64_t segment_size = (size / num_threads + kBlockSize - 1) / kBlockSize * kBlockSize;
+		segment_size = std::max<uint64_t>(segment_size, kMinRecoverySegmentSize);
+		for (uint64_t start = 0; start < size; start += segment_size) {
+			LogSegment segment;
+			segment.log_number = log_number;
+			segment.start = start;
+			segment.end = std::min(start + segment_size, size);
+			segment.status = Status::kSuccess;
+			segment.max_sequence = 0;
+			segments.push_back(std::move(segment));
+		}
+	}
+
+	std::atomic<size_t> next_segment{0};
+	auto replay = [this, &segments, &next_segment]() {
+		size_t i;
+		while ((i = next_segment.fetch_add(1)) < segments.size()) {
+			LogSegment& segment = segments[i];
+			segment.status = RecoverLogSegment(segment.log_number, segment.start,
+							   segment.end, &segment.max_sequence,
+							   &segment.files, &segment.blob_files);
+		}
+	};
+	// 回放期间分配文件编号需要加锁
+	lock.unlock();
+	std::vector<std::thread> threads;
+	const size_t extra_threads = std::min<size_t>(num_threads, segments.size());
+	for (size_t i = 1; i < extra_threads; i++) {
+		threads.emplace_back(replay);
+	}
+	replay();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	lock.lock();
+
+	for (const auto& segment : segments) {
+		if (segment.status != Status::kSuccess) {
+			return segment.status;
+		}
+		max_sequence = std::max(max_sequence, segment.max_sequence);
+		for (const auto& files : segment.files) {
+			for (const auto& meta : files.second) {
+				(*edits)[files.first].AddFile(0, meta);
+			}
+		}
+		for (const auto& blob_files : segment.blob_files) {
+			for (const auto& blob : blob_files.second) {
+				(*edits)[blob_files.first].AddBlobFile(blob);
+			}
+		}
+	}
+	versions_->SetLastSequence(max_sequence);
+	return Status::kSuccess;
+}
+
+DBStatus DB::RecoverLogSegment(uint64_t log_number, uint64_t start, uint64_t end,
+			       SequenceNumber* max_sequence,
+			       std::map<uint32_t, std::vector<FileMetaData>>* files,
+			       std::map<uint32_t, std::vector<BlobFileMetaData>>* blob_files) {
+	struct LogReporter : public Reader::Reporter {
+		const char* fname;
+		void Corruption(size_t bytes, const DBStatus& s) override {
+			// 尾部没写完整的记录直接丢弃，不影响前面已经写成功的数据
+			LOG(WARN, "%s: dropping %d bytes; %s", fname,
+			    static_cast<int>(bytes), s.message);
+		}
+	};
+
+	const std::string fname = LogFileName(dbname_, log_number);
+	FileReader file(fname);
+	LogReporter reporter;
+	reporter.fname = fname.c_str();
+	// 从start开始读时会跳过上一段中的记录的后半部分
+	Reader reader(&file, &reporter, true /*checksum*/, start /*initial_offset*/);
+
+	// 回放期间不会新建column family，按编号索引，这个WAL已经刷过盘的column family为nullptr
+	std::vector<ColumnFamilyData*> cfds(column_families_.rbegin()->first + 1, nullptr);
+	for (const auto& cf : column_families_) {
+		if (log_number >= cf.second->versions->LogNumber()) {
+			cfds[cf.first] = cf.second;
+		}
+	}
+
+	// 把memtable刷成cfd中L0的sst
+	auto flush = [this, files, blob_files](ColumnFamilyData* cfd, MemTable* mem) {
+		FileMetaData meta;
+		BlobFileMetaData blob;
+		{
+			std::lock_guard<std::mutex> l(mutex_);
+			meta.number = cfd->versions->NewFileNumber();
+			blob.number = cfd->versions->NewFileNumber();
+		}
+		DBStatus s = WriteLevel0Table(cfd, mem, &meta, &blob);
+		if (s == Status::kSuccess && meta.file_size > 0) {
+			(*files)[cfd->id].push_back(meta);
+		}
+		if (s == Status::kSuccess && blob.total_count > 0) {
+			(*blob_files)[cfd->id].push_back(blob);
+		}
+		return s;
+	};
+
+	// WAL中的每条记录都是一个完整的WriteBatch
+	DBStatus status = Status::kSuccess;
+	std::string scratch;
+	Slice record;
+	WriteBatch batch;
+	std::vector<MemTable*> mems(cfds.size(), nullptr);
+	while (reader.ReadRecord(&record, &scratch)) {
+		// 从下一段开始的记录由下一段负责
+		if (reader.LastRecordOffset() >= end) {
+			break;
+		}
+		if (record.size() < 12) {
+			reporter.Corruption(record.size(), Status::kCorruption);
+			continue;
+		}
+		for (size_t i = 0; i < cfds.size(); i++) {
+			if (cfds[i] != nullptr && mems[i] == nullptr) {
+				mems[i] = cfds[i]->NewMemTable();
+				mems[i]->Ref();
+			}
+		}
+		WriteBatchInternal::SetContents(&batch, record);
+		DBStatus s = WriteBatchInternal::InsertInto(&batch, mems);
+		if (s != Status::kSuccess) {
+			reporter.Corruption(record.size(), s);
+			continue;
+		}
+		const SequenceNumber last_seq = WriteBatchInternal::Sequence(&batch) +
+						WriteBatchInternal::Count(&batch) - 1;
+		*max_sequence = std::max(*max_sequence, last_seq);
+
+		for (size_t i = 0; i < cfds.size() && status == Status::kSuccess; i++) {
+			if (mems[i] != nullptr &&
+			    mems[i]->ApproximateMemoryUsage() > cfds[i]->options.write_buffer_size) {
+				status = flush(cfds[i], mems[i]);
+				mems[i]->Unref();
+				mems[i] = nullptr;
+			}
+		}
+		if (status != Status::kSuccess) {
+			break;
+		}
+	}
+	for (size_t i = 0; i < cfds.size(); i++) {
+		if (mems[i] == nullptr) {
+			continue;
+		}
+		if (status == Status::kSuccess && mems[i]->NumEntries() > 0) {
+			status = flush(cfds[i], mems[i]);
+		}
+		mems[i]->Unref();
+	}
+	return status;
+}
+
+DBStatus DB::CreateColumnFamily(const Options& options, const std::string& name,
+				ColumnFamilyHandle** handle) {
+	*handle = nullptr;
+	// 写MANIFEST期间会释放mutex_，不能让两个线程分到同一个编号或者创建同名的column family
+	std::lock_guard<std::mutex> create_lock(create_column_family_mutex_);
+	std::unique_lock<std::mutex> lock(mutex_);
+	ColumnFamilyData* cfd = nullptr;
+	DBStatus s = CreateColumnFamilyLocked(options, name, &cfd, lock);
+	if (s == Status::kSuccess) {
+		*handle = &cfd->handle;
+	}
+	return s;
+}
+
+DBStatus DB::CreateColumnFamilyLocked(const Options& options, const std::string& name,
+				      ColumnFamilyData** cfd,
+				      std::unique_lock<std::mutex>& lock) {
+	if (FindColumnFamily(name) != nullptr) {
+		LOG(ERROR, "column family %s already exists", name.c_str());
+		return Status::kInvalidArgument;
+	}
+	// 编号只增不减，已经创建的column family不会被删除
+	const uint32_t id = column_families_.rbegin()->first + 1;
+	const std::string dir = ColumnFamilyDirName(dbname_, id);
+	if (!FileTool::CreateDir(dir)) {
+		return Status::kIOError;
+	}
+	std::unique_ptr<ColumnFamilyData> new_cfd(new ColumnFamilyData(id, name, dir, options));
+	// 上次创建到一半的column family可能在目录下留下了MANIFEST，直接覆盖
+	DBStatus s = NewDB(new_cfd.get());
+	if (s == Status::kSuccess) {
+		s = new_cfd->versions->Recover();
+	}
+	if (s == Status::kSuccess) {
+		// 新的column family不需要回放之前的WAL
+		VersionEdit edit;
+		edit.SetLogNumber(logfile_number_);
+		new_cfd->mem_log_number = logfile_number_;
+		s = LogAndApply(new_cfd.get(), &edit, lock);
+	}
+	if (s == Status::kSuccess) {
+		// 写入默认column family的MANIFEST之后才算创建成功
+		VersionEdit edit;
+		edit.AddColumnFamily(id, name);
+		s = LogAndApply(default_cf_, &edit, lock);
+	}
+	if (s != Status::kSuccess) {
+		return s;
+	}
+	new_cfd->mem = new_cfd->NewMemTable();
+	new_cfd->mem->Ref();
+	*cfd = new_cfd.release();
+	column_families_[id] = *cfd;
+	UpdateTtlColumnFamilies();
+	return Status::kSuccess;
+}
+
+ColumnFamilyData* DB::FindColumnFamily(const std::string& name) const {
+	for (const auto& cf : column_families_) {
+		if (cf.second->name == name) {
+			return cf.second;
+		}
+	}
+	return nullptr;
+}
+
+ColumnFamilyHandle* DB::DefaultColumnFamily() const {
+	return &default_cf_->handle;
+}
+
+DBStatus DB::LogAndApply(ColumnFamilyData* cfd, VersionEdit* edit,
+			 std::unique_lock<std::mutex>& lock) {
+	// 刷盘之后WAL会被删除，重启时从所有MANIFEST中最大的顺序号继续分配
+	// WAL的编号由默认column family分配，edit中的log number也不能超出这个column family已经分配的编号
+	if (cfd != default_cf_) {
+		cfd->versions->SetLastSequence(versions_->LastSequence());
+		cfd->versions->MarkFileNumberUsed(logfile_number_);
+	}
+	return cfd->versions->LogAndApply(edit, lock);
+}
+
+DBStatus DB::NewLogFile() {
+	const uint64_t number = versions_->NewFileNumber();
+	FileWriter* file = new FileWriter(LogFileName(dbname_, number));
+	file->SetRateLimiter(options_.rate_limiter.get(), kIOHigh);
+	delete log_;
+	if (logfile_ != nullptr) {
+		logfile_->Close();
+		delete logfile_;
+	}
+	logfile_ = file;
+	logfile_number_ = number;
+	log_ = new Writer(logfile_);
+	return Status::kSuccess;
+}
+
+DBStatus DB::Put(const WriteOptions& options, const Slice& key, const Slice& value) {
+	return Put(options, DefaultColumnFamily(), key, value);
+}
+
+DBStatus DB::Delete(const WriteOptions& options, const Slice& key) {
+	return Delete(options, DefaultColumnFamily(), key);
+}
+
+DBStatus DB::DeleteRange(const WriteOptions& options, const Slice& begin_key,
+			 const Slice& end_key) {
+	return DeleteRange(options, DefaultColumnFamily(), begin_key, end_key);
+}
+
+DBStatus DB::Merge(const WriteOptions& options, const Slice& key, const Slice& value) {
+	return Merge(options, DefaultColumnFamily(), key, value);
+}
+
+DBStatus DB::Put(const WriteOptions& options, ColumnFamilyHandle* column_family,
+		 const Slice& key, const Slice& value) {
+	WriteBatch batch;
+	batch.Put(column_family, key, value);
+	return Write(options, &batch);
+}
+
+DBStatus DB::Delete(const WriteOptions& options, ColumnFamilyHandle* column_family,
+		    const Slice& key) {
+	WriteBatch batch;
+	batch.Delete(column_family, key);
+	return Write(options, &batch);
+}
+
+DBStatus DB::DeleteRange(const WriteOptions& options, ColumnFamilyHandle* column_family,
+			 const Slice& begin_key, const Slice& end_key) {
+	const Comparator* ucmp = column_family->cfd()->internal_comparator.user_comparator();
+	const int r = ucmp->Compare(begin_key, end_key);
+	if (r > 0) {
+		return Status::kInvalidArgument;
+	} else if (r == 0) {
+		return Status::kSuccess;
+	}
+	WriteBatch batch;
+	batch.DeleteRange(column_family, begin_key, end_key);
+	return Write(options, &batch);
+}
+
+DBStatus DB::Merge(const WriteOptions& options, ColumnFamilyHandle* column_family,
+		   const Slice& key, const Slice& value) {
+	const Options& cf_options = column_family->cfd()->options;
+	if (cf_options.merge_operator == nullptr || cf_options.ttl > 0) {
+		return Status::kInvalidArgument;
+	}
+	WriteBatch batch;
+	batch.Merge(column_family, key, value);
+	return Write(options, &batch);
+}
+
+namespace {
+// 复制batch中的操作，开启了TTL的column family的Put在value末尾追加写入时间
+class TtlTimestampInserter : public WriteBatch::Handler {
+public:
+	TtlTimestampInserter(const std::map<uint32_t, ColumnFamilyData*>* column_families,
+			     WriteBatch* result)
+		: column_families_(column_families), result_(result) {}
+
+	void Put(const Slice& key, const Slice& value) override { PutCF(0, key, value); }
+	void Delete(const Slice& key) override { DeleteCF(0, key); }
+	void DeleteRange(const Slice& begin_key, const Slice& end_key) override {
+		DeleteRangeCF(0, begin_key, end_key);
+	}
+	void Merge(const Slice& key, const Slice& value) override { MergeCF(0, key, value); }
+	void PutCF(uint32_t column_family_id, const Slice& key, const Slice& value) override {
+		ColumnFamilyData* cfd = Find(column_family_id);
+		if (cfd == nullptr) {
+			return;
+		}
+		if (cfd->options.ttl == 0) {
+			result_->Put(&cfd->handle, key, value);
+			return;
+		}
+		buffer_.assign(value.data(), value.size());
+		TtlCompactionFilter::AppendTimestamp(&buffer_);
+		result_->Put(&cfd->handle, key, buffer_);
+	}
+	void DeleteCF(uint32_t column_family_id, const Slice& key) override {
+		ColumnFamilyData* cfd = Find(column_family_id);
+		if (cfd != nullptr) {
+			result_->Delete(&cfd->handle, key);
+		}
+	}
+	void DeleteRangeCF(uint32_t column_family_id, const Slice& begin_key,
+			   const Slice& end_key) override {
+		ColumnFamilyData* cfd = Find(column_family_id);
+		if (cfd != nullptr) {
+			result_->DeleteRange(&cfd->handle, begin_key, end_key);
+		}
+	}
+	void MergeCF(uint32_t column_family_id, const Slice& key, const Slice& value) override {
+		ColumnFamilyData* cfd = Find(column_family_id);
+		if (cfd == nullptr) {
+			return;
+		}
+		if (cfd->options.ttl > 0) {
+			// 操作数没有写入时间，合并之后的value无法判断是否过期
+			status_ = Status::kInvalidArgument;
+			return;
+		}
+		result_->Merge(&cfd->handle, key, value);
+	}
+
+	DBStatus status() const { return status_; }
+
+private:
+	ColumnFamilyData* Find(uint32_t column_family_id) {
+		auto it = column_families_->find(column_family_id);
+		if (it == column_families_->end()) {
+			status_ = Status::kInvalidArgument;
+			return nullptr;
+		}
+		return it->second;
+	}
+
+	const std::map<uint32_t, ColumnFamilyData*>* const column_families_;
+	WriteBatch* const result_;
+	std::string buffer_;
+	DBStatus status_ = Status::kSuccess;
+};
+
+// batch中是否有写入开启了TTL的column family的Put或Merge，只检查不复制
+class TtlWriteDetector : public WriteBatch::Handler {
+public:
+	explicit TtlWriteDetector(const std::map<uint32_t, ColumnFamilyData*>* column_families)
+		: column_families_(column_families) {}
+
+	void Put(const Slice& /*key*/, const Slice& /*value*/) override { Check(0); }
+	void Delete(const Slice& /*key*/) override {}
+	void DeleteRange(const Slice& /*begin_key*/, const Slice& /*end_key*/) override {}
+	void Merge(const Slice& /*key*/, const Slice& /*value*/) override { Check(0); }
+	void PutCF(uint32_t column_family_id, const Slice& /*key*/, const Slice& /*value*/) override {
+		Check(column_family_id);
+	}
+	void MergeCF(uint32_t column_family_id, const Slice& /*key*/, const Slice& /*value*/) override {
+		Check(column_family_id);
+	}
+
+	bool found() const { return found_; }
+
+private:
+	void Check(uint32_t column_family_id) {
+		auto it = column_families_->find(column_family_id);
+		// 不存在的column family交给TtlTimestampInserter报错
+		found_ = found_ || it == column_families_->end() || it->second->options.ttl > 0;
+	}
+
+	const std::map<uint32_t, ColumnFamilyData*>* const column_families_;
+	bool found_ = false;
+};
+}  // namespace
+
+void DB::UpdateTtlColumnFamilies() {
+	std::shared_ptr<const std::map<uint32_t, ColumnFamilyData*>> ttl_column_families;
+	for (const auto& cf : column_families_) {
+		if (cf.second->options.ttl > 0) {
+			ttl_column_families =
+				std::make_shared<const std::map<uint32_t, ColumnFamilyData*>>(column_families_);
+			break;
+		}
+	}
+	std::atomic_store(&ttl_column_families_, std::move(ttl_column_families));
+}
+
+DBStatus DB::AddTtlTimestamps(const std::map<uint32_t, ColumnFamilyData*>& column_families,
+			      const WriteBatch& updates, WriteBatch* result) {
+	TtlTimestampInserter inserter(&column_families, result);
+	DBStatus s = updates.Iterate(&inserter);
+	if (s == Status::kSuccess) {
+		s = inserter.status();
+	}
+	return s;
+}
+
+DBStatus DB::Write(const WriteOptions& options, WriteBatch* updates) {
+	// batch写入了开启TTL的column family时写入改写之后的batch，调用者的batch保持不变
+	// 没有写入这些column family的batch只扫描一遍，不复制也不加锁
+	WriteBatch stamped;
+	std::shared_ptr<const std::map<uint32_t, ColumnFamilyData*>> ttl_column_families =
+		std::atomic_load(&ttl_column_families_);
+	if (ttl_column_families != nullptr) {
+		TtlWriteDetector detector(ttl_column_families.get());
+		DBStatus s = updates->Iterate(&detector);
+		if (s == Status::kSuccess && detector.found()) {
+			s = AddTtlTimestamps(*ttl_column_families, *updates, &stamped);
+			updates = &stamped;
+		}
+		if (s != Status::kSuccess) {
+			return s;
+		}
+	}
+	PendingWriter w(updates, options.sync);
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	writers_.push_back(&w);
+	// 等到自己成为leader，或者已经被前面的leader合并写入了
+	// 流水线写入时被合并的writer写完WAL就离开了writers_，只能等leader通知
+	while (!w.done && (w.group != nullptr || &w != writers_.front())) {
+		if (w.mems != nullptr) {
+			// leader写完了WAL，自己把batch插入memtable，同一组的writer都插入完成之后leader才会继续
+			const std::vector<MemTable*>* mems = w.mems;
+			w.mems = nullptr;
+			lock.unlock();
+			DBStatus s = WriteBatchInternal::InsertInto(w.batch, *mems, true);
+			lock.lock();
+			if (s != Status::kSuccess) {
+				w.leader->status = s;
+			}
+			if (--w.leader->pending_inserts == 0) {
+				w.leader->cv.notify_one();
+			}
+			continue;
+		}
+		w.cv.wait(lock);
+	}
+	if (w.done) {
+		return w.status;
+	}
+
+	const bool pipelined = options_.enable_pipelined_write;
+	WriteGroup group;
+	DBStatus s = MakeRoomForWrite(lock);
+	PendingWriter* last_writer = &w;
+	if (s == Status::kSuccess) {
+		// 流水线写入时上一组可能还在用合并好的batch插入memtable，每一组合并到自己的batch中
+		group.batch = BuildBatchGroup(&last_writer, pipelined ? &group.tmp_batch : tmp_batch_);
+	}
+	for (PendingWriter* writer : writers_) {
+		writer->group = &group;
+		group.writers.push_back(writer);
+		if (writer == last_writer) {
+			break;
+		}
+	}
+	bool wal_written = false;
+	if (s == Status::kSuccess) {
+		// 前面的组可能还没有插入完memtable、发布顺序号，从已经分配出去的顺序号之后继续分配
+		SequenceNumber sequence = last_allocated_sequence_ + 1;
+		WriteBatchInternal::SetSequence(group.batch, sequence);
+		if (options_.allow_concurrent_memtable_write && group.writers.size() > 1) {
+			// 每个writer各自插入memtable，按在组中的顺序给各自的batch分配顺序号
+			for (PendingWriter* writer : group.writers) {
+				WriteBatchInternal::SetSequence(writer->batch, sequence);
+				sequence += WriteBatchInternal::Count(writer->batch);
+			}
+		}
+		last_allocated_sequence_ += WriteBatchInternal::Count(group.batch);
+		group.last_sequence = last_allocated_sequence_;
+		// 流水线写入时切换memtable之前会等前面的组都插入完成，所以这一组插入时memtable不会变化
+		group.mems.assign(column_families_.rbegin()->first + 1, nullptr);
+		for (const auto& cf : column_families_) {
+			group.mems[cf.first] = cf.second->mem;
+		}
+
+		// 写WAL的时候可以释放锁，因为只有队头的leader会写log_，其他写线程都在writers_中排队
+		lock.unlock();
+		s = log_->AddRecord(WriteBatchInternal::Contents(group.batch));
+		if (s == Status::kSuccess) {
+			if (w.sync) {
+				s = logfile_->Sync();
+			} else {
+				// 至少写到内核缓冲区，进程崩溃时不会丢数据
+				s = logfile_->Flush();
+			}
+		}
+		lock.lock();
+		wal_written = (s == Status::kSuccess);
+	}
+
+	if (pipelined) {
+		// WAL写完就让出队头，下一组可以在这一组插入memtable的同时写WAL
+		writers_.erase(writers_.begin(), writers_.begin() + group.writers.size());
+		if (!writers_.empty()) {
+			writers_.front()->cv.notify_one();
+		}
+		if (wal_written) {
+			// 各组按写WAL的顺序插入memtable、发布顺序号
+			memtable_groups_.push_back(&group);
+			while (memtable_groups_.front() != &group) {
+				w.cv.wait(lock);
+			}
+		}
+	}
+	if (wal_written) {
+		s = InsertWriteGroup(&group, lock);
+		// 这一组之前的顺序号都已经插入memtable了，读操作可以看到
+		versions_->SetLastSequence(group.last_sequence);
+	}
+	if (s != Status::kSuccess) {
+		// WAL写失败之后无法确定文件中的状态，后续的写操作全部拒绝
+		bg_error_ = s;
+	}
+	if (group.batch == tmp_batch_) {
+		tmp_batch_->Clear();
+	}
+	if (pipelined && wal_written) {
+		memtable_groups_.pop_front();
+		if (!memtable_groups_.empty()) {
+			memtable_groups_.front()->writers.front()->cv.notify_one();
+		} else {
+			// MakeRoomForWrite可能在等所有组插入完成之后切换memtable
+			background_work_finished_cv_.notify_all();
+		}
+	}
+
+	// 唤醒被合并写入的follower
+	for (PendingWriter* writer : group.writers) {
+		if (writer != &w) {
+			writer->status = s;
+			writer->done = true;
+			writer->cv.notify_one();
+		}
+	}
+	if (!pipelined) {
+		writers_.erase(writers_.begin(), writers_.begin() + group.writers.size());
+		// 唤醒下一个leader
+		if (!writers_.empty()) {
+			writers_.front()->cv.notify_one();
+		}
+	}
+	return s;
+}
+
+DBStatus DB::InsertWriteGroup(WriteGroup* group, std::unique_lock<std::mutex>& lock) {
+	PendingWriter* leader = group->writers.front();
+	if (!options_.allow_concurrent_memtable_write || group->writers.size() == 1) {
+		lock.unlock();
+		DBStatus s = WriteBatchInternal::InsertInto(group->batch, group->mems);
+		lock.lock();
+		return s;
+	}
+	// 在leader插入的同时唤醒组中的follower一起插入
+	for (size_t i = 1; i < group->writers.size(); i++) {
+		PendingWriter* writer = group->writers[i];
+		writer->mems = &group->mems;
+		writer->leader = leader;
+		leader->pending_inserts++;
+		writer->cv.notify_one();
+	}
+	lock.unlock();
+	DBStatus s = WriteBatchInternal::InsertInto(leader->batch, group->mems, true);
+	lock.lock();
+	// 所有follower插入完成之后才能发布顺序号，否则读操作可能看到一部分写入
+	while (leader->pending_inserts > 0) {
+		leader->cv.wait(lock);
+	}
+	if (s == Status::kSuccess) {
+		s = leader->status;
+	}
+	return s;
+}
+
+WriteBatch* DB::BuildBatchGroup(PendingWriter** last_writer, WriteBatch* tmp_batch) {
+	assert(!writers_.empty());
+	PendingWriter* first = writers_.front();
+	WriteBatch* result = first->batch;
+
+	// 合并后的batch不能太大，否则会拖慢单个写入的延迟
+	// 如果第一个batch很小，合并的上限也相应调小
+	size_t size = WriteBatchInternal::ByteSize(first->batch);
+	size_t max_size = 1 << 20;
+	if (size <= (128 << 10)) {
+		max_size = size + (128 << 10);
+	}
+
+	*last_writer = first;
+	auto iter = writers_.begin();
+	++iter;
+	for (; iter != writers_.end(); ++iter) {
+		PendingWriter* w = *iter;
+		if (w->sync && !first->sync) {
+			// 需要sync的写入不能合并到不sync的leader中
+			break;
+		}
+		size += WriteBatchInternal::ByteSize(w->batch);
+		if (size > max_size) {
+			break;
+		}
+		// 不能直接修改调用者的batch，合并到tmp_batch中
+		if (result == first->batch) {
+			result = tmp_batch;
+			assert(WriteBatchInternal::Count(result) == 0);
+			WriteBatchInternal::Append(result, first->batch);
+		}
+		WriteBatchInternal::Append(result, w->batch);
+		*last_writer = w;
+	}
+	return result;
+}
+
+DBStatus DB::MakeRoomForWrite(std::unique_lock<std::mutex>& lock) {
+	bool allow_delay = true;
+	while (true) {
+		if (bg_error_ != Status::kSuccess) {
+			return bg_error_;
+		}
+		bool slowdown = false;
+		bool wait = false;
+		// memtable写满了、可以切换的column family
+		std::vector<ColumnFamilyData*> full;
+		for (const auto& cf : column_families_) {
+			ColumnFamilyData* cfd = cf.second;
+			const int l0_files = cfd->versions->NumLevelFiles(0);
+			if (l0_files >= config::kL0_SlowdownWritesTrigger) {
+				slowdown = true;
+			}
+			if (cfd->mem->ApproximateMemoryUsage() <= cfd->options.write_buffer_size) {
+				continue;
+			}
+			if (cfd->imm != nullptr || l0_files >= config::kL0_StopWritesTrigger) {
+				// 上一个memtable还没有刷完，或者L0的文件太多了，等后台线程
+				wait = true;
+			} else {
+				full.push_back(cfd);
+			}
+		}
+		if (allow_delay && slowdown) {
+			// L0的文件快要太多了，每次写入延迟1ms，让compaction跟上
+			// 把延迟分摊到每次写入上，而不是等到L0满了之后让某一次写入阻塞很久
+			lock.unlock();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			allow_delay = false;
+			lock.lock();
+		} else if (wait) {
+			background_work_finished_cv_.wait(lock);
+		} else if (full.empty()) {
+			return Status::kSuccess;
+		} else if (!memtable_groups_.empty()) {
+			// 流水线写入时前面的组还在插入当前的memtable，等它们完成之后才能切换
+			background_work_finished_cv_.wait(lock);
+		} else {
+			// 切换到新的WAL，写满的memtable交给后台线程刷盘，它们的数据都在之前的WAL中
+			DBStatus s = NewLogFile();
+			if (s != Status::kSuccess) {
+				return s;
+			}
+			for (ColumnFamilyData* cfd : full) {
+				cfd->imm = cfd->mem;
+				cfd->mem = cfd->NewMemTable();
+				cfd->mem->Ref();
+				cfd->mem_log_number = logfile_number_;
+			}
+			has_imm_.store(true, std::memory_order_release);
+			background_work_cv_.notify_one();
+		}
+	}
+}
+
+bool DB::NeedsCompaction() const {
+	for (const auto& cf : column_families_) {
+		if (cf.second->versions->NeedsCompaction()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void DB::BackgroundCall() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true) {
+		while (!shutting_down_.load(std::memory_order_acquire) &&
+		       !has_imm_.load(std::memory_order_acquire) &&
+		       (bg_error_ != Status::kSuccess || !NeedsCompaction())) {
+			background_work_cv_.wait(lock);
+		}
+		if (shutting_down_.load(std::memory_order_acquire)) {
+			// imm对应的WAL还在，下次打开时会回放
+			break;
+		}
+		BackgroundCompaction(lock);
+		background_work_finished_cv_.notify_all();
+	}
+	background_work_finished_cv_.notify_all();
+}
+
+void DB::BackgroundCompaction(std::unique_lock<std::mutex>& lock) {
+	if (has_imm_.load(std::memory_order_acquire)) {
+		FlushImmutableMemTable(lock);
+		return;
+	}
+
+	// 从上次compaction的下一个column family开始找，避免写入多的column family一直占着后台线程
+	ColumnFamilyData* cfd = nullptr;
+	std::unique_ptr<Compaction> c;
+	auto start = column_families_.lower_bound(next_compaction_cf_);
+	for (size_t i = 0; i < column_families_.size() && c == nullptr; i++, start++) {
+		if (start == column_families_.end()) {
+			start = column_families_.begin();
+		}
+		cfd = start->second;
+		c.reset(cfd->versions->PickCompaction());
+	}
+	if (c == nullptr) {
+		return;
+	}
+	next_compaction_cf_ = cfd->id + 1;
+	if (c->IsTrivialMove()) {
+		// 直接把文件移到下一层，不需要读写数据
+		const FileMetaData& f = c->input(0, 0)->meta;
+		c->edit()->RemoveFile(c->level(), f.number);
+		c->edit()->AddFile(c->output_level(), f);
+		DBStatus s = LogAndApply(cfd, c->edit(), lock);
+		if (s != Status::kSuccess && !shutting_down_.load(std::memory_order_acquire)) {
+			LOG(ERROR, "trivial move failed: %s", s.message);
+			bg_error_ = s;
+		}
+		return;
+	}
+
+	CompactionState compact(cfd, c.get());
+	DBStatus s = DoCompactionWork(&compact, lock);
+	if (s == Status::kSuccess) {
+		// 所有subcompaction的输出在同一个VersionEdit中一起生效
+		c->AddInputDeletions(c->edit());
+		for (const auto& sub : compact.subcompactions) {
+			for (const auto& out : sub->outputs) {
+				c->edit()->AddFile(c->output_level(), out);
+			}
+			if (sub->blob != nullptr && !sub->blob->Empty()) {
+				c->edit()->AddBlobFile(sub->blob->meta());
+			}
+		}
+		s = LogAndApply(cfd, c->edit(), lock);
+	}
+	for (const auto& sub : compact.subcompactions) {
+		// 最后一个输出文件可能没有写完，也要从pending_outputs中去掉
+		cfd->pending_outputs.erase(sub->current_output.number);
+		for (const auto& out : sub->outputs) {
+			cfd->pending_outputs.erase(out.number);
+		}
+		if (sub->blob != nullptr) {
+			cfd->pending_outputs.erase(sub->blob->meta().number);
+		}
+	}
+	if (s != Status::kSuccess && !shutting_down_.load(std::memory_order_acquire)) {
+		LOG(ERROR, "compaction failed: %s", s.message);
+		bg_error_ = s;
+	}
+	// compaction持有输入的Version，先释放掉，否则输入文件会被当成还在使用
+	compact.subcompactions.clear();
+	c.reset();
+	// 输入文件已经不在新的Version中了，失败时没有生效的输出文件也一起删掉
+	RemoveObsoleteFiles();
+}
+
+DBStatus DB::DoCompactionWork(CompactionState* compact,
+			      std::unique_lock<std::mutex>& lock) {
+	ColumnFamilyData* cfd = compact->cfd;
+	Compaction* c = compact->compaction;
+	// 最旧的快照能看到的版本都要保留
+	if (snapshots_.Empty()) {
+		compact->smallest_snapshot = versions_->LastSequence();
+		compact->newest_snapshot = 0;
+	} else {
+		compact->smallest_snapshot = snapshots_.Oldest()->sequence_number();
+		compact->newest_snapshot = snapshots_.Newest()->sequence_number();
+	}
+	// 按分界点把输入切成互不重叠的key范围，每个范围有自己的输入迭代器
+	std::vector<std::string> boundaries;
+	c->GetSubcompactionBoundaries(cfd->options.max_subcompactions, &boundaries);
+	for (size_t i = 0; i <= boundaries.size(); i++) {
+		std::unique_ptr<SubcompactionState> sub(new SubcompactionState);
+		if (i > 0) {
+			sub->start = boundaries[i - 1];
+			sub->has_start = true;
+			// 范围删除也按subcompaction的边界切开
+			sub->range_del_lower = sub->start;
+			sub->has_range_del_lower = true;
+		}
+		if (i < boundaries.size()) {
+			sub->end = boundaries[i];
+			sub->has_end = true;
+		}
+		sub->input.reset(cfd->versions->MakeInputIterator(c));
+		compact->subcompactions.push_back(std::move(sub));
+	}
+
+	// 合并期间释放锁，不影响前台的读写
+	lock.unlock();
+
+	std::vector<RangeTombstone> tombstones;
+	c->AddInputRangeTombstones(&tombstones);
+	if (!tombstones.empty()) {
+		compact->range_del.reset(new FragmentedRangeTombstoneList(
+			cfd->internal_comparator.user_comparator(), std::move(tombstones)));
+	}
+
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < compact->subcompactions.size(); i++) {
+		threads.emplace_back(&DB::DoSubcompactionWork, this, compact,
+				     compact->subcompactions[i].get());
+	}
+	DoSubcompactionWork(compact, compact->subcompactions[0].get());
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	DBStatus s = Status::kSuccess;
+	for (const auto& sub : compact->subcompactions) {
+		if (s == Status::kSuccess) {
+			s = sub->status;
+		}
+		for (const auto& garbage : sub->blob_garbage) {
+			c->edit()->AddBlobGarbage(garbage.first, 1, garbage.second);
+		}
+		sub->input.reset();
+	}
+
+	lock.lock();
+	return s;
+}
+
+void DB::DoSubcompactionWork(CompactionState* compact, SubcompactionState* sub) {
+	ColumnFamilyData* cfd = compact->cfd;
+	Compaction* c = compact->compaction;
+	Iterator* input = sub->input.get();
+	// 只在分配文件编号和刷immutable memtable时加锁
+	std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+	const bool flush_imm = (sub == compact->subcompactions[0].get());
+
+	const Comparator* ucmp = cfd->internal_comparator.user_comparator();
+	DBStatus s = Status::kSuccess;
+	ParsedInternalKey ikey;
+	std::string current_user_key;
+	bool has_current_user_key = false;
+	SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
+	if (sub->has_start) {
+		InternalKey start_key(sub->start, kMaxSequenceNumber, kValueTypeForSeek);
+		input->Seek(start_key.Encode());
+	} else {
+		input->SeekToFirst();
+	}
+	while (input->Valid() && !shutting_down_.load(std::memory_order_acquire)) {
+		// 优先把immutable memtable刷盘，避免前台写入被长时间的compaction阻塞
+		// 任何一个column family的imm都会阻塞所有的写入，不只是正在compaction的这个
+		if (flush_imm && has_imm_.load(std::memory_order_acquire)) {
+			lock.lock();
+			FlushImmutableMemTable(lock);
+			background_work_finished_cv_.notify_all();
+			lock.unlock();
+		}
+
+		Slice key = input->key();
+		bool drop = false;
+		bool new_user_key = true;
+		bool filter_candidate = false;
+		if (!ParseInternalKey(key, &ikey)) {
+			// 不认识的key原样保留
+			current_user_key.clear();
+			has_current_user_key = false;
+			last_sequence_for_key = kMaxSequenceNumber;
+		} else {
+			if (sub->has_end && ucmp->Compare(ikey.user_key, sub->end) >= 0) {
+				// 剩下的key属于下一个subcompaction
+				break;
+			}
+			if (!has_current_user_key ||
+			    ucmp->Compare(ikey.user_key, current_user_key) != 0) {
+				// 第一次遇到这个user key
+				current_user_key.assign(ikey.user_key.data(), ikey.user_key.size());
+				has_current_user_key = true;
+				last_sequence_for_key = kMaxSequenceNumber;
+			} else {
+				new_user_key = false;
+			}
+			// 只过滤user key的最新版本，而且不能被任何快照读到，快照中的数据不会因为过滤而改变
+			filter_candidate = (cfd->compaction_filter != nullptr &&
+					    last_sequence_for_key == kMaxSequenceNumber &&
+					    ikey.sequence > compact->newest_snapshot &&
+					    (ikey.type == kTypeValue || ikey.type == kTypeBlobIndex));
+
+			if (last_sequence_for_key <= compact->smallest_snapshot) {
+				// 有更新的版本，而且更新的版本对所有读操作都可见，这个版本不会再被读到
+				drop = true;
+			} else if (ikey.type == kTypeDeletion &&
+				   ikey.sequence <= compact->smallest_snapshot &&
+				   c->IsBaseLevelForKey(ikey.user_key, &sub->level_ptrs)) {
+				// 更深的层中没有这个key，更旧的版本也会在这次compaction中被丢弃，
+				// 删除标记已经没有用了
+				drop = true;
+			} else if (compact->range_del != nullptr &&
+				   compact->range_del->MaxCoveringSeq(ikey.user_key,
+								      compact->smallest_snapshot) >
+					   ikey.sequence) {
+				// 被一个对所有读操作都可见的范围删除覆盖了，删除标记也一样丢弃，不需要改写
+				drop = true;
+			}
+			last_sequence_for_key = ikey.sequence;
+		}
+
+		Slice value = input->value();
+		if (!drop && filter_candidate) {
+			s = ApplyCompactionFilter(compact, sub, &ikey, &key, &value, &drop);
+			if (s != Status::kSuccess) {
+				break;
+			}
+		}
+		// 对所有读操作都可见的merge操作数和更旧的版本合并，合并时input已经前进了
+		bool advanced = false;
+		if (!drop && has_current_user_key && ikey.type == kTypeMerge &&
+		    ikey.sequence <= compact->smallest_snapshot &&
+		    cfd->options.merge_operator != nullptr) {
+			s = MergeCompactionOperands(compact, sub, &ikey, &key, &value);
+			if (s != Status::kSuccess) {
+				break;
+			}
+			advanced = true;
+		}
+		if (drop && ikey.type == kTypeBlobIndex) {
+			// 丢弃的BlobIndex指向的record变成了垃圾
+			BlobIndex index;
+			if (index.DecodeFrom(value) == Status::kSuccess) {
+				sub->blob_garbage.emplace_back(index.file_number, index.size);
+			}
+		} else if (!drop && has_current_user_key) {
+			s = SeparateCompactionValue(compact, sub, ikey, &key, &value, lock);
+			if (s != Status::kSuccess) {
+				break;
+			}
+		}
+
+		if (!drop) {
+			// 同一个user key的所有版本放在同一个文件中，保证下层文件之间的user key不重叠
+			if (sub->builder != nullptr && new_user_key && has_current_user_key &&
+			    sub->builder->GetFileSize() >= c->MaxOutputFileSize()) {
+				const Slice next_user_key(current_user_key);
+				s = FinishCompactionOutputFile(compact, sub, &next_user_key);
+				if (s != Status::kSuccess) {
+					break;
+				}
+			}
+			if (sub->builder == nullptr) {
+				lock.lock();
+				sub->current_output.number = cfd->versions->NewFileNumber();
+				cfd->pending_outputs.insert(sub->current_output.number);
+				lock.unlock();
+				s = OpenCompactionOutputFile(compact, sub);
+				if (s != Status::kSuccess) {
+					break;
+				}
+				sub->current_output.smallest.DecodeFrom(key);
+				sub->current_output.smallest_seq = kMaxSequenceNumber;
+				sub->current_output.largest_seq = 0;
+			}
+			sub->current_output.largest.DecodeFrom(key);
+			sub->current_output.smallest_seq =
+				std::min(sub->current_output.smallest_seq, ikey.sequence);
+			sub->current_output.largest_seq =
+				std::max(sub->current_output.largest_seq, ikey.sequence);
+			sub->builder->Add(key.ToString(), value.ToString());
+		}
+		if (!advanced) {
+			input->Next();
+		}
+	}
+
+	if (s == Status::kSuccess && shutting_down_.load(std::memory_order_acquire)) {
+		s = Status::kInterupt;
+	}
+	if (s == Status::kSuccess && sub->builder == nullptr &&
+	    compact->range_del != nullptr) {
+		// 最后一个文件之后(或者所有的key都被丢弃之后)可能还有范围删除需要保留
+		lock.lock();
+		sub->current_output.number = cfd->versions->NewFileNumber();
+		cfd->pending_outputs.insert(sub->current_output.number);
+		lock.unlock();
+		s = OpenCompactionOutputFile(compact, sub);
+		sub->current_output.smallest_seq = kMaxSequenceNumber;
+		sub->current_output.largest_seq = 0;
+	}
+	if (s == Status::kSuccess && sub->builder != nullptr) {
+		const Slice end(sub->end);
+		s = FinishCompactionOutputFile(compact, sub, sub->has_end ? &end : nullptr);
+	}
+	if (s == Status::kSuccess) {
+		s = input->status();
+	}
+	// 输出的sst中的BlobIndex指向的数据必须在新Version生效之前落盘
+	if (s == Status::kSuccess && sub->blob != nullptr) {
+		s = sub->blob->Finish();
+	}
+	if (s != Status::kSuccess && sub->blob != nullptr) {
+		sub->blob->Abandon();
+	}
+	if (sub->builder != nullptr) {
+		// 出错时还没有写完的输出文件
+		sub->builder.reset();
+		sub->outfile->Close();
+		sub->outfile.reset();
+		FileTool::RemoveFile(TempFileName(cfd->dbname, sub->current_output.number));
+	}
+	sub->status = s;
+}
+
+DBStatus DB::ApplyCompactionFilter(CompactionState* compact, SubcompactionState* sub,
+				   ParsedInternalKey* ikey, Slice* key, Slice* value,
+				   bool* drop) {
+	ColumnFamilyData* cfd = compact->cfd;
+	Compaction* c = compact->compaction;
+	// kv分离的value先从blob文件中读出来
+	Slice existing = *value;
+	BlobIndex index;
+	if (ikey->type == kTypeBlobIndex) {
+		DBStatus s = index.DecodeFrom(*value);
+		if (s == Status::kSuccess) {
+			s = c->GetBlob(ikey->user_key, *value, &sub->filter_value);
+		}
+		if (s != Status::kSuccess) {
+			return s;
+		}
+		existing = sub->filter_value;
+	}
+
+	sub->filter_new_value.clear();
+	bool value_changed = false;
+	const bool remove = cfd->compaction_filter->Filter(
+		c->level(), ikey->user_key, existing, &sub->filter_new_value, &value_changed);
+	if (remove) {
+		if (ikey->sequence <= compact->smallest_snapshot &&
+		    c->IsBaseLevelForKey(ikey->user_key, &sub->level_ptrs)) {
+			// 更旧的版本会在这次compaction中被丢弃，更深的层中也没有这个key，直接丢弃
+			// BlobIndex指向的record由调用者记为垃圾
+			*drop = true;
+			return Status::kSuccess;
+		}
+		// 还有更旧的版本可能被读到，改写成删除标记把它们盖住
+		if (ikey->type == kTypeBlobIndex) {
+			sub->blob_garbage.emplace_back(index.file_number, index.size);
+		}
+		ikey->type = kTypeDeletion;
+		sub->filter_key.clear();
+		AppendInternalKey(&sub->filter_key, *ikey);
+		*key = sub->filter_key;
+		*value = Slice();
+		return Status::kSuccess;
+	}
+	if (value_changed) {
+		// 新的value按普通的value处理，足够大时由SeparateCompactionValue重新做kv分离
+		if (ikey->type == kTypeBlobIndex) {
+			sub->blob_garbage.emplace_back(index.file_number, index.size);
+			ikey->type = kTypeValue;
+			sub->filter_key.clear();
+			AppendInternalKey(&sub->filter_key, *ikey);
+			*key = sub->filter_key;
+		}
+		*value = sub->filter_new_value;
+	}
+	return Status::kSuccess;
+}
+
+DBStatus DB::MergeCompactionOperands(CompactionState* compact, SubcompactionState* sub,
+				     ParsedInternalKey* ikey, Slice* key, Slice* value) {
+	ColumnFamilyData* cfd = compact->cfd;
+	Compaction* c = compact->compaction;
+	const Comparator* ucmp = cfd->internal_comparator.user_comparator();
+	const MergeOperator* merge_operator = cfd->options.merge_operator.get();
+	Iterator* input = sub->input.get();
+	// input前进之后key和value就失效了，先保存下来
+	sub->merge_key.assign(key->data(), key->size());
+	sub->merge_value.assign(value->data(), value->size());
+	const Slice user_key = ExtractUserKey(sub->merge_key);
+	MergeContext& merge_context = sub->merge_context;
+	merge_context.Clear();
+	merge_context.PushOperand(*value);
+
+	// 找到了旧值: 完整的value、删除标记或者范围删除，旧值本身留在input中，
+	// 它之前有对所有读操作都可见的新版本，主循环会把它丢弃
+	bool has_base = false;
+	Slice base_value;
+	const Slice* base = nullptr;
+	ParsedInternalKey next;
+	for (input->Next(); input->Valid(); input->Next()) {
+		if (!ParseInternalKey(input->key(), &next) ||
+		    ucmp->Compare(next.user_key, user_key) != 0) {
+			break;
+		}
+		if (compact->range_del != nullptr &&
+		    compact->range_del->MaxCoveringSeq(user_key, compact->smallest_snapshot) >
+			    next.sequence) {
+			has_base = true;
+			break;
+		}
+		if (next.type == kTypeMerge) {
+			merge_context.PushOperand(input->value());
+			continue;
+		}
+		has_base = true;
+		if (next.type == kTypeValue) {
+			sub->merge_base.assign(input->value().data(), input->value().size());
+			base_value = sub->merge_base;
+			base = &base_value;
+		} else if (next.type == kTypeBlobIndex) {
+			DBStatus s = c->GetBlob(user_key, input->value(), &sub->merge_base);
+			if (s != Status::kSuccess) {
+				return s;
+			}
+			base_value = sub->merge_base;
+			base = &base_value;
+		}
+		break;
+	}
+	if (!has_base) {
+		// 更深的层中没有这个key时，相当于合并到不存在的key上
+		has_base = c->IsBaseLevelForKey(user_key, &sub->level_ptrs);
+	}
+
+	DBStatus s = Status::kSuccess;
+	if (has_base) {
+		s = merge_context.FullMerge(merge_operator, user_key, base, &sub->merge_value);
+		if (s == Status::kSuccess) {
+			// 合并成了完整的value，顺序号不变，值类型改成kTypeValue
+			ikey->type = kTypeValue;
+			EncodeFixed64(&sub->merge_key[sub->merge_key.size() - 8],
+				      PackSequenceAndType(ikey->sequence, kTypeValue));
+		}
+	} else if (merge_context.NumOperands() > 1) {
+		// 更深的层中可能还有旧值，先把这些操作数合并成一个
+		s = merge_context.PartialMerge(merge_operator, user_key, &sub->merge_value);
+	}
+	ikey->user_key = user_key;
+	*key = sub->merge_key;
+	*value = sub->merge_value;
+	return s;
+}
+
+DBStatus DB::SeparateCompactionValue(CompactionState* compact, SubcompactionState* sub,
+				     const ParsedInternalKey& ikey, Slice* key,
+				     Slice* value, std::unique_lock<std::mutex>& lock) {
+	ColumnFamilyData* cfd = compact->cfd;
+	Compaction* c = compact->compaction;
+	if (ikey.type == kTypeBlobIndex) {
+		BlobIndex index;
+		DBStatus s = index.DecodeFrom(*value);
+		if (s != Status::kSuccess) {
+			return s;
+		}
+		if (!c->ShouldRelocateBlob(index.file_number)) {
+			// 只重写sst中的BlobIndex，value留在原来的blob文件中
+			return Status::kSuccess;
+		}
+		s = c->GetBlob(ikey.user_key, *value, &sub->blob_value);
+		if (s != Status::kSuccess) {
+			return s;
+		}
+		sub->blob_garbage.emplace_back(index.file_number, index.size);
+		*value = sub->blob_value;
+	} else if (ikey.type != kTypeValue || cfd->options.max_key_value_split_threshold == 0 ||
+		   value->size() < cfd->options.max_key_value_split_threshold) {
+		return Status::kSuccess;
+	}
+
+	if (sub->blob == nullptr) {
+		lock.lock();
+		const uint64_t number = cfd->versions->NewFileNumber();
+		cfd->pending_outputs.insert(number);
+		lock.unlock();
+		sub->blob.reset(new BlobFileBuilder(cfd->dbname, number,
+						    cfd->options.max_key_value_split_threshold));
+		sub->blob->SetRateLimiter(options_.rate_limiter.get(), kIOLow);
+	}
+	DBStatus s = sub->blob->Add(ikey.user_key, *value, &sub->blob_index);
+	if (s != Status::kSuccess) {
+		return s;
+	}
+	sub->blob_key.clear();
+	AppendInternalKey(&sub->blob_key,
+			  ParsedInternalKey(ikey.user_key, ikey.sequence, kTypeBlobIndex));
+	*key = sub->blob_key;
+	*value = sub->blob_index;
+	return Status::kSuccess;
+}
+
+DBStatus DB::OpenCompactionOutputFile(CompactionState* compact, SubcompactionState* sub) {
+	assert(sub->builder == nullptr);
+	ColumnFamilyData* cfd = compact->cfd;
+	sub->outfile.reset(
+		new FileWriter(TempFileName(cfd->dbname, sub->current_output.number)));
+	sub->outfile->SetRateLimiter(options_.rate_limiter.get(), kIOLow);
+	sub->builder.reset(new TableBuilder(cfd->table_options, sub->outfile.get()));
+	return Status::kSuccess;
+}
+
+DBStatus DB::FinishCompactionOutputFile(CompactionState* compact, SubcompactionState* sub,
+				       const Slice* next_user_key) {
+	assert(sub->builder != nullptr);
+	ColumnFamilyData* cfd = compact->cfd;
+	FileMetaData& meta = sub->current_output;
+	const std::string tmp_name = TempFileName(cfd->dbname, meta.number);
+	const std::string fname = TableFileName(cfd->dbname, meta.number);
+
+	// 范围删除按输出文件的边界切开，每个文件只保存[range_del_lower, next_user_key)中的部分，
+	// 这样输出文件之间不会重叠，文件之间的空隙也仍然被覆盖
+	if (compact->range_del != nullptr) {
+		const Comparator* ucmp = cfd->internal_comparator.user_comparator();
+		Compaction* c = compact->compaction;
+		bool has_bounds = sub->builder->GetEntryNum() > 0;
+		for (const auto& f : compact->range_del->fragments()) {
+			Slice start(f.start);
+			Slice end(f.end);
+			if (sub->has_range_del_lower &&
+			    ucmp->Compare(start, sub->range_del_lower) < 0) {
+				start = sub->range_del_lower;
+			}
+			if (next_user_key != nullptr && ucmp->Compare(end, *next_user_key) > 0) {
+				end = *next_user_key;
+			}
+			if (ucmp->Compare(start, end) >= 0) {
+				continue;
+			}
+			// 对所有读操作都可见的版本只需要保留最新的一个，更深的层中没有数据时一个也不需要
+			const bool base_level = c->IsBaseLevelForRange(start, end);
+			bool kept_visible = false;
+			for (size_t i = f.seq_begin; i < f.seq_end; i++) {
+				const SequenceNumber seq = compact->range_del->seq(i);
+				if (seq <= compact->smallest_snapshot) {
+					if (kept_visible || base_level) {
+						continue;
+					}
+					kept_visible = true;
+				}
+				InternalKey start_key(start, seq, kTypeRangeDeletion);
+				InternalKey end_key(end, kMaxSequenceNumber, kTypeRangeDeletion);
+				sub->builder->AddRangeTombstone(start_key.Encode().ToString(),
+								    end.ToString());
+				if (!has_bounds ||
+				    cfd->internal_comparator.Compare(start_key, meta.smallest) < 0) {
+					meta.smallest = start_key;
+				}
+				if (!has_bounds ||
+				    cfd->internal_comparator.Compare(end_key, meta.largest) > 0) {
+					meta.largest = end_key;
+				}
+				has_bounds = true;
+				meta.smallest_seq = std::min(meta.smallest_seq, seq);
+				meta.largest_seq = std::max(meta.largest_seq, seq);
+			}
+		}
+	}
+	if (next_user_key != nullptr) {
+		sub->range_del_lower.assign(next_user_key->data(), next_user_key->size());
+		sub->has_range_del_lower = true;
+	}
+	if (sub->builder->GetEntryNum() == 0 &&
+	    sub->builder->GetRangeTombstoneNum() == 0) {
+		// 只为范围删除打开的文件，但是范围删除都不需要保留了
+		sub->builder.reset();
+		sub->outfile->Close();
+		sub->outfile.reset();
+		FileTool::RemoveFile(tmp_name);
+		return Status::kSuccess;
+	}
+
+	sub->builder->Finish();
+	DBStatus s = sub->builder->Success() ? Status::kSuccess
+						 : Status::kWriteFileFailed;
+	sub->builder.reset();
+	if (s == Status::kSuccess) {
+		s = sub->outfile->Sync();
+	}
+	sub->outfile->Close();
+	sub->outfile.reset();
+	if (s == Status::kSuccess && !FileTool::Rename(tmp_name, fname)) {
+		s = Status::kIOError;
+	}
+	if (s != Status::kSuccess) {
+		FileTool::RemoveFile(tmp_name);
+		return s;
+	}
+
+	meta.file_size = FileTool::GetFileSize(fname);
+	sub->outputs.push_back(meta);
+	return s;
+}
+
+void DB::FlushImmutableMemTable(std::unique_lock<std::mutex>& lock) {
+	for (const auto& cf : column_families_) {
+		if (cf.second->imm != nullptr) {
+			CompactMemTable(cf.second, lock);
+			return;
+		}
+	}
+}
+
+void DB::CompactMemTable(ColumnFamilyData* cfd, std::unique_lock<std::mutex>& lock) {
+	assert(cfd->imm != nullptr);
+	MemTable* imm = cfd->imm;
+	FileMetaData meta;
+	meta.number = cfd->versions->NewFileNumber();
+	BlobFileMetaData blob;
+	blob.number = cfd->versions->NewFileNumber();
+	cfd->pending_outputs.insert(meta.number);
+	cfd->pending_outputs.insert(blob.number);
+
+	lock.unlock();
+	DBStatus s = WriteLevel0Table(cfd, imm, &meta, &blob);
+	lock.lock();
+
+	if (s == Status::kSuccess) {
+		// imm的数据都在mem_log_number之前的WAL中，刷盘之后这个column family就不再需要它们了
+		VersionEdit edit;
+		if (meta.file_size > 0) {
+			edit.AddFile(0, meta);
+		}
+		if (blob.total_count > 0) {
+			edit.AddBlobFile(blob);
+		}
+		edit.SetLogNumber(cfd->mem_log_number);
+		s = LogAndApply(cfd, &edit, lock);
+	}
+	cfd->pending_outputs.erase(meta.number);
+	cfd->pending_outputs.erase(blob.number);
+	if (s != Status::kSuccess) {
+		LOG(ERROR, "flush memtable failed: %s", s.message);
+		bg_error_ = s;
+		return;
+	}
+	cfd->imm->Unref();
+	cfd->imm = nullptr;
+	bool has_imm = false;
+	for (const auto& cf : column_families_) {
+		has_imm = has_imm || cf.second->imm != nullptr;
+	}
+	has_imm_.store(has_imm, std::memory_order_release);
+	RemoveObsoleteFiles();
+}
+
+DBStatus DB::WriteLevel0Table(ColumnFamilyData* cfd, MemTable* mem, FileMetaData* meta,
+			      BlobFileMetaData* blob) {
+	// 刷盘的memtable不会再有写入，有的MemTableRep在这里一次性排好序，之后的迭代器直接按顺序遍历
+	mem->MarkImmutable();
+	Iterator* iter = mem->NewIterator();
+	Iterator* range_del_iter = mem->NewRangeTombstoneIterator();
+	BlobFileBuilder blob_builder(cfd->dbname, blob->number,
+				     cfd->options.max_key_value_split_threshold);
+	blob_builder.SetRateLimiter(options_.rate_limiter.get(), kIOMid);
+	DBStatus s = BuildTable(cfd->dbname, cfd->table_options, iter, range_del_iter, meta,
+				&blob_builder);
+	delete iter;
+	delete range_del_iter;
+	if (s == Status::kSuccess) {
+		*blob = blob_builder.meta();
+	}
+	return s;
+}
+
+void DB::RemoveObsoleteFiles() {
+	if (bg_error_ != Status::kSuccess) {
+		// 出错之后不知道哪些文件还是有效的，先都保留
+		return;
+	}
+	// 每个column family还没有刷盘的数据最早在它的LogNumber对应的WAL中，
+	// 没有未刷盘数据的column family不需要保留任何WAL
+	uint64_t min_log_number = logfile_number_;
+	for (const auto& cf : column_families_) {
+		ColumnFamilyData* cfd = cf.second;
+		if (cfd->imm != nullptr || cfd->mem->NumEntries() > 0) {
+			min_log_number = std::min(min_log_number, cfd->versions->LogNumber());
+		}
+	}
+
+	for (const auto& cf : column_families_) {
+		ColumnFamilyData* cfd = cf.second;
+		std::set<uint64_t> live = cfd->pending_outputs;
+		cfd->versions->AddLiveFiles(&live);
+
+		std::vector<std::string> filenames;
+		FileTool::GetChildren(cfd->dbname, &filenames);
+		uint64_t number;
+		FileType type;
+		for (const auto& filename : filenames) {
+			if (!ParseFileName(filename, &number, &type)) {
+				continue;
+			}
+			bool keep = true;
+			switch (type) {
+				case kLogFile:
+					keep = (number >= min_log_number);
+					break;
+				case kDescriptorFile:
+					keep = (number >= cfd->versions->ManifestFileNumber());
+					break;
+				case kTableFile:
+				case kTempFile:
+				case kBlobFile:
+					// live中包含了迭代器等还在使用的旧Version中的文件
+					keep = (live.find(number) != live.end());
+					break;
+				case kCurrentFile:
+					break;
+			}
+			if (!keep) {
+				if (type == kTableFile) {
+					cfd->table_cache->Evict(number);
+				}
+				FileTool::RemoveFile(cfd->dbname + "/" + filename);
+			}
+		}
+	}
+}
+
+DBStatus DB::Get(const ReadOptions& options, const Slice& key, std::string* value) {
+	return Get(options, DefaultColumnFamily(), key, value);
+}
+
+DBStatus DB::Get(const ReadOptions& options, ColumnFamilyHandle* column_family,
+		 const Slice& key, std::string* value) {
+	ColumnFamilyData* cfd = column_family->cfd();
+	MemTable* mem;
+	MemTable* imm;
+	std::shared_ptr<Version> current;
+	SequenceNumber snapshot;
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (options.snapshot != nullptr) {
+			snapshot = options.snapshot->sequence_number();
+		} else {
+			snapshot = versions_->LastSequence();
+		}
+		mem = cfd->mem;
+		imm = cfd->imm;
+		mem->Ref();
+		if (imm != nullptr) imm->Ref();
+		current = cfd->versions->current();
+	}
+
+	// 查找的时候不需要持有锁，memtable和Version中的sst都不会被释放
+	LookupKey lkey(key, snapshot);
+	// MemTable::Get只在遇到删除标记时才会把s设置成kNotFound
+	DBStatus s = Status::kSuccess;
+	// 沿途遇到的merge操作数，找到旧值之后再合并
+	MergeContext merge_context;
+	if (mem->Get(lkey, value, &s, &merge_context)) {
+		// 在memtable中找到了
+	} else if (imm != nullptr && imm->Get(lkey, value, &s, &merge_context)) {
+		// 在immutable memtable中找到了
+	} else {
+		s = current->Get(options, lkey, value, &merge_context);
+	}
+	if (!merge_context.Empty() && (s == Status::kSuccess || s == Status::kNotFound)) {
+		const Slice base(*value);
+		s = merge_context.FullMerge(cfd->options.merge_operator.get(), key,
+					    s == Status::kSuccess ? &base : nullptr, value);
+	}
+	if (s == Status::kSuccess && cfd->options.ttl > 0 &&
+	    value->size() >= TtlCompactionFilter::kTimestampSize) {
+		value->resize(value->size() - TtlCompactionFilter::kTimestampSize);
+	}
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	mem->Unref();
+	if (imm != nullptr) imm->Unref();
+	return s;
+}
+
+std::vector<DBStatus> DB::MultiGet(const ReadOptions& options,
+				   const std::vector<Slice>& keys,
+				   std::vector<std::string>* values) {
+	return MultiGet(options, DefaultColumnFamily(), keys, values);
+}
+
+std::vector<DBStatus> DB::MultiGet(const ReadOptions& options,
+				   ColumnFamilyHandle* column_family,
+				   const std::vector<Slice>& keys,
+				   std::vector<std::string>* values) {
+	ColumnFamilyData* cfd = column_family->cfd();
+	const size_t n = keys.size();
+	std::vector<DBStatus> statuses(n, Status::kNotFound);
+	values->assign(n, std::string());
+	MemTable* mem;
+	MemTable* imm;
+	std::shared_ptr<Version> current;
+	SequenceNumber snapshot;
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (options.snapshot != nullptr) {
+			snapshot = options.snapshot->sequence_number();
+		} else {
+			snapshot = versions_->LastSequence();
+		}
+		mem = cfd->mem;
+		imm = cfd->imm;
+		mem->Ref();
+		if (imm != nullptr) imm->Ref();
+		current = cfd->versions->current();
+	}
+
+	// 按user key排序，重复的key只查找一次
+	const Comparator* ucmp = cfd->internal_comparator.user_comparator();
+	std::vector<size_t> order(n);
+	for (size_t i = 0; i < n; i++) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&keys, ucmp](size_t a, size_t b) {
+		return ucmp->Compare(keys[a], keys[b]) < 0;
+	});
+
+	std::vector<std::unique_ptr<LookupKey>> lookup_keys;
+	// 每个key沿途遇到的merge操作数
+	std::vector<MergeContext> merge_contexts(n);
+	// memtable中没有的key，以及它们在keys中的下标
+	std::vector<const LookupKey*> pending;
+	std::vector<MergeContext*> pending_contexts;
+	std::vector<size_t> pending_index;
+	for (size_t k = 0; k < n; k++) {
+		const size_t i = order[k];
+		if (k > 0 && ucmp->Compare(keys[order[k - 1]], keys[i]) == 0) {
+			continue;
+		}
+		lookup_keys.emplace_back(new LookupKey(keys[i], snapshot));
+		const LookupKey& lkey = *lookup_keys.back();
+		DBStatus s = Status::kSuccess;
+		if (mem->Get(lkey, &(*values)[i], &s, &merge_contexts[i]) ||
+		    (imm != nullptr && imm->Get(lkey, &(*values)[i], &s, &merge_contexts[i]))) {
+			statuses[i] = s;
+		} else {
+			pending.push_back(&lkey);
+			pending_contexts.push_back(&merge_contexts[i]);
+			pending_index.push_back(i);
+		}
+	}
+
+	if (!pending.empty()) {
+		std::vector<std::string> pending_values;
+		std::vector<DBStatus> pending_statuses;
+		current->MultiGet(options, pending, &pending_values, &pending_statuses,
+				  pending_contexts);
+		for (size_t k = 0; k < pending.size(); k++) {
+			(*values)[pending_index[k]].swap(pending_values[k]);
+			statuses[pending_index[k]] = pending_statuses[k];
+		}
+	}
+	for (size_t i = 0; i < n; i++) {
+		const MergeContext& merge_context = merge_contexts[i];
+		if (!merge_context.Empty() &&
+		    (statuses[i] == Status::kSuccess || statuses[i] == Status::kNotFound)) {
+			const Slice base((*values)[i]);
+			statuses[i] = merge_context.FullMerge(
+				cfd->options.merge_operator.get(), keys[i],
+				statuses[i] == Status::kSuccess ? &base : nullptr, &(*values)[i]);
+		}
+	}
+	if (cfd->options.ttl > 0) {
+		for (size_t i = 0; i < n; i++) {
+			std::string& v = (*values)[i];
+			if (statuses[i] == Status::kSuccess &&
+			    v.size() >= TtlCompactionFilter::kTimestampSize) {
+				v.resize(v.size() - TtlCompactionFilter::kTimestampSize);
+			}
+		}
+	}
+	// 重复的key直接复制第一次查找的结果
+	for (size_t k = 1; k < n; k++) {
+		const size_t prev = order[k - 1];
+		const size_t i = order[k];
+		if (ucmp->Compare(keys[prev], keys[i]) == 0) {
+			(*values)[i] = (*values)[prev];
+			statuses[i] = statuses[prev];
+		}
+	}
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	mem->Unref();
+	if (imm != nullptr) imm->Unref();
+	return statuses;
+}
+
+namespace {
+// 内部迭代器存活期间需要持有的资源
+struct IterState {
+	std::mutex* const mu;
+	MemTable* const mem;
+	MemTable* const imm;
+	// 持有引用，避免迭代过程中sst被关闭
+	std::shared_ptr<Version> version;
+
+	IterState(std::mutex* mutex, MemTable* mem, MemTable* imm)
+		: mu(mutex), mem(mem), imm(imm) {}
+};
+
+void CleanupIteratorState(void* arg1, void* /*arg2*/) {
+	IterState* state = reinterpret_cast<IterState*>(arg1);
+	{
+		std::lock_guard<std::mutex> lock(*state->mu);
+		state->mem->Unref();
+		if (state->imm != nullptr) state->imm->Unref();
+	}
+	delete state;
+}
+}  // namespace
+
+Iterator* DB::NewInternalIterator(const ReadOptions& options, ColumnFamilyData* cfd,
+				      SequenceNumber* latest_snapshot,
+				      const Version** version,
+				      std::shared_ptr<const FragmentedRangeTombstoneList>* range_del) {
+	std::unique_lock<std::mutex> lock(mutex_);
+	*latest_snapshot = versions_->LastSequence();
+	const SequenceNumber read_seq =
+		(options.snapshot != nullptr) ? options.snapshot->sequence_number()
+					      : *latest_snapshot;
+
+	std::vector<Iterator*> list;
+	list.push_back(cfd->mem->NewIterator());
+	cfd->mem->Ref();
+	if (cfd->imm != nullptr) {
+		list.push_back(cfd->imm->NewIterator());
+		cfd->imm->Ref();
+	}
+	IterState* state = new IterState(&mutex_, cfd->mem, cfd->imm);
+	state->version = cfd->versions->current();
+	state->version->AddIterators(options, &list);
+	*version = state->version.get();
+
+	// 把所有来源的范围删除合并起来重新切分，迭代时每个key只需要在一个列表中二分查找
+	std::vector<RangeTombstone> tombstones;
+	for (MemTable* m : {cfd->mem, cfd->imm}) {
+		std::shared_ptr<const FragmentedRangeTombstoneList> fragments =
+			(m == nullptr) ? nullptr : m->GetRangeTombstones();
+		if (fragments != nullptr) {
+			fragments->AppendTo(read_seq, &tombstones);
+		}
+	}
+	state->version->AddRangeTombstones(read_seq, &tombstones);
+	range_del->reset();
+	if (!tombstones.empty()) {
+		*range_del = std::make_shared<const FragmentedRangeTombstoneList>(
+			cfd->internal_comparator.user_comparator(), std::move(tombstones));
+	}
+	Iterator* internal_iter = NewMergingIterator(
+		&cfd->internal_comparator, &list[0], static_cast<int>(list.size()));
+	internal_iter->RegisterCleanup(CleanupIteratorState, state, nullptr);
+	return internal_iter;
+}
+
+Iterator* DB::NewIterator(const ReadOptions& options) {
+	return NewIterator(options, DefaultColumnFamily());
+}
+
+Iterator* DB::NewIterator(const ReadOptions& options, ColumnFamilyHandle* column_family) {
+	ColumnFamilyData* cfd = column_family->cfd();
+	SequenceNumber latest_snapshot;
+	const Version* version;
+	std::shared_ptr<const FragmentedRangeTombstoneList> range_del;
+	Iterator* iter =
+		NewInternalIterator(options, cfd, &latest_snapshot, &version, &range_del);
+	return NewDBIterator(cfd->internal_comparator.user_comparator(), iter,
+			     (options.snapshot != nullptr
+				      ? options.snapshot->sequence_number()
+				      : latest_snapshot),
+			     version, std::move(range_del),
+			     options.prefix_same_as_start ? cfd->options.prefix_extractor.get()
+							  : nullptr,
+			     cfd->options.ttl > 0 ? TtlCompactionFilter::kTimestampSize : 0,
+			     cfd->options.merge_operator.get());
+}
+
+const Snapshot* DB::GetSnapshot() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	return snapshots_.New(versions_->LastSequence());
+}
+
+void DB::ReleaseSnapshot(const Snapshot* snapshot) {
+	std::unique_lock<std::mutex> lock(mutex_);
+	snapshots_.Delete(snapshot);
+}
+
+bool DB::GetProperty(const Slice& property, std::string* value) {
+	return GetProperty(DefaultColumnFamily(), property, value);
+}
+
+bool DB::GetProperty(ColumnFamilyHandle* column_family, const Slice& property,
+		     std::string* value) {
+	VersionSet* versions = column_family->cfd()->versions;
+	value->clear();
+	Slice in = property;
+	const Slice prefix("tinykv.");
+	if (!in.starts_with(prefix)) {
+		return false;
+	}
+	in.remove_prefix(prefix.size());
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	const Slice num_files("num-files-at-level");
+	if (in.starts_with(num_files)) {
+		in.remove_prefix(num_files.size());
+		const std::string level_str = in.ToString();
+		if (level_str.empty() ||
+		    level_str.find_first_not_of("0123456789") != std::string::npos) {
+			return false;
+		}
+		// 很长的数字串会溢出，不能用std::stoi，它会在调用者传入的参数上抛异常
+		errno = 0;
+		const unsigned long level = strtoul(level_str.c_str(), nullptr, 10);
+		if (errno == ERANGE ||
+		    level >= static_cast<unsigned long>(versions->current()->NumLevels())) {
+			return false;
+		}
+		*value = std::to_string(versions->NumLevelFiles(static_cast<int>(level)));
+		return true;
+	} else if (in == Slice("num-blob-files")) {
+		*value = std::to_string(versions->current()->NumBlobFiles());
+		return true;
+	} else if (in == Slice("cur-size-all-mem-tables") ||
+		   in == Slice("mem-table-huge-page-bytes")) {
+		const bool huge_page = (in == Slice("mem-table-huge-page-bytes"));
+		// 统计所有column family的memtable，不只是传入的这一个
+		size_t size = 0;
+		for (const auto& entry : column_families_) {
+			ColumnFamilyData* cfd = entry.second;
+			for (MemTable* mem : {cfd->mem, cfd->imm}) {
+				if (mem != nullptr) {
+					size += huge_page ? mem->HugePageUsage() : mem->ApproximateMemoryUsage();
+				}
+			}
+		}
+		*value = std::to_string(size);
+		return true;
+	}
+	return false;
+}
+}
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "column_family.h"
+#include "dbformat.h"
+#include "options.h"
+#include "snapshot.h"
+#include "../include/tinykv/status.h"
+
+namespace tinykv {
+class Compaction;
+class FileWriter;
+class FragmentedRangeTombstoneList;
+class Iterator;
+class MemTable;
+class TableCache;
+class Writer;
+class WriteBatch;
+class VersionEdit;
+class Version;
+class VersionSet;
+struct BlobFileMetaData;
+struct FileMetaData;
+struct ParsedInternalKey;
+
+// tinykv对外的读写入口
+// 写入路径: 先写WAL，再写memtable；memtable写满之后变成immutable memtable，
+//           由后台线程刷成sst文件，刷盘完成之后对应的WAL就可以删除了
+// 读取路径: memtable -> immutable memtable -> L0 -> L1 -> ...，找到即返回
+// 后台线程还负责leveled compaction，把上层的sst和下层有重叠的sst合并写入下层
+// 数据按column family分成互相独立的keyspace，每个column family有自己的配置、memtable和sst，
+// 所有column family共用一个WAL和顺序号，一个WriteBatch可以原子地写入多个column family
+// 不指定column family的接口读写的是默认column family
+class DB final {
+public:
+	// 打开dbname目录下的数据库，目录不存在时会自动创建
+	// 打开时先从MANIFEST恢复每一层的文件，再回放还没有刷盘的WAL，保证上次进程退出前写成功的数据不会丢失
+	// 数据库中有其他column family时返回kInvalidArgument，需要用下面的版本打开
+	static DBStatus Open(const Options& options, const std::string& dbname, DB** dbptr);
+	// 打开数据库以及column_families中的column family，options是默认column family的配置
+	// 已经存在的column family必须全部列出，不存在的会被创建，*handles和column_families一一对应
+	// rate_limiter、recovery_threads和写入方式等DB级别的配置总是以options为准
+	static DBStatus Open(const Options& options, const std::string& dbname,
+			     const std::vector<ColumnFamilyDescriptor>& column_families,
+			     std::vector<ColumnFamilyHandle*>* handles, DB** dbptr);
+
+	DB(const DB&) = delete;
+	DB& operator=(const DB&) = delete;
+
+	~DB();
+
+	// 新建一个column family，名字已经存在时返回kInvalidArgument
+	// *handle由DB持有，不需要释放
+	DBStatus CreateColumnFamily(const Options& options, const std::string& name,
+				    ColumnFamilyHandle** handle);
+	ColumnFamilyHandle* DefaultColumnFamily() const;
+
+	DBStatus Put(const WriteOptions& options, const Slice& key, const Slice& value);
+	DBStatus Delete(const WriteOptions& options, const Slice& key);
+	// 删除[begin_key, end_key)范围内的所有key，只写入一条范围删除记录
+	// begin_key大于end_key时返回kInvalidArgument，相等时什么也不做
+	DBStatus DeleteRange(const WriteOptions& options, const Slice& begin_key,
+			     const Slice& end_key);
+	// 写入一个merge操作数，不需要先读出旧值，读取和compaction时由Options::merge_operator合并到旧值上
+	// 没有设置merge_operator或者开启了TTL时返回kInvalidArgument
+	DBStatus Merge(const WriteOptions& options, const Slice& key, const Slice& value);
+	// 写入指定的column family，含义和上面相同
+	DBStatus Put(const WriteOptions& options, ColumnFamilyHandle* column_family,
+		     const Slice& key, const Slice& value);
+	DBStatus Delete(const WriteOptions& options, ColumnFamilyHandle* column_family,
+			const Slice& key);
+	DBStatus DeleteRange(const WriteOptions& options, ColumnFamilyHandle* column_family,
+			     const Slice& begin_key, const Slice& end_key);
+	DBStatus Merge(const WriteOptions& options, ColumnFamilyHandle* column_family,
+		       const Slice& key, const Slice& value);
+	// 原子地写入batch中的所有操作
+	// 多个线程并发写入时，排在队头的线程(leader)会把后面排队的batch合并起来，
+	// 一次写入WAL并只做一次Sync，然后唤醒被合并的线程(follower)直接返回
+	DBStatus Write(const WriteOptions& options, WriteBatch* updates);
+	// 找到时返回kSuccess，key不存在或者已经被删除时返回kNotFound
+	DBStatus Get(const ReadOptions& options, const Slice& key, std::string* value);
+	DBStatus Get(const ReadOptions& options, ColumnFamilyHandle* column_family,
+		     const Slice& key, std::string* value);
+	// 批量点查，返回值和*values的第i项是keys[i]的结果，含义和Get相同
+	// 所有key看到的是同一时刻(或者options.snapshot)的数据，keys可以无序、可以重复
+	// key排序之后逐个查找memtable，剩下的key按sst分组查找，同一个data block只读取一次
+	std::vector<DBStatus> MultiGet(const ReadOptions& options,
+				       const std::vector<Slice>& keys,
+				       std::vector<std::string>* values);
+	std::vector<DBStatus> MultiGet(const ReadOptions& options,
+				       ColumnFamilyHandle* column_family,
+				       const std::vector<Slice>& keys,
+				       std::vector<std::string>* values);
+	// 返回的迭代器只包含用户键，看到的是创建迭代器那一刻(或者options.snapshot)的数据
+	// 使用者负责delete，且必须在DB析构之前delete
+	Iterator* NewIterator(const ReadOptions& options);
+	Iterator* NewIterator(const ReadOptions& options, ColumnFamilyHandle* column_family);
+	// 创建当前时刻的快照，读操作通过ReadOptions::snapshot使用，对所有column family都有效
+	// 快照存在期间，即使数据被覆盖或删除，compaction也会保留对快照可见的版本
+	// 使用完之后必须调用ReleaseSnapshot，且必须在DB析构之前释放
+	const Snapshot* GetSnapshot();
+	void ReleaseSnapshot(const Snapshot* snapshot);
+	// 查询DB内部的状态，property不认识时返回false，目前支持:
+	//  "tinykv.num-files-at-level<N>": 第N层的文件个数
+	//  "tinykv.num-blob-files": 还在使用的blob文件的个数
+	//  "tinykv.cur-size-all-mem-tables": 所有column family的memtable和immutable memtable已经分配的内存，
+	//    和传入的column family无关
+	//  "tinykv.mem-table-huge-page-bytes": 其中用MAP_HUGETLB映射的内存，见Options::memtable_huge_page_size
+	bool GetProperty(const Slice& property, std::string* value);
+	bool GetProperty(ColumnFamilyHandle* column_family, const Slice& property,
+			 std::string* value);
+
+private:
+	// 正在执行的compaction的输出
+	struct CompactionState;
+	// compaction中一个key范围的合并状态
+	struct SubcompactionState;
+	// 在writers_中排队等待写入的线程
+	struct PendingWriter;
+	// 合并在一起写入的一组writer
+	struct WriteGroup;
+
+	DB(const Options& options, const std::string& dbname);
+
+	// 在cfd的目录下创建一个空的MANIFEST和CURRENT
+	DBStatus NewDB(ColumnFamilyData* cfd);
+	// 恢复出上次关闭时的状态，打开MANIFEST中记录的所有column family，
+	// WAL回放出来的sst按column family的编号记录在edits中，需要持有mutex_，回放期间会释放锁
+	DBStatus Recover(const std::vector<ColumnFamilyDescriptor>& column_families,
+			 std::map<uint32_t, VersionEdit>* edits,
+			 std::unique_lock<std::mutex>& lock);
+	// 回放一个WAL中起始位置在[start, end)之间的记录，每个column family回放到自己的memtable中，
+	// memtable超过write_buffer_size时直接刷成L0的sst，生成的文件按column family的编号记录
+	// 可以在多个线程中同时调用，调用者不持有锁
+	DBStatus RecoverLogSegment(uint64_t log_number, uint64_t start, uint64_t end,
+				   SequenceNumber* max_sequence,
+				   std::map<uint32_t, std::vector<FileMetaData>>* files,
+				   std::map<uint32_t, std::vector<BlobFileMetaData>>* blob_files);
+	// 新建column family并写入MANIFEST，需要持有mutex_，写MANIFEST期间会释放锁
+	DBStatus CreateColumnFamilyLocked(const Options& options, const std::string& name,
+					  ColumnFamilyData** cfd,
+					  std::unique_lock<std::mutex>& lock);
+	// 名字为name的column family，不存在时返回nullptr，需要持有mutex_
+	ColumnFamilyData* FindColumnFamily(const std::string& name) const;
+	// 把edit写入cfd的MANIFEST，所有column family的MANIFEST都记录全局的最大顺序号，需要持有mutex_
+	DBStatus LogAndApply(ColumnFamilyData* cfd, VersionEdit* edit,
+			     std::unique_lock<std::mutex>& lock);
+	DBStatus NewLogFile();
+	// 把队头开始的多个batch合并成一个，需要时合并到tmp_batch中，*last_writer返回最后一个被合并的writer
+	WriteBatch* BuildBatchGroup(PendingWriter** last_writer, WriteBatch* tmp_batch);
+	// 把一组写入插入memtable，允许并发写memtable时组中的writer各自插入，需要持有mutex_，插入期间会释放锁
+	DBStatus InsertWriteGroup(WriteGroup* group, std::unique_lock<std::mutex>& lock);
+	// 保证所有column family的memtable都有空间写入，需要持有mutex_
+	DBStatus MakeRoomForWrite(std::unique_lock<std::mutex>& lock);
+	// 有column family需要compaction，需要持有mutex_
+	bool NeedsCompaction() const;
+	void BackgroundCall();
+	// 后台线程的一轮工作: 优先刷immutable memtable，否则轮流选一个column family做一次compaction，
+	// 需要持有mutex_
+	void BackgroundCompaction(std::unique_lock<std::mutex>& lock);
+	// 把一个column family的imm刷成sst，没有imm时什么也不做，需要持有mutex_，刷盘期间会释放锁
+	void FlushImmutableMemTable(std::unique_lock<std::mutex>& lock);
+	// 把cfd->imm刷成sst，需要持有mutex_，刷盘期间会释放锁
+	void CompactMemTable(ColumnFamilyData* cfd, std::unique_lock<std::mutex>& lock);
+	// 把mem刷成cfd中编号为meta->number的sst，大value写到编号为blob->number的blob文件中，调用者不持有锁
+	// 没有大value时blob->total_count为0，不会生成blob文件
+	DBStatus WriteLevel0Table(ColumnFamilyData* cfd, MemTable* mem, FileMetaData* meta,
+				  BlobFileMetaData* blob);
+	// 合并compaction的输入文件并写出新文件，需要持有mutex_，合并期间会释放锁
+	// 输入按key范围切成多个subcompaction，除第一个以外的每个subcompaction在自己的线程中合并
+	DBStatus DoCompactionWork(CompactionState* compact,
+				  std::unique_lock<std::mutex>& lock);
+	// 合并sub负责的key范围，结果记录在sub->status中，调用时不持有锁
+	// 只有第一个subcompaction(在后台线程中执行)会中途刷immutable memtable
+	void DoSubcompactionWork(CompactionState* compact, SubcompactionState* sub);
+	DBStatus OpenCompactionOutputFile(CompactionState* compact, SubcompactionState* sub);
+	// next_user_key是下一个输出文件的第一个user key，为nullptr表示这是最后一个输出文件
+	// 落在这个文件范围内的范围删除也一起写入
+	DBStatus FinishCompactionOutputFile(CompactionState* compact, SubcompactionState* sub,
+					    const Slice* next_user_key);
+	// 大value写到sub输出的blob文件中，垃圾太多的blob文件中的value也搬过去，
+	// 需要改写时*key和*value指向sub中的缓冲区。调用时不持有锁
+	DBStatus SeparateCompactionValue(CompactionState* compact, SubcompactionState* sub,
+					 const ParsedInternalKey& ikey, Slice* key,
+					 Slice* value, std::unique_lock<std::mutex>& lock);
+	// 对第一次遇到的user key的最新版本调用column family的CompactionFilter，调用时不持有锁
+	// 过滤掉时*drop为true，或者把它改写成删除标记(还有更旧的版本可能被读到时)；
+	// 改写value时*key和*value指向sub中的缓冲区，ikey->type随之改变
+	DBStatus ApplyCompactionFilter(CompactionState* compact, SubcompactionState* sub,
+				       ParsedInternalKey* ikey, Slice* key, Slice* value,
+				       bool* drop);
+	// ikey是对所有读操作都可见的merge操作数，继续读入同一个user key更旧的版本，
+	// 遇到完整的value、删除标记或者到了最底层时合并成完整的value，否则把读到的操作数合并成一个操作数
+	// 改写之后*key和*value指向sub中的缓冲区，ikey->type随之改变，input停在没有用到的第一个entry上
+	// 调用时不持有锁
+	DBStatus MergeCompactionOperands(CompactionState* compact, SubcompactionState* sub,
+					 ParsedInternalKey* ikey, Slice* key, Slice* value);
+	// 把updates中开启了TTL的column family的Put改写成追加了写入时间的value，写入*result
+	// column_families是ttl_column_families_的副本，不需要持有mutex_
+	DBStatus AddTtlTimestamps(const std::map<uint32_t, ColumnFamilyData*>& column_families,
+				  const WriteBatch& updates, WriteBatch* result);
+	// column_families_变化之后更新ttl_column_families_，需要持有mutex_
+	void UpdateTtlColumnFamilies();
+	// 删除所有column family都已经刷盘的WAL、不再使用的sst和旧的MANIFEST，需要持有mutex_
+	void RemoveObsoleteFiles();
+	// *version返回迭代器使用的Version，在迭代器析构之前一直有效
+	// *range_del返回memtable和所有sst中对这次读可见的范围删除，没有时为nullptr
+	Iterator* NewInternalIterator(const ReadOptions& options, ColumnFamilyData* cfd,
+				      SequenceNumber* latest_snapshot,
+				      const Version** version,
+				      std::shared_ptr<const FragmentedRangeTombstoneList>* range_del);
+
+	const std::string dbname_;
+	const Options options_;
+
+	std::mutex mutex_;
+	// 同一时刻只有一个线程在创建column family，先于mutex_加锁
+	std::mutex create_column_family_mutex_;
+	// 通知后台线程有immutable memtable需要刷盘
+	std::condition_variable background_work_cv_;
+	// 后台线程刷盘完成时通知等待的写线程
+	std::condition_variable background_work_finished_cv_;
+	std::atomic<bool> shutting_down_{false};
+	// compaction期间不持有锁，通过这个标记得知有immutable memtable需要优先刷盘
+	// 任意一个column family有imm时为true
+	std::atomic<bool> has_imm_{false};
+	// 有column family开启了TTL时是column_families_的只读副本，否则为nullptr
+	// 写入时不加锁地通过std::atomic_load读取，判断batch是否需要追加写入时间
+	std::shared_ptr<const std::map<uint32_t, ColumnFamilyData*>> ttl_column_families_;
+	// 后台刷盘出错后所有写操作都会返回这个错误
+	DBStatus bg_error_ = Status::kSuccess;
+
+	FileWriter* logfile_ = nullptr;
+	uint64_t logfile_number_ = 0;
+	Writer* log_ = nullptr;
+
+	// 还没有释放的快照
+	SnapshotList snapshots_;
+
+	// 排队等待写入的线程，队头是正在写入的leader
+	std::deque<PendingWriter*> writers_;
+	// leader合并多个batch时使用的临时batch
+	WriteBatch* tmp_batch_;
+	// 流水线写入时已经写完WAL、按顺序等待插入memtable的组，队头正在插入
+	std::deque<WriteGroup*> memtable_groups_;
+	// 已经分配给写入的最大顺序号，流水线写入时可能比已经发布的LastSequence大
+	SequenceNumber last_allocated_sequence_ = 0;
+
+	// 所有的column family，按编号索引，创建之后直到DB析构都不会删除
+	std::map<uint32_t, ColumnFamilyData*> column_families_;
+	ColumnFamilyData* const default_cf_;
+	// 默认column family的VersionSet，同时负责分配WAL的编号、发布顺序号，以及记录有哪些column family
+	VersionSet* const versions_;
+	// 下一次compaction从这个编号的column family开始找，让每个column family轮流compaction
+	uint32_t next_compaction_cf_ = 0;
+
+	std::thread bg_thread_;
+};
+}
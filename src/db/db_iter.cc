@@ -0,0 +1,477 @@
+#include "db_iter.h"
+#include "merge_context.h"
+#include "version_set.h"
+#include "../include/tinykv/comparator.h"
+#include "../include/tinykv/merge_operator.h"
+#include "../include/tinykv/slice_transform.h"
+
+#include <string>
+
+namespace tinykv {
+// 内部迭代器中同一个用户键的多个版本是按顺序号从大到小排列的，
+// 正向迭代时遇到的第一个可见版本就是最新的版本；
+// 反向迭代时则需要一直走到这个用户键的最前面才知道最新版本是什么，
+// 所以反向迭代时把当前的key/value保存在saved_key_/saved_value_中
+// 最新的可见版本是merge操作数时，正向迭代要往后读到旧值才能合并，合并的结果同样保存在saved中；
+// 反向迭代从旧到新经过每个版本，边走边合并
+class DBIter : public Iterator {
+public:
+	// 正向迭代时: 内部迭代器指向的就是当前的entry
+	// 反向迭代时: 内部迭代器指向当前用户键的所有entry之前的位置，当前的key/value保存在saved中
+	enum Direction { kForward, kReverse };
+
+	DBIter(const Comparator* cmp, Iterator* iter, SequenceNumber s,
+	       const Version* version,
+	       std::shared_ptr<const FragmentedRangeTombstoneList> range_del,
+	       const SliceTransform* prefix_extractor, size_t value_trailer_size,
+	       const MergeOperator* merge_operator)
+		: user_comparator_(cmp)
+		, iter_(iter)
+		, sequence_(s)
+		, version_(version)
+		, range_del_(std::move(range_del))
+		, prefix_extractor_(prefix_extractor)
+		, value_trailer_size_(value_trailer_size)
+		, merge_operator_(merge_operator)
+		, status_(Status::kSuccess)
+		, direction_(kForward)
+		, valid_(false) {}
+
+	DBIter(const DBIter&) = delete;
+	DBIter& operator=(const DBIter&) = delete;
+
+	~DBIter() override { delete iter_; }
+
+	bool Valid() const override { return valid_; }
+	Slice key() const override {
+		assert(valid_);
+		return (direction_ == kForward && !merged_) ? ExtractUserKey(iter_->key())
+							     : saved_key_;
+	}
+	Slice value() const override {
+		assert(valid_);
+		Slice v;
+		if (direction_ == kReverse || merged_) {
+			v = saved_value_;
+		} else {
+			v = value_is_blob_ ? Slice(blob_value_) : iter_->value();
+		}
+		if (v.size() >= value_trailer_size_) {
+			v = Slice(v.data(), v.size() - value_trailer_size_);
+		}
+		return v;
+	}
+	DBStatus status() const override {
+		if (status_ == Status::kSuccess) {
+			return iter_->status();
+		}
+		return status_;
+	}
+
+	void Next() override;
+	void Prev() override;
+	void Seek(const Slice& target) override;
+	void SeekToFirst() override;
+	void SeekToLast() override;
+
+private:
+	void FindNextUserEntry(bool skipping, std::string* skip);
+	void FindPrevUserEntry();
+	bool ParseKey(ParsedInternalKey* key);
+	// 正向迭代时iter_指向user_key最新的可见版本，它是merge操作数，
+	// 往后收集更旧的操作数直到旧值，合并结果保存在saved_value_中，iter_停在旧值或者下一个用户键上
+	bool MergeValuesNewToOld(const Slice& user_key);
+	// 把operand合并到*value上，has_value为false表示没有旧值
+	bool MergeOperand(const Slice& user_key, bool has_value, const Slice& operand,
+			  std::string* value);
+	// 被范围删除覆盖的版本和删除标记一样处理
+	ValueType EffectiveType(const ParsedInternalKey& ikey) const {
+		if (range_del_ != nullptr &&
+		    range_del_->MaxCoveringSeq(ikey.user_key, sequence_) > ikey.sequence) {
+			return kTypeDeletion;
+		}
+		return ikey.type;
+	}
+
+	// 前缀迭代时user_key已经离开了Seek的前缀
+	bool OutOfPrefix(const Slice& user_key) const {
+		return has_prefix_ && (!prefix_extractor_->InDomain(user_key) ||
+				       prefix_extractor_->Transform(user_key) != Slice(prefix_));
+	}
+
+	inline void SaveKey(const Slice& k, std::string* dst) {
+		dst->assign(k.data(), k.size());
+	}
+
+	inline void ClearSavedValue() {
+		// 避免长时间持有一块很大的内存
+		if (saved_value_.capacity() > 1048576) {
+			std::string empty;
+			swap(empty, saved_value_);
+		} else {
+			saved_value_.clear();
+		}
+	}
+
+	const Comparator* const user_comparator_;
+	Iterator* const iter_;
+	SequenceNumber const sequence_;
+	const Version* const version_;
+	const std::shared_ptr<const FragmentedRangeTombstoneList> range_del_;
+	const SliceTransform* const prefix_extractor_;
+	const size_t value_trailer_size_;
+	const MergeOperator* const merge_operator_;
+	// 前缀迭代时最近一次Seek的前缀，只有Seek的目标有前缀时has_prefix_才为true
+	std::string prefix_;
+	bool has_prefix_ = false;
+	DBStatus status_;
+	std::string saved_key_;    // 反向迭代时保存当前的用户键；正向迭代时保存需要跳过的用户键
+	std::string saved_value_;  // 反向迭代时保存当前的value
+	std::string blob_value_;   // 正向迭代时当前entry是BlobIndex，保存从blob文件中读出的value
+	bool value_is_blob_ = false;
+	// 正向迭代时当前的key/value是合并出来的，保存在saved_key_/saved_value_中，iter_已经越过了当前entry
+	bool merged_ = false;
+	Direction direction_;
+	bool valid_;
+};
+
+inline bool DBIter::ParseKey(ParsedInternalKey* ikey) {
+	if (!ParseInternalKey(iter_->key(), ikey)) {
+		status_ = Status::kCorruption;
+		return false;
+	}
+	return true;
+}
+
+void DBIter::Next() {
+	assert(valid_);
+
+	if (direction_ == kReverse) {
+		direction_ = kForward;
+		// iter_指向的是当前用户键之前的位置，先把它挪到当前用户键的范围之内，
+		// 然后下面的FindNextUserEntry会跳过当前用户键的所有版本
+		if (!iter_->Valid()) {
+			iter_->SeekToFirst();
+		} else {
+			iter_->Next();
+		}
+		if (!iter_->Valid()) {
+			valid_ = false;
+			saved_key_.clear();
+			return;
+		}
+		// saved_key_中已经保存了需要跳过的用户键
+	} else if (merged_) {
+		// saved_key_中是当前的用户键，iter_已经越过了合并用到的版本
+		merged_ = false;
+		if (!iter_->Valid()) {
+			valid_ = false;
+			saved_key_.clear();
+			return;
+		}
+	} else {
+		// 把当前的用户键保存下来，跳过它所有的旧版本
+		SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+		iter_->Next();
+		if (!iter_->Valid()) {
+			valid_ = false;
+			saved_key_.clear();
+			return;
+		}
+	}
+
+	FindNextUserEntry(true, &saved_key_);
+}
+
+void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
+	// 跳过对当前快照不可见的entry、被删除的key以及skip对应用户键的旧版本
+	assert(iter_->Valid());
+	assert(direction_ == kForward);
+	do {
+		ParsedInternalKey ikey;
+		const bool parsed = ParseKey(&ikey);
+		if (parsed && OutOfPrefix(ikey.user_key)) {
+			// 前缀相同的key是连续的，后面不会再有这个前缀的key
+			break;
+		}
+		if (parsed && ikey.sequence <= sequence_) {
+			switch (EffectiveType(ikey)) {
+				case kTypeDeletion:
+					// 删除标记之后的同一个用户键的所有版本都要跳过
+					SaveKey(ikey.user_key, skip);
+					skipping = true;
+					break;
+				case kTypeValue:
+				case kTypeBlobIndex:
+					if (skipping &&
+					    user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
+						// 被更新的版本覆盖了或者被删除了
+					} else {
+						value_is_blob_ = (ikey.type == kTypeBlobIndex);
+						if (value_is_blob_) {
+							DBStatus s = version_->GetBlob(ikey.user_key, iter_->value(),
+										       &blob_value_);
+							if (s != Status::kSuccess) {
+								status_ = s;
+								valid_ = false;
+								saved_key_.clear();
+								return;
+							}
+						}
+						valid_ = true;
+						saved_key_.clear();
+						return;
+					}
+					break;
+				case kTypeMerge:
+					if (skipping &&
+					    user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
+						// 被更新的版本覆盖了或者被删除了
+					} else {
+						value_is_blob_ = false;
+						if (!MergeValuesNewToOld(ikey.user_key)) {
+							valid_ = false;
+							saved_key_.clear();
+							return;
+						}
+						valid_ = true;
+						merged_ = true;
+						return;
+					}
+					break;
+				default:
+					break;
+			}
+		}
+		iter_->Next();
+	} while (iter_->Valid());
+	saved_key_.clear();
+	valid_ = false;
+}
+
+void DBIter::Prev() {
+	assert(valid_);
+	if (has_prefix_) {
+		// 前缀过滤器排除的sst在Seek之后没有定位，无法正确地反向合并
+		valid_ = false;
+		status_ = Status::kInvalidArgument;
+		return;
+	}
+
+	if (direction_ == kForward) {
+		// iter_指向当前entry，向前走到当前用户键的所有版本之前，
+		// 然后FindPrevUserEntry会找到前一个用户键的最新可见版本
+		if (merged_) {
+			// saved_key_中是当前的用户键，iter_可能已经越过了它的所有版本，甚至到了末尾
+			merged_ = false;
+			if (!iter_->Valid()) {
+				iter_->SeekToLast();
+			}
+		} else {
+			assert(iter_->Valid());
+			SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+		}
+		while (true) {
+			if (!iter_->Valid()) {
+				valid_ = false;
+				saved_key_.clear();
+				ClearSavedValue();
+				return;
+			}
+			if (user_comparator_->Compare(ExtractUserKey(iter_->key()), saved_key_) < 0) {
+				break;
+			}
+			iter_->Prev();
+		}
+		direction_ = kReverse;
+	}
+
+	FindPrevUserEntry();
+}
+
+void DBIter::FindPrevUserEntry() {
+	assert(direction_ == kReverse);
+
+	ValueType value_type = kTypeDeletion;
+	if (iter_->Valid()) {
+		do {
+			ParsedInternalKey ikey;
+			if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
+				if ((value_type != kTypeDeletion) &&
+				    user_comparator_->Compare(ikey.user_key, saved_key_) < 0) {
+					// 已经走到了前一个用户键，saved中的就是当前用户键最新的可见版本
+					break;
+				}
+				const ValueType prev_type = value_type;
+				value_type = EffectiveType(ikey);
+				if (value_type == kTypeDeletion) {
+					saved_key_.clear();
+					ClearSavedValue();
+				} else if (value_type == kTypeMerge) {
+					// 从旧到新依次合并，前一个版本是删除标记时没有旧值
+					if (prev_type == kTypeBlobIndex) {
+						const std::string blob_index = saved_value_;
+						DBStatus s = version_->GetBlob(saved_key_, blob_index,
+									       &saved_value_);
+						if (s != Status::kSuccess) {
+							status_ = s;
+							value_type = kTypeDeletion;
+							break;
+						}
+					}
+					SaveKey(ikey.user_key, &saved_key_);
+					if (!MergeOperand(saved_key_, prev_type != kTypeDeletion,
+							  iter_->value(), &saved_value_)) {
+						value_type = kTypeDeletion;
+						break;
+					}
+				} else {
+					Slice raw_value = iter_->value();
+					if (saved_value_.capacity() > raw_value.size() + 1048576) {
+						std::string empty;
+						swap(empty, saved_value_);
+					}
+					SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+					saved_value_.assign(raw_value.data(), raw_value.size());
+				}
+			}
+			iter_->Prev();
+		} while (iter_->Valid());
+	}
+
+	if (value_type == kTypeBlobIndex) {
+		// 只读取最终选中的版本，跳过的旧版本不需要读blob文件
+		const std::string blob_index = saved_value_;
+		DBStatus s = version_->GetBlob(saved_key_, blob_index, &saved_value_);
+		if (s != Status::kSuccess) {
+			status_ = s;
+			value_type = kTypeDeletion;
+		}
+	}
+	if (value_type == kTypeDeletion) {
+		// 已经到头了
+		valid_ = false;
+		saved_key_.clear();
+		ClearSavedValue();
+		direction_ = kForward;
+	} else {
+		valid_ = true;
+	}
+}
+
+void DBIter::Seek(const Slice& target) {
+	direction_ = kForward;
+	merged_ = false;
+	ClearSavedValue();
+	has_prefix_ = (prefix_extractor_ != nullptr && prefix_extractor_->InDomain(target));
+	if (has_prefix_) {
+		const Slice prefix = prefix_extractor_->Transform(target);
+		prefix_.assign(prefix.data(), prefix.size());
+	}
+	saved_key_.clear();
+	AppendInternalKey(&saved_key_,
+			  ParsedInternalKey(target, sequence_, kValueTypeForSeek));
+	iter_->Seek(saved_key_);
+	if (iter_->Valid()) {
+		FindNextUserEntry(false, &saved_key_);
+	} else {
+		valid_ = false;
+	}
+}
+
+void DBIter::SeekToFirst() {
+	direction_ = kForward;
+	merged_ = false;
+	ClearSavedValue();
+	has_prefix_ = false;
+	iter_->SeekToFirst();
+	if (iter_->Valid()) {
+		FindNextUserEntry(false, &saved_key_);
+	} else {
+		valid_ = false;
+	}
+}
+
+void DBIter::SeekToLast() {
+	direction_ = kReverse;
+	merged_ = false;
+	ClearSavedValue();
+	has_prefix_ = false;
+	iter_->SeekToLast();
+	FindPrevUserEntry();
+}
+
+bool DBIter::MergeOperand(const Slice& user_key, bool has_value, const Slice& operand,
+			  std::string* value) {
+	if (merge_operator_ == nullptr) {
+		status_ = Status::kInvalidArgument;
+		return false;
+	}
+	std::string result;
+	const Slice existing(*value);
+	if (!merge_operator_->Merge(user_key, has_value ? &existing : nullptr, operand, &result)) {
+		status_ = Status::kCorruption;
+		return false;
+	}
+	value->swap(result);
+	return true;
+}
+
+bool DBIter::MergeValuesNewToOld(const Slice& user_key) {
+	SaveKey(user_key, &saved_key_);
+	MergeContext merge_context;
+	merge_context.PushOperand(iter_->value());
+	// 旧值，没有时(删除标记或者没有更旧的版本)合并到不存在的key上
+	bool has_base = false;
+	std::string base;
+	for (iter_->Next(); iter_->Valid(); iter_->Next()) {
+		ParsedInternalKey ikey;
+		if (!ParseKey(&ikey)) {
+			return false;
+		}
+		if (user_comparator_->Compare(ikey.user_key, saved_key_) != 0) {
+			break;
+		}
+		if (ikey.sequence > sequence_) {
+			continue;
+		}
+		const ValueType type = EffectiveType(ikey);
+		if (type == kTypeMerge) {
+			merge_context.PushOperand(iter_->value());
+			continue;
+		}
+		if (type == kTypeValue) {
+			base.assign(iter_->value().data(), iter_->value().size());
+			has_base = true;
+		} else if (type == kTypeBlobIndex) {
+			DBStatus s = version_->GetBlob(ikey.user_key, iter_->value(), &base);
+			if (s != Status::kSuccess) {
+				status_ = s;
+				return false;
+			}
+			has_base = true;
+		}
+		break;
+	}
+	const Slice base_slice(base);
+	DBStatus s = merge_context.FullMerge(merge_operator_, saved_key_,
+					     has_base ? &base_slice : nullptr, &saved_value_);
+	if (s != Status::kSuccess) {
+		status_ = s;
+		return false;
+	}
+	return true;
+}
+
+Iterator* NewDBIterator(const Comparator* user_key_comparator,
+			Iterator* internal_iter, SequenceNumber sequence,
+			const Version* version,
+			std::shared_ptr<const FragmentedRangeTombstoneList> range_del,
+			const SliceTransform* prefix_extractor,
+			size_t value_trailer_size,
+			const MergeOperator* merge_operator) {
+	return new DBIter(user_key_comparator, internal_iter, sequence, version,
+			  std::move(range_del), prefix_extractor, value_trailer_size,
+			  merge_operator);
+}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <memory>
+
+#include "../include/tinykv/iterator.h"
+#include "dbformat.h"
+#include "range_tombstone.h"
+
+namespace tinykv {
+class Comparator;
+class MergeOperator;
+class SliceTransform;
+class Version;
+
+// internal_iter是内部键(user_key + 顺序号 + 值类型)组成的有序迭代器，
+// 返回的迭代器对外只暴露用户键：同一个用户键只保留顺序号<=sequence的最新版本，
+// 被删除的key直接跳过，kv分离的value通过version从blob文件中读出来
+// 被range_del中的范围删除覆盖的版本当作删除标记处理，range_del为nullptr表示没有范围删除
+// prefix_extractor不为nullptr时是前缀迭代: Seek(target)之后只返回和target前缀相同的key，不支持Prev
+// merge操作数由merge_operator合并到更旧的版本上，遇到merge操作数时merge_operator为nullptr返回kInvalidArgument
+// value_trailer_size不为0时，value()去掉value末尾这么多字节再返回(TTL追加的写入时间)
+// 返回的迭代器拥有internal_iter的所有权，version在internal_iter析构之前必须有效
+Iterator* NewDBIterator(const Comparator* user_key_comparator,
+			Iterator* internal_iter, SequenceNumber sequence,
+			const Version* version,
+			std::shared_ptr<const FragmentedRangeTombstoneList> range_del,
+			const SliceTransform* prefix_extractor = nullptr,
+			size_t value_trailer_size = 0,
+			const MergeOperator* merge_operator = nullptr);
+}
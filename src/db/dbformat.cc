@@ -4,15 +4,10 @@
 
 #include <cstdio>
 #include <sstream>
+#include <vector>
 
 namespace tinykv {
 
-static uint64_t PackSequenceAndType(uint64_t seq, ValueType t) {
-  assert(seq <= kMaxSequenceNumber);
-  assert(t <= kValueTypeForSeek);
-  return (seq << 8) | t;
-}
-
 void AppendInternalKey(std::string* result, const ParsedInternalKey& key) {
   result->append(key.user_key.data(), key.user_key.size());
   PutFixed64(result, PackSequenceAndType(key.sequence, key.type));
@@ -82,4 +77,60 @@ Slice user_key = ExtractUserKey(*key);
 	}
 }
 
-}
\ No newline at end of file
+// 把内部键转换成用户键
+static std::vector<std::string> UserKeys(const std::string* keys, int n) {
+  std::vector<std::string> user_keys;
+  user_keys.reserve(n);
+  for (int i = 0; i < n; i++) {
+    user_keys.push_back(ExtractUserKey(keys[i]).ToString());
+  }
+  return user_keys;
+}
+
+InternalFilterPolicy::InternalFilterPolicy(std::shared_ptr<FilterPolicy> p)
+    : user_policy_(std::move(p)),
+      name_(std::string("tinykv.InternalFilterPolicy.") + user_policy_->Name()) {}
+
+void InternalFilterPolicy::CreateFilter(const std::string* keys, int n) {
+  std::vector<std::string> user_keys = UserKeys(keys, n);
+  user_policy_->CreateFilter(user_keys.data(), n);
+}
+
+void InternalFilterPolicy::CreateFilter(const std::string* keys, int n,
+                                        std::string* dst) const {
+  std::vector<std::string> user_keys = UserKeys(keys, n);
+  user_policy_->CreateFilter(user_keys.data(), n, dst);
+}
+
+bool InternalFilterPolicy::MayMatch(const std::string& key, int32_t start_pos,
+                                    int32_t len) {
+  return user_policy_->MayMatch(ExtractUserKey(key).ToString(), start_pos, len);
+}
+
+bool InternalFilterPolicy::MayMatch(const std::string_view& key,
+                                    const std::string_view& datas) {
+  const Slice user_key = ExtractUserKey(Slice(key.data(), key.size()));
+  // 过滤器不处理空key，只能认为可能存在
+  if (user_key.empty()) {
+    return true;
+  }
+  return user_policy_->MayMatch(std::string_view(user_key.data(), user_key.size()),
+                                datas);
+}
+
+void InternalFilterPolicy::CreateFilter(const std::string* keys, int n,
+                                        const std::string* prefixes, int m,
+                                        std::string* dst) const {
+  std::vector<std::string> user_keys = UserKeys(keys, n);
+  user_keys.insert(user_keys.end(), prefixes, prefixes + m);
+  user_policy_->CreateFilter(user_keys.data(), static_cast<int>(user_keys.size()), dst);
+}
+
+bool InternalFilterPolicy::PrefixMayMatch(const std::string_view& prefix,
+                                          const std::string_view& datas) {
+  if (prefix.empty()) {
+    return true;
+  }
+  return user_policy_->MayMatch(prefix, datas);
+}
+}
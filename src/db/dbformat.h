@@ -2,12 +2,25 @@
 
 #include "../include/tinykv/slice.h"
 #include "../include/tinykv/comparator.h"
+#include "../include/tinykv/filter_policy.h"
+#include "../include/tinykv/slice_transform.h"
 #include "../utils/codec.h"
 
+#include <memory>
 #include <string>
 
 namespace tinykv {
 
+// compaction相关的参数，代码源自leveldb/db/dbformat.h
+namespace config {
+// L0的文件数达到这个值时开始compaction
+static const int kL0_CompactionTrigger = 4;
+// L0的文件数达到这个值时，每次写入延迟1ms，给compaction让出CPU
+static const int kL0_SlowdownWritesTrigger = 8;
+// L0的文件数达到这个值时，写入直接阻塞，直到compaction完成
+static const int kL0_StopWritesTrigger = 12;
+}  // namespace config
+
 // SequenceNumber是一个无符号64位整型的值，我们这里用“顺序号”这个名字。
 // tinykv每添加/修改一次记录都会触发顺序号的+1。
 typedef uint64_t SequenceNumber;
@@ -25,10 +38,21 @@ static const SequenceNumber kMaxSequenceNumber = ((0x1ull << 56) - 1);
 // 代码源自leveldb/db/dbformat.h
 enum ValueType {
     kTypeDeletion = 0x0,                               // 删除
-    kTypeValue = 0x1                                   // 数据
+    kTypeValue = 0x1,                                  // 数据
+    kTypeBlobIndex = 0x2,                              // kv分离后的数据，value是指向blob文件的BlobIndex，只出现在sst中
+    kTypeRangeDeletion = 0x3,                          // 范围删除，user key是起点，value是终点(不包含)，和普通数据分开存放
+    kTypeMerge = 0x4                                   // merge操作数，读取和compaction时由MergeOperator合并到更旧的版本上
 };
-// 在查找对象时，对象不能是被删除的，所以kValueTypeForSeek等于kTypeValue。
-static const ValueType kValueTypeForSeek = kTypeValue; // 用于查找
+// 同一个用户键的entry按(顺序号<<8|值类型)从大到小排列，查找时要定位到顺序号相同的所有类型之前，
+// 所以kValueTypeForSeek必须是最大的值类型，新增值类型时要同时修改
+static const ValueType kValueTypeForSeek = kTypeMerge; // 用于查找
+
+// 顺序号和值类型打包成一个64位整数，低8位是值类型，高56位是顺序号
+inline uint64_t PackSequenceAndType(uint64_t seq, ValueType t) {
+  assert(seq <= kMaxSequenceNumber);
+  assert(t <= kValueTypeForSeek);
+  return (seq << 8) | t;
+}
 
 struct ParsedInternalKey {
   Slice user_key;
@@ -52,6 +76,19 @@ inline Slice ExtractUserKey(const Slice& internal_key) {
   return Slice(internal_key.data(), internal_key.size() - 8);
 }
 
+// 把内部键解析成ParsedInternalKey，格式不合法时返回false
+inline bool ParseInternalKey(const Slice& internal_key,
+                             ParsedInternalKey* result) {
+  const size_t n = internal_key.size();
+  if (n < 8) return false;
+  uint64_t num = DecodeFixed64(internal_key.data() + n - 8);
+  uint8_t c = num & 0xff;
+  result->sequence = num >> 8;
+  result->type = static_cast<ValueType>(c);
+  result->user_key = Slice(internal_key.data(), n - 8);
+  return (c <= static_cast<uint8_t>(kValueTypeForSeek));
+}
+
 /**
  * @brief 
  * 用户在使用tinykv的时候用Slice作为key,但是在tinykv内部是以InternalKey作为Key的
@@ -126,6 +163,51 @@ public:
     
 };
 
+/**
+ * @brief
+ * sst中的key都是内部键，同一个用户键的不同版本顺序号不同，点查时也不知道要找的顺序号，
+ * 所以过滤器只对用户键生效：构建和查询之前先把内部键末尾的8字节去掉，再交给用户的FilterPolicy。
+ * 名字和用户的FilterPolicy不同，以前按内部键构建的过滤器不会被误用。
+ */
+class InternalFilterPolicy : public FilterPolicy {
+private:
+    std::shared_ptr<FilterPolicy> user_policy_;
+    std::string name_;
+    // 旧接口的元数据，不使用
+    FilterPolicyMeta meta_;
+public:
+    explicit InternalFilterPolicy(std::shared_ptr<FilterPolicy> p);
+    const char* Name() override { return name_.c_str(); }
+    void CreateFilter(const std::string* keys, int n) override;
+    void CreateFilter(const std::string* keys, int n, std::string* dst) const override;
+    bool MayMatch(const std::string& key, int32_t start_pos, int32_t len) override;
+    bool MayMatch(const std::string_view& key, const std::string_view& datas) override;
+    // keys是内部键，prefixes是用户键的前缀，不需要再去掉顺序号和类型
+    void CreateFilter(const std::string* keys, int n, const std::string* prefixes, int m,
+                      std::string* dst) const override;
+    bool PrefixMayMatch(const std::string_view& prefix, const std::string_view& datas) override;
+    const std::string& Data() override { return user_policy_->Data(); }
+    uint32_t Size() override { return user_policy_->Size(); }
+    const FilterPolicyMeta& GetMeta() override { return user_policy_->GetMeta(); }
+};
+
+// 把用户的SliceTransform包装成对内部键使用的版本，前缀取自内部键中的用户键部分
+// 得到的前缀是用户键的前缀，不带顺序号和类型
+class InternalKeySliceTransform : public SliceTransform {
+private:
+    std::shared_ptr<const SliceTransform> user_transform_;
+public:
+    explicit InternalKeySliceTransform(std::shared_ptr<const SliceTransform> t)
+        : user_transform_(std::move(t)) {}
+    const char* Name() const override { return user_transform_->Name(); }
+    Slice Transform(const Slice& key) const override {
+        return user_transform_->Transform(ExtractUserKey(key));
+    }
+    bool InDomain(const Slice& key) const override {
+        return user_transform_->InDomain(ExtractUserKey(key));
+    }
+};
+
 /**
  * @brief 
  * 当需要在leveldb查找对象的时候，查找顺序是从第0层到第n层遍历查找，
@@ -168,7 +250,7 @@ public:
         memcpy(dst, user_key.data(), usize);
         dst += usize;
         // 最后是64位的(顺序号<<8|值类型)，此处值类型是kValueTypeForSeek，和类名LookupKey照应上了
-        EncodeFixed64(dst, PackSequenceAndType(s, kValueTypeForSeek));
+        EncodeFixed64(dst, PackSequenceAndType(sequence, kValueTypeForSeek));
         dst += 8;
         // 记录结束位置，可以用于计算各种类型键值长度
         end_ = dst;
@@ -185,6 +267,8 @@ public:
     Slice internal_key() const { return Slice(kstart_, end_ - kstart_); }
     // 获取用户指定键
     Slice user_key() const { return Slice(kstart_, end_ - kstart_ - 8); }
+    // 读操作的顺序号
+    SequenceNumber sequence() const { return DecodeFixed64(end_ - 8) >> 8; }
  
 private:
     const char* start_;  // 指向存储空间的起始位置
@@ -0,0 +1,127 @@
+#include "filename.h"
+#include "../file/file_writer.h"
+
+#include <cassert>
+#include <cstdio>
+
+namespace tinykv {
+static std::string MakeFileName(const std::string& dbname, uint64_t number,
+				const char* suffix) {
+	char buf[100];
+	std::snprintf(buf, sizeof(buf), "/%06llu.%s",
+		      static_cast<unsigned long long>(number), suffix);
+	return dbname + buf;
+}
+
+std::string LogFileName(const std::string& dbname, uint64_t number) {
+	assert(number > 0);
+	return MakeFileName(dbname, number, "log");
+}
+
+std::string TableFileName(const std::string& dbname, uint64_t number) {
+	assert(number > 0);
+	return MakeFileName(dbname, number, "sst");
+}
+
+std::string TempFileName(const std::string& dbname, uint64_t number) {
+	assert(number > 0);
+	return MakeFileName(dbname, number, "dbtmp");
+}
+
+std::string BlobFileName(const std::string& dbname, uint64_t number) {
+	assert(number > 0);
+	return MakeFileName(dbname, number, "blob");
+}
+
+std::string DescriptorFileName(const std::string& dbname, uint64_t number) {
+	assert(number > 0);
+	char buf[100];
+	std::snprintf(buf, sizeof(buf), "/MANIFEST-%06llu",
+		      static_cast<unsigned long long>(number));
+	return dbname + buf;
+}
+
+std::string CurrentFileName(const std::string& dbname) {
+	return dbname + "/CURRENT";
+}
+
+std::string ColumnFamilyDirName(const std::string& dbname, uint32_t id) {
+	if (id == 0) {
+		return dbname;
+	}
+	char buf[100];
+	std::snprintf(buf, sizeof(buf), "/cf-%06u", id);
+	return dbname + buf;
+}
+
+DBStatus SetCurrentFile(const std::string& dbname, uint64_t descriptor_number) {
+	std::string contents = DescriptorFileName(dbname, descriptor_number);
+	// CURRENT中只保存MANIFEST的文件名，不包含目录
+	contents = contents.substr(dbname.size() + 1) + "\n";
+	const std::string tmp = TempFileName(dbname, descriptor_number);
+	DBStatus s;
+	{
+		FileWriter file(tmp);
+		s = file.Append(contents.data(), static_cast<int32_t>(contents.size()));
+		if (s == Status::kSuccess) {
+			s = file.Sync();
+		}
+		file.Close();
+	}
+	if (s == Status::kSuccess && !FileTool::Rename(tmp, CurrentFileName(dbname))) {
+		s = Status::kIOError;
+	}
+	if (s != Status::kSuccess) {
+		FileTool::RemoveFile(tmp);
+	}
+	return s;
+}
+
+bool ParseFileName(const std::string& filename, uint64_t* number, FileType* type) {
+	if (filename == "CURRENT") {
+		*number = 0;
+		*type = kCurrentFile;
+		return true;
+	}
+	const std::string manifest_prefix = "MANIFEST-";
+	size_t pos = 0;
+	if (filename.compare(0, manifest_prefix.size(), manifest_prefix) == 0) {
+		pos = manifest_prefix.size();
+	}
+	// 其余文件名的格式是"数字.后缀"，先解析前面的数字部分
+	const size_t num_start = pos;
+	uint64_t num = 0;
+	while (pos < filename.size() && filename[pos] >= '0' && filename[pos] <= '9') {
+		num = num * 10 + (filename[pos] - '0');
+		++pos;
+	}
+	if (pos == num_start) {
+		return false;
+	}
+	if (num_start > 0) {
+		if (pos != filename.size()) {
+			return false;
+		}
+		*number = num;
+		*type = kDescriptorFile;
+		return true;
+	}
+	if (pos >= filename.size() || filename[pos] != '.') {
+		return false;
+	}
+	const std::string suffix = filename.substr(pos + 1);
+	if (suffix == "log") {
+		*type = kLogFile;
+	} else if (suffix == "sst") {
+		*type = kTableFile;
+	} else if (suffix == "dbtmp") {
+		*type = kTempFile;
+	} else if (suffix == "blob") {
+		*type = kBlobFile;
+	} else {
+		return false;
+	}
+	*number = num;
+	return true;
+}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "../include/tinykv/status.h"
+
+namespace tinykv {
+// 数据库目录下的文件类型
+enum FileType {
+	kLogFile,	// WAL文件: [dbname]/[number].log
+	kTableFile,	// sst文件: [dbname]/[number].sst
+	kTempFile,	// 正在生成的临时文件: [dbname]/[number].dbtmp
+	kBlobFile,	// kv分离之后保存大value的文件: [dbname]/[number].blob
+	kDescriptorFile,	// 记录每一层有哪些sst的元数据文件: [dbname]/MANIFEST-[number]
+	kCurrentFile	// 记录当前使用的MANIFEST的文件名: [dbname]/CURRENT
+};
+
+// 除了CURRENT和MANIFEST，文件名都是"数据库目录/编号.后缀"的形式，编号全局递增，编号越大文件越新
+std::string LogFileName(const std::string& dbname, uint64_t number);
+std::string TableFileName(const std::string& dbname, uint64_t number);
+std::string TempFileName(const std::string& dbname, uint64_t number);
+std::string BlobFileName(const std::string& dbname, uint64_t number);
+std::string DescriptorFileName(const std::string& dbname, uint64_t number);
+std::string CurrentFileName(const std::string& dbname);
+// 编号为id的column family的目录: [dbname]/cf-[id]，里面的文件和数据库目录一样命名，但是没有WAL
+// 默认column family(编号0)直接使用数据库目录
+std::string ColumnFamilyDirName(const std::string& dbname, uint32_t id);
+
+// 让CURRENT指向编号为descriptor_number的MANIFEST
+// 先写临时文件再改名，保证崩溃时CURRENT要么是旧的内容，要么是新的内容
+DBStatus SetCurrentFile(const std::string& dbname, uint64_t descriptor_number);
+
+// 解析目录下的文件名，得到文件编号和类型，不是tinykv的文件返回false
+bool ParseFileName(const std::string& filename, uint64_t* number, FileType* type);
+}
@@ -0,0 +1,53 @@
+#include "merge_context.h"
+#include "../include/tinykv/merge_operator.h"
+
+namespace tinykv {
+// 从operands[end-1]开始(最旧的)依次合并到*acc上，has_acc为false时第一个操作数没有旧值
+static DBStatus MergeOperands(const MergeOperator* merge_operator, const Slice& user_key,
+			      const std::vector<std::string>& operands, size_t end,
+			      bool has_acc, std::string* acc) {
+	if (merge_operator == nullptr) {
+		return Status::kInvalidArgument;
+	}
+	std::string tmp;
+	for (size_t i = end; i > 0; i--) {
+		const Slice existing(*acc);
+		if (!merge_operator->Merge(user_key, has_acc ? &existing : nullptr,
+					   operands[i - 1], &tmp)) {
+			return Status::kCorruption;
+		}
+		acc->swap(tmp);
+		has_acc = true;
+	}
+	return Status::kSuccess;
+}
+
+DBStatus MergeContext::FullMerge(const MergeOperator* merge_operator, const Slice& user_key,
+				 const Slice* base, std::string* result) const {
+	std::string acc;
+	if (base != nullptr) {
+		acc.assign(base->data(), base->size());
+	}
+	DBStatus s = MergeOperands(merge_operator, user_key, operands_, operands_.size(),
+				   base != nullptr, &acc);
+	if (s == Status::kSuccess) {
+		result->swap(acc);
+	}
+	return s;
+}
+
+DBStatus MergeContext::PartialMerge(const MergeOperator* merge_operator,
+				    const Slice& user_key, std::string* result) const {
+	if (operands_.empty()) {
+		return Status::kInvalidArgument;
+	}
+	// 最旧的操作数作为旧值，把更新的操作数依次合并上去
+	std::string acc = operands_.back();
+	DBStatus s = MergeOperands(merge_operator, user_key, operands_, operands_.size() - 1,
+				   true, &acc);
+	if (s == Status::kSuccess) {
+		result->swap(acc);
+	}
+	return s;
+}
+}
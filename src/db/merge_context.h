@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../include/tinykv/slice.h"
+#include "../include/tinykv/status.h"
+
+namespace tinykv {
+class MergeOperator;
+
+// 读取一个key时从新到旧收集到的merge操作数，遇到完整的value、删除标记或者没有更旧的版本时
+// 再把它们合并到旧值上
+class MergeContext {
+public:
+	MergeContext() = default;
+
+	MergeContext(const MergeContext&) = delete;
+	MergeContext& operator=(const MergeContext&) = delete;
+
+	// 操作数需要按从新到旧的顺序加入
+	void PushOperand(const Slice& operand) {
+		operands_.emplace_back(operand.data(), operand.size());
+	}
+	bool Empty() const { return operands_.empty(); }
+	size_t NumOperands() const { return operands_.size(); }
+	void Clear() { operands_.clear(); }
+
+	// 以base为旧值(为nullptr表示key不存在)，从旧到新依次合并所有操作数，结果写入*result
+	// result可以和base指向同一块内存。没有设置MergeOperator时返回kInvalidArgument，合并失败时返回kCorruption
+	DBStatus FullMerge(const MergeOperator* merge_operator, const Slice& user_key,
+			   const Slice* base, std::string* result) const;
+	// 不知道旧值时把所有操作数合并成一个操作数，依赖MergeOperator满足结合律
+	DBStatus PartialMerge(const MergeOperator* merge_operator, const Slice& user_key,
+			      std::string* result) const;
+
+private:
+	// 从新到旧
+	std::vector<std::string> operands_;
+};
+}
@@ -11,12 +11,40 @@ namespace tinykv {
 
 class FilterPolicy;
 class Comparator;
+class CompactionFilter;
+class MemTableRepFactory;
+class MergeOperator;
+class RateLimiter;
+class SliceTransform;
+class Snapshot;
 
 enum BlockCompressType {
 	kNonCompress = 0x0,
 	kSnappyCompression = 0x1
 };
 
+enum CompactionStyle {
+	// 分层compaction: 每一层的数据量是上一层的10倍，读放大和空间放大小，写放大大
+	kCompactionStyleLevel = 0x0,
+	// 分级(universal) compaction: 所有数据都在L0，每个sst是一个有序段，
+	// 把大小相近的相邻有序段合并成一个，写放大小，读放大和空间放大大
+	kCompactionStyleUniversal = 0x1
+};
+
+// universal compaction的参数，只在compaction_style为kCompactionStyleUniversal时生效
+struct UniversalCompactionOptions {
+	// 比较相邻有序段的大小时允许的误差(百分比)
+	// 已选中的有序段的总大小 * (100 + size_ratio) / 100 不小于下一个有序段时，把下一个也选上
+	uint32_t size_ratio = 1;
+	// 一次最少合并几个有序段
+	uint32_t min_merge_width = 2;
+	// 一次最多合并几个有序段
+	uint32_t max_merge_width = UINT32_MAX;
+	// 空间放大的上限(百分比)，即除最旧的有序段以外所有有序段的大小之和 / 最旧的有序段的大小
+	// 超过之后把所有有序段合并成一个，调大可以减少写放大，但是会占用更多的磁盘空间
+	uint32_t max_size_amplification_percent = 200;
+};
+
 // DB的配置信息，如是否开启同步、缓存池等
 struct Options {
 	// 单个block的大小
@@ -25,18 +53,80 @@ struct Options {
 	uint32_t block_restart_interval = 16;
 	// 最多的层数，默认是7
 	uint32_t max_level_num = 7;
-	// kv分离的阈值(默认1024K)
+	// kv分离的阈值(默认1KB): 长度不小于这个值的value在刷盘和compaction时写到单独的blob文件中，
+	// sst中只保存指向它的BlobIndex，compaction时不需要重写value。为0时不做kv分离
 	uint32_t max_key_value_split_threshold = 1024;
+	// blob文件中不再被引用的数据占比达到这个值之后，compaction时会把其中还有效的value搬到新的blob文件中，
+	// 旧文件中的数据全部变成垃圾之后被删除。为0时不主动搬迁，只在文件中的数据全部失效之后删除
+	double blob_garbage_collection_ratio = 0.5;
 	// 默认不会进行压缩
 	BlockCompressType block_compress_type = BlockCompressType::kNonCompress;
+	// memtable的大小超过这个值之后就会变成immutable memtable，由后台线程刷成sst(默认4MB)
+	size_t write_buffer_size = 4 * 1024 * 1024;
+	// 大于0时memtable的内存用这个大小的大页映射(一般是2MB)，减少在很大的memtable中查找跳表时的TLB miss，
+	// 优先使用MAP_HUGETLB(需要系统预留大页)，不够时退回透明大页，都失败时使用普通的内存
+	// 每个memtable至少占用一个大页。为0时不使用大页
+	size_t memtable_huge_page_size = 0;
+	// memtable中记录的存放方式(见memtable/memtable_rep.h)，为nullptr时用跳表
+	// 点查多、范围查询少时可以用NewHashSkipListRepFactory()，点查平均O(1)，但迭代器和刷盘需要先排序；
+	// 它的桶数组(每个桶8字节)计入write_buffer_size，bucket_count要和写缓冲的大小相匹配
+	// 只写不读的批量导入可以用NewVectorRepFactory()，插入只是追加到数组，刷盘前排序一次；
+	// 但是排序之前的每次点查都要持有锁扫描整个memtable(O(n))，期间阻塞所有写入，不要在边写边读的场景使用
+	std::shared_ptr<MemTableRepFactory> memtable_factory = nullptr;
+	// compaction生成的单个sst文件的大小上限(默认2MB)
+	size_t max_file_size = 2 * 1024 * 1024;
+	// compaction的策略，默认是分层compaction
+	CompactionStyle compaction_style = kCompactionStyleLevel;
+	UniversalCompactionOptions universal_compaction;
+	// 打开DB时回放WAL的线程数，每个WAL按32KB的block对齐切成若干段，由多个线程同时回放
+	uint32_t recovery_threads = 4;
+	// 一次分层compaction最多切成几个互不重叠的key范围(subcompaction)，每个范围由一个线程合并、
+	// 写出自己的sst，全部完成之后一起生效。为1时不切分，只由后台线程合并
+	uint32_t max_subcompactions = 1;
+	// 最多同时打开多少个sst(文件描述符)，打开的sst缓存在TableCache中，超过之后关闭最久没有使用的
+	uint32_t max_open_files = 1000;
+	// 为true时，合并写入的一组batch写完WAL之后，由各自的写线程同时插入memtable，而不是全部由leader插入
+	bool allow_concurrent_memtable_write = false;
+	// 为true时写入分成WAL和memtable两个阶段，一组写完WAL之后下一组就可以开始写WAL，
+	// 不用等前一组插入完memtable，各组仍然按写WAL的顺序发布顺序号
+	bool enable_pipelined_write = false;
 
 	std::shared_ptr<FilterPolicy> filter_policy = nullptr;
+	// 不为nullptr且设置了filter_policy时，sst的过滤器中除了完整的key还会加入每个key的前缀，
+	// 前缀迭代(ReadOptions::prefix_same_as_start)时过滤器中没有这个前缀的sst会被整个跳过
+	std::shared_ptr<const SliceTransform> prefix_extractor = nullptr;
 	std::shared_ptr<Comparator> comparator = nullptr;
+	// 不为nullptr时，compaction对每个key不被任何快照引用的最新版本调用它，决定丢弃还是改写value
+	std::shared_ptr<const CompactionFilter> compaction_filter = nullptr;
+	// DB::Merge写入的操作数由它合并，没有设置时不能写入merge
+	std::shared_ptr<const MergeOperator> merge_operator = nullptr;
+	// 大于0时开启TTL(秒): Put时在value末尾追加写入时间，读取时去掉，
+	// compaction时丢弃写入超过ttl秒的key(使用内置的TtlCompactionFilter，忽略compaction_filter)
+	// 过期的key在被compaction之前仍然可以读到，同一个DB打开时ttl需要一直为0或者一直大于0
+	// 开启TTL的column family不能写入merge
+	uint32_t ttl = 0;
+	// 不为nullptr时限制WAL、memtable刷盘和compaction写文件的总速率，令牌不够时WAL优先，compaction最后
+	// 可以在多个DB之间共享
+	std::shared_ptr<RateLimiter> rate_limiter = nullptr;
 
-	Cache<Slice, DataBlock>* block_cache = nullptr;
+	// key是cache_id+block offset编码后的16字节字符串，Slice不持有内存，不能作为cache的key
+	// 构造Cache时传入NewHugePageAllocator()，缓存的block数据就放在大页中
+	Cache<std::string, DataBlock>* block_cache = nullptr;
 };
 struct ReadOptions {
-	
+	// 不为nullptr时读取这个快照时刻的数据，必须是还没有释放的快照
+	// 为nullptr时读取调用时刻的最新数据
+	const Snapshot* snapshot = nullptr;
+	// 为true且设置了Options::prefix_extractor时，迭代器Seek(target)之后只返回和target前缀相同的key，
+	// 离开这个前缀之后变为无效；前缀过滤器中没有这个前缀的sst不会读取index block和data block
+	// 这种模式下Seek之后只能调用Next，Prev会让迭代器失效并返回kInvalidArgument
+	// target没有前缀(不在InDomain中)时和普通的迭代器一样
+	bool prefix_same_as_start = false;
+};
+
+struct WriteOptions {
+	// 为true时写完WAL之后会调用fsync，保证机器掉电也不会丢数据
+	bool sync = false;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "range_tombstone.h"
+#include "../include/tinykv/comparator.h"
+#include "../include/tinykv/iterator.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace tinykv {
+DBStatus CollectRangeTombstones(Iterator* iter, SequenceNumber upper_seq,
+				std::vector<RangeTombstone>* tombstones) {
+	if (iter == nullptr) {
+		return Status::kSuccess;
+	}
+	ParsedInternalKey ikey;
+	for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+		if (!ParseInternalKey(iter->key(), &ikey) || ikey.type != kTypeRangeDeletion) {
+			return Status::kCorruption;
+		}
+		if (ikey.sequence <= upper_seq) {
+			tombstones->emplace_back(ikey.user_key, iter->value(), ikey.sequence);
+		}
+	}
+	return iter->status();
+}
+
+FragmentedRangeTombstoneList::FragmentedRangeTombstoneList(
+	const Comparator* ucmp, std::vector<RangeTombstone> tombstones)
+	: ucmp_(ucmp) {
+	// 空的范围不覆盖任何key
+	tombstones.erase(std::remove_if(tombstones.begin(), tombstones.end(),
+					[ucmp](const RangeTombstone& t) {
+						return ucmp->Compare(t.start, t.end) >= 0;
+					}),
+			 tombstones.end());
+	std::sort(tombstones.begin(), tombstones.end(),
+		  [ucmp](const RangeTombstone& a, const RangeTombstone& b) {
+			  return ucmp->Compare(a.start, b.start) < 0;
+		  });
+
+	// 所有范围的起点和终点把key空间切成若干段，每一段被哪些范围删除覆盖是确定的
+	std::vector<Slice> bounds;
+	bounds.reserve(tombstones.size() * 2);
+	for (const RangeTombstone& t : tombstones) {
+		bounds.emplace_back(t.start);
+		bounds.emplace_back(t.end);
+	}
+	std::sort(bounds.begin(), bounds.end(), [ucmp](const Slice& a, const Slice& b) {
+		return ucmp->Compare(a, b) < 0;
+	});
+	bounds.erase(std::unique(bounds.begin(), bounds.end(),
+				 [ucmp](const Slice& a, const Slice& b) {
+					 return ucmp->Compare(a, b) == 0;
+				 }),
+		     bounds.end());
+
+	// 从左往右扫描，active是覆盖当前这一段的范围删除
+	std::vector<const RangeTombstone*> active;
+	size_t next = 0;
+	for (size_t i = 0; i + 1 < bounds.size(); i++) {
+		const Slice& begin = bounds[i];
+		active.erase(std::remove_if(active.begin(), active.end(),
+					    [ucmp, &begin](const RangeTombstone* t) {
+						    return ucmp->Compare(t->end, begin) <= 0;
+					    }),
+			     active.end());
+		while (next < tombstones.size() &&
+		       ucmp->Compare(tombstones[next].start, begin) <= 0) {
+			active.push_back(&tombstones[next++]);
+		}
+		if (active.empty()) {
+			continue;
+		}
+
+		Fragment fragment;
+		fragment.start = begin.ToString();
+		fragment.end = bounds[i + 1].ToString();
+		fragment.seq_begin = seqs_.size();
+		for (const RangeTombstone* t : active) {
+			seqs_.push_back(t->seq);
+		}
+		auto first = seqs_.begin() + fragment.seq_begin;
+		std::sort(first, seqs_.end(), std::greater<SequenceNumber>());
+		seqs_.erase(std::unique(first, seqs_.end()), seqs_.end());
+		fragment.seq_end = seqs_.size();
+		fragments_.push_back(std::move(fragment));
+	}
+}
+
+SequenceNumber FragmentedRangeTombstoneList::MaxCoveringSeq(const Slice& user_key,
+							     SequenceNumber read_seq) const {
+	// 最后一个start <= user_key的片段
+	auto it = std::upper_bound(fragments_.begin(), fragments_.end(), user_key,
+				   [this](const Slice& key, const Fragment& f) {
+					   return ucmp_->Compare(key, f.start) < 0;
+				   });
+	if (it == fragments_.begin()) {
+		return 0;
+	}
+	--it;
+	if (ucmp_->Compare(user_key, it->end) >= 0) {
+		return 0;
+	}
+	// 顺序号从大到小排列，第一个不大于read_seq的就是对读操作可见的最大顺序号
+	auto first = seqs_.begin() + it->seq_begin;
+	auto last = seqs_.begin() + it->seq_end;
+	auto seq = std::lower_bound(first, last, read_seq, std::greater<SequenceNumber>());
+	return seq == last ? 0 : *seq;
+}
+
+void FragmentedRangeTombstoneList::AppendTo(SequenceNumber upper_seq,
+					    std::vector<RangeTombstone>* tombstones) const {
+	for (const Fragment& f : fragments_) {
+		for (size_t i = f.seq_begin; i < f.seq_end; i++) {
+			if (seqs_[i] <= upper_seq) {
+				tombstones->emplace_back(f.start, f.end, seqs_[i]);
+			}
+		}
+	}
+}
+}
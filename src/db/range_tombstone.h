@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "dbformat.h"
+#include "../include/tinykv/slice.h"
+#include "../include/tinykv/status.h"
+
+namespace tinykv {
+class Comparator;
+class Iterator;
+
+// 一条范围删除: 删除user key在[start, end)中、顺序号小于seq的所有版本
+// memtable和sst中保存为key=InternalKey(start, seq, kTypeRangeDeletion)，value=end
+struct RangeTombstone {
+	std::string start;
+	std::string end;
+	SequenceNumber seq = 0;
+
+	RangeTombstone() = default;
+	RangeTombstone(const Slice& s, const Slice& e, SequenceNumber sequence)
+		: start(s.data(), s.size()), end(e.data(), e.size()), seq(sequence) {}
+};
+
+// 把iter中保存的范围删除追加到tombstones中，顺序号大于upper_seq的忽略
+// iter为nullptr表示没有范围删除
+DBStatus CollectRangeTombstones(Iterator* iter, SequenceNumber upper_seq,
+				std::vector<RangeTombstone>* tombstones);
+
+// 把可能互相重叠的范围删除切成互不重叠的片段，每个片段记录覆盖它的所有顺序号(从大到小)，
+// 查询一个key被覆盖的最大顺序号只需要两次二分查找
+// 创建之后只读，可以在多个线程中同时使用
+class FragmentedRangeTombstoneList final {
+public:
+	struct Fragment {
+		std::string start;
+		std::string end;
+		// 覆盖这个片段的顺序号在seqs_中的范围[seq_begin, seq_end)
+		size_t seq_begin;
+		size_t seq_end;
+	};
+
+	FragmentedRangeTombstoneList(const Comparator* ucmp,
+				     std::vector<RangeTombstone> tombstones);
+
+	FragmentedRangeTombstoneList(const FragmentedRangeTombstoneList&) = delete;
+	FragmentedRangeTombstoneList& operator=(const FragmentedRangeTombstoneList&) = delete;
+
+	bool Empty() const { return fragments_.empty(); }
+	// 按start排列的片段，相邻的片段之间可能有空隙
+	const std::vector<Fragment>& fragments() const { return fragments_; }
+	SequenceNumber seq(size_t i) const { return seqs_[i]; }
+
+	// user_key被顺序号不大于read_seq的范围删除覆盖时，返回其中最大的顺序号；没有被覆盖时返回0
+	SequenceNumber MaxCoveringSeq(const Slice& user_key, SequenceNumber read_seq) const;
+
+	// 把顺序号不大于upper_seq的部分按片段还原成范围删除，用于合并多个来源
+	void AppendTo(SequenceNumber upper_seq, std::vector<RangeTombstone>* tombstones) const;
+
+private:
+	const Comparator* const ucmp_;
+	std::vector<Fragment> fragments_;
+	std::vector<SequenceNumber> seqs_;
+};
+}
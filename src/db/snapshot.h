@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cassert>
+
+#include "dbformat.h"
+
+namespace tinykv {
+class SnapshotList;
+
+// DB::GetSnapshot返回的快照，读操作带上快照之后只能看到顺序号不大于sequence_number()的数据
+// 快照存在期间，compaction会保留对它可见的旧版本
+class Snapshot final {
+public:
+	Snapshot(const Snapshot&) = delete;
+	Snapshot& operator=(const Snapshot&) = delete;
+
+	SequenceNumber sequence_number() const { return sequence_number_; }
+
+private:
+	friend class SnapshotList;
+
+	explicit Snapshot(SequenceNumber sequence_number)
+		: sequence_number_(sequence_number) {}
+	~Snapshot() = default;
+
+	const SequenceNumber sequence_number_;
+	// 所有快照按照创建的顺序组成一个双向循环链表
+	Snapshot* prev_ = nullptr;
+	Snapshot* next_ = nullptr;
+};
+
+// DB中所有还没有释放的快照，顺序号从旧到新排列，需要在DB的mutex保护下使用
+class SnapshotList final {
+public:
+	SnapshotList() : head_(0) {
+		head_.prev_ = &head_;
+		head_.next_ = &head_;
+	}
+	~SnapshotList() { assert(Empty()); }
+
+	SnapshotList(const SnapshotList&) = delete;
+	SnapshotList& operator=(const SnapshotList&) = delete;
+
+	bool Empty() const { return head_.next_ == &head_; }
+	Snapshot* Oldest() const {
+		assert(!Empty());
+		return head_.next_;
+	}
+	Snapshot* Newest() const {
+		assert(!Empty());
+		return head_.prev_;
+	}
+
+	// 创建一个新的快照，顺序号不能比已有的快照小
+	Snapshot* New(SequenceNumber sequence_number) {
+		assert(Empty() || Newest()->sequence_number_ <= sequence_number);
+		Snapshot* snapshot = new Snapshot(sequence_number);
+		snapshot->next_ = &head_;
+		snapshot->prev_ = head_.prev_;
+		snapshot->prev_->next_ = snapshot;
+		snapshot->next_->prev_ = snapshot;
+		return snapshot;
+	}
+
+	void Delete(const Snapshot* snapshot) {
+		snapshot->prev_->next_ = snapshot->next_;
+		snapshot->next_->prev_ = snapshot->prev_;
+		delete snapshot;
+	}
+
+private:
+	// 链表的哑节点，不是真正的快照
+	Snapshot head_;
+};
+}
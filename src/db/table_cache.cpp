@@ -0,0 +1,102 @@
+#include "table_cache.h"
+#include "filename.h"
+#include "options.h"
+#include "../file/file_reader.h"
+#include "../include/tinykv/iterator.h"
+#include "../logger/log.h"
+#include "../table/table.h"
+
+#include <algorithm>
+
+namespace tinykv {
+TableAndFile::TableAndFile() = default;
+
+TableAndFile::~TableAndFile() = default;
+
+static void DeleteTableAndFile(const uint64_t& /*file_number*/, TableAndFile* tf) {
+	delete tf;
+}
+
+static void ReleaseTableHandle(void* arg1, void* arg2) {
+	TableCache* cache = reinterpret_cast<TableCache*>(arg1);
+	cache->Release(reinterpret_cast<TableCache::Handle*>(arg2));
+}
+
+TableCache::TableCache(const std::string& dbname, const Options* options,
+		       uint32_t capacity)
+	: dbname_(dbname)
+	, options_(options)
+	, cache_(static_cast<uint32_t>(std::max<uint64_t>(
+		  1, (capacity + Cache<uint64_t, TableAndFile>::kShardNum - 1) /
+			     Cache<uint64_t, TableAndFile>::kShardNum))) {
+	cache_.RegistCleanHandle(DeleteTableAndFile);
+}
+
+TableCache::~TableCache() = default;
+
+DBStatus TableCache::FindTable(uint64_t file_number, uint64_t file_size, Handle** handle) {
+	// 插入之后到再次Get之前可能已经被其他线程的插入挤出去了，这时重新打开
+	while ((*handle = cache_.Get(file_number)) == nullptr) {
+		// 多个线程同时打开同一个sst时，后插入的替换先插入的，结果是一样的
+		std::unique_ptr<TableAndFile> tf(new TableAndFile);
+		tf->file.reset(new FileReader(TableFileName(dbname_, file_number)));
+		Table* table = nullptr;
+		DBStatus s = Table::Open(*options_, tf->file.get(), file_size, &table);
+		if (s != Status::kSuccess) {
+			// 不缓存错误，文件修复之后可以重新打开
+			LOG(ERROR, "open table %llu failed: %s",
+			    static_cast<unsigned long long>(file_number), s.message);
+			return s;
+		}
+		tf->table.reset(table);
+		cache_.Insert(file_number, tf.release());
+	}
+	return Status::kSuccess;
+}
+
+void TableCache::Release(Handle* handle) {
+	cache_.Release(handle);
+}
+
+Iterator* TableCache::NewIterator(const ReadOptions& options, uint64_t file_number,
+				  uint64_t file_size) {
+	Handle* handle = nullptr;
+	DBStatus s = FindTable(file_number, file_size, &handle);
+	if (s != Status::kSuccess) {
+		return NewErrorIterator(s);
+	}
+	Iterator* iter = handle->value->table->NewIterator(options);
+	iter->RegisterCleanup(&ReleaseTableHandle, this, handle);
+	return iter;
+}
+
+DBStatus TableCache::Get(const ReadOptions& options, uint64_t file_number,
+			 uint64_t file_size, const Slice& target, void* arg,
+			 void (*handle_result)(void* arg, const Slice& key,
+					       const Slice& value)) {
+	Handle* handle = nullptr;
+	DBStatus s = FindTable(file_number, file_size, &handle);
+	if (s == Status::kSuccess) {
+		s = handle->value->table->InternalGet(options, target, arg, handle_result);
+		Release(handle);
+	}
+	return s;
+}
+
+DBStatus TableCache::MultiGet(const ReadOptions& options, uint64_t file_number,
+			      uint64_t file_size, const Slice* targets, int n, void* arg,
+			      void (*handle_result)(void* arg, int index, const Slice& key,
+						    const Slice& value)) {
+	Handle* handle = nullptr;
+	DBStatus s = FindTable(file_number, file_size, &handle);
+	if (s == Status::kSuccess) {
+		s = handle->value->table->MultiGet(options, targets, n, arg, handle_result);
+		Release(handle);
+	}
+	return s;
+}
+
+void TableCache::Evict(uint64_t file_number) {
+	cache_.Erase(file_number);
+}
+}
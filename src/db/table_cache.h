@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+#include "../cache/cache.h"
+#include "../include/tinykv/slice.h"
+#include "../include/tinykv/status.h"
+
+namespace tinykv {
+class FileReader;
+class Iterator;
+class Table;
+struct Options;
+struct ReadOptions;
+
+// 一个打开的sst，FileReader持有文件描述符，Table持有footer、index block和过滤器
+struct TableAndFile {
+	std::unique_ptr<FileReader> file;
+	std::unique_ptr<Table> table;
+
+	TableAndFile();
+	~TableAndFile();
+};
+
+// 按文件编号缓存打开的sst，同一个sst只在第一次使用时读取footer、index block和过滤器
+// 内部按文件编号分片，每个分片独立做LRU淘汰，最多同时打开capacity个sst(文件描述符)
+// 被淘汰的sst在所有使用者Release之后才会关闭
+// 可以在多个线程中同时使用
+class TableCache final {
+public:
+	// options中的comparator必须是InternalKeyComparator，TableCache使用期间options必须有效
+	TableCache(const std::string& dbname, const Options* options, uint32_t capacity);
+	~TableCache();
+
+	TableCache(const TableCache&) = delete;
+	TableCache& operator=(const TableCache&) = delete;
+
+	using Handle = CacheNode<uint64_t, TableAndFile>;
+
+	// 取出编号为file_number的sst，不在cache中时打开它，用完之后调用Release
+	DBStatus FindTable(uint64_t file_number, uint64_t file_size, Handle** handle);
+	void Release(Handle* handle);
+
+	// 遍历编号为file_number的sst，迭代器析构之前sst不会被关闭
+	Iterator* NewIterator(const ReadOptions& options, uint64_t file_number,
+			      uint64_t file_size);
+
+	// 在编号为file_number的sst中点查，含义和Table::InternalGet相同
+	DBStatus Get(const ReadOptions& options, uint64_t file_number, uint64_t file_size,
+		     const Slice& target, void* arg,
+		     void (*handle_result)(void* arg, const Slice& key, const Slice& value));
+
+	// 在编号为file_number的sst中批量点查，含义和Table::MultiGet相同
+	DBStatus MultiGet(const ReadOptions& options, uint64_t file_number, uint64_t file_size,
+			  const Slice* targets, int n, void* arg,
+			  void (*handle_result)(void* arg, int index, const Slice& key,
+						const Slice& value));
+
+	// 编号为file_number的sst已经被删除，从cache中去掉，正在使用的在Release之后关闭
+	void Evict(uint64_t file_number);
+
+private:
+	const std::string dbname_;
+	const Options* const options_;
+	Cache<uint64_t, TableAndFile> cache_;
+};
+}
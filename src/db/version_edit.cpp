@@ -0,0 +1,205 @@
+#include "version_edit.h"
+#include "../utils/codec.h"
+
+namespace tinykv {
+// 序列化时每个字段前面的标记，写入MANIFEST之后就不能再修改了
+enum Tag {
+	kComparator = 1,
+	kLogNumber = 2,
+	kNextFileNumber = 3,
+	kLastSequence = 4,
+	kCompactPointer = 5,
+	kDeletedFile = 6,
+	kNewFile = 7,
+	kNewBlobFile = 8,
+	kBlobGarbage = 9,
+	kColumnFamily = 10
+};
+
+void VersionEdit::Clear() {
+	comparator_.clear();
+	log_number_ = 0;
+	next_file_number_ = 0;
+	last_sequence_ = 0;
+	has_comparator_ = false;
+	has_log_number_ = false;
+	has_next_file_number_ = false;
+	has_last_sequence_ = false;
+	compact_pointers_.clear();
+	deleted_files_.clear();
+	new_files_.clear();
+	new_blob_files_.clear();
+	blob_garbage_.clear();
+	new_column_families_.clear();
+}
+
+void VersionEdit::EncodeTo(std::string* dst) const {
+	if (has_comparator_) {
+		PutVarint32(dst, kComparator);
+		PutLengthPrefixedSlice(dst, comparator_);
+	}
+	if (has_log_number_) {
+		PutVarint32(dst, kLogNumber);
+		PutVarint64(dst, log_number_);
+	}
+	if (has_next_file_number_) {
+		PutVarint32(dst, kNextFileNumber);
+		PutVarint64(dst, next_file_number_);
+	}
+	if (has_last_sequence_) {
+		PutVarint32(dst, kLastSequence);
+		PutVarint64(dst, last_sequence_);
+	}
+	for (const auto& cp : compact_pointers_) {
+		PutVarint32(dst, kCompactPointer);
+		PutVarint32(dst, cp.first);
+		PutLengthPrefixedSlice(dst, cp.second.Encode());
+	}
+	for (const auto& deleted : deleted_files_) {
+		PutVarint32(dst, kDeletedFile);
+		PutVarint32(dst, deleted.first);
+		PutVarint64(dst, deleted.second);
+	}
+	for (const auto& nf : new_files_) {
+		const FileMetaData& f = nf.second;
+		PutVarint32(dst, kNewFile);
+		PutVarint32(dst, nf.first);
+		PutVarint64(dst, f.number);
+		PutVarint64(dst, f.file_size);
+		PutLengthPrefixedSlice(dst, f.smallest.Encode());
+		PutLengthPrefixedSlice(dst, f.largest.Encode());
+		PutVarint64(dst, f.smallest_seq);
+		PutVarint64(dst, f.largest_seq);
+	}
+	for (const auto& f : new_blob_files_) {
+		PutVarint32(dst, kNewBlobFile);
+		PutVarint64(dst, f.number);
+		PutVarint64(dst, f.total_count);
+		PutVarint64(dst, f.total_bytes);
+		PutVarint64(dst, f.garbage_count);
+		PutVarint64(dst, f.garbage_bytes);
+	}
+	for (const auto& garbage : blob_garbage_) {
+		PutVarint32(dst, kBlobGarbage);
+		PutVarint64(dst, garbage.first);
+		PutVarint64(dst, garbage.second.count);
+		PutVarint64(dst, garbage.second.bytes);
+	}
+	for (const auto& cf : new_column_families_) {
+		PutVarint32(dst, kColumnFamily);
+		PutVarint32(dst, cf.first);
+		PutLengthPrefixedSlice(dst, cf.second);
+	}
+}
+
+static bool GetInternalKey(Slice* input, InternalKey* dst) {
+	Slice str;
+	if (!GetLengthPrefixedSlice(input, &str) || str.size() < 8) {
+		return false;
+	}
+	dst->DecodeFrom(str);
+	return true;
+}
+
+static bool GetLevel(Slice* input, int* level) {
+	uint32_t v;
+	if (!GetVarint32(input, &v)) {
+		return false;
+	}
+	*level = static_cast<int>(v);
+	return true;
+}
+
+DBStatus VersionEdit::DecodeFrom(const Slice& src) {
+	Clear();
+	Slice input = src;
+	uint32_t tag;
+	int level;
+	uint64_t number;
+	FileMetaData f;
+	BlobFileMetaData blob;
+	BlobGarbage garbage;
+	uint32_t cf_id;
+	Slice str;
+	InternalKey key;
+	bool ok = true;
+
+	while (ok && GetVarint32(&input, &tag)) {
+		switch (tag) {
+			case kComparator:
+				ok = GetLengthPrefixedSlice(&input, &str);
+				if (ok) {
+					comparator_ = str.ToString();
+					has_comparator_ = true;
+				}
+				break;
+			case kLogNumber:
+				ok = GetVarint64(&input, &log_number_);
+				has_log_number_ = ok;
+				break;
+			case kNextFileNumber:
+				ok = GetVarint64(&input, &next_file_number_);
+				has_next_file_number_ = ok;
+				break;
+			case kLastSequence:
+				ok = GetVarint64(&input, &last_sequence_);
+				has_last_sequence_ = ok;
+				break;
+			case kCompactPointer:
+				ok = GetLevel(&input, &level) && GetInternalKey(&input, &key);
+				if (ok) {
+					compact_pointers_.push_back(std::make_pair(level, key));
+				}
+				break;
+			case kDeletedFile:
+				ok = GetLevel(&input, &level) && GetVarint64(&input, &number);
+				if (ok) {
+					deleted_files_.insert(std::make_pair(level, number));
+				}
+				break;
+			case kNewFile:
+				ok = GetLevel(&input, &level) && GetVarint64(&input, &f.number) &&
+				     GetVarint64(&input, &f.file_size) &&
+				     GetInternalKey(&input, &f.smallest) &&
+				     GetInternalKey(&input, &f.largest) &&
+				     GetVarint64(&input, &f.smallest_seq) &&
+				     GetVarint64(&input, &f.largest_seq);
+				if (ok) {
+					new_files_.push_back(std::make_pair(level, f));
+				}
+				break;
+			case kNewBlobFile:
+				ok = GetVarint64(&input, &blob.number) &&
+				     GetVarint64(&input, &blob.total_count) &&
+				     GetVarint64(&input, &blob.total_bytes) &&
+				     GetVarint64(&input, &blob.garbage_count) &&
+				     GetVarint64(&input, &blob.garbage_bytes);
+				if (ok) {
+					new_blob_files_.push_back(blob);
+				}
+				break;
+			case kBlobGarbage:
+				ok = GetVarint64(&input, &number) &&
+				     GetVarint64(&input, &garbage.count) &&
+				     GetVarint64(&input, &garbage.bytes);
+				if (ok) {
+					AddBlobGarbage(number, garbage.count, garbage.bytes);
+				}
+				break;
+			case kColumnFamily:
+				ok = GetVarint32(&input, &cf_id) && GetLengthPrefixedSlice(&input, &str);
+				if (ok) {
+					AddColumnFamily(cf_id, str.ToString());
+				}
+				break;
+			default:
+				ok = false;
+				break;
+		}
+	}
+	if (!ok || !input.empty()) {
+		return Status::kCorruption;
+	}
+	return Status::kSuccess;
+}
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "dbformat.h"
+#include "../include/tinykv/status.h"
+
+namespace tinykv {
+// 一个sst文件的元数据
+struct FileMetaData {
+	uint64_t number = 0;	// 文件编号
+	uint64_t file_size = 0;	// 文件大小
+	InternalKey smallest;	// 文件中最小的内部键
+	InternalKey largest;	// 文件中最大的内部键
+	SequenceNumber smallest_seq = 0;	// 文件中最小的顺序号
+	SequenceNumber largest_seq = 0;	// 文件中最大的顺序号，L0的文件按这个值从新到旧排列
+};
+
+// 一个blob文件的元数据
+// blob文件写完之后就不会再修改，只是其中的record随着sst中的BlobIndex被compaction丢弃而逐渐变成垃圾
+// garbage_count等于total_count时没有任何sst再引用这个文件，可以删除
+struct BlobFileMetaData {
+	uint64_t number = 0;		// 文件编号
+	uint64_t total_count = 0;	// record的个数
+	uint64_t total_bytes = 0;	// 所有record的大小之和
+	uint64_t garbage_count = 0;	// 已经不再被引用的record的个数
+	uint64_t garbage_bytes = 0;	// 已经不再被引用的record的大小之和
+};
+
+// 两个Version之间的差异，每次刷盘或者compaction都会生成一个VersionEdit追加到MANIFEST中
+// 重启时从空的Version开始依次应用MANIFEST中的所有VersionEdit，就能恢复出最新的Version
+class VersionEdit {
+public:
+	VersionEdit() = default;
+	~VersionEdit() = default;
+
+	void Clear();
+
+	void SetComparatorName(const Slice& name) {
+		has_comparator_ = true;
+		comparator_ = name.ToString();
+	}
+	// 编号小于log_number的WAL中的数据都已经刷成sst了
+	void SetLogNumber(uint64_t num) {
+		has_log_number_ = true;
+		log_number_ = num;
+	}
+	void SetNextFile(uint64_t num) {
+		has_next_file_number_ = true;
+		next_file_number_ = num;
+	}
+	void SetLastSequence(SequenceNumber seq) {
+		has_last_sequence_ = true;
+		last_sequence_ = seq;
+	}
+	void SetCompactPointer(int level, const InternalKey& key) {
+		compact_pointers_.push_back(std::make_pair(level, key));
+	}
+
+	// 在level层加入一个文件
+	void AddFile(int level, const FileMetaData& f) {
+		new_files_.push_back(std::make_pair(level, f));
+	}
+	// 从level层删除编号为file的文件
+	void RemoveFile(int level, uint64_t file) {
+		deleted_files_.insert(std::make_pair(level, file));
+	}
+
+	// 新增一个blob文件
+	void AddBlobFile(const BlobFileMetaData& f) {
+		new_blob_files_.push_back(f);
+	}
+	// 编号为file的blob文件中又有count个、共bytes字节的record变成了垃圾
+	void AddBlobGarbage(uint64_t file, uint64_t count, uint64_t bytes) {
+		BlobGarbage& garbage = blob_garbage_[file];
+		garbage.count += count;
+		garbage.bytes += bytes;
+	}
+
+	// 新建一个编号为id、名字为name的column family，只记录在默认column family的MANIFEST中
+	void AddColumnFamily(uint32_t id, const std::string& name) {
+		new_column_families_.push_back(std::make_pair(id, name));
+	}
+
+	void EncodeTo(std::string* dst) const;
+	// 格式不对时返回kCorruption
+	DBStatus DecodeFrom(const Slice& src);
+
+private:
+	friend class VersionSet;
+
+	using DeletedFileSet = std::set<std::pair<int, uint64_t>>;
+	struct BlobGarbage {
+		uint64_t count = 0;
+		uint64_t bytes = 0;
+	};
+
+	std::string comparator_;
+	uint64_t log_number_ = 0;
+	uint64_t next_file_number_ = 0;
+	SequenceNumber last_sequence_ = 0;
+	bool has_comparator_ = false;
+	bool has_log_number_ = false;
+	bool has_next_file_number_ = false;
+	bool has_last_sequence_ = false;
+
+	std::vector<std::pair<int, InternalKey>> compact_pointers_;
+	DeletedFileSet deleted_files_;
+	std::vector<std::pair<int, FileMetaData>> new_files_;
+	std::vector<BlobFileMetaData> new_blob_files_;
+	std::map<uint64_t, BlobGarbage> blob_garbage_;
+	std::vector<std::pair<uint32_t, std::string>> new_column_families_;
+};
+}
@@ -0,0 +1,1350 @@
+#include "version_set.h"
+#include "filename.h"
+#include "merge_context.h"
+#include "table_cache.h"
+#include "options.h"
+#include "../file/file_reader.h"
+#include "../file/file_writer.h"
+#include "../include/tinykv/iterator.h"
+#include "../log/log_read.h"
+#include "../log/log_write.h"
+#include "../logger/log.h"
+#include "../table/merger.h"
+#include "../table/table.h"
+#include "../table/two_level_iterator.h"
+#include "../utils/codec.h"
+
+#include <algorithm>
+#include <map>
+
+namespace tinykv {
+// L1的数据量上限是10MB，之后每一层是上一层的10倍
+static double MaxBytesForLevel(int level) {
+	double result = 10. * 1048576.0;
+	while (level > 1) {
+		result *= 10;
+		level--;
+	}
+	return result;
+}
+
+static int64_t TotalFileSize(const TableFileList& files) {
+	int64_t sum = 0;
+	for (const auto& f : files) {
+		sum += f->meta.file_size;
+	}
+	return sum;
+}
+
+TableFile::TableFile() = default;
+
+TableFile::~TableFile() = default;
+
+// 二分查找第一个largest >= key的文件，都小于key时返回files.size()
+static size_t FindFile(const InternalKeyComparator& icmp,
+		       const TableFileList& files, const Slice& key) {
+	size_t left = 0;
+	size_t right = files.size();
+	while (left < right) {
+		size_t mid = (left + right) / 2;
+		if (icmp.Compare(files[mid]->meta.largest.Encode(), key) < 0) {
+			left = mid + 1;
+		} else {
+			right = mid;
+		}
+	}
+	return right;
+}
+
+namespace {
+// TableGet通过Table::InternalGet的回调拿到查找结果
+struct Saver {
+	const Comparator* ucmp;
+	Slice user_key;
+	bool found = false;
+	ParsedInternalKey* ikey;
+	std::string* value;
+	DBStatus status = Status::kSuccess;
+};
+
+void SaveValue(void* arg, const Slice& key, const Slice& value) {
+	Saver* saver = reinterpret_cast<Saver*>(arg);
+	if (!ParseInternalKey(key, saver->ikey)) {
+		saver->status = Status::kCorruption;
+	} else if (saver->ucmp->Compare(saver->ikey->user_key, saver->user_key) == 0) {
+		if (saver->ikey->type != kTypeDeletion) {
+			saver->value->assign(value.data(), value.size());
+		}
+		saver->found = true;
+	}
+}
+
+// MultiGet中一个key的查找状态
+struct KeyState {
+	const LookupKey* key;
+	std::string* value;
+	DBStatus status = Status::kSuccess;
+	// 已经有了结果(在上面的层找到了、被范围删除覆盖了或者出错了)，不需要再往下查找
+	bool done = false;
+	bool found = false;
+	SequenceNumber sequence = 0;
+	ValueType type = kTypeDeletion;
+	// 覆盖这个key的范围删除中对读操作可见的最大顺序号
+	SequenceNumber covering_seq = 0;
+};
+
+// Table::MultiGet的回调参数，targets[i]对应batch[i]
+struct MultiSaver {
+	const Comparator* ucmp;
+	const std::vector<KeyState*>* batch;
+};
+
+void SaveMultiValue(void* arg, int index, const Slice& key, const Slice& value) {
+	MultiSaver* saver = reinterpret_cast<MultiSaver*>(arg);
+	KeyState* state = (*saver->batch)[index];
+	ParsedInternalKey ikey;
+	if (!ParseInternalKey(key, &ikey)) {
+		state->status = Status::kCorruption;
+		state->done = true;
+	} else if (saver->ucmp->Compare(ikey.user_key, state->key->user_key()) == 0) {
+		// L0中同一个key可能出现在多个文件中，取顺序号最大的版本
+		if (!state->found || ikey.sequence > state->sequence) {
+			state->found = true;
+			state->sequence = ikey.sequence;
+			state->type = ikey.type;
+			if (ikey.type == kTypeDeletion) {
+				state->value->clear();
+			} else {
+				state->value->assign(value.data(), value.size());
+			}
+		}
+	}
+}
+}  // namespace
+
+// 在一个sst中查找user_key，找到时返回true，并通过ikey返回找到的版本
+// kTypeBlobIndex类型的版本通过value返回BlobIndex，由调用者读取blob文件
+static bool TableGet(TableCache* table_cache, const TableFile& f,
+		     const ReadOptions& options, const Comparator* ucmp,
+		     const LookupKey& key, ParsedInternalKey* ikey,
+		     std::string* value, DBStatus* s) {
+	Saver saver;
+	saver.ucmp = ucmp;
+	saver.user_key = key.user_key();
+	saver.ikey = ikey;
+	saver.value = value;
+	*s = table_cache->Get(options, f.meta.number, f.meta.file_size, key.internal_key(),
+			      &saver, &SaveValue);
+	if (*s == Status::kSuccess) {
+		*s = saver.status;
+	}
+	// ikey指向block中的数据，InternalGet返回之后就失效了，只有顺序号和类型还可以使用
+	ikey->user_key = Slice();
+	return *s == Status::kSuccess && saver.found;
+}
+
+Version::Version(const InternalKeyComparator* icmp, TableCache* table_cache,
+		 int num_levels)
+	: icmp_(icmp), table_cache_(table_cache), files_(num_levels) {}
+
+uint64_t Version::NumLevelBytes(int level) const {
+	return TotalFileSize(files_[level]);
+}
+
+DBStatus Version::Get(const ReadOptions& options, const LookupKey& key,
+		      std::string* value, MergeContext* merge_context) const {
+	const Comparator* ucmp = icmp_->user_comparator();
+	const Slice user_key = key.user_key();
+	DBStatus s = Status::kSuccess;
+	ParsedInternalKey ikey;
+
+	// L0的文件之间可能有重叠，重启之后文件的新旧也无法只通过编号判断，
+	// 所以查找所有可能包含这个key的文件，取顺序号最大的版本
+	bool found = false;
+	SequenceNumber best_sequence = 0;
+	ValueType best_type = kTypeDeletion;
+	// 覆盖这个key的范围删除中对读操作可见的最大顺序号，顺序号比它小的版本都已经被删除了
+	SequenceNumber covering_seq = 0;
+	std::string tmp;
+	for (const auto& f : files_[0]) {
+		if (ucmp->Compare(user_key, f->meta.smallest.user_key()) < 0 ||
+		    ucmp->Compare(user_key, f->meta.largest.user_key()) > 0) {
+			continue;
+		}
+		if (f->range_del != nullptr) {
+			covering_seq = std::max(covering_seq,
+						f->range_del->MaxCoveringSeq(user_key, key.sequence()));
+		}
+		if (TableGet(table_cache_, *f, options, ucmp, key, &ikey, &tmp, &s)) {
+			if (!found || ikey.sequence > best_sequence) {
+				found = true;
+				best_sequence = ikey.sequence;
+				best_type = ikey.type;
+				if (best_type != kTypeDeletion) {
+					value->swap(tmp);
+				}
+			}
+		}
+		if (s != Status::kSuccess) {
+			return s;
+		}
+	}
+	// 找到的是BlobIndex时还要从blob文件中读出value，找到的是merge操作数时还要继续找更旧的版本
+	auto finish = [this, &options, &key, &user_key, value, merge_context](ValueType type) {
+		if (type == kTypeDeletion) {
+			return Status::kNotFound;
+		} else if (type == kTypeBlobIndex) {
+			const std::string blob_index = *value;
+			return GetBlob(user_key, blob_index, value);
+		} else if (type == kTypeMerge) {
+			return GetMergeOperands(options, key, value, merge_context);
+		}
+		return Status::kSuccess;
+	};
+	if (covering_seq > 0 && (!found || best_sequence < covering_seq)) {
+		// 更深的层中的版本都比L0中的旧，也被删除了
+		return Status::kNotFound;
+	}
+	if (found) {
+		return finish(best_type);
+	}
+
+	// 其他层的文件之间没有重叠，每层最多只需要查找一个文件
+	for (int level = 1; level < NumLevels(); level++) {
+		const TableFileList& files = files_[level];
+		size_t index = FindFile(*icmp_, files, key.internal_key());
+		if (index >= files.size()) {
+			continue;
+		}
+		const TableFile& f = *files[index];
+		if (ucmp->Compare(user_key, f.meta.smallest.user_key()) < 0) {
+			continue;
+		}
+		covering_seq = (f.range_del == nullptr)
+				       ? 0
+				       : f.range_del->MaxCoveringSeq(user_key, key.sequence());
+		if (TableGet(table_cache_, f, options, ucmp, key, &ikey, value, &s)) {
+			return ikey.sequence < covering_seq ? Status::kNotFound : finish(ikey.type);
+		}
+		if (s != Status::kSuccess) {
+			return s;
+		}
+		if (covering_seq > 0) {
+			return Status::kNotFound;
+		}
+	}
+	return Status::kNotFound;
+}
+
+void Version::MultiGet(const ReadOptions& options,
+		       const std::vector<const LookupKey*>& keys,
+		       std::vector<std::string>* values,
+		       std::vector<DBStatus>* statuses,
+		       const std::vector<MergeContext*>& merge_contexts) const {
+	const Comparator* ucmp = icmp_->user_comparator();
+	const size_t n = keys.size();
+	values->assign(n, std::string());
+	statuses->assign(n, Status::kNotFound);
+	std::vector<KeyState> states(n);
+	for (size_t i = 0; i < n; i++) {
+		states[i].key = keys[i];
+		states[i].value = &(*values)[i];
+	}
+
+	// 把batch中的key交给f一次查完
+	std::vector<KeyState*> batch;
+	std::vector<Slice> targets;
+	auto probe = [&](const TableFile& f) {
+		if (batch.empty()) {
+			return;
+		}
+		targets.clear();
+		for (KeyState* state : batch) {
+			targets.push_back(state->key->internal_key());
+			if (f.range_del != nullptr) {
+				state->covering_seq = std::max(
+					state->covering_seq,
+					f.range_del->MaxCoveringSeq(state->key->user_key(),
+								    state->key->sequence()));
+			}
+		}
+		MultiSaver saver;
+		saver.ucmp = ucmp;
+		saver.batch = &batch;
+		DBStatus s = table_cache_->MultiGet(options, f.meta.number, f.meta.file_size,
+						    targets.data(),
+						    static_cast<int>(targets.size()),
+						    &saver, &SaveMultiValue);
+		if (s != Status::kSuccess) {
+			for (KeyState* state : batch) {
+				if (!state->done) {
+					state->status = s;
+					state->done = true;
+				}
+			}
+		}
+		batch.clear();
+	};
+	// 在当前层找到的key以及被范围删除覆盖的key不需要再往下查找
+	auto finish_level = [&states]() {
+		for (KeyState& state : states) {
+			if (state.found || state.covering_seq > 0) {
+				state.done = true;
+			}
+		}
+	};
+
+	// 和Get一样，L0中所有可能包含key的文件都要查找
+	for (const auto& f : files_[0]) {
+		for (KeyState& state : states) {
+			const Slice user_key = state.key->user_key();
+			if (!state.done &&
+			    ucmp->Compare(user_key, f->meta.smallest.user_key()) >= 0 &&
+			    ucmp->Compare(user_key, f->meta.largest.user_key()) <= 0) {
+				batch.push_back(&state);
+			}
+		}
+		probe(*f);
+	}
+	finish_level();
+
+	// 其他层的文件之间没有重叠，key有序，所以落在同一个文件中的key是连续的
+	for (int level = 1; level < NumLevels(); level++) {
+		const TableFileList& files = files_[level];
+		size_t current = files.size();
+		for (KeyState& state : states) {
+			if (state.done) {
+				continue;
+			}
+			size_t index = FindFile(*icmp_, files, state.key->internal_key());
+			if (index >= files.size() ||
+			    ucmp->Compare(state.key->user_key(),
+					  files[index]->meta.smallest.user_key()) < 0) {
+				continue;
+			}
+			if (index != current) {
+				if (current < files.size()) {
+					probe(*files[current]);
+				}
+				current = index;
+			}
+			batch.push_back(&state);
+		}
+		if (current < files.size()) {
+			probe(*files[current]);
+		}
+		finish_level();
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		const KeyState& state = states[i];
+		if (state.status != Status::kSuccess) {
+			(*statuses)[i] = state.status;
+		} else if (!state.found || state.type == kTypeDeletion ||
+			   state.sequence < state.covering_seq) {
+			(*statuses)[i] = Status::kNotFound;
+		} else if (state.type == kTypeBlobIndex) {
+			const std::string blob_index = (*values)[i];
+			(*statuses)[i] = GetBlob(state.key->user_key(), blob_index, &(*values)[i]);
+		} else if (state.type == kTypeMerge) {
+			// 很少见，单独找齐这个key的所有版本
+			(*statuses)[i] = GetMergeOperands(options, *state.key, &(*values)[i],
+							  merge_contexts[i]);
+		} else {
+			(*statuses)[i] = Status::kSuccess;
+		}
+	}
+}
+
+DBStatus Version::GetMergeOperands(const ReadOptions& options, const LookupKey& key,
+				   std::string* value, MergeContext* merge_context) const {
+	const Comparator* ucmp = icmp_->user_comparator();
+	const Slice user_key = key.user_key();
+	// 对这次读可见的一个版本
+	struct Entry {
+		SequenceNumber sequence;
+		ValueType type;
+		std::string value;
+	};
+	std::vector<Entry> entries;
+	// 覆盖这个key的范围删除中对读操作可见的最大顺序号
+	SequenceNumber covering_seq = 0;
+	auto collect = [&](const TableFile& f) {
+		if (f.range_del != nullptr) {
+			covering_seq = std::max(covering_seq,
+						f.range_del->MaxCoveringSeq(user_key, key.sequence()));
+		}
+		std::unique_ptr<Iterator> iter(
+			table_cache_->NewIterator(options, f.meta.number, f.meta.file_size));
+		ParsedInternalKey ikey;
+		for (iter->Seek(key.internal_key()); iter->Valid(); iter->Next()) {
+			if (!ParseInternalKey(iter->key(), &ikey)) {
+				return Status::kCorruption;
+			}
+			if (ucmp->Compare(ikey.user_key, user_key) != 0) {
+				break;
+			}
+			entries.push_back(Entry{ikey.sequence, ikey.type, iter->value().ToString()});
+		}
+		return iter->status();
+	};
+	// 下层的版本都比上层的旧，某一层中出现了完整的value、删除标记或者范围删除之后就不用再往下找了
+	auto has_base = [&entries, &covering_seq]() {
+		if (covering_seq > 0) {
+			return true;
+		}
+		for (const Entry& e : entries) {
+			if (e.type != kTypeMerge) {
+				return true;
+			}
+		}
+		return false;
+	};
+
+	DBStatus s = Status::kSuccess;
+	for (const auto& f : files_[0]) {
+		if (ucmp->Compare(user_key, f->meta.smallest.user_key()) < 0 ||
+		    ucmp->Compare(user_key, f->meta.largest.user_key()) > 0) {
+			continue;
+		}
+		s = collect(*f);
+		if (s != Status::kSuccess) {
+			return s;
+		}
+	}
+	for (int level = 1; level < NumLevels() && !has_base(); level++) {
+		const TableFileList& files = files_[level];
+		size_t index = FindFile(*icmp_, files, key.internal_key());
+		if (index >= files.size() ||
+		    ucmp->Compare(user_key, files[index]->meta.smallest.user_key()) < 0) {
+			continue;
+		}
+		s = collect(*files[index]);
+		if (s != Status::kSuccess) {
+			return s;
+		}
+	}
+
+	// L0的文件之间可能有重叠，按顺序号从新到旧排列之后再依次处理
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+		return a.sequence > b.sequence;
+	});
+	for (Entry& e : entries) {
+		if (e.sequence < covering_seq) {
+			return Status::kNotFound;
+		}
+		switch (e.type) {
+			case kTypeMerge:
+				merge_context->PushOperand(e.value);
+				break;
+			case kTypeValue:
+				value->swap(e.value);
+				return Status::kSuccess;
+			case kTypeBlobIndex:
+				return GetBlob(user_key, e.value, value);
+			default:
+				return Status::kNotFound;
+		}
+	}
+	return Status::kNotFound;
+}
+
+DBStatus Version::GetBlob(const Slice& user_key, const Slice& blob_index,
+			 std::string* value) const {
+	BlobIndex index;
+	DBStatus s = index.DecodeFrom(blob_index);
+	if (s != Status::kSuccess) {
+		return s;
+	}
+	auto iter = blob_files_.find(index.file_number);
+	if (iter == blob_files_.end()) {
+		LOG(ERROR, "blob file %llu referenced by key %s is missing",
+		    static_cast<unsigned long long>(index.file_number),
+		    user_key.ToString().c_str());
+		return Status::kCorruption;
+	}
+	return iter->second->Read(user_key, index, value);
+}
+
+void Version::AddRangeTombstones(SequenceNumber upper_seq,
+				 std::vector<RangeTombstone>* tombstones) const {
+	for (const TableFileList& files : files_) {
+		for (const auto& f : files) {
+			if (f->range_del != nullptr) {
+				f->range_del->AppendTo(upper_seq, tombstones);
+			}
+		}
+	}
+}
+
+namespace {
+// 遍历一层中的所有文件，key()是文件的最大key，value()是文件的编号和大小
+// 和TwoLevelIterator配合使用，可以把一层的所有文件串成一个迭代器
+class LevelFileNumIterator : public Iterator {
+public:
+	LevelFileNumIterator(const InternalKeyComparator& icmp,
+			     const TableFileList* flist)
+		: icmp_(icmp), flist_(flist), index_(flist->size()) {}
+
+	bool Valid() const override { return index_ < flist_->size(); }
+	void Seek(const Slice& target) override {
+		index_ = FindFile(icmp_, *flist_, target);
+	}
+	void SeekToFirst() override { index_ = 0; }
+	void SeekToLast() override {
+		index_ = flist_->empty() ? 0 : flist_->size() - 1;
+	}
+	void Next() override {
+		assert(Valid());
+		index_++;
+	}
+	void Prev() override {
+		assert(Valid());
+		if (index_ == 0) {
+			index_ = flist_->size();  // 标记为无效
+		} else {
+			index_--;
+		}
+	}
+	Slice key() const override {
+		assert(Valid());
+		return (*flist_)[index_]->meta.largest.Encode();
+	}
+	Slice value() const override {
+		assert(Valid());
+		const FileMetaData& meta = (*flist_)[index_]->meta;
+		EncodeFixed64(value_buf_, meta.number);
+		EncodeFixed64(value_buf_ + 8, meta.file_size);
+		return Slice(value_buf_, sizeof(value_buf_));
+	}
+	DBStatus status() const override { return Status::kSuccess; }
+
+private:
+	const InternalKeyComparator icmp_;
+	const TableFileList* const flist_;
+	size_t index_;
+	mutable char value_buf_[16];
+};
+
+Iterator* GetFileIterator(void* arg, const ReadOptions& options,
+			  const std::string& file_value) {
+	TableCache* table_cache = reinterpret_cast<TableCache*>(arg);
+	if (file_value.size() != 16) {
+		return NewErrorIterator(Status::kCorruption);
+	}
+	return table_cache->NewIterator(options, DecodeFixed64(file_value.data()),
+					DecodeFixed64(file_value.data() + 8));
+}
+
+Iterator* NewConcatenatingIterator(const InternalKeyComparator& icmp,
+				   const TableFileList* flist, TableCache* table_cache,
+				   const ReadOptions& options) {
+	return NewTwoLevelIterator(new LevelFileNumIterator(icmp, flist),
+				   &GetFileIterator, table_cache, options);
+}
+}  // namespace
+
+void Version::AddIterators(const ReadOptions& options,
+			   std::vector<Iterator*>* iters) const {
+	for (const auto& f : files_[0]) {
+		iters->push_back(table_cache_->NewIterator(options, f->meta.number, f->meta.file_size));
+	}
+	for (int level = 1; level < NumLevels(); level++) {
+		if (!files_[level].empty()) {
+			iters->push_back(NewConcatenatingIterator(*icmp_, &files_[level],
+								  table_cache_, options));
+		}
+	}
+}
+
+void Version::GetOverlappingInputs(int level, const InternalKey* begin,
+				   const InternalKey* end,
+				   TableFileList* inputs) const {
+	inputs->clear();
+	Slice user_begin, user_end;
+	if (begin != nullptr) {
+		user_begin = begin->user_key();
+	}
+	if (end != nullptr) {
+		user_end = end->user_key();
+	}
+	const Comparator* ucmp = icmp_->user_comparator();
+	for (size_t i = 0; i < files_[level].size();) {
+		const std::shared_ptr<TableFile>& f = files_[level][i++];
+		const Slice file_start = f->meta.smallest.user_key();
+		const Slice file_limit = f->meta.largest.user_key();
+		if (begin != nullptr && ucmp->Compare(file_limit, user_begin) < 0) {
+			// f完全在范围的左边
+		} else if (end != nullptr && ucmp->Compare(file_start, user_end) > 0) {
+			// f完全在范围的右边
+		} else {
+			inputs->push_back(f);
+			if (level == 0) {
+				// L0的文件之间有重叠，如果f扩大了范围，需要用新的范围重新查找
+				if (begin != nullptr && ucmp->Compare(file_start, user_begin) < 0) {
+					user_begin = file_start;
+					inputs->clear();
+					i = 0;
+				} else if (end != nullptr && ucmp->Compare(file_limit, user_end) > 0) {
+					user_end = file_limit;
+					inputs->clear();
+					i = 0;
+				}
+			}
+		}
+	}
+}
+
+Compaction::Compaction(int level, int output_level, uint64_t max_output_file_size,
+		       std::shared_ptr<Version> input_version)
+	: level_(level)
+	, output_level_(output_level)
+	, max_output_file_size_(max_output_file_size)
+	, input_version_(std::move(input_version)) {}
+
+Compaction::~Compaction() = default;
+
+bool Compaction::IsTrivialMove() const {
+	return level_ != output_level_ && num_input_files(0) == 1 &&
+	       num_input_files(1) == 0;
+}
+
+void Compaction::AddInputDeletions(VersionEdit* edit) {
+	for (int which = 0; which < 2; which++) {
+		for (const auto& f : inputs_[which]) {
+			edit->RemoveFile(level_ + which, f->meta.number);
+		}
+	}
+}
+
+bool Compaction::IsBaseLevelForKey(const Slice& user_key,
+				   std::vector<size_t>* level_ptrs) const {
+	if (level_ == output_level_) {
+		return bottommost_;
+	}
+	if (level_ptrs->empty()) {
+		level_ptrs->resize(input_version_->NumLevels(), 0);
+	}
+	const Comparator* ucmp = input_version_->icmp_->user_comparator();
+	for (int lvl = level_ + 2; lvl < input_version_->NumLevels(); lvl++) {
+		const TableFileList& files = input_version_->files_[lvl];
+		size_t& ptr = (*level_ptrs)[lvl];
+		while (ptr < files.size()) {
+			const TableFile& f = *files[ptr];
+			if (ucmp->Compare(user_key, f.meta.largest.user_key()) <= 0) {
+				// user_key可能在这个文件中
+				if (ucmp->Compare(user_key, f.meta.smallest.user_key()) >= 0) {
+					return false;
+				}
+				break;
+			}
+			ptr++;
+		}
+	}
+	return true;
+}
+
+bool Compaction::IsBaseLevelForRange(const Slice& begin, const Slice& end) const {
+	if (level_ == output_level_) {
+		return bottommost_;
+	}
+	const Comparator* ucmp = input_version_->icmp_->user_comparator();
+	for (int lvl = level_ + 2; lvl < input_version_->NumLevels(); lvl++) {
+		for (const auto& f : input_version_->files_[lvl]) {
+			if (ucmp->Compare(f->meta.smallest.user_key(), end) < 0 &&
+			    ucmp->Compare(f->meta.largest.user_key(), begin) >= 0) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void Compaction::GetSubcompactionBoundaries(uint32_t max_subcompactions,
+					    std::vector<std::string>* boundaries) const {
+	boundaries->clear();
+	if (max_subcompactions <= 1 || level_ == output_level_) {
+		return;
+	}
+	// 每个index key对应一个data block，按key的个数均分也就是按数据量均分
+	std::vector<std::string> keys;
+	for (int which = 0; which < 2; which++) {
+		for (const auto& f : inputs_[which]) {
+			TableCache::Handle* handle = nullptr;
+			// 打不开的文件不参与切分，合并时会报错
+			if (input_version_->table_cache_->FindTable(f->meta.number, f->meta.file_size,
+								    &handle) == Status::kSuccess) {
+				handle->value->table->AddIndexKeys(&keys);
+				input_version_->table_cache_->Release(handle);
+			}
+		}
+	}
+	// 同一个user key的所有版本必须在同一个范围中，所以按user key切分
+	const Comparator* ucmp = input_version_->icmp_->user_comparator();
+	for (std::string& key : keys) {
+		key = ExtractUserKey(key).ToString();
+	}
+	std::sort(keys.begin(), keys.end(), [ucmp](const std::string& a, const std::string& b) {
+		return ucmp->Compare(a, b) < 0;
+	});
+	keys.erase(std::unique(keys.begin(), keys.end(),
+			       [ucmp](const std::string& a, const std::string& b) {
+				       return ucmp->Compare(a, b) == 0;
+			       }),
+		   keys.end());
+
+	const size_t n = std::min<size_t>(max_subcompactions, keys.size());
+	for (size_t i = 1; i < n; i++) {
+		boundaries->push_back(std::move(keys[i * keys.size() / n]));
+	}
+}
+
+void Compaction::AddInputRangeTombstones(std::vector<RangeTombstone>* tombstones) const {
+	for (int which = 0; which < 2; which++) {
+		for (const auto& f : inputs_[which]) {
+			if (f->range_del != nullptr) {
+				f->range_del->AppendTo(kMaxSequenceNumber, tombstones);
+			}
+		}
+	}
+}
+
+// 把一系列VersionEdit应用到base上，最后只生成一个Version
+// 恢复时MANIFEST中可能有很多条记录，中途被删除的文件不会被打开
+class VersionSet::Builder {
+public:
+	Builder(VersionSet* vset, std::shared_ptr<Version> base)
+		: vset_(vset)
+		, base_(std::move(base))
+		, levels_(base_->NumLevels()) {}
+
+	void Apply(const VersionEdit* edit) {
+		for (const auto& cp : edit->compact_pointers_) {
+			if (cp.first < base_->NumLevels()) {
+				vset_->compact_pointer_[cp.first] = cp.second.Encode().ToString();
+			}
+		}
+		for (const auto& deleted : edit->deleted_files_) {
+			if (!CheckLevel(deleted.first)) {
+				continue;
+			}
+			levels_[deleted.first].deleted_files.insert(deleted.second);
+			levels_[deleted.first].added_files.erase(deleted.second);
+		}
+		for (const auto& nf : edit->new_files_) {
+			if (!CheckLevel(nf.first)) {
+				continue;
+			}
+			levels_[nf.first].deleted_files.erase(nf.second.number);
+			levels_[nf.first].added_files[nf.second.number] = nf.second;
+		}
+		for (const auto& blob : edit->new_blob_files_) {
+			added_blob_files_[blob.number] = blob;
+		}
+		for (const auto& garbage : edit->blob_garbage_) {
+			auto iter = added_blob_files_.find(garbage.first);
+			if (iter != added_blob_files_.end()) {
+				iter->second.garbage_count += garbage.second.count;
+				iter->second.garbage_bytes += garbage.second.bytes;
+			} else {
+				VersionEdit::BlobGarbage& g = blob_garbage_[garbage.first];
+				g.count += garbage.second.count;
+				g.bytes += garbage.second.bytes;
+			}
+		}
+	}
+
+	// 生成新的Version，新加入的文件在这里打开，调用者不需要持有锁
+	DBStatus SaveTo(Version* v) {
+		if (!status_ok_) {
+			return Status::kCorruption;
+		}
+		// trivial move只是把文件换了一层，直接复用已经打开的文件
+		std::map<uint64_t, std::shared_ptr<TableFile>> opened;
+		for (int level = 0; level < base_->NumLevels(); level++) {
+			for (const auto& f : base_->files_[level]) {
+				opened[f->meta.number] = f;
+			}
+		}
+		for (int level = 0; level < base_->NumLevels(); level++) {
+			const LevelState& state = levels_[level];
+			TableFileList& files = v->files_[level];
+			for (const auto& f : base_->files_[level]) {
+				if (state.deleted_files.count(f->meta.number) == 0 &&
+				    state.added_files.count(f->meta.number) == 0) {
+					files.push_back(f);
+				}
+			}
+			for (const auto& added : state.added_files) {
+				std::shared_ptr<TableFile> table;
+				auto iter = opened.find(added.first);
+				if (iter != opened.end()) {
+					table = iter->second;
+				} else {
+					DBStatus s = vset_->OpenTable(added.second, &table);
+					if (s != Status::kSuccess) {
+						return s;
+					}
+				}
+				files.push_back(std::move(table));
+			}
+			vset_->SortFiles(level, &files);
+		}
+
+		// 只有垃圾统计变化的blob文件复用已经打开的FileReader，所有record都是垃圾的blob文件不再保留
+		for (const auto& base_blob : base_->blob_files_) {
+			std::shared_ptr<BlobFile> blob = base_blob.second;
+			auto garbage = blob_garbage_.find(base_blob.first);
+			if (garbage != blob_garbage_.end()) {
+				auto updated = std::make_shared<BlobFile>();
+				updated->meta = blob->meta;
+				updated->meta.garbage_count += garbage->second.count;
+				updated->meta.garbage_bytes += garbage->second.bytes;
+				updated->file = blob->file;
+				blob = std::move(updated);
+			}
+			if (blob->meta.garbage_count < blob->meta.total_count) {
+				v->blob_files_[base_blob.first] = std::move(blob);
+			}
+		}
+		for (const auto& added : added_blob_files_) {
+			if (added.second.garbage_count >= added.second.total_count) {
+				continue;
+			}
+			std::shared_ptr<BlobFile> blob;
+			DBStatus s = vset_->OpenBlobFile(added.second, &blob);
+			if (s != Status::kSuccess) {
+				return s;
+			}
+			v->blob_files_[added.first] = std::move(blob);
+		}
+		return Status::kSuccess;
+	}
+
+private:
+	struct LevelState {
+		std::set<uint64_t> deleted_files;
+		std::map<uint64_t, FileMetaData> added_files;
+	};
+
+	bool CheckLevel(int level) {
+		if (level < 0 || level >= base_->NumLevels()) {
+			// max_level_num比写MANIFEST时小，这一层的文件无处安放
+			LOG(ERROR, "version edit references level %d, only %d levels",
+			    level, base_->NumLevels());
+			status_ok_ = false;
+			return false;
+		}
+		return true;
+	}
+
+	VersionSet* const vset_;
+	const std::shared_ptr<Version> base_;
+	std::vector<LevelState> levels_;
+	// 新增的blob文件，以及base中的blob文件新增的垃圾
+	std::map<uint64_t, BlobFileMetaData> added_blob_files_;
+	std::map<uint64_t, VersionEdit::BlobGarbage> blob_garbage_;
+	bool status_ok_ = true;
+};
+
+VersionSet::VersionSet(const std::string& dbname, const Options* options,
+		       TableCache* table_cache, const InternalKeyComparator* icmp)
+	: dbname_(dbname)
+	, options_(options)
+	, table_cache_(table_cache)
+	, icmp_(icmp)
+	, current_(std::make_shared<Version>(
+		  icmp, table_cache,
+		  std::max<int>(2, static_cast<int>(options->max_level_num))))
+	, compact_pointer_(current_->NumLevels()) {
+	Finalize(current_.get());
+	live_versions_.push_back(current_);
+}
+
+VersionSet::~VersionSet() {
+	delete descriptor_log_;
+	if (descriptor_file_ != nullptr) {
+		descriptor_file_->Close();
+		delete descriptor_file_;
+	}
+}
+
+DBStatus VersionSet::OpenTable(const FileMetaData& meta,
+			       std::shared_ptr<TableFile>* table) {
+	auto t = std::make_shared<TableFile>();
+	t->meta = meta;
+	TableCache::Handle* handle = nullptr;
+	DBStatus s = table_cache_->FindTable(meta.number, meta.file_size, &handle);
+	if (s != Status::kSuccess) {
+		return s;
+	}
+	std::unique_ptr<Iterator> range_del_iter(
+		handle->value->table->NewRangeTombstoneIterator());
+	if (range_del_iter != nullptr) {
+		std::vector<RangeTombstone> tombstones;
+		s = CollectRangeTombstones(range_del_iter.get(), kMaxSequenceNumber, &tombstones);
+		if (s == Status::kSuccess) {
+			t->range_del.reset(new FragmentedRangeTombstoneList(
+				icmp_->user_comparator(), std::move(tombstones)));
+		} else {
+			LOG(ERROR, "read range tombstones of table %llu failed",
+			    static_cast<unsigned long long>(meta.number));
+		}
+	}
+	range_del_iter.reset();
+	table_cache_->Release(handle);
+	if (s == Status::kSuccess) {
+		*table = std::move(t);
+	}
+	return s;
+}
+
+DBStatus VersionSet::OpenBlobFile(const BlobFileMetaData& meta,
+				  std::shared_ptr<BlobFile>* blob) {
+	const std::string fname = BlobFileName(dbname_, meta.number);
+	if (!FileTool::Exist(fname)) {
+		LOG(ERROR, "blob file %s is missing", fname.c_str());
+		return Status::kCorruption;
+	}
+	auto b = std::make_shared<BlobFile>();
+	b->meta = meta;
+	b->file = std::make_shared<FileReader>(fname);
+	*blob = std::move(b);
+	return Status::kSuccess;
+}
+
+DBStatus VersionSet::LogAndApply(VersionEdit* edit, std::unique_lock<std::mutex>& lock) {
+	// 下面会释放锁写MANIFEST，前一个调用者完成之后才能基于它的结果生成新的Version
+	manifest_cv_.wait(lock, [this] { return !manifest_writing_; });
+	manifest_writing_ = true;
+	if (edit->has_log_number_) {
+		assert(edit->log_number_ >= log_number_);
+		assert(edit->log_number_ < next_file_number_);
+	} else {
+		edit->SetLogNumber(log_number_);
+	}
+	edit->SetNextFile(next_file_number_);
+	edit->SetLastSequence(last_sequence_);
+
+	Builder builder(this, current_);
+	builder.Apply(edit);
+
+	// 打开DB之后第一次写MANIFEST时新建一个文件，先写入当前状态的快照，之后只追加修改
+	DBStatus s = Status::kSuccess;
+	std::string new_manifest_file;
+	if (descriptor_log_ == nullptr) {
+		assert(descriptor_file_ == nullptr);
+		new_manifest_file = DescriptorFileName(dbname_, manifest_file_number_);
+		descriptor_file_ = new FileWriter(new_manifest_file);
+		descriptor_log_ = new Writer(descriptor_file_);
+		s = WriteSnapshot(descriptor_log_);
+	}
+	std::string record;
+	edit->EncodeTo(&record);
+	auto v = std::make_shared<Version>(icmp_, table_cache_, current_->NumLevels());
+
+	// 打开新文件和写MANIFEST期间不持有锁，不影响前台读写
+	lock.unlock();
+	if (s == Status::kSuccess) {
+		s = builder.SaveTo(v.get());
+	}
+	if (s == Status::kSuccess) {
+		s = descriptor_log_->AddRecord(record);
+	}
+	if (s == Status::kSuccess) {
+		s = descriptor_file_->Sync();
+	}
+	// MANIFEST完整写入之后才切换CURRENT
+	if (s == Status::kSuccess && !new_manifest_file.empty()) {
+		s = SetCurrentFile(dbname_, manifest_file_number_);
+	}
+	if (s == Status::kSuccess) {
+		Finalize(v.get());
+	}
+	lock.lock();
+
+	if (s == Status::kSuccess) {
+		current_ = std::move(v);
+		live_versions_.push_back(current_);
+		log_number_ = edit->log_number_;
+		for (const auto& cf : edit->new_column_families_) {
+			column_families_[cf.first] = cf.second;
+		}
+	} else if (!new_manifest_file.empty()) {
+		delete descriptor_log_;
+		descriptor_log_ = nullptr;
+		descriptor_file_->Close();
+		delete descriptor_file_;
+		descriptor_file_ = nullptr;
+		FileTool::RemoveFile(new_manifest_file);
+	}
+	manifest_writing_ = false;
+	manifest_cv_.notify_all();
+	return s;
+}
+
+DBStatus VersionSet::Recover() {
+	// CURRENT中保存的是MANIFEST的文件名，以换行结尾
+	const std::string current_name = CurrentFileName(dbname_);
+	std::string current(FileTool::GetFileSize(current_name), '\0');
+	DBStatus s = Status::kSuccess;
+	if (!current.empty()) {
+		FileReader file(current_name);
+		s = file.Read(0, current.size(), &current[0]);
+	}
+	if (s != Status::kSuccess) {
+		return s;
+	}
+	if (current.empty() || current.back() != '\n') {
+		LOG(ERROR, "CURRENT file does not end with newline");
+		return Status::kCorruption;
+	}
+	current.resize(current.size() - 1);
+	const std::string dscname = dbname_ + "/" + current;
+	if (!FileTool::Exist(dscname)) {
+		LOG(ERROR, "CURRENT points to a non-existent file: %s", dscname.c_str());
+		return Status::kCorruption;
+	}
+
+	struct LogReporter : public Reader::Reporter {
+		DBStatus* status;
+		void Corruption(size_t /*bytes*/, const DBStatus& s) override {
+			if (*status == Status::kSuccess) {
+				*status = s;
+			}
+		}
+	};
+
+	bool have_log_number = false;
+	bool have_next_file = false;
+	bool have_last_sequence = false;
+	uint64_t log_number = 0;
+	uint64_t next_file = 0;
+	SequenceNumber last_sequence = 0;
+	Builder builder(this, current_);
+	{
+		FileReader file(dscname);
+		LogReporter reporter;
+		reporter.status = &s;
+		Reader reader(&file, &reporter, true /*checksum*/, 0 /*initial_offset*/);
+		Slice record;
+		std::string scratch;
+		while (reader.ReadRecord(&record, &scratch) && s == Status::kSuccess) {
+			VersionEdit edit;
+			s = edit.DecodeFrom(record);
+			if (s == Status::kSuccess && edit.has_comparator_ &&
+			    edit.comparator_ != icmp_->user_comparator()->Name()) {
+				LOG(ERROR, "comparator %s does not match existing comparator %s",
+				    icmp_->user_comparator()->Name(), edit.comparator_.c_str());
+				s = Status::kInvalidArgument;
+			}
+			if (s != Status::kSuccess) {
+				break;
+			}
+			builder.Apply(&edit);
+			if (edit.has_log_number_) {
+				log_number = edit.log_number_;
+				have_log_number = true;
+			}
+			if (edit.has_next_file_number_) {
+				next_file = edit.next_file_number_;
+				have_next_file = true;
+			}
+			if (edit.has_last_sequence_) {
+				last_sequence = edit.last_sequence_;
+				have_last_sequence = true;
+			}
+			for (const auto& cf : edit.new_column_families_) {
+				column_families_[cf.first] = cf.second;
+			}
+		}
+	}
+	if (s == Status::kSuccess &&
+	    (!have_log_number || !have_next_file || !have_last_sequence)) {
+		LOG(ERROR, "%s: missing log number, next file number or last sequence",
+		    dscname.c_str());
+		s = Status::kCorruption;
+	}
+	if (s != Status::kSuccess) {
+		return s;
+	}
+
+	auto v = std::make_shared<Version>(icmp_, table_cache_, current_->NumLevels());
+	s = builder.SaveTo(v.get());
+	if (s != Status::kSuccess) {
+		return s;
+	}
+	Finalize(v.get());
+	current_ = std::move(v);
+	live_versions_.push_back(current_);
+	// 新的MANIFEST使用next_file作为编号，下一次LogAndApply时创建
+	manifest_file_number_ = next_file;
+	next_file_number_ = next_file + 1;
+	last_sequence_ = last_sequence;
+	log_number_ = log_number;
+	MarkFileNumberUsed(log_number);
+	return Status::kSuccess;
+}
+
+DBStatus VersionSet::WriteSnapshot(Writer* log) {
+	VersionEdit edit;
+	edit.SetComparatorName(icmp_->user_comparator()->Name());
+	for (int level = 0; level < current_->NumLevels(); level++) {
+		if (!compact_pointer_[level].empty()) {
+			InternalKey key;
+			key.DecodeFrom(compact_pointer_[level]);
+			edit.SetCompactPointer(level, key);
+		}
+		for (const auto& f : current_->files_[level]) {
+			edit.AddFile(level, f->meta);
+		}
+	}
+	for (const auto& blob : current_->blob_files_) {
+		edit.AddBlobFile(blob.second->meta);
+	}
+	for (const auto& cf : column_families_) {
+		edit.AddColumnFamily(cf.first, cf.second);
+	}
+	std::string record;
+	edit.EncodeTo(&record);
+	return log->AddRecord(record);
+}
+
+void VersionSet::AddLiveFiles(std::set<uint64_t>* live) {
+	size_t n = 0;
+	for (size_t i = 0; i < live_versions_.size(); i++) {
+		std::shared_ptr<Version> v = live_versions_[i].lock();
+		if (v == nullptr) {
+			continue;
+		}
+		for (int level = 0; level < v->NumLevels(); level++) {
+			for (const auto& f : v->files_[level]) {
+				live->insert(f->meta.number);
+			}
+		}
+		for (const auto& blob : v->blob_files_) {
+			live->insert(blob.first);
+		}
+		live_versions_[n++] = live_versions_[i];
+	}
+	live_versions_.resize(n);
+}
+
+void VersionSet::SortFiles(int level, TableFileList* files) const {
+	if (level == 0) {
+		// 重启之后文件编号不能反映数据的新旧(compaction的输出编号更大，数据却更旧)，按顺序号排列
+		std::stable_sort(files->begin(), files->end(),
+				 [](const std::shared_ptr<TableFile>& a,
+				    const std::shared_ptr<TableFile>& b) {
+					 return a->meta.largest_seq > b->meta.largest_seq;
+				 });
+	} else {
+		std::sort(files->begin(), files->end(),
+			  [this](const std::shared_ptr<TableFile>& a,
+				 const std::shared_ptr<TableFile>& b) {
+				  return icmp_->Compare(a->meta.smallest, b->meta.smallest) < 0;
+			  });
+	}
+}
+
+void VersionSet::Finalize(Version* v) {
+	if (options_->compaction_style == kCompactionStyleUniversal) {
+		// 所有的有序段都在L0，有序段太多时合并
+		v->compaction_level_ = 0;
+		v->compaction_score_ = v->files_[0].size() /
+			static_cast<double>(config::kL0_CompactionTrigger);
+		return;
+	}
+
+	int best_level = -1;
+	double best_score = -1;
+	for (int level = 0; level < v->NumLevels() - 1; level++) {
+		double score;
+		if (level == 0) {
+			// L0按文件个数而不是数据量计算，因为每次读都要查找L0的所有文件，
+			// 而且memtable比较小时L0的数据量也很小
+			score = v->files_[level].size() /
+				static_cast<double>(config::kL0_CompactionTrigger);
+		} else {
+			score = static_cast<double>(TotalFileSize(v->files_[level])) /
+				MaxBytesForLevel(level);
+		}
+		if (score > best_score) {
+			best_level = level;
+			best_score = score;
+		}
+	}
+	v->compaction_level_ = best_level;
+	v->compaction_score_ = best_score;
+}
+
+Compaction* VersionSet::PickCompaction() {
+	if (!NeedsCompaction()) {
+		return nullptr;
+	}
+	Compaction* c;
+	if (options_->compaction_style == kCompactionStyleUniversal) {
+		c = PickUniversalCompaction();
+	} else {
+		c = PickLevelCompaction();
+	}
+	if (c != nullptr) {
+		SetupBlobRelocation(c);
+	}
+	return c;
+}
+
+Compaction* VersionSet::PickLevelCompaction() {
+	const int level = current_->compaction_level_;
+	assert(level >= 0 && level + 1 < current_->NumLevels());
+	Compaction* c = new Compaction(level, level + 1, options_->max_file_size, current_);
+
+	// 从上次compaction结束的位置之后选择第一个文件
+	for (const auto& f : current_->files_[level]) {
+		if (compact_pointer_[level].empty() ||
+		    icmp_->Compare(f->meta.largest.Encode(), compact_pointer_[level]) > 0) {
+			c->inputs_[0].push_back(f);
+			break;
+		}
+	}
+	if (c->inputs_[0].empty()) {
+		// 已经到了这一层的末尾，从头开始
+		c->inputs_[0].push_back(current_->files_[level][0]);
+	}
+
+	// L0的文件之间有重叠，需要把所有重叠的文件都选上
+	// 否则同一个key较旧的版本留在L0，较新的版本被移到了L1，读的时候就会读到旧版本
+	if (level == 0) {
+		InternalKey smallest, largest;
+		GetRange(c->inputs_[0], &smallest, &largest);
+		current_->GetOverlappingInputs(0, &smallest, &largest, &c->inputs_[0]);
+		assert(!c->inputs_[0].empty());
+	}
+
+	SetupOtherInputs(c);
+	return c;
+}
+
+Compaction* VersionSet::PickUniversalCompaction() {
+	const TableFileList& runs = current_->files_[0];
+	const UniversalCompactionOptions& uopts = options_->universal_compaction;
+	const size_t min_width = std::max<size_t>(2, uopts.min_merge_width);
+	const size_t max_width = std::max<size_t>(min_width, uopts.max_merge_width);
+	if (runs.size() < min_width) {
+		return nullptr;
+	}
+	size_t start = 0;
+	size_t count = 0;
+
+	// 空间放大太大时，说明最旧的有序段中有很多数据已经被覆盖或删除了，全部合并
+	uint64_t newer_size = 0;
+	for (size_t i = 0; i + 1 < runs.size(); i++) {
+		newer_size += runs[i]->meta.file_size;
+	}
+	const uint64_t oldest_size = runs.back()->meta.file_size;
+	if (newer_size * 100 >= oldest_size * uopts.max_size_amplification_percent) {
+		count = runs.size();
+	}
+
+	// 从新到旧找一组大小相近的相邻有序段，合并之后的有序段大小大致按倍数增长，写放大是对数级别的
+	for (size_t i = 0; count == 0 && i + 1 < runs.size(); i++) {
+		uint64_t candidate_size = runs[i]->meta.file_size;
+		size_t j = i + 1;
+		for (; j < runs.size() && j - i < max_width; j++) {
+			const uint64_t next_size = runs[j]->meta.file_size;
+			if (candidate_size * (100 + uopts.size_ratio) / 100 < next_size) {
+				break;
+			}
+			candidate_size += next_size;
+		}
+		if (j - i >= min_width) {
+			start = i;
+			count = j - i;
+		}
+	}
+
+	// 大小都差得很远，为了控制读放大，合并最新的几个有序段，使有序段的个数降到阈值以下
+	if (count == 0) {
+		count = runs.size() - config::kL0_CompactionTrigger + 1;
+		count = std::min(std::max(count, min_width), max_width);
+		count = std::min(count, runs.size());
+	}
+
+	// 一个有序段只对应一个文件，不按max_file_size切分输出
+	Compaction* c = new Compaction(0, 0, UINT64_MAX, current_);
+	c->inputs_[0].assign(runs.begin() + start, runs.begin() + start + count);
+	c->bottommost_ = (start + count == runs.size());
+	return c;
+}
+
+void VersionSet::SetupOtherInputs(Compaction* c) {
+	const int level = c->level();
+	InternalKey smallest, largest;
+	GetRange(c->inputs_[0], &smallest, &largest);
+	current_->GetOverlappingInputs(level + 1, &smallest, &largest, &c->inputs_[1]);
+
+	// 下一次这一层的compaction从这次的最大key之后开始
+	// 同时记录到edit中，重启之后也能接着上次的位置
+	compact_pointer_[level] = largest.Encode().ToString();
+	c->edit_.SetCompactPointer(level, largest);
+}
+
+void VersionSet::SetupBlobRelocation(Compaction* c) {
+	const double ratio = options_->blob_garbage_collection_ratio;
+	if (ratio <= 0 || ratio > 1) {
+		return;
+	}
+	// 垃圾太多的blob文件读起来和普通文件一样，但是占着磁盘空间，
+	// 把其中还有效的value随着这次compaction搬走，文件中的record就会全部变成垃圾，之后被删除
+	for (const auto& blob : current_->blob_files_) {
+		const BlobFileMetaData& meta = blob.second->meta;
+		if (meta.garbage_bytes >= meta.total_bytes * ratio) {
+			c->relocate_blob_files_.insert(blob.first);
+		}
+	}
+}
+
+void VersionSet::GetRange(const TableFileList& inputs, InternalKey* smallest,
+			  InternalKey* largest) {
+	assert(!inputs.empty());
+	smallest->Clear();
+	largest->Clear();
+	for (size_t i = 0; i < inputs.size(); i++) {
+		const FileMetaData& f = inputs[i]->meta;
+		if (i == 0) {
+			*smallest = f.smallest;
+			*largest = f.largest;
+		} else {
+			if (icmp_->Compare(f.smallest, *smallest) < 0) {
+				*smallest = f.smallest;
+			}
+			if (icmp_->Compare(f.largest, *largest) > 0) {
+				*largest = f.largest;
+			}
+		}
+	}
+}
+
+Iterator* VersionSet::MakeInputIterator(Compaction* c) {
+	ReadOptions options;
+	// L0每个文件一个迭代器，其他层整层一个迭代器
+	const int space = (c->level() == 0 ? c->inputs_[0].size() + 1 : 2);
+	std::vector<Iterator*> list;
+	list.reserve(space);
+	for (int which = 0; which < 2; which++) {
+		if (c->inputs_[which].empty()) {
+			continue;
+		}
+		if (c->level() + which == 0) {
+			for (const auto& f : c->inputs_[which]) {
+				list.push_back(table_cache_->NewIterator(options, f->meta.number,
+									 f->meta.file_size));
+			}
+		} else {
+			list.push_back(NewConcatenatingIterator(*icmp_, &c->inputs_[which],
+								table_cache_, options));
+		}
+	}
+	return NewMergingIterator(icmp_, list.data(), static_cast<int>(list.size()));
+}
+}
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "blob_file.h"
+#include "dbformat.h"
+#include "range_tombstone.h"
+#include "version_edit.h"
+#include "../include/tinykv/status.h"
+
+namespace tinykv {
+class FileReader;
+class FileWriter;
+class Iterator;
+class MergeContext;
+class Table;
+class TableCache;
+class Writer;
+struct Options;
+struct ReadOptions;
+
+// Version中的一个sst文件，读取数据时通过TableCache打开
+struct TableFile {
+	FileMetaData meta;
+	// sst中切分好的范围删除，加入Version时读入内存，没有范围删除时为nullptr
+	std::unique_ptr<FragmentedRangeTombstoneList> range_del;
+
+	TableFile();
+	~TableFile();
+};
+
+using TableFileList = std::vector<std::shared_ptr<TableFile>>;
+// 按文件编号排列的blob文件
+using BlobFileMap = std::map<uint64_t, std::shared_ptr<BlobFile>>;
+
+// 某一时刻每一层都有哪些sst文件，创建之后就不会再修改
+// 读操作持有Version的引用(shared_ptr)，刷盘或compaction安装了新的Version之后，
+// 旧Version中的文件依然可以安全地读取，读操作不需要等待安装完成
+// L0的文件由memtable直接刷盘生成，文件之间的key范围可能重叠，按最大顺序号从新到旧排列
+// 其他层的文件之间没有重叠，按最小key从小到大排列
+// universal compaction只使用L0，每个文件是一个有序段，文件之间的顺序号范围不重叠
+class Version {
+public:
+	Version(const InternalKeyComparator* icmp, TableCache* table_cache, int num_levels);
+
+	Version(const Version&) = delete;
+	Version& operator=(const Version&) = delete;
+
+	// 从上往下逐层查找，找到时返回kSuccess，不存在或者已被删除时返回kNotFound
+	// kv分离的value会从blob文件中读出来
+	// 最新的版本是merge操作数时，从新到旧把操作数加入merge_context，直到遇到完整的value或者删除标记，
+	// 返回的value(kNotFound时没有)是它们的旧值，由调用者合并
+	DBStatus Get(const ReadOptions& options, const LookupKey& key,
+		     std::string* value, MergeContext* merge_context) const;
+
+	// 批量点查，keys必须按照user key递增排列且没有重复，(*values)[i]和(*statuses)[i]是keys[i]的结果
+	// 每个sst只查找一次，落在其中的key一起交给Table::MultiGet，同一个data block只读取一次
+	// merge_contexts[i]和Get的merge_context含义相同
+	void MultiGet(const ReadOptions& options, const std::vector<const LookupKey*>& keys,
+		      std::vector<std::string>* values, std::vector<DBStatus>* statuses,
+		      const std::vector<MergeContext*>& merge_contexts) const;
+
+	// 读取user_key对应的BlobIndex指向的value，blob文件不在这个Version中时返回kCorruption
+	DBStatus GetBlob(const Slice& user_key, const Slice& blob_index,
+			 std::string* value) const;
+
+	// 把所有sst中顺序号不大于upper_seq的范围删除追加到tombstones中
+	void AddRangeTombstones(SequenceNumber upper_seq,
+				std::vector<RangeTombstone>* tombstones) const;
+
+	// 把所有sst的迭代器加入iters: L0每个文件一个迭代器，其他层每层一个
+	// 迭代器使用期间调用者必须持有这个Version的引用
+	void AddIterators(const ReadOptions& options, std::vector<Iterator*>* iters) const;
+
+	int NumLevels() const { return static_cast<int>(files_.size()); }
+	int NumFiles(int level) const { return static_cast<int>(files_[level].size()); }
+	uint64_t NumLevelBytes(int level) const;
+	int NumBlobFiles() const { return static_cast<int>(blob_files_.size()); }
+
+	// 把level层中和[begin,end]有重叠的文件放入inputs，begin/end为nullptr表示无穷
+	// 对于L0，如果重叠的文件扩大了范围，会用新的范围重新查找，保证同一个key的所有版本都被选中
+	void GetOverlappingInputs(int level, const InternalKey* begin,
+				  const InternalKey* end, TableFileList* inputs) const;
+
+private:
+	friend class Compaction;
+	friend class VersionSet;
+
+	// 最新的版本是merge操作数时，逐层遍历所有可能包含key的sst，收集key所有可见的版本，
+	// 按顺序号从新到旧把操作数加入merge_context，返回最旧的操作数之下的value
+	DBStatus GetMergeOperands(const ReadOptions& options, const LookupKey& key,
+				  std::string* value, MergeContext* merge_context) const;
+
+	const InternalKeyComparator* const icmp_;
+	TableCache* const table_cache_;
+	std::vector<TableFileList> files_;
+	// 还有sst引用的blob文件
+	BlobFileMap blob_files_;
+
+	// 下一次需要compaction的层及其分数，分数>=1时需要compaction，由VersionSet::Finalize计算
+	double compaction_score_ = -1;
+	int compaction_level_ = -1;
+};
+
+// 一次compaction的输入: level层的inputs_[0]和level+1层的inputs_[1]
+// 分层compaction输出到level+1层；universal compaction只有inputs_[0]，输出仍然在L0
+class Compaction {
+public:
+	Compaction(const Compaction&) = delete;
+	Compaction& operator=(const Compaction&) = delete;
+
+	~Compaction();
+
+	int level() const { return level_; }
+	int output_level() const { return output_level_; }
+	// compaction完成之后要写入MANIFEST的修改，PickCompaction时已经记录了compact pointer
+	VersionEdit* edit() { return &edit_; }
+	// which为0表示level层，为1表示level+1层
+	int num_input_files(int which) const {
+		return static_cast<int>(inputs_[which].size());
+	}
+	const std::shared_ptr<TableFile>& input(int which, int i) const {
+		return inputs_[which][i];
+	}
+	uint64_t MaxOutputFileSize() const { return max_output_file_size_; }
+
+	// 只有一个输入文件且下一层没有重叠时，直接把文件移到下一层，不需要重写
+	bool IsTrivialMove() const;
+
+	// 比输出层更深的层中没有user_key时返回true，此时删除标记可以直接丢弃
+	// universal compaction没有更深的层，包含了最旧的有序段时返回true
+	// level_ptrs是调用者持有的查找位置，初始为空，同一个level_ptrs上的user_key必须是递增的
+	// 每个subcompaction使用自己的level_ptrs，可以在多个线程中同时调用
+	bool IsBaseLevelForKey(const Slice& user_key, std::vector<size_t>* level_ptrs) const;
+	// 和IsBaseLevelForKey相同，但是检查的是[begin, end)整个范围，没有顺序要求
+	bool IsBaseLevelForRange(const Slice& begin, const Slice& end) const;
+
+	// 把输入按user key切成最多max_subcompactions个互不重叠的范围，由多个线程同时合并
+	// *boundaries返回相邻范围之间的分界点(递增)，第i个范围是[boundaries[i-1], boundaries[i])，
+	// 第一个范围没有下界，最后一个没有上界。分界点取自输入文件的index block，每个范围的数据量大致相同
+	// 只有分层compaction会切分，不需要切分时*boundaries为空
+	void GetSubcompactionBoundaries(uint32_t max_subcompactions,
+					std::vector<std::string>* boundaries) const;
+
+	// 所有输入文件中的范围删除
+	void AddInputRangeTombstones(std::vector<RangeTombstone>* tombstones) const;
+
+	// 把所有输入文件的删除记录到edit中
+	void AddInputDeletions(VersionEdit* edit);
+
+	// 编号为file_number的blob文件中垃圾太多，compaction时要把其中还有效的value搬到新的blob文件中
+	bool ShouldRelocateBlob(uint64_t file_number) const {
+		return relocate_blob_files_.count(file_number) != 0;
+	}
+	// 从输入Version中读取BlobIndex指向的value
+	DBStatus GetBlob(const Slice& user_key, const Slice& blob_index,
+			 std::string* value) const {
+		return input_version_->GetBlob(user_key, blob_index, value);
+	}
+
+private:
+	friend class VersionSet;
+
+	Compaction(int level, int output_level, uint64_t max_output_file_size,
+		   std::shared_ptr<Version> input_version);
+
+	const int level_;
+	const int output_level_;
+	const uint64_t max_output_file_size_;
+	std::shared_ptr<Version> input_version_;
+	VersionEdit edit_;
+	TableFileList inputs_[2];
+	// universal compaction的输入是否包含了最旧的有序段
+	bool bottommost_ = false;
+	// 垃圾比例达到blob_garbage_collection_ratio的blob文件
+	std::set<uint64_t> relocate_blob_files_;
+};
+
+// 管理当前的Version，并决定下一次对哪些文件做compaction
+// 每次修改都以VersionEdit的形式追加到MANIFEST中，重启时只需要回放MANIFEST，不需要扫描sst
+// 所有接口都需要在DB的mutex保护下调用
+class VersionSet {
+public:
+	// sst都通过table_cache打开，comparator是InternalKeyComparator
+	VersionSet(const std::string& dbname, const Options* options,
+		   TableCache* table_cache, const InternalKeyComparator* icmp);
+	~VersionSet();
+
+	VersionSet(const VersionSet&) = delete;
+	VersionSet& operator=(const VersionSet&) = delete;
+
+	// 把edit应用到当前Version上生成新的Version，追加到MANIFEST之后再替换当前Version
+	// 写MANIFEST和打开新文件期间会释放lock，多个线程同时调用时排队依次写入
+	DBStatus LogAndApply(VersionEdit* edit, std::unique_lock<std::mutex>& lock);
+
+	// 从CURRENT指向的MANIFEST恢复出最新的Version，只在打开DB时调用
+	DBStatus Recover();
+
+	std::shared_ptr<Version> current() const { return current_; }
+
+	int NumLevelFiles(int level) const { return current_->NumFiles(level); }
+
+	uint64_t NewFileNumber() { return next_file_number_++; }
+	// 打开DB时发现目录下的文件，保证之后分配的编号不会和它们冲突
+	void MarkFileNumberUsed(uint64_t number) {
+		if (next_file_number_ <= number) {
+			next_file_number_ = number + 1;
+		}
+	}
+	uint64_t ManifestFileNumber() const { return manifest_file_number_; }
+	// 编号小于这个值的WAL都已经刷盘，可以删除
+	uint64_t LogNumber() const { return log_number_; }
+	SequenceNumber LastSequence() const { return last_sequence_; }
+	void SetLastSequence(SequenceNumber s) {
+		assert(s >= last_sequence_);
+		last_sequence_ = s;
+	}
+
+	// 已经创建的column family的编号和名字，只有默认column family的VersionSet会记录
+	const std::map<uint32_t, std::string>& ColumnFamilies() const {
+		return column_families_;
+	}
+
+	// 把所有还在使用的Version(当前Version和迭代器等持有的旧Version)中sst和blob文件的编号加入live
+	// 旧Version中的sst可能还没有打开，或者已经被TableCache关闭，所以不能删除
+	void AddLiveFiles(std::set<uint64_t>* live);
+
+	bool NeedsCompaction() const { return current_->compaction_score_ >= 1; }
+
+	// 选出下一次要compaction的文件，不需要compaction时返回nullptr，调用者负责delete
+	Compaction* PickCompaction();
+
+	// 按内部键顺序遍历compaction所有输入文件的迭代器
+	Iterator* MakeInputIterator(Compaction* c);
+
+private:
+	class Builder;
+
+	// 通过TableCache打开编号为meta.number的sst，读出其中的范围删除
+	DBStatus OpenTable(const FileMetaData& meta, std::shared_ptr<TableFile>* table);
+	// 打开编号为meta.number的blob文件
+	DBStatus OpenBlobFile(const BlobFileMetaData& meta, std::shared_ptr<BlobFile>* blob);
+	// 把当前的状态作为一个完整的VersionEdit写入新的MANIFEST
+	DBStatus WriteSnapshot(Writer* log);
+	// 计算v中下一次需要compaction的层
+	void Finalize(Version* v);
+	Compaction* PickLevelCompaction();
+	// 依次按照空间放大、相邻有序段的大小比例、有序段的个数选出要合并的有序段
+	Compaction* PickUniversalCompaction();
+	// 把files按照level层的顺序排好
+	void SortFiles(int level, TableFileList* files) const;
+	// 根据inputs_[0]的范围选出level+1层的输入
+	void SetupOtherInputs(Compaction* c);
+	// 选出这次compaction需要回收的blob文件
+	void SetupBlobRelocation(Compaction* c);
+	void GetRange(const TableFileList& inputs, InternalKey* smallest,
+		      InternalKey* largest);
+
+	const std::string dbname_;
+	const Options* const options_;
+	TableCache* const table_cache_;
+	const InternalKeyComparator* const icmp_;
+	uint64_t next_file_number_ = 2;
+	uint64_t manifest_file_number_ = 0;
+	uint64_t log_number_ = 0;
+	SequenceNumber last_sequence_ = 0;
+
+	// 正在使用的MANIFEST，第一次LogAndApply时创建
+	FileWriter* descriptor_file_ = nullptr;
+	Writer* descriptor_log_ = nullptr;
+	// 是否有线程正在LogAndApply，其他调用者在manifest_cv_上等待
+	bool manifest_writing_ = false;
+	std::condition_variable manifest_cv_;
+	std::map<uint32_t, std::string> column_families_;
+
+	std::shared_ptr<Version> current_;
+	// 曾经作为current_的Version，AddLiveFiles时清理掉已经没有人使用的
+	std::vector<std::weak_ptr<Version>> live_versions_;
+	// 每一层下一次compaction从哪个key开始，保证每一层的文件轮流参与compaction
+	std::vector<std::string> compact_pointer_;
+};
+}
@@ -0,0 +1,270 @@
+#include "write_batch.h"
+#include "write_batch_internal.h"
+#include "column_family.h"
+#include "../memtable/memtable.h"
+#include "../utils/codec.h"
+
+#include <cassert>
+
+namespace tinykv {
+// 8字节的顺序号 + 4字节的操作个数
+static const size_t kHeader = 12;
+// record的类型带上这个标记时，后面跟着column family的编号，默认column family不带标记
+static const uint8_t kColumnFamilyFlag = 0x80;
+
+WriteBatch::Handler::~Handler() = default;
+
+void WriteBatch::Handler::PutCF(uint32_t /*column_family_id*/, const Slice& key,
+				const Slice& value) {
+	Put(key, value);
+}
+
+void WriteBatch::Handler::DeleteCF(uint32_t /*column_family_id*/, const Slice& key) {
+	Delete(key);
+}
+
+void WriteBatch::Handler::DeleteRangeCF(uint32_t /*column_family_id*/,
+					const Slice& begin_key, const Slice& end_key) {
+	DeleteRange(begin_key, end_key);
+}
+
+void WriteBatch::Handler::Merge(const Slice& /*key*/, const Slice& /*value*/) {}
+
+void WriteBatch::Handler::MergeCF(uint32_t /*column_family_id*/, const Slice& key,
+				  const Slice& value) {
+	Merge(key, value);
+}
+
+WriteBatch::WriteBatch() { Clear(); }
+
+WriteBatch::~WriteBatch() = default;
+
+void WriteBatch::Clear() {
+	rep_.clear();
+	rep_.resize(kHeader);
+}
+
+size_t WriteBatch::ApproximateSize() const { return rep_.size(); }
+
+DBStatus WriteBatch::Iterate(Handler* handler) const {
+	Slice input(rep_);
+	if (input.size() < kHeader) {
+		return Status::kCorruption;
+	}
+
+	input.remove_prefix(kHeader);
+	Slice key, value;
+	int found = 0;
+	while (!input.empty()) {
+		found++;
+		uint8_t tag = static_cast<uint8_t>(input[0]);
+		input.remove_prefix(1);
+		uint32_t column_family = 0;
+		if ((tag & kColumnFamilyFlag) != 0) {
+			if (!GetVarint32(&input, &column_family)) {
+				return Status::kCorruption;
+			}
+			tag &= ~kColumnFamilyFlag;
+		}
+		switch (tag) {
+			case kTypeValue:
+				if (GetLengthPrefixedSlice(&input, &key) &&
+				    GetLengthPrefixedSlice(&input, &value)) {
+					handler->PutCF(column_family, key, value);
+				} else {
+					return Status::kCorruption;
+				}
+				break;
+			case kTypeDeletion:
+				if (GetLengthPrefixedSlice(&input, &key)) {
+					handler->DeleteCF(column_family, key);
+				} else {
+					return Status::kCorruption;
+				}
+				break;
+			case kTypeRangeDeletion:
+				if (GetLengthPrefixedSlice(&input, &key) &&
+				    GetLengthPrefixedSlice(&input, &value)) {
+					handler->DeleteRangeCF(column_family, key, value);
+				} else {
+					return Status::kCorruption;
+				}
+				break;
+			case kTypeMerge:
+				if (GetLengthPrefixedSlice(&input, &key) &&
+				    GetLengthPrefixedSlice(&input, &value)) {
+					handler->MergeCF(column_family, key, value);
+				} else {
+					return Status::kCorruption;
+				}
+				break;
+			default:
+				return Status::kCorruption;
+		}
+	}
+	if (found != WriteBatchInternal::Count(this)) {
+		return Status::kCorruption;
+	}
+	return Status::kSuccess;
+}
+
+int WriteBatchInternal::Count(const WriteBatch* b) {
+	return DecodeFixed32(b->rep_.data() + 8);
+}
+
+void WriteBatchInternal::SetCount(WriteBatch* b, int n) {
+	EncodeFixed32(&b->rep_[8], n);
+}
+
+SequenceNumber WriteBatchInternal::Sequence(const WriteBatch* b) {
+	return SequenceNumber(DecodeFixed64(b->rep_.data()));
+}
+
+void WriteBatchInternal::SetSequence(WriteBatch* b, SequenceNumber seq) {
+	EncodeFixed64(&b->rep_[0], seq);
+}
+
+// 写入一个record的类型，非默认column family还要写入编号
+static void PutRecordType(std::string* rep, ValueType type, uint32_t column_family) {
+	if (column_family == 0) {
+		rep->push_back(static_cast<char>(type));
+	} else {
+		rep->push_back(static_cast<char>(type | kColumnFamilyFlag));
+		PutVarint32(rep, column_family);
+	}
+}
+
+static uint32_t GetColumnFamilyID(ColumnFamilyHandle* column_family) {
+	return column_family == nullptr ? 0 : column_family->GetID();
+}
+
+void WriteBatch::Put(const Slice& key, const Slice& value) {
+	Put(nullptr, key, value);
+}
+
+void WriteBatch::Delete(const Slice& key) {
+	Delete(nullptr, key);
+}
+
+void WriteBatch::DeleteRange(const Slice& begin_key, const Slice& end_key) {
+	DeleteRange(nullptr, begin_key, end_key);
+}
+
+void WriteBatch::Merge(const Slice& key, const Slice& value) {
+	Merge(nullptr, key, value);
+}
+
+void WriteBatch::Put(ColumnFamilyHandle* column_family, const Slice& key,
+		     const Slice& value) {
+	WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+	PutRecordType(&rep_, kTypeValue, GetColumnFamilyID(column_family));
+	PutLengthPrefixedSlice(&rep_, key);
+	PutLengthPrefixedSlice(&rep_, value);
+}
+
+void WriteBatch::Delete(ColumnFamilyHandle* column_family, const Slice& key) {
+	WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+	PutRecordType(&rep_, kTypeDeletion, GetColumnFamilyID(column_family));
+	PutLengthPrefixedSlice(&rep_, key);
+}
+
+void WriteBatch::DeleteRange(ColumnFamilyHandle* column_family, const Slice& begin_key,
+			     const Slice& end_key) {
+	WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+	PutRecordType(&rep_, kTypeRangeDeletion, GetColumnFamilyID(column_family));
+	PutLengthPrefixedSlice(&rep_, begin_key);
+	PutLengthPrefixedSlice(&rep_, end_key);
+}
+
+void WriteBatch::Merge(ColumnFamilyHandle* column_family, const Slice& key,
+		       const Slice& value) {
+	WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+	PutRecordType(&rep_, kTypeMerge, GetColumnFamilyID(column_family));
+	PutLengthPrefixedSlice(&rep_, key);
+	PutLengthPrefixedSlice(&rep_, value);
+}
+
+void WriteBatch::Append(const WriteBatch& source) {
+	WriteBatchInternal::Append(this, &source);
+}
+
+namespace {
+// 把batch中的操作按顺序号依次插入对应column family的memtable
+class MemTableInserter : public WriteBatch::Handler {
+public:
+	SequenceNumber sequence_;
+	const std::vector<MemTable*>* memtables_;
+	bool concurrent_;
+	DBStatus status_ = Status::kSuccess;
+
+	void Put(const Slice& key, const Slice& value) override {
+		PutCF(0, key, value);
+	}
+	void Delete(const Slice& key) override {
+		DeleteCF(0, key);
+	}
+	void DeleteRange(const Slice& begin_key, const Slice& end_key) override {
+		DeleteRangeCF(0, begin_key, end_key);
+	}
+	void Merge(const Slice& key, const Slice& value) override {
+		MergeCF(0, key, value);
+	}
+	void PutCF(uint32_t column_family_id, const Slice& key, const Slice& value) override {
+		Add(column_family_id, kTypeValue, key, value);
+	}
+	void DeleteCF(uint32_t column_family_id, const Slice& key) override {
+		Add(column_family_id, kTypeDeletion, key, Slice());
+	}
+	void DeleteRangeCF(uint32_t column_family_id, const Slice& begin_key,
+			   const Slice& end_key) override {
+		Add(column_family_id, kTypeRangeDeletion, begin_key, end_key);
+	}
+	void MergeCF(uint32_t column_family_id, const Slice& key, const Slice& value) override {
+		Add(column_family_id, kTypeMerge, key, value);
+	}
+
+private:
+	// 跳过的操作也要占用顺序号，保证其他操作的顺序号和写入时一致
+	void Add(uint32_t column_family_id, ValueType type, const Slice& key,
+		 const Slice& value) {
+		if (column_family_id >= memtables_->size()) {
+			status_ = Status::kInvalidArgument;
+		} else if ((*memtables_)[column_family_id] != nullptr) {
+			(*memtables_)[column_family_id]->Add(sequence_, type, key, value,
+							     concurrent_);
+		}
+		sequence_++;
+	}
+};
+}  // namespace
+
+DBStatus WriteBatchInternal::InsertInto(const WriteBatch* b,
+				       const std::vector<MemTable*>& memtables,
+				       bool concurrent) {
+	MemTableInserter inserter;
+	inserter.sequence_ = WriteBatchInternal::Sequence(b);
+	inserter.memtables_ = &memtables;
+	inserter.concurrent_ = concurrent;
+	DBStatus s = b->Iterate(&inserter);
+	if (s == Status::kSuccess) {
+		s = inserter.status_;
+	}
+	return s;
+}
+
+DBStatus WriteBatchInternal::InsertInto(const WriteBatch* b, MemTable* memtable,
+				       bool concurrent) {
+	return InsertInto(b, std::vector<MemTable*>(1, memtable), concurrent);
+}
+
+void WriteBatchInternal::SetContents(WriteBatch* b, const Slice& contents) {
+	assert(contents.size() >= kHeader);
+	b->rep_.assign(contents.data(), contents.size());
+}
+
+void WriteBatchInternal::Append(WriteBatch* dst, const WriteBatch* src) {
+	SetCount(dst, Count(dst) + Count(src));
+	assert(src->rep_.size() >= kHeader);
+	dst->rep_.append(src->rep_.data() + kHeader, src->rep_.size() - kHeader);
+}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "../include/tinykv/slice.h"
+#include "../include/tinykv/status.h"
+
+namespace tinykv {
+class ColumnFamilyHandle;
+
+// WriteBatch把多个Put/Delete打包成一次原子写入，整个batch作为一条记录写入WAL，
+// 要么全部生效，要么全部不生效
+// batch中可以同时包含多个column family的操作，它们共用一条WAL记录，同样是原子的
+// 多个线程同时写入时，DB会把排队中的多个batch合并成一个，只写一次WAL、只做一次Sync
+class WriteBatch {
+public:
+	// 遍历batch中的每一个操作
+	class Handler {
+	public:
+		virtual ~Handler();
+		virtual void Put(const Slice& key, const Slice& value) = 0;
+		virtual void Delete(const Slice& key) = 0;
+		virtual void DeleteRange(const Slice& begin_key, const Slice& end_key) = 0;
+		// 默认忽略merge，需要处理merge的handler覆盖这个函数
+		virtual void Merge(const Slice& key, const Slice& value);
+		// Iterate对每个操作都调用下面带column family编号的版本，默认column family的编号是0
+		// 默认实现忽略编号，转给上面的版本，需要区分column family时覆盖这几个函数
+		virtual void PutCF(uint32_t column_family_id, const Slice& key, const Slice& value);
+		virtual void DeleteCF(uint32_t column_family_id, const Slice& key);
+		virtual void DeleteRangeCF(uint32_t column_family_id, const Slice& begin_key,
+					   const Slice& end_key);
+		virtual void MergeCF(uint32_t column_family_id, const Slice& key, const Slice& value);
+	};
+
+	WriteBatch();
+
+	// 可以拷贝
+	WriteBatch(const WriteBatch&) = default;
+	WriteBatch& operator=(const WriteBatch&) = default;
+
+	~WriteBatch();
+
+	void Put(const Slice& key, const Slice& value);
+	void Delete(const Slice& key);
+	// 删除[begin_key, end_key)范围内的所有key，只写入一条记录
+	void DeleteRange(const Slice& begin_key, const Slice& end_key);
+	// 写入一个merge操作数，读取时由column family的MergeOperator合并到旧值上
+	void Merge(const Slice& key, const Slice& value);
+	// 写入指定的column family，column_family为nullptr时和上面的版本相同，写入默认column family
+	void Put(ColumnFamilyHandle* column_family, const Slice& key, const Slice& value);
+	void Delete(ColumnFamilyHandle* column_family, const Slice& key);
+	void DeleteRange(ColumnFamilyHandle* column_family, const Slice& begin_key,
+			 const Slice& end_key);
+	void Merge(ColumnFamilyHandle* column_family, const Slice& key, const Slice& value);
+	// 清空batch中的所有操作
+	void Clear();
+	// batch编码后的大小，可以用来控制单个batch不要太大
+	size_t ApproximateSize() const;
+	// 把source中的操作追加到当前batch的后面
+	void Append(const WriteBatch& source);
+	// 按写入的顺序回调handler，格式不合法时返回kCorruption
+	DBStatus Iterate(Handler* handler) const;
+
+private:
+	friend class WriteBatchInternal;
+
+	// rep_的格式:
+	// | sequence(fixed64) | count(fixed32) | record[count] |
+	// record :=
+	//    kTypeValue    | key(length prefixed) | value(length prefixed)
+	//    kTypeDeletion | key(length prefixed)
+	//    kTypeRangeDeletion | begin key(length prefixed) | end key(length prefixed)
+	//    kTypeMerge    | key(length prefixed) | operand(length prefixed)
+	// 非默认column family的record在类型上加kColumnFamilyFlag，后面跟着column family的编号:
+	//    type|kColumnFamilyFlag | column family id(varint32) | 和上面相同的内容
+	std::string rep_;
+};
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+#include "dbformat.h"
+#include "write_batch.h"
+
+namespace tinykv {
+class MemTable;
+
+// WriteBatch中只有DB内部才需要的接口，不对用户暴露
+class WriteBatchInternal {
+public:
+	// batch中操作的个数
+	static int Count(const WriteBatch* batch);
+	static void SetCount(WriteBatch* batch, int n);
+
+	// batch中第一个操作的顺序号，后面的操作依次+1
+	static SequenceNumber Sequence(const WriteBatch* batch);
+	static void SetSequence(WriteBatch* batch, SequenceNumber seq);
+
+	// 编码后的内容，直接作为一条记录写入WAL
+	static Slice Contents(const WriteBatch* batch) { return Slice(batch->rep_); }
+	static size_t ByteSize(const WriteBatch* batch) { return batch->rep_.size(); }
+	// 回放WAL时用读到的记录重建batch
+	static void SetContents(WriteBatch* batch, const Slice& contents);
+
+	// 把batch中的所有操作写入memtable，concurrent为true时可以和其他线程同时写同一个memtable
+	// memtables按column family的编号索引，为nullptr的column family跳过，
+	// 遇到没有对应memtable的编号时跳过这个操作并返回kInvalidArgument
+	static DBStatus InsertInto(const WriteBatch* batch, const std::vector<MemTable*>& memtables,
+				   bool concurrent = false);
+	// 只有默认column family时的简化版本
+	static DBStatus InsertInto(const WriteBatch* batch, MemTable* memtable,
+				   bool concurrent = false);
+
+	static void Append(WriteBatch* dst, const WriteBatch* src);
+};
+}
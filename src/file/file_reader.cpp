@@ -40,7 +40,28 @@ DBStatus FileReader::Read(uint64_t offset, size_t n,
 	}
 	// 原子读 
 	// 线程安全
-	pread(fd_, result, n, static_cast<off_t>(offset));
+	ssize_t r = pread(fd_, result, n, static_cast<off_t>(offset));
+	if (r < 0 || static_cast<size_t>(r) != n) {
+		return Status::kReadFileFailed;
+	}
+	return Status::kSuccess;
+}
+
+DBStatus FileReader::Read(uint64_t offset, size_t n, Slice* result,
+                          char* scratch) const {
+	if (!result || !scratch) {
+		return Status::kInvalidObject;
+	}
+	if (fd_ == -1) {
+		LOG(tinykv::LogLevel::ERROR, "Invalid Socket");
+		return Status::kInterupt;
+	}
+	ssize_t r = pread(fd_, scratch, n, static_cast<off_t>(offset));
+	if (r < 0) {
+		*result = Slice(scratch, 0);
+		return Status::kReadFileFailed;
+	}
+	*result = Slice(scratch, r);
 	return Status::kSuccess;
 }
 
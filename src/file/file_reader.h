@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../include/tinykv/status.h"
+#include "../include/tinykv/slice.h"
 
 #include <string>
 
@@ -13,6 +14,9 @@ public:
 
 	// 从offset处开始，读取长度为n的内容到result中
 	DBStatus Read(uint64_t offset, size_t n, void* result) const;
+	// 从offset处开始最多读取n个字节到scratch中，*result指向实际读到的数据
+	// 读到文件末尾时result->size()会小于n，用于WAL这种按块顺序扫描的场景
+	DBStatus Read(uint64_t offset, size_t n, Slice* result, char* scratch) const;
 
 private:
 	int fd_ = -1;
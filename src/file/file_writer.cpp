@@ -7,7 +7,9 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <dirent.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstring>
@@ -96,7 +98,13 @@ ssize_t FileWriter::Writen(const char* data, int len) {
 	ptr = data;
 	nleft = len;
 	while(nleft > 0) {
-		if ((nwriten = write(fd_, ptr, nleft)) <= 0) {
+		size_t allowed = nleft;
+		if (rate_limiter_ != nullptr) {
+			// 每次最多申请一个周期的令牌，大块数据分多次写入
+			allowed = std::min<size_t>(nleft, rate_limiter_->GetSingleBurstBytes());
+			rate_limiter_->Request(allowed, io_priority_);
+		}
+		if ((nwriten = write(fd_, ptr, allowed)) <= 0) {
 			if(nwriten < 0 && errno == EINTR) {//在写的过程中遇到了中断，那么write（）会返回-1，同时置errno为EINTR，此时重新调用write
 				nwriten = 0;
 			} else {
@@ -109,11 +117,15 @@ ssize_t FileWriter::Writen(const char* data, int len) {
 	return current_pos_;	// 返回已经写了的字节数
 }
 
-void FileWriter::Sync() {
-	Flush();
-	if (fd_ > -1) {
-		fsync(fd_);
+DBStatus FileWriter::Sync() {
+	DBStatus s = Flush();
+	if (s != Status::kSuccess) {
+		return s;
 	}
+	if (fd_ > -1 && fsync(fd_) != 0) {
+		return Status::kWriteFileFailed;
+	}
+	return Status::kSuccess;
 }
 
 void FileWriter::Close() {
@@ -127,4 +139,53 @@ void FileWriter::Close() {
 FileWriter::~FileWriter() {
 	Sync();	//保证Buffer缓冲区的剩余部分刷盘
 }
-}
\ No newline at end of file
+
+uint64_t FileTool::GetFileSize(const std::string_view& path) {
+	struct stat file_stat;
+	if (::stat(std::string(path).c_str(), &file_stat) != 0) {
+		return 0;
+	}
+	return file_stat.st_size;
+}
+
+bool FileTool::Exist(std::string_view path) {
+	return ::access(std::string(path).c_str(), F_OK) == 0;
+}
+
+bool FileTool::Rename(std::string_view from, std::string_view to) {
+	return ::rename(std::string(from).c_str(), std::string(to).c_str()) == 0;
+}
+
+bool FileTool::RemoveFile(const std::string& file_name) {
+	return ::unlink(file_name.c_str()) == 0;
+}
+
+bool FileTool::RemoveDir(const std::string& dirname) {
+	return ::rmdir(dirname.c_str()) == 0;
+}
+
+bool FileTool::CreateDir(const std::string& dirname) {
+	if (Exist(dirname)) {
+		return true;
+	}
+	return ::mkdir(dirname.c_str(), 0755) == 0;
+}
+
+bool FileTool::GetChildren(const std::string& dirname,
+			   std::vector<std::string>* result) {
+	result->clear();
+	DIR* dir = ::opendir(dirname.c_str());
+	if (dir == nullptr) {
+		return false;
+	}
+	struct dirent* entry;
+	while ((entry = ::readdir(dir)) != nullptr) {
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+			continue;
+		}
+		result->emplace_back(entry->d_name);
+	}
+	::closedir(dir);
+	return true;
+}
+}
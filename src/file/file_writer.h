@@ -5,6 +5,7 @@
 #include <string_view>
 #include <vector>
 
+#include "rate_limiter.h"
 #include "../include/tinykv/status.h"
 
 namespace tinykv {
@@ -24,9 +25,16 @@ public:
 	DBStatus Flush();
 
 	// Sync底层是fsync，从内核缓冲区刷到磁盘
-	void Sync();
+	DBStatus Sync();
 	
 	void Close();
+
+	// 之后每次写入磁盘之前都先向rate_limiter申请令牌，rate_limiter为nullptr时不限速
+	// rate_limiter必须比FileWriter活得更久
+	void SetRateLimiter(RateLimiter* rate_limiter, IOPriority priority) {
+		rate_limiter_ = rate_limiter;
+		io_priority_ = priority;
+	}
 private:
 	ssize_t Writen(const char* data, int len);
 
@@ -39,6 +47,9 @@ private:
 	int fd_ = -1;	// 文件描述符
 	std::string file_name_;
 
+	RateLimiter* rate_limiter_ = nullptr;
+	IOPriority io_priority_ = kIOLow;
+
 };
 
 class FileTool final {
@@ -49,5 +60,8 @@ public:
 	static bool RemoveFile(const std::string& file_name);
 	static bool RemoveDir(const std::string& dirname);
 	static bool CreateDir(const std::string& dirname);
+	// 列出目录下的所有文件名(不包含"."和"..")
+	static bool GetChildren(const std::string& dirname,
+				std::vector<std::string>* result);
 };
 }
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "rate_limiter.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace tinykv {
+// 自动调整时每隔多少个周期统计一次
+static const int64_t kTunePeriods = 100;
+// 有请求排队的周期占比高于kHighWatermark%时提速，低于kLowWatermark%时降速
+static const int64_t kHighWatermark = 90;
+static const int64_t kLowWatermark = 50;
+// 每次调整的幅度(百分比)
+static const int64_t kTuneStep = 5;
+// 自动调整时速率的下限是上限的1/kMinRateDivisor
+static const int64_t kMinRateDivisor = 20;
+
+struct RateLimiter::Req {
+	explicit Req(int64_t b) : bytes(b) {}
+
+	int64_t bytes;
+	bool granted = false;
+};
+
+RateLimiter::RateLimiter(int64_t rate_bytes_per_sec, int64_t refill_period_us,
+			 bool auto_tuned)
+	: refill_period_us_(std::max<int64_t>(1, refill_period_us))
+	, auto_tuned_(auto_tuned)
+	, max_bytes_per_sec_(rate_bytes_per_sec)
+	, next_refill_us_(NowMicros()) {
+	SetRateLocked(rate_bytes_per_sec);
+}
+
+RateLimiter::~RateLimiter() = default;
+
+int64_t RateLimiter::NowMicros() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		       std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+
+void RateLimiter::Request(int64_t bytes, IOPriority priority) {
+	assert(priority >= kIOLow && priority < kIOTotal);
+	if (bytes <= 0) {
+		return;
+	}
+	std::unique_lock<std::mutex> lock(mutex_);
+	bytes = std::min(bytes, refill_bytes_per_period_);
+	total_requests_[priority]++;
+	RefillLocked(NowMicros());
+
+	bool queued = false;
+	for (const auto& queue : queues_) {
+		queued = queued || !queue.empty();
+	}
+	// 没有人排队且令牌足够时直接通过，否则排队，保证先来的请求先得到令牌
+	if (!queued && available_bytes_ >= bytes) {
+		available_bytes_ -= bytes;
+		total_bytes_through_[priority] += bytes;
+		return;
+	}
+
+	Req req(bytes);
+	queues_[priority].push_back(&req);
+	total_waits_[priority]++;
+	drained_ = true;
+	while (!req.granted) {
+		// 每个等待的线程都会在下一次补充令牌的时刻醒来，由先醒来的线程负责分配令牌
+		const auto deadline = std::chrono::steady_clock::time_point(
+			std::chrono::microseconds(next_refill_us_));
+		cv_.wait_until(lock, deadline);
+		RefillLocked(NowMicros());
+	}
+}
+
+void RateLimiter::RefillLocked(int64_t now_us) {
+	if (now_us < next_refill_us_) {
+		return;
+	}
+	const int64_t periods = (now_us - next_refill_us_) / refill_period_us_ + 1;
+	next_refill_us_ += periods * refill_period_us_;
+	if (auto_tuned_) {
+		TuneLocked(periods);
+	}
+	// 桶中最多保存一个周期的令牌，空闲一段时间之后也不会出现突发的大量写入
+	available_bytes_ = std::min(available_bytes_ + periods * refill_bytes_per_period_,
+				    refill_bytes_per_period_);
+
+	bool granted = false;
+	for (int pri = kIOTotal - 1; pri >= kIOLow; pri--) {
+		std::deque<Req*>& queue = queues_[pri];
+		// 排队期间速率可能被调低，桶满时即使令牌不够也放行队头的请求，透支的部分从之后的周期中扣除
+		while (!queue.empty() && (queue.front()->bytes <= available_bytes_ ||
+					  available_bytes_ >= refill_bytes_per_period_)) {
+			Req* req = queue.front();
+			queue.pop_front();
+			available_bytes_ -= req->bytes;
+			total_bytes_through_[pri] += req->bytes;
+			req->granted = true;
+			granted = true;
+		}
+		if (!queue.empty()) {
+			// 高优先级的请求还没有满足时，不给低优先级的请求分配令牌
+			break;
+		}
+	}
+	if (granted) {
+		cv_.notify_all();
+	}
+}
+
+void RateLimiter::TuneLocked(int64_t periods) {
+	// 现在还有请求在排队，说明这几个周期一直有积压；否则最多只有最近的一个周期有请求排队过
+	bool queued = false;
+	for (const auto& queue : queues_) {
+		queued = queued || !queue.empty();
+	}
+	tune_periods_ += periods;
+	if (queued) {
+		drained_periods_ += periods;
+	} else if (drained_) {
+		drained_periods_++;
+	}
+	drained_ = false;
+	if (tune_periods_ < kTunePeriods) {
+		return;
+	}
+	const int64_t drained_percent = drained_periods_ * 100 / tune_periods_;
+	int64_t rate = rate_bytes_per_sec_;
+	if (drained_percent > kHighWatermark) {
+		rate = std::min(max_bytes_per_sec_,
+				rate + std::max<int64_t>(1, rate * kTuneStep / 100));
+	} else if (drained_percent < kLowWatermark) {
+		rate = std::max(max_bytes_per_sec_ / kMinRateDivisor,
+				rate - rate * kTuneStep / 100);
+	}
+	if (rate != rate_bytes_per_sec_) {
+		SetRateLocked(rate);
+	}
+	tune_periods_ = 0;
+	drained_periods_ = 0;
+}
+
+void RateLimiter::SetRateLocked(int64_t rate_bytes_per_sec) {
+	rate_bytes_per_sec_ = std::max<int64_t>(1, rate_bytes_per_sec);
+	refill_bytes_per_period_ =
+		std::max<int64_t>(1, rate_bytes_per_sec_ * refill_period_us_ / 1000000);
+}
+
+void RateLimiter::SetBytesPerSecond(int64_t rate_bytes_per_sec) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	max_bytes_per_sec_ = rate_bytes_per_sec;
+	if (!auto_tuned_ || rate_bytes_per_sec_ > rate_bytes_per_sec) {
+		SetRateLocked(rate_bytes_per_sec);
+	}
+}
+
+int64_t RateLimiter::GetBytesPerSecond() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return rate_bytes_per_sec_;
+}
+
+int64_t RateLimiter::GetSingleBurstBytes() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return refill_bytes_per_period_;
+}
+
+int64_t RateLimiter::GetTotalBytesThrough(IOPriority priority) const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (priority == kIOTotal) {
+		return total_bytes_through_[kIOLow] + total_bytes_through_[kIOMid] +
+		       total_bytes_through_[kIOHigh];
+	}
+	return total_bytes_through_[priority];
+}
+
+int64_t RateLimiter::GetTotalRequests(IOPriority priority) const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (priority == kIOTotal) {
+		return total_requests_[kIOLow] + total_requests_[kIOMid] + total_requests_[kIOHigh];
+	}
+	return total_requests_[priority];
+}
+
+int64_t RateLimiter::GetTotalWaits(IOPriority priority) const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (priority == kIOTotal) {
+		return total_waits_[kIOLow] + total_waits_[kIOMid] + total_waits_[kIOHigh];
+	}
+	return total_waits_[priority];
+}
+}
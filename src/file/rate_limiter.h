@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace tinykv {
+// 写文件的优先级，令牌不够时先满足高优先级的请求
+enum IOPriority {
+	kIOLow = 0,	// compaction
+	kIOMid = 1,	// memtable刷盘
+	kIOHigh = 2,	// WAL
+	kIOTotal = 3	// 只用于查询计数器，表示所有优先级之和
+};
+
+// 令牌桶限速器，限制所有FileWriter写入磁盘的总速率，避免后台的sst写入把磁盘带宽占满，
+// 导致前台WAL的写入和fsync变慢
+// 每隔refill_period_us补充一次令牌，每次补充rate_bytes_per_sec * refill_period_us / 1000000字节，
+// 桶中最多也只保存这么多，所以单次申请超过这个值时由调用者拆成多次
+// 可以在多个线程中同时使用
+class RateLimiter final {
+public:
+	// auto_tuned为true时rate_bytes_per_sec是速率的上限，实际速率根据积压情况在[上限/20, 上限]之间调整:
+	// 一段时间内大部分周期都有请求在排队时提高5%，很少排队时降低5%
+	RateLimiter(int64_t rate_bytes_per_sec, int64_t refill_period_us = 100 * 1000,
+		    bool auto_tuned = false);
+
+	RateLimiter(const RateLimiter&) = delete;
+	RateLimiter& operator=(const RateLimiter&) = delete;
+
+	~RateLimiter();
+
+	// 申请写入bytes字节，令牌不够时阻塞到获得令牌为止
+	// bytes不能超过GetSingleBurstBytes()，超过的部分按GetSingleBurstBytes()计算
+	void Request(int64_t bytes, IOPriority priority);
+
+	// 修改速率，auto_tuned时修改的是上限
+	void SetBytesPerSecond(int64_t rate_bytes_per_sec);
+	// 当前的速率
+	int64_t GetBytesPerSecond() const;
+	// 一个周期补充的令牌数，也是单次Request最多能申请的字节数
+	int64_t GetSingleBurstBytes() const;
+
+	// 计数器，priority为kIOTotal时返回所有优先级之和
+	// 已经通过限速器的字节数
+	int64_t GetTotalBytesThrough(IOPriority priority = kIOTotal) const;
+	// Request的调用次数
+	int64_t GetTotalRequests(IOPriority priority = kIOTotal) const;
+	// 因为令牌不够而需要等待的Request次数
+	int64_t GetTotalWaits(IOPriority priority = kIOTotal) const;
+
+private:
+	struct Req;
+
+	// 到了补充令牌的时间就补充，然后按优先级从高到低把令牌分给排队的请求，需要持有mutex_
+	void RefillLocked(int64_t now_us);
+	// 统计过去periods个周期的积压情况，必要时调整速率，需要持有mutex_
+	void TuneLocked(int64_t periods);
+	void SetRateLocked(int64_t rate_bytes_per_sec);
+	static int64_t NowMicros();
+
+	const int64_t refill_period_us_;
+	const bool auto_tuned_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable cv_;
+	// 速率上限，不自动调整时就是当前的速率
+	int64_t max_bytes_per_sec_;
+	int64_t rate_bytes_per_sec_;
+	int64_t refill_bytes_per_period_;
+	// 桶中剩余的令牌
+	int64_t available_bytes_ = 0;
+	int64_t next_refill_us_;
+	// 每个优先级排队等待令牌的请求
+	std::deque<Req*> queues_[kIOTotal];
+
+	// 自动调整使用: 统计的周期数，以及其中有请求排队的周期数
+	int64_t tune_periods_ = 0;
+	int64_t drained_periods_ = 0;
+	// 当前周期中是否有请求排队
+	bool drained_ = false;
+
+	int64_t total_bytes_through_[kIOTotal] = {0, 0, 0};
+	int64_t total_requests_[kIOTotal] = {0, 0, 0};
+	int64_t total_waits_[kIOTotal] = {0, 0, 0};
+};
+}
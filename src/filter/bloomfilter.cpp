@@ -44,18 +44,32 @@ void BloomFilter::CreateFilter(const std::string* keys, int n)
 	{
 		return;
 	}
-
+	AddKeys(keys, n, &bloomfilter_data_);
+}
+void BloomFilter::CreateFilter(const std::string* keys, int n,
+                               std::string* dst) const
+{
+	if(n<=0 || !keys)
+	{
+		return;
+	}
+	AddKeys(keys, n, dst);
+	// 位图之后是哈希函数的个数，MayMatch(key, datas)从这里恢复k
+	PutFixed32(dst, k_);
+}
+void BloomFilter::AddKeys(const std::string* keys, int n, std::string* dst) const
+{
 	int32_t bits = n * bits_per_key_;
 	bits = bits < 64 ? 64 : bits;
 	// bits向上取整
 	const int32_t bytes = (bits + 7) / 8;
 	bits = bytes * 8;
 
-	const int32_t init_size = bloomfilter_data_.size();
-	bloomfilter_data_.resize(init_size + bytes, 0);
+	const int32_t init_size = dst->size();
+	dst->resize(init_size + bytes, 0);
 
-	// 将bloomfilter_data_转成数组方便使用
-	char* array = &(bloomfilter_data_)[init_size];
+	// 将dst转成数组方便使用
+	char* array = &(*dst)[init_size];
 
 	// 对于每个key，计算哈希值，给相应的位置1
 	for(int i = 0; i < n; i++)
@@ -12,6 +12,8 @@ public:
     const char* Name() override;
     // 创建过滤器
     void CreateFilter(const std::string* keys, int n) override;
+    void CreateFilter(const std::string* keys, int n,
+                      std::string* dst) const override;
     // 判断key是否在过滤器中
     bool MayMatch(const std::string& key, int32_t start_pos,
 			int32_t len) override;
@@ -26,6 +28,8 @@ public:
 private:
     void CalcBloomBitsPerKey(int32_t entries_num, float positive = 0.01);
     void CalcHashNum();
+    // 把keys对应的位图追加到dst中
+    void AddKeys(const std::string* keys, int n, std::string* dst) const;
 private:
     FilterPolicyMeta filter_policy_meta_;
     // 每个key占用的bit位数
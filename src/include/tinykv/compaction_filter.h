@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include "slice.h"
+
+namespace tinykv {
+// compaction时对每个key的最新版本调用，用来在合并的同时丢弃或者改写数据，不需要额外的扫描和删除
+// 只处理对所有快照都不可见的版本，快照能读到的数据不会因为过滤而改变
+// 可能在多个subcompaction线程中同时调用，实现需要是线程安全的
+class CompactionFilter {
+public:
+    virtual ~CompactionFilter();
+    virtual const char* Name() const = 0;
+    // level是compaction的输入层，返回true表示丢弃这个key，之后读不到它，更旧的版本也不会再出现
+    // 返回false时可以把新的value写入*new_value并把*value_changed设为true，用来代替原来的value
+    virtual bool Filter(int level, const Slice& key, const Slice& existing_value,
+                        std::string* new_value, bool* value_changed) const = 0;
+};
+
+// 内置的TTL过滤器: value的最后4字节是写入时间(unix时间戳，秒)，写入超过ttl秒的key被丢弃
+// Options::ttl大于0时，DB在Put时追加写入时间、读取时去掉，并自动使用这个过滤器
+class TtlCompactionFilter final : public CompactionFilter {
+public:
+    // value末尾的写入时间的长度
+    static constexpr size_t kTimestampSize = 4;
+
+    explicit TtlCompactionFilter(uint32_t ttl) : ttl_(ttl) {}
+
+    const char* Name() const override { return "tinykv.TtlCompactionFilter"; }
+    bool Filter(int level, const Slice& key, const Slice& existing_value,
+                std::string* new_value, bool* value_changed) const override;
+
+    // 把当前时间追加到value后面
+    static void AppendTimestamp(std::string* value);
+    // 去掉value末尾的写入时间，value比kTimestampSize短时原样返回
+    static Slice StripTimestamp(const Slice& value);
+
+private:
+    const uint32_t ttl_;
+};
+}
@@ -29,5 +29,9 @@ public:
 	const char* Name() const override;
 	int32_t Compare(const Slice& a, const Slice& b) const override;
 	void FindShortestSeparator(std::string* start, const Slice& limit) const override;
+	void FindShortSuccessor(std::string* /*key*/) const override {}
 };
+
+// 返回按字节序比较的内置比较器，是一个全局单例，调用方不能delete
+const Comparator* BytewiseComparator();
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <vector>
 // 用于过滤
 namespace tinykv {
 
@@ -14,11 +16,29 @@ class FilterPolicy {
   virtual const char* Name() = 0;
   // 创建过滤器
   virtual void CreateFilter(const std::string* keys, int n) = 0;
+  // 为keys构建一个独立的过滤器追加到dst中，结果可以直接交给MayMatch(key, datas)判断
+  // 不修改过滤器自身的状态，多个sst可以同时用同一个FilterPolicy构建过滤器
+  virtual void CreateFilter(const std::string* keys, int n,
+                            std::string* dst) const = 0;
   // 判断key是否在过滤器中
   virtual bool MayMatch(const std::string& key, int32_t start_pos,
                         int32_t len) = 0;
   virtual bool MayMatch(const std::string_view& key,
                         const std::string_view& datas) = 0;
+  // 和上面的CreateFilter相同，另外把prefixes(从key中取出的前缀)也加入过滤器，之后用PrefixMayMatch查找
+  // 默认把前缀当作普通的key，key和前缀的格式不同时(比如内部键)需要覆盖这两个函数
+  virtual void CreateFilter(const std::string* keys, int n,
+                            const std::string* prefixes, int m,
+                            std::string* dst) const {
+    std::vector<std::string> all(keys, keys + n);
+    all.insert(all.end(), prefixes, prefixes + m);
+    CreateFilter(all.data(), static_cast<int>(all.size()), dst);
+  }
+  // 判断过滤器中是否可能有以prefix为前缀的key
+  virtual bool PrefixMayMatch(const std::string_view& prefix,
+                              const std::string_view& datas) {
+    return MayMatch(prefix, datas);
+  }
   virtual const std::string& Data() = 0;
   // 返回当前过滤器底层对象的空间占用
   virtual uint32_t Size() = 0;
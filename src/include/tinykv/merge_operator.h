@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+
+#include "slice.h"
+
+namespace tinykv {
+// merge把对value的修改(比如计数器加一、往列表末尾追加)作为操作数直接写入，不需要先读出旧值，
+// 读取和compaction时再按写入的顺序把操作数依次合并到旧值上
+// 这里的合并需要满足结合律: 相邻的几个操作数先合并成一个再合并到旧值上，结果不变，
+// compaction时不知道旧值也可以把多个操作数提前合并成一个
+// 可能在多个线程中同时调用，实现需要是线程安全的
+class MergeOperator {
+public:
+    virtual ~MergeOperator();
+    virtual const char* Name() const = 0;
+    // 把value合并到existing_value上，结果写入*new_value
+    // existing_value为nullptr表示key不存在或者已经被删除，也可能是之前合并好的操作数
+    // 返回false表示数据的格式不对，读取会返回kCorruption
+    virtual bool Merge(const Slice& key, const Slice* existing_value, const Slice& value,
+                       std::string* new_value) const = 0;
+};
+
+// 64位无符号整数的计数器，value和操作数都是fixed64编码，相加溢出时回绕
+class UInt64AddOperator final : public MergeOperator {
+public:
+    const char* Name() const override { return "tinykv.UInt64AddOperator"; }
+    bool Merge(const Slice& key, const Slice* existing_value, const Slice& value,
+               std::string* new_value) const override;
+};
+
+// 字符串追加，旧值和操作数之间用delimiter分隔
+class StringAppendOperator final : public MergeOperator {
+public:
+    explicit StringAppendOperator(char delimiter) : delimiter_(delimiter) {}
+
+    const char* Name() const override { return "tinykv.StringAppendOperator"; }
+    bool Merge(const Slice& key, const Slice* existing_value, const Slice& value,
+               std::string* new_value) const override;
+
+private:
+    const char delimiter_;
+};
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+
+#include "slice.h"
+
+namespace tinykv {
+// 从key中取出前缀，用来给sst构建前缀过滤器，以及让前缀迭代跳过不包含这个前缀的sst
+// 前缀相同的key在comparator的顺序中必须是连续的
+class SliceTransform {
+public:
+    virtual ~SliceTransform();
+    // 名字会记录在sst中，换成不同的前缀规则之后旧sst中的前缀过滤器不会被误用
+    virtual const char* Name() const = 0;
+    // 返回key的前缀，只在InDomain(key)为true时调用，结果指向key的内存
+    virtual Slice Transform(const Slice& key) const = 0;
+    // key是否有前缀，没有前缀的key不加入前缀过滤器，用它Seek时也不会跳过任何sst
+    virtual bool InDomain(const Slice& key) const = 0;
+};
+
+// 取key的前prefix_len个字节作为前缀，比prefix_len短的key没有前缀
+class FixedPrefixTransform final : public SliceTransform {
+public:
+    explicit FixedPrefixTransform(size_t prefix_len);
+    const char* Name() const override { return name_.c_str(); }
+    Slice Transform(const Slice& key) const override;
+    bool InDomain(const Slice& key) const override;
+
+private:
+    const size_t prefix_len_;
+    const std::string name_;
+};
+}
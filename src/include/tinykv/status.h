@@ -107,13 +107,13 @@
 #include <stdint.h>
 namespace tinykv {
 
-#define constexpr const
 struct DBStatus {
   int32_t code;
   const char *message;
 };
-bool operator==(const DBStatus &x, const DBStatus &y);
-bool operator!=(const DBStatus &x, const DBStatus &y);
+// 只比较错误码，message只是描述
+inline bool operator==(const DBStatus &x, const DBStatus &y) { return x.code == y.code; }
+inline bool operator!=(const DBStatus &x, const DBStatus &y) { return x.code != y.code; }
 
 struct Status {
   Status() = delete;
@@ -126,6 +126,9 @@ struct Status {
   static constexpr DBStatus kWriteFileFailed = {1004, "WriteFile Failed"};
   static constexpr DBStatus kReadFileFailed = {1005, "ReadFile Failed"};
   static constexpr DBStatus kInvalidObject = {1006, "Invalid Object"};
+  static constexpr DBStatus kCorruption = {1007, "Corruption"};
+  static constexpr DBStatus kIOError = {1008, "IO Error"};
+  static constexpr DBStatus kInvalidArgument = {1009, "Invalid Argument"};
 };
 
 }  // namespace corekv
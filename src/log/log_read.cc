@@ -19,7 +19,8 @@ Reader::Reader(FileReader* file, Reporter* reporter, bool checksum,
       eof_(false),
       last_record_offset_(0),
       end_of_buffer_offset_(0),
-      initial_offset_(initial_offset) {
+      initial_offset_(initial_offset),
+      resyncing_(initial_offset > 0) {
 }
  
 Reader::~Reader() {
@@ -41,18 +42,9 @@ bool Reader::SkipToInitialBlock() {
     block_start_location += kBlockSize;
   }
  
+  // FileReader是按offset读取的(pread)，所以跳过前面的Block只需要
+  // 把下一次读取的位置设置为block_start_location即可，不需要真的去Skip文件
   end_of_buffer_offset_ = block_start_location;
- 
-  // 如果block_start_location大于0，则文件中应该跳过block_start_location
-  // 个字节，到达目标Block的开头。否则将数据损坏信息打印到LOG文件。
-  if (block_start_location > 0) {
-    Status skip_status = file_->Skip(block_start_location);
-    if (!skip_status.ok()) {
-      ReportDrop(block_start_location, skip_status);
-      return false;
-    }
-  }
- 
   return true;
 }
  
@@ -76,6 +68,17 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
 	// 还未解析的记录，而end_of_buffer_offset_是当前Block的结束位置的偏移
     uint64_t physical_record_offset = end_of_buffer_offset_ - buffer_.size();
     const unsigned int record_type = ReadPhysicalRecord(&fragment);
+    // 从initial_offset开始读时，开头可能是上一条记录的后半部分，直接跳过，不算数据损坏
+    if (resyncing_) {
+      if (record_type == kMiddleType) {
+        continue;
+      } else if (record_type == kLastType) {
+        resyncing_ = false;
+        continue;
+      } else {
+        resyncing_ = false;
+      }
+    }
     switch (record_type) {
       case kFullType:
         if (in_fragmented_record) {
@@ -172,10 +175,11 @@ uint64_t Reader::LastRecordOffset() {
 }
  
 void Reader::ReportCorruption(size_t bytes, const char* reason) {
-  ReportDrop(bytes, Status::Corruption(reason));
+  // 错误码用kCorruption，message换成具体的原因；reason可能在栈上，只在Corruption回调期间有效
+  ReportDrop(bytes, DBStatus{Status::kCorruption.code, reason});
 }
  
-void Reader::ReportDrop(size_t bytes, const Status& reason) {
+void Reader::ReportDrop(size_t bytes, const DBStatus& reason) {
   if (reporter_ != NULL &&
       end_of_buffer_offset_ - buffer_.size() - bytes >= initial_offset_) {
     reporter_->Corruption(bytes, reason);
@@ -192,12 +196,12 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
       if (!eof_) {
         // 清空buffer_，存储下一个Block
         buffer_.clear();
-		// 从文件中每次读取一个Block，Read内部会做偏移，保证按顺序读取
-        Status status = file_->Read(kBlockSize, &buffer_, backing_store_);
+		// 从文件中每次读取一个Block，读取的位置就是上一个Block的结束位置，保证按顺序读取
+        DBStatus status = file_->Read(end_of_buffer_offset_, kBlockSize, &buffer_, backing_store_);
 		// 当前Block结束位置的偏移
         end_of_buffer_offset_ += buffer_.size();
 		// 读取失败，打印LOG信息，并将eof_设置为true，终止log文件的解析
-        if (!status.ok()) {
+        if (status != Status::kSuccess) {
           buffer_.clear();
           ReportDrop(kBlockSize, status);
           eof_ = true;
@@ -19,7 +19,8 @@ public:
 	public:
 		virtual ~Reporter();
 
-		virtual void Corruption(size_t bytes, const Status& status) = 0;
+		// 丢弃了bytes字节，status.message是具体的原因，只在这次调用期间有效
+		virtual void Corruption(size_t bytes, const DBStatus& status) = 0;
 	};
 
 	/**
@@ -101,6 +102,6 @@ private:
 	
 	// 上报错误和丢弃
 	void ReportCorruption(size_t bytes, const char* reason);
-	void ReportDrop(size_t bytes, const Status& reason);
+	void ReportDrop(size_t bytes, const DBStatus& reason);
 };
 } // namespace tinykvclass FileReader;
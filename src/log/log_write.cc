@@ -18,6 +18,13 @@ Writer::Writer(FileWriter* dest)
 	InitTypeCrc(type_crc_);
 } 
 
+Writer::Writer(FileWriter* dest, uint64_t dest_length)
+	: dest_(dest)
+	, block_offset_(dest_length % kBlockSize)
+{
+	InitTypeCrc(type_crc_);
+}
+
 Writer::~Writer() = default;
 
 /**
@@ -30,7 +37,7 @@ Writer::~Writer() = default;
 
 写入由EmitPhysicalRecord完成，EmitPhysicalRecord的第一个参数RecordType表示当前fragment在当前记录的相对位置。
  */
-Status Writer::AddRecord(const Slice& slice) {
+DBStatus Writer::AddRecord(const Slice& slice) {
 	const char* ptr = slice.data();
 	size_t left = slice.size();
 
@@ -50,7 +57,7 @@ Status Writer::AddRecord(const Slice& slice) {
 	3、L < 7，当前Block的剩余长度小于7Byte，则填充0。      
 	以上流程就是整个写流程了。
 	 */
-	Status s;
+	DBStatus s = Status::kSuccess;
 	bool begin = true;
 	do {
 		// 每个block还剩多少空间
@@ -59,7 +66,7 @@ Status Writer::AddRecord(const Slice& slice) {
 		if (leftover < kHeaderSize) {
 			if(leftover > 0) {
 				static_assert(kHeaderSize == 7, "");
-				dest_->Append(Slice("\x00\x00\x00\x00\x00\x00", leftover));
+				dest_->Append("\x00\x00\x00\x00\x00\x00", leftover);
 			}
 			block_offset_ = 0;
 		}
@@ -89,7 +96,7 @@ Status Writer::AddRecord(const Slice& slice) {
 		ptr += fragment_length;
 		left -= fragment_length;
 		begin = false;
-	} while(s.ok() && left>0);
+	} while(s == Status::kSuccess && left>0);
 	return s;
 }
 
@@ -100,7 +107,7 @@ Status Writer::AddRecord(const Slice& slice) {
   3、先写头、在写Payload，写成功之后flush下；
   4、将block_offset_位置重新计算下。
  */
-Status Writer::EmitPhysicalRecord(RecordType t, const char* ptr, size_t length) {
+DBStatus Writer::EmitPhysicalRecord(RecordType t, const char* ptr, size_t length) {
 assert(length <= 0xffff);  // Must fit in two bytes
 	assert(block_offset_ + kHeaderSize + length <= kBlockSize);
 
@@ -121,11 +128,11 @@ assert(length <= 0xffff);  // Must fit in two bytes
 
 	// 2.添加header
 	// Write the header and the payload
-	Status s = dest_->Append(Slice(buf, kHeaderSize));
-	if (s.ok()) {
+	DBStatus s = dest_->Append(buf, kHeaderSize);
+	if (s == Status::kSuccess) {
 		// 3.添加数据
-		s = dest_->Append(Slice(ptr, length));
-		if (s.ok()) {
+		s = dest_->Append(ptr, length);
+		if (s == Status::kSuccess) {
 			// 写入到磁盘
 			/** 
 			 * 通过Flush方法将用户态buffer中写入的内容刷入内核态buffer后便会返回，后续写入通过操作系统实现。
@@ -12,6 +12,7 @@ class Writer {
 public:
 	explicit Writer(FileWriter* dest);
 
+	// 以追加的方式打开已有的log文件时使用，dest_length是文件当前的长度
 	Writer(FileWriter* dest, uint64_t dest_length);
 
 	Writer(const Writer&) = delete;
@@ -19,10 +20,10 @@ public:
 
 	~Writer();
 
-	Status AddRecord(const Slice& slice);
+	DBStatus AddRecord(const Slice& slice);
 
 private:
-	Status EmitPhysicalRecord(RecordType type, const char* ptr, size_t length);
+	DBStatus EmitPhysicalRecord(RecordType type, const char* ptr, size_t length);
 	// FileWriter这是一个文件操作的抽象类
 	// 是对不同操作系统的文件操作的抽象，不同操作系统实现也不一样，提供Write、Sync等接口。
 	FileWriter* dest_;
@@ -5,7 +5,6 @@
 #include <string>
 #include "log_level.h"
 namespace tinykv {
-#define constexpr const
 static constexpr uint32_t kDefaultLogBufferMaxSize = 4096;
 static const std::string kLogActiveName = "tinykv_active.log";
 enum class LogType : uint8_t { EMPTY = 0, CONSOLE = 1, FILE = 2 };
@@ -3,6 +3,8 @@
 #include <cstdint>
 #include <atomic>
 
+#include "../utils/lock.h"
+
 // 参考C++标准库内存池的设计
 namespace tinykv{
 /**
@@ -50,6 +52,7 @@ private:
 	char* free_list_end_pos_ = nullptr;	// 当前可用内存终点
 	int32_t heap_size_ = 0;	// 总的内存大小，可以理解为bias
 	FreeList* freelist_[kFreeListMaxNum] = {nullptr};
-};	std::atomic<uint32_t> memory_usage_;	// 用户获取当前内存分配量
+	std::atomic<uint32_t> memory_usage_{0};	// 用户获取当前内存分配量
+};
 
 }
\ No newline at end of file
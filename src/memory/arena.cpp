@@ -0,0 +1,185 @@
+#include "arena.h"
+#include "huge_page.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <functional>
+#include <thread>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace tinykv {
+// 对齐到指针大小，至少8字节
+static const size_t kAlignUnit = (sizeof(void*) > 8) ? sizeof(void*) : 8;
+static_assert((kAlignUnit & (kAlignUnit - 1)) == 0, "Pointer size should be a power of 2");
+
+// 使用大页时block是大页的整数倍，避免一个block的尾巴落在普通页上
+static size_t RoundUpBlockSize(size_t block_size, size_t huge_page_size) {
+	if (huge_page_size == 0) {
+		return block_size;
+	}
+	assert((huge_page_size & (huge_page_size - 1)) == 0);
+	return (block_size + huge_page_size - 1) & ~(huge_page_size - 1);
+}
+
+Arena::Arena(size_t block_size, size_t huge_page_size)
+	: huge_page_size_(huge_page_size)
+	, block_size_(RoundUpBlockSize(block_size, huge_page_size)) {
+	assert(block_size_ >= kAlignUnit);
+}
+
+Arena::~Arena() {
+	for (char* block : blocks_) {
+		delete[] block;
+	}
+	for (const auto& block : huge_blocks_) {
+		FreeHugePages(block.first, block.second);
+	}
+}
+
+char* Arena::Allocate(size_t bytes) {
+	// 不允许分配0字节，返回值的含义不明确
+	assert(bytes > 0);
+	if (bytes <= alloc_bytes_remaining_) {
+		char* result = alloc_ptr_;
+		alloc_ptr_ += bytes;
+		alloc_bytes_remaining_ -= bytes;
+		return result;
+	}
+	return AllocateFallback(bytes);
+}
+
+char* Arena::AllocateAligned(size_t bytes) {
+	size_t current_mod = reinterpret_cast<uintptr_t>(alloc_ptr_) & (kAlignUnit - 1);
+	size_t slop = (current_mod == 0 ? 0 : kAlignUnit - current_mod);
+	size_t needed = bytes + slop;
+	char* result;
+	if (needed <= alloc_bytes_remaining_) {
+		result = alloc_ptr_ + slop;
+		alloc_ptr_ += needed;
+		alloc_bytes_remaining_ -= needed;
+	} else {
+		// new[]返回的内存总是对齐的
+		result = AllocateFallback(bytes);
+	}
+	assert((reinterpret_cast<uintptr_t>(result) & (kAlignUnit - 1)) == 0);
+	return result;
+}
+
+char* Arena::AllocateFallback(size_t bytes) {
+	if (bytes > block_size_ / 4) {
+		// 超过block的1/4单独申请，当前block剩下的空间留给后面的小请求，避免浪费太多
+		return AllocateNewBlock(bytes);
+	}
+	// 当前block剩下的空间直接丢弃
+	alloc_ptr_ = AllocateNewBlock(block_size_);
+	alloc_bytes_remaining_ = block_size_;
+
+	char* result = alloc_ptr_;
+	alloc_ptr_ += bytes;
+	alloc_bytes_remaining_ -= bytes;
+	return result;
+}
+
+char* Arena::AllocateNewBlock(size_t block_bytes) {
+	// 只有普通的block用大页，超过block 1/4单独申请的内存大小不固定，映射成大页浪费太多
+	if (huge_page_size_ > 0 && block_bytes == block_size_) {
+		size_t mapped_bytes = 0;
+		bool hugetlb = false;
+		char* result = AllocateHugePages(block_bytes, huge_page_size_, &mapped_bytes, &hugetlb);
+		if (result != nullptr) {
+			huge_blocks_.emplace_back(result, mapped_bytes);
+			memory_usage_.fetch_add(mapped_bytes + sizeof(char*) + sizeof(size_t),
+						std::memory_order_relaxed);
+			if (hugetlb) {
+				huge_page_usage_.fetch_add(mapped_bytes, std::memory_order_relaxed);
+			}
+			return result;
+		}
+	}
+	char* result = new char[block_bytes];
+	blocks_.push_back(result);
+	memory_usage_.fetch_add(block_bytes + sizeof(char*), std::memory_order_relaxed);
+	return result;
+}
+
+// shard个数取不小于CPU核数的2的幂次
+static size_t ShardCount() {
+	size_t cores = std::thread::hardware_concurrency();
+	size_t count = 1;
+	while (count < cores) {
+		count <<= 1;
+	}
+	return count;
+}
+
+ConcurrentArena::ConcurrentArena(size_t block_size, size_t huge_page_size)
+	: shard_block_size_(block_size / 8 < 128 ? 128 : block_size / 8)
+	, shards_(new Shard[ShardCount()])
+	, shard_mask_(ShardCount() - 1)
+	, arena_(block_size, huge_page_size) {}
+
+size_t ConcurrentArena::MemoryUsage() const {
+	size_t unused = arena_allocated_and_unused_.load(std::memory_order_relaxed);
+	for (size_t i = 0; i <= shard_mask_; i++) {
+		unused += shards_[i].allocated_and_unused.load(std::memory_order_relaxed);
+	}
+	size_t reserved = arena_.MemoryUsage();
+	// 和其他线程的分配并发时几个计数器不是同一时刻的值，不能让结果回绕
+	return reserved > unused ? reserved - unused : 0;
+}
+
+ConcurrentArena::Shard* ConcurrentArena::CurrentShard() {
+	size_t index;
+#ifdef __linux__
+	int cpu = sched_getcpu();
+	if (cpu >= 0) {
+		index = static_cast<size_t>(cpu);
+	} else
+#endif
+	{
+		// 拿不到CPU编号时按线程id分配shard
+		static thread_local size_t thread_index =
+			std::hash<std::thread::id>()(std::this_thread::get_id());
+		index = thread_index;
+	}
+	// 线程在取到shard之后可能被调度到其他核上，只影响锁竞争，不影响正确性
+	return &shards_[index & shard_mask_];
+}
+
+char* ConcurrentArena::AllocateFromArena(size_t bytes, bool aligned) {
+	ScopedLockImple<SpinLock> lock_guard(arena_lock_);
+	char* result = aligned ? arena_.AllocateAligned(bytes) : arena_.Allocate(bytes);
+	arena_allocated_and_unused_.store(arena_.AllocatedAndUnused(), std::memory_order_relaxed);
+	return result;
+}
+
+char* ConcurrentArena::AllocateImpl(size_t bytes, bool aligned) {
+	assert(bytes > 0);
+	// 大的分配直接交给Arena，否则shard block剩下的空间会被大量浪费
+	if (bytes > shard_block_size_ / 4) {
+		return AllocateFromArena(bytes, aligned);
+	}
+	Shard* shard = CurrentShard();
+	ScopedLockImple<SpinLock> lock_guard(shard->lock);
+	size_t unused = shard->allocated_and_unused.load(std::memory_order_relaxed);
+	size_t slop = 0;
+	if (aligned) {
+		size_t current_mod = reinterpret_cast<uintptr_t>(shard->free_begin) & (kAlignUnit - 1);
+		slop = (current_mod == 0 ? 0 : kAlignUnit - current_mod);
+	}
+	if (bytes + slop > unused) {
+		// shard中剩下的空间不够，换一块新的shard block，剩下的尾巴直接丢弃
+		shard->free_begin = AllocateFromArena(shard_block_size_, true);
+		unused = shard_block_size_;
+		slop = 0;
+	}
+	char* result = shard->free_begin + slop;
+	shard->free_begin = result + bytes;
+	shard->allocated_and_unused.store(unused - bytes - slop, std::memory_order_relaxed);
+	return result;
+}
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "../utils/lock.h"
+
+namespace tinykv {
+/**
+ * @brief
+ * memtable专用的内存分配器，参考leveldb的Arena：每次向系统申请一大块内存(block)，
+ * 分配时只需要在block中移动指针，没有free list，也不支持单独释放某一块内存。
+ * memtable中的记录和跳表节点只增不删，整个memtable释放时Arena析构，一次性归还所有block。
+ */
+class Arena final {
+public:
+	static const size_t kBlockSize = 64 * 1024;	// 默认的block大小
+
+	// huge_page_size大于0时block_size向上取整到huge_page_size的整数倍，block用大页映射(见AllocateHugePages)，
+	// 减少在很大的memtable中查找时的TLB miss，映射失败时退回new
+	explicit Arena(size_t block_size = kBlockSize, size_t huge_page_size = 0);
+	~Arena();
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	// 返回一块大小为bytes的内存，不保证对齐
+	char* Allocate(size_t bytes);
+	// 返回的内存按指针大小对齐，跳表节点中有std::atomic<Node*>，必须对齐
+	char* AllocateAligned(size_t bytes);
+
+	// 从系统申请的全部内存，包括block中还没有分配出去的部分和记录block的指针数组
+	size_t MemoryUsage() const {
+		return memory_usage_.load(std::memory_order_relaxed);
+	}
+	// 当前block中还没有分配出去的字节数
+	size_t AllocatedAndUnused() const { return alloc_bytes_remaining_; }
+	// 用MAP_HUGETLB映射的字节数，包含在MemoryUsage()中；透明大页由内核决定，这里不统计
+	size_t HugePageUsage() const {
+		return huge_page_usage_.load(std::memory_order_relaxed);
+	}
+
+private:
+	// 当前block放不下时调用，大的请求单独申请一个block，否则换一个新的block
+	char* AllocateFallback(size_t bytes);
+	char* AllocateNewBlock(size_t block_bytes);
+
+	const size_t huge_page_size_;
+	const size_t block_size_;
+	char* alloc_ptr_ = nullptr;		// 当前block中下一次分配的位置
+	size_t alloc_bytes_remaining_ = 0;	// 当前block中剩余的字节数
+	std::vector<char*> blocks_;		// new出来的block，析构时释放
+	std::vector<std::pair<char*, size_t>> huge_blocks_;	// 大页映射的block和映射的大小
+	std::atomic<size_t> memory_usage_{0};
+	std::atomic<size_t> huge_page_usage_{0};
+};
+
+/**
+ * @brief
+ * 多个线程同时插入memtable时使用的Arena。
+ * 每个CPU核一个shard，shard每次从Arena中取一小块内存(shard block)，小的分配只需要在shard中移动指针，
+ * 临界区只有几条指令，并且不同核上的线程基本不会竞争同一把自旋锁；大的分配直接交给Arena。
+ */
+class ConcurrentArena final {
+public:
+	explicit ConcurrentArena(size_t block_size = Arena::kBlockSize, size_t huge_page_size = 0);
+
+	ConcurrentArena(const ConcurrentArena&) = delete;
+	ConcurrentArena& operator=(const ConcurrentArena&) = delete;
+
+	char* Allocate(size_t bytes) { return AllocateImpl(bytes, false); }
+	char* AllocateAligned(size_t bytes) { return AllocateImpl(bytes, true); }
+
+	// 已经分配出去的内存，包括跳表节点、对齐浪费的字节和shard block换掉时剩下的尾巴，
+	// 不包括Arena和各个shard中还没有分配出去的部分，memtable用它判断是否写满
+	size_t MemoryUsage() const;
+	// 从系统申请的全部内存
+	size_t MemoryReserved() const { return arena_.MemoryUsage(); }
+	size_t HugePageUsage() const { return arena_.HugePageUsage(); }
+
+private:
+	// 占满一个cache line，避免不同核上的shard伪共享
+	struct Shard {
+		char* free_begin = nullptr;
+		std::atomic<size_t> allocated_and_unused{0};
+		SpinLock lock;
+		char padding[64 - sizeof(char*) - sizeof(std::atomic<size_t>) - sizeof(SpinLock)];
+	};
+
+	char* AllocateImpl(size_t bytes, bool aligned);
+	// 当前线程所在CPU核对应的shard
+	Shard* CurrentShard();
+	// 在arena_lock_保护下从Arena分配
+	char* AllocateFromArena(size_t bytes, bool aligned);
+
+	const size_t shard_block_size_;
+	std::unique_ptr<Shard[]> shards_;
+	size_t shard_mask_;	// shard个数是2的幂次，用来取模
+	SpinLock arena_lock_;
+	Arena arena_;
+	std::atomic<size_t> arena_allocated_and_unused_{0};
+};
+
+}
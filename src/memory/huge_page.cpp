@@ -0,0 +1,65 @@
+#include "huge_page.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace tinykv {
+char* AllocateHugePages(size_t bytes, size_t huge_page_size, size_t* mapped_bytes, bool* hugetlb) {
+	assert(huge_page_size > 0 && (huge_page_size & (huge_page_size - 1)) == 0);
+	*mapped_bytes = 0;
+	*hugetlb = false;
+#ifdef __linux__
+	const size_t size = (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+	void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+	p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (p != MAP_FAILED) {
+		*mapped_bytes = size;
+		*hugetlb = true;
+		return static_cast<char*>(p);
+	}
+#endif
+	// 多映射一个大页，把起始地址对齐到大页边界之后再去掉两头多出来的部分，
+	// 透明大页只能合并对齐的2MB区间
+	const size_t reserve = size + huge_page_size;
+	p = mmap(nullptr, reserve, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		return nullptr;
+	}
+	char* begin = static_cast<char*>(p);
+	char* aligned = reinterpret_cast<char*>(
+		(reinterpret_cast<uintptr_t>(begin) + huge_page_size - 1) & ~(huge_page_size - 1));
+	if (aligned > begin) {
+		munmap(begin, aligned - begin);
+	}
+	char* end = begin + reserve;
+	if (end > aligned + size) {
+		munmap(aligned + size, end - (aligned + size));
+	}
+#ifdef MADV_HUGEPAGE
+	// 内核没有开启透明大页时失败，内存仍然可以用，只是由普通的页组成
+	madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+	*mapped_bytes = size;
+	return aligned;
+#else
+	(void)bytes;
+	return nullptr;
+#endif
+}
+
+void FreeHugePages(char* p, size_t mapped_bytes) {
+#ifdef __linux__
+	munmap(p, mapped_bytes);
+#else
+	(void)p;
+	(void)mapped_bytes;
+#endif
+}
+
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace tinykv {
+// x86-64上透明大页和hugetlbfs默认的大页大小
+static const size_t kDefaultHugePageSize = 2 * 1024 * 1024;
+
+/**
+ * @brief
+ * 用大页申请至少bytes字节的内存，实际映射的字节数(huge_page_size的整数倍)写入*mapped_bytes。
+ * 优先使用MAP_HUGETLB，需要系统预留足够的大页(/proc/sys/vm/nr_hugepages)，成功时*hugetlb为true；
+ * 预留的大页不够时退回普通的匿名映射，按huge_page_size对齐之后madvise(MADV_HUGEPAGE)，
+ * 由内核的透明大页尽量合并成大页，*hugetlb为false。
+ * 两种方式都失败时返回nullptr，由调用者退回new/malloc。
+ */
+char* AllocateHugePages(size_t bytes, size_t huge_page_size, size_t* mapped_bytes, bool* hugetlb);
+// 释放AllocateHugePages返回的内存，mapped_bytes是当时写入*mapped_bytes的值
+void FreeHugePages(char* p, size_t mapped_bytes);
+
+}
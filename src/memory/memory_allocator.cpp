@@ -0,0 +1,179 @@
+#include "memory_allocator.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace tinykv {
+namespace {
+// 大小分级：256字节以内按64字节取整，之后每个2的幂次区间等分成4级，取整浪费的不超过1/4
+static size_t SizeClass(size_t size) {
+	static const size_t kMinStep = 64;
+	if (size <= 4 * kMinStep) {
+		return (size + kMinStep - 1) & ~(kMinStep - 1);
+	}
+	size_t power = 4 * kMinStep;
+	while (power * 2 < size) {
+		power *= 2;
+	}
+	const size_t step = power / 4;
+	return (size + step - 1) & ~(step - 1);
+}
+
+class HugePageAllocator final : public MemoryAllocator {
+public:
+	explicit HugePageAllocator(size_t huge_page_size)
+		: slab_size_(huge_page_size)
+		, max_class_size_(huge_page_size / 8) {
+		assert(huge_page_size > 0 && (huge_page_size & (huge_page_size - 1)) == 0);
+	}
+
+	~HugePageAllocator() override {
+		for (const auto& entry : slabs_) {
+			FreeSlab(entry.second);
+		}
+	}
+
+	const char* Name() const override { return "tinykv.HugePageAllocator"; }
+
+	char* Allocate(size_t size) override {
+		assert(size > 0);
+		const size_t class_size = SizeClass(size);
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (class_size > max_class_size_) {
+			// 一个slab放不下几个，单独申请，释放时直接还给系统
+			memory_usage_ += class_size;
+			return new char[class_size];
+		}
+		std::vector<Slab*>& partial = partial_slabs_[class_size];
+		if (partial.empty()) {
+			partial.push_back(NewSlab(class_size));
+		}
+		Slab* slab = partial.back();
+		char* result;
+		if (slab->free_list != nullptr) {
+			result = slab->free_list;
+			slab->free_list = *reinterpret_cast<char**>(result);
+		} else {
+			result = slab->begin + slab->carved * class_size;
+			slab->carved++;
+		}
+		slab->used++;
+		free_bytes_ -= class_size;
+		if (slab->used == slab->capacity) {
+			partial.pop_back();
+		}
+		return result;
+	}
+
+	void Deallocate(char* p, size_t size) override {
+		const size_t class_size = SizeClass(size);
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (class_size > max_class_size_) {
+			memory_usage_ -= class_size;
+			delete[] p;
+			return;
+		}
+		auto iter = slabs_.upper_bound(p);
+		assert(iter != slabs_.begin());
+		Slab* slab = (--iter)->second;
+		assert(slab->slot_size == class_size && p < slab->begin + slab_size_);
+		*reinterpret_cast<char**>(p) = slab->free_list;
+		slab->free_list = p;
+		free_bytes_ += class_size;
+		std::vector<Slab*>& partial = partial_slabs_[class_size];
+		if (slab->used-- == slab->capacity) {
+			partial.push_back(slab);
+		}
+		// 空的slab只在它是这一级唯一有空闲slot的slab时保留，避免分配和释放交替时反复映射；
+		// 这一级还有别的slab可以分配时立即还给系统。分配总是先用完已有的slab，所以每一级最多一个空的slab
+		if (slab->used == 0 && partial.size() > 1) {
+			partial.erase(std::find(partial.begin(), partial.end(), slab));
+			slabs_.erase(iter);
+			free_bytes_ -= SlabBytes(slab);
+			FreeSlab(slab);
+		}
+	}
+
+	size_t MemoryUsage() const override {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return memory_usage_;
+	}
+	size_t HugePageUsage() const override {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return huge_page_usage_;
+	}
+	size_t FreeBytes() const override {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return free_bytes_;
+	}
+
+private:
+	// 一个大页切成大小相同的slot，释放的slot串在slab自己的free list上，slot的前8字节存放下一个slot
+	struct Slab {
+		char* begin;
+		size_t mapped_bytes;	// 为0时是new出来的
+		bool hugetlb;
+		size_t slot_size;
+		size_t capacity;	// slot的个数
+		size_t carved = 0;	// 从头开始切出去过的slot个数，之后的还没有用过
+		size_t used = 0;	// 正在使用的slot个数
+		char* free_list = nullptr;
+	};
+
+	Slab* NewSlab(size_t class_size) {
+		Slab* slab = new Slab();
+		slab->begin = AllocateHugePages(slab_size_, slab_size_, &slab->mapped_bytes, &slab->hugetlb);
+		if (slab->begin == nullptr) {
+			slab->begin = new char[slab_size_];
+			slab->mapped_bytes = 0;
+			slab->hugetlb = false;
+		}
+		slab->slot_size = class_size;
+		slab->capacity = slab_size_ / class_size;
+		slabs_[slab->begin] = slab;
+		memory_usage_ += SlabBytes(slab);
+		huge_page_usage_ += slab->hugetlb ? slab->mapped_bytes : 0;
+		// slab末尾切不出一个slot的部分也算作空闲
+		free_bytes_ += SlabBytes(slab);
+		return slab;
+	}
+
+	void FreeSlab(Slab* slab) {
+		memory_usage_ -= SlabBytes(slab);
+		huge_page_usage_ -= slab->hugetlb ? slab->mapped_bytes : 0;
+		if (slab->mapped_bytes > 0) {
+			FreeHugePages(slab->begin, slab->mapped_bytes);
+		} else {
+			delete[] slab->begin;
+		}
+		delete slab;
+	}
+
+	size_t SlabBytes(const Slab* slab) const {
+		return slab->mapped_bytes > 0 ? slab->mapped_bytes : slab_size_;
+	}
+
+	const size_t slab_size_;
+	// 超过这个大小的block不放在slab中，保证每个slab至少能切出8个slot
+	const size_t max_class_size_;
+	mutable std::mutex mutex_;
+	// 按起始地址排序，释放时找到内存所在的slab
+	std::map<char*, Slab*> slabs_;
+	// 每一级还有空闲slot的slab，分配时从最后一个取
+	std::unordered_map<size_t, std::vector<Slab*>> partial_slabs_;
+	size_t memory_usage_ = 0;
+	size_t huge_page_usage_ = 0;
+	size_t free_bytes_ = 0;
+};
+}  // namespace
+
+std::shared_ptr<MemoryAllocator> NewHugePageAllocator(size_t huge_page_size) {
+	return std::make_shared<HugePageAllocator>(huge_page_size);
+}
+
+}
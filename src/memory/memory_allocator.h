@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <memory>
+
+#include "huge_page.h"
+
+namespace tinykv {
+// block cache中block数据的内存分配器，通过Cache的构造函数设置，所有线程共用，实现必须是线程安全的
+class MemoryAllocator {
+public:
+	virtual ~MemoryAllocator() = default;
+	virtual const char* Name() const = 0;
+	virtual char* Allocate(size_t size) = 0;
+	// size必须和Allocate时相同
+	virtual void Deallocate(char* p, size_t size) = 0;
+	// 从系统申请的内存，包括已经释放、等待复用的部分
+	virtual size_t MemoryUsage() const = 0;
+	// 其中用MAP_HUGETLB映射的字节数
+	virtual size_t HugePageUsage() const = 0;
+	// 其中没有分配出去的字节数，MemoryUsage()减去它是正在使用的block占用的内存(包括取整浪费的部分)
+	virtual size_t FreeBytes() const = 0;
+};
+
+/**
+ * @brief
+ * 按大小分级分配block：256字节以内按64字节取整，之后每个2的幂次区间分成4级，取整浪费不超过1/4。
+ * 每一级从若干个slab(一个大页)中切出大小相同的slot，释放的slot给同一级之后的block复用，
+ * block cache中的block大小都接近Options::block_size，基本落在相邻的几级中。
+ * slab中的slot全部释放之后，如果这一级还有别的slab有空闲的slot就立即归还系统，否则留给之后的分配，
+ * 所以每一级最多一个空的slab，空闲的内存不会超过还有block在使用的slab加上每级一个slab。
+ * 超过大页1/8的block不进slab，直接new/delete。大页不可用时slab退回普通的内存，见AllocateHugePages
+ */
+std::shared_ptr<MemoryAllocator> NewHugePageAllocator(size_t huge_page_size = kDefaultHugePageSize);
+
+}
@@ -0,0 +1,225 @@
+#include "memtable_rep.h"
+#include "skiplist.h"
+#include "../include/tinykv/slice_transform.h"
+#include "../utils/hash_util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+namespace tinykv {
+namespace {
+// 桶中的链表超过这么多条记录之后，之后的记录写入这个桶的跳表，链表太长时查找要逐个比较
+static const uint32_t kListThreshold = 32;
+// 桶中跳表的最大高度，头节点只有8个指针；按1/4的概率升高，几万条记录以内都能保持O(log n)
+static const int32_t kBucketSkipListHeight = 8;
+
+class HashSkipListRep final : public MemTableRep {
+public:
+	HashSkipListRep(const MemTableKeyComparator& comparator, ConcurrentArena* arena,
+			const SliceTransform* prefix_extractor, size_t bucket_count)
+		: comparator_(comparator)
+		, arena_(arena)
+		, prefix_extractor_(prefix_extractor)
+		, bucket_count_(bucket_count) {
+		char* mem = arena_->AllocateAligned(sizeof(std::atomic<Bucket*>) * bucket_count_);
+		buckets_ = reinterpret_cast<std::atomic<Bucket*>*>(mem);
+		for (size_t i = 0; i < bucket_count_; i++) {
+			new (&buckets_[i]) std::atomic<Bucket*>(nullptr);
+		}
+	}
+
+	void Insert(const char* entry) override { InsertImpl(entry, false); }
+
+	void InsertConcurrently(const char* entry) override { InsertImpl(entry, true); }
+
+	void Get(const LookupKey& key, void* arg,
+		 bool (*callback)(void* arg, const char* entry)) override {
+		// 同一个用户键的所有版本都在这个桶中，桶中其他的记录只是哈希冲突
+		Bucket* bucket = buckets_[GetHash(key.user_key())].load(std::memory_order_acquire);
+		if (bucket == nullptr) {
+			return;
+		}
+		const char* target = key.memtable_key().data();
+		// 链表和跳表各自有序，两边按顺序归并着交给callback
+		Node* node = bucket->head.load(std::memory_order_acquire);
+		while (node != nullptr && comparator_(node->key, target) < 0) {
+			node = node->Next();
+		}
+		BucketSkipList* skiplist = bucket->skiplist.load(std::memory_order_acquire);
+		BucketSkipList::Iterator iter(skiplist);
+		if (skiplist != nullptr) {
+			iter.Seek(target);
+		}
+		while (true) {
+			const bool list_valid = node != nullptr;
+			const bool skiplist_valid = skiplist != nullptr && iter.Valid();
+			if (!list_valid && !skiplist_valid) {
+				break;
+			}
+			if (list_valid && (!skiplist_valid || comparator_(node->key, iter.key()) < 0)) {
+				if (!callback(arg, node->key)) {
+					break;
+				}
+				node = node->Next();
+			} else {
+				if (!callback(arg, iter.key())) {
+					break;
+				}
+				iter.Next();
+			}
+		}
+	}
+
+	// 把所有桶中的记录收集起来排好序，之后写入的记录不会出现在迭代器中
+	MemTableRep::Iterator* GetIterator() override {
+		auto entries = std::make_shared<std::vector<const char*>>();
+		for (size_t i = 0; i < bucket_count_; i++) {
+			Bucket* bucket = buckets_[i].load(std::memory_order_acquire);
+			if (bucket == nullptr) {
+				continue;
+			}
+			for (Node* node = bucket->head.load(std::memory_order_acquire); node != nullptr;
+			     node = node->Next()) {
+				entries->push_back(node->key);
+			}
+			BucketSkipList* skiplist = bucket->skiplist.load(std::memory_order_acquire);
+			if (skiplist != nullptr) {
+				BucketSkipList::Iterator iter(skiplist);
+				for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+					entries->push_back(iter.key());
+				}
+			}
+		}
+		std::sort(entries->begin(), entries->end(),
+			  [this](const char* a, const char* b) { return comparator_(a, b) < 0; });
+		return NewSortedVectorIterator(std::move(entries), comparator_);
+	}
+
+private:
+	typedef SkipList<const char*, MemTableKeyComparator, ConcurrentArena> BucketSkipList;
+
+	// 链表节点，只有记录指针和next指针两个字段
+	struct Node {
+		explicit Node(const char* k) : key(k) {}
+		Node* Next() const { return next.load(std::memory_order_acquire); }
+
+		const char* const key;
+		std::atomic<Node*> next{nullptr};
+	};
+
+	// 桶在第一条记录写入时才创建。记录先按顺序插入链表，链表中的记录超过kListThreshold条之后，
+	// 之后的记录写入低高度的跳表。链表不会转换成跳表，所以插入链表不需要和转换同步，
+	// 已经写入的记录也不会移动，读者只要把两边归并起来
+	struct Bucket {
+		std::atomic<Node*> head{nullptr};
+		std::atomic<uint32_t> list_size{0};
+		std::atomic<BucketSkipList*> skiplist{nullptr};
+	};
+
+	static Slice GetInternalKey(const char* entry) {
+		uint32_t len;
+		const char* p = GetVarint32Ptr(entry, entry + 5, &len);
+		return Slice(p, len);
+	}
+
+	size_t GetHash(const Slice& user_key) const {
+		Slice hash_key = user_key;
+		if (prefix_extractor_ != nullptr && prefix_extractor_->InDomain(user_key)) {
+			hash_key = prefix_extractor_->Transform(user_key);
+		}
+		return hash_util::SimMurMurHash(hash_key.data(), hash_key.size()) % bucket_count_;
+	}
+
+	void InsertImpl(const char* entry, bool concurrent) {
+		Bucket* bucket = GetOrCreateBucket(ExtractUserKey(GetInternalKey(entry)));
+		// 超过阈值之前可能有多个线程同时拿到名额，链表会比kListThreshold稍长一点，没有影响
+		if (bucket->list_size.load(std::memory_order_relaxed) < kListThreshold &&
+		    bucket->list_size.fetch_add(1, std::memory_order_relaxed) < kListThreshold) {
+			InsertIntoList(bucket, entry);
+			return;
+		}
+		BucketSkipList* skiplist = GetOrCreateSkipList(bucket);
+		if (concurrent) {
+			skiplist->InsertConcurrently(entry);
+		} else {
+			skiplist->Insert(entry);
+		}
+	}
+
+	// 只有插入没有删除，找到插入位置之后用CAS接到链表上，失败说明前驱后面插入了新节点，从前驱继续找
+	void InsertIntoList(Bucket* bucket, const char* entry) {
+		Node* node = new (arena_->AllocateAligned(sizeof(Node))) Node(entry);
+		std::atomic<Node*>* link = &bucket->head;
+		Node* next = link->load(std::memory_order_acquire);
+		while (true) {
+			while (next != nullptr && comparator_(next->key, entry) < 0) {
+				link = &next->next;
+				next = link->load(std::memory_order_acquire);
+			}
+			node->next.store(next, std::memory_order_relaxed);
+			if (link->compare_exchange_weak(next, node, std::memory_order_release,
+							std::memory_order_acquire)) {
+				return;
+			}
+		}
+	}
+
+	// 节点、桶和跳表都只保存指针，内存都在arena中，不需要析构
+	// 并发插入时其他线程可能已经创建了同一个对象，用它创建的，自己的留在arena中浪费掉
+	Bucket* GetOrCreateBucket(const Slice& user_key) {
+		std::atomic<Bucket*>& slot = buckets_[GetHash(user_key)];
+		Bucket* bucket = slot.load(std::memory_order_acquire);
+		if (bucket != nullptr) {
+			return bucket;
+		}
+		Bucket* created = new (arena_->AllocateAligned(sizeof(Bucket))) Bucket();
+		if (slot.compare_exchange_strong(bucket, created, std::memory_order_acq_rel)) {
+			return created;
+		}
+		return bucket;
+	}
+
+	BucketSkipList* GetOrCreateSkipList(Bucket* bucket) {
+		BucketSkipList* skiplist = bucket->skiplist.load(std::memory_order_acquire);
+		if (skiplist != nullptr) {
+			return skiplist;
+		}
+		BucketSkipList* created = new (arena_->AllocateAligned(sizeof(BucketSkipList)))
+			BucketSkipList(comparator_, arena_, kBucketSkipListHeight);
+		if (bucket->skiplist.compare_exchange_strong(skiplist, created,
+							     std::memory_order_acq_rel)) {
+			return created;
+		}
+		return skiplist;
+	}
+
+	const MemTableKeyComparator comparator_;
+	ConcurrentArena* const arena_;
+	const SliceTransform* const prefix_extractor_;
+	const size_t bucket_count_;
+	std::atomic<Bucket*>* buckets_;	// 还没有记录的桶为nullptr
+};
+
+class HashSkipListRepFactory final : public MemTableRepFactory {
+public:
+	explicit HashSkipListRepFactory(size_t bucket_count)
+		: bucket_count_(bucket_count > 0 ? bucket_count : 1) {}
+
+	const char* Name() const override { return "HashSkipListRepFactory"; }
+	MemTableRep* CreateMemTableRep(const MemTableKeyComparator& comparator,
+				       ConcurrentArena* arena,
+				       const SliceTransform* prefix_extractor) override {
+		return new HashSkipListRep(comparator, arena, prefix_extractor, bucket_count_);
+	}
+
+private:
+	const size_t bucket_count_;
+};
+}  // namespace
+
+std::shared_ptr<MemTableRepFactory> NewHashSkipListRepFactory(size_t bucket_count) {
+	return std::make_shared<HashSkipListRepFactory>(bucket_count);
+}
+
+}
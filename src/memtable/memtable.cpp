@@ -1,5 +1,6 @@
 #include "memtable.h"
 #include "memtable_iterator.h"
+#include "../db/merge_context.h"
 
 #include <stdlib.h>
 
@@ -15,29 +16,31 @@ static Slice GetLengthPrefixedSlice(const char* data) {
   p = GetVarint32Ptr(p, p + 5, &len);  //  +5是因为Varint32最长是5个字节，这样比较保险
   return Slice(p, len);
 }
-MemTable::MemTable(const InternalKeyComparator& Comparator)
-	: comparator_(Comparator), refs_(0), table_(comparator_) {}
+MemTable::MemTable(const InternalKeyComparator& Comparator, size_t huge_page_size,
+		   MemTableRepFactory* rep_factory, const SliceTransform* prefix_extractor)
+	: comparator_(Comparator), refs_(0), arena_(Arena::kBlockSize, huge_page_size)
+	, num_range_del_(0) {
+	SkipListRepFactory skiplist_factory;
+	if (rep_factory == nullptr) {
+		rep_factory = &skiplist_factory;
+	}
+	table_.reset(rep_factory->CreateMemTableRep(comparator_, &arena_, prefix_extractor));
+	// 范围删除需要按顺序切分，总是放在跳表中
+	range_del_table_.reset(skiplist_factory.CreateMemTableRep(comparator_, &arena_, nullptr));
+}
 
 MemTable::~MemTable() { assert(refs_ == 0); }
 
 size_t MemTable::ApproximateMemoryUsage() {
-	return alloc_.MemoryUsage();
-}
-// 重载了运算符()，比较的两个对象是const char*类型， 这里一个buf存储一条记录
-// 记录的存储格式是[内部键长度(varint32)][internalkey][值长度(varint32)][value]
-int MemTable::KeyComparator::operator()(const char* aptr, const char* bptr) const {
-	// 比较前就要先提取内部键然后在用InternalKeyComparator比较就可以了
-	Slice a = GetLengthPrefixedSlice(aptr);
-	Slice b = GetLengthPrefixedSlice(bptr);
-	return comparator.Compare(a, b);
+	return arena_.MemoryUsage() + table_->ApproximateMemoryUsage();
 }
-
 Iterator* MemTable::NewIterator() {
-	return new MemTableIterator(&table_);
+	return new MemTableIterator(table_->GetIterator());
 }
 
 // 向MemTable中添加记录
-void MemTable::Add(SequenceNumber seq, ValueType type, const Slice& key, const Slice& value) {
+void MemTable::Add(SequenceNumber seq, ValueType type, const Slice& key, const Slice& value,
+		   bool concurrent) {
 	// 因为存储到SkipList中的内容是把用户的键和值进行编码后的值, 
 	// 格式为[内部键长度(varint32)][internalkey][值长度(varint32)][value]
 	// 下面是具体的编码实现
@@ -51,7 +54,7 @@ void MemTable::Add(SequenceNumber seq, ValueType type, const Slice& key, const S
 	const size_t encoded_len = VarintLength(internal_key_size) + internal_key_size + 
 				VarintLength(value_size) + value_size;
 	// 使用内存分配器分配内存
-	char* buf = (char*)alloc_.Allocate(encoded_len);
+	char* buf = arena_.Allocate(encoded_len);
 	// 先存放InternalKey的长度，编码成Varint32
 	char* p = EncodeVarint32(buf, internal_key_size);
 	// 接着存放内部键
@@ -64,63 +67,140 @@ void MemTable::Add(SequenceNumber seq, ValueType type, const Slice& key, const S
 	// 存放value
 	memcpy(p, value.data(), value_size);
 	assert(p + value_size == buf + encoded_len);
-	table_.Insert(buf);
+	MemTableRep* table = (type == kTypeRangeDeletion) ? range_del_table_.get() : table_.get();
+	if (concurrent) {
+		table->InsertConcurrently(buf);
+	} else {
+		table->Insert(buf);
+	}
+	if (type == kTypeRangeDeletion) {
+		num_range_del_.fetch_add(1, std::memory_order_release);
+	}
+	num_entries_.fetch_add(1, std::memory_order_release);
 }
+
+Iterator* MemTable::NewRangeTombstoneIterator() {
+	if (num_range_del_.load(std::memory_order_acquire) == 0) {
+		return nullptr;
+	}
+	return new MemTableIterator(range_del_table_->GetIterator());
+}
+
+std::shared_ptr<const FragmentedRangeTombstoneList> MemTable::GetRangeTombstones() {
+	const size_t count = num_range_del_.load(std::memory_order_acquire);
+	if (count == 0) {
+		return nullptr;
+	}
+	std::lock_guard<std::mutex> lock(range_del_mutex_);
+	if (range_del_fragments_ == nullptr || range_del_fragments_count_ != count) {
+		// 切分期间可能有新的范围删除写入，多读到的部分不影响正确性，下次再重新切分
+		std::vector<RangeTombstone> tombstones;
+		MemTableIterator iter(range_del_table_->GetIterator());
+		CollectRangeTombstones(&iter, kMaxSequenceNumber, &tombstones);
+		range_del_fragments_ = std::make_shared<const FragmentedRangeTombstoneList>(
+			comparator_.comparator.user_comparator(), std::move(tombstones));
+		range_del_fragments_count_ = count;
+	}
+	return range_del_fragments_;
+}
+namespace {
+// MemTable::Get交给MemTableRep::Get的回调参数
+struct Saver {
+	const LookupKey* key;
+	const Comparator* user_comparator;
+	// 覆盖这个key的范围删除中对读操作可见的最大顺序号
+	SequenceNumber covering_seq;
+	std::string* value;
+	DBStatus* status;
+	MergeContext* merge_context;
+	// 已经确定了结果: 找到了value，或者key已经被删除
+	bool found;
+};
+}  // namespace
+
+// 处理一条记录，还需要继续看同一个用户键更旧的版本时返回true
+static bool SaveValue(void* arg, const char* entry) {
+	Saver* saver = reinterpret_cast<Saver*>(arg);
+	// 一个结点的结构如下所示
+	// entry format is:
+	//    klength  varint32
+	//    userkey  char[klength]
+	//    tag      uint64
+	//    vlength  varint32
+	//    value    char[vlength]
+	// Check that it belongs to same user key.  We do not check the
+	// sequence number since the Seek() call above should have skipped
+	// all entries with overly large sequence numbers.
+	// 通过Varint32解码InternalKey的长度
+	uint32_t key_length;
+	// 取出klength，并将key_ptr指到klength之后
+	const char* key_ptr = GetVarint32Ptr(entry, entry+5, &key_length);
+	// 接下来就用用户提供的键比较器(BytewiseComparator)比较用户键，因为Seek不是准确定位
+	// 毕竟他也没法准确定位，因为他不知道顺序号，所以要比较一下用户键是否相同
+	// 比较结点中的userkey和LookupKey中的userkey是否相等，如果相等，说明找到了这个结点
+	if (saver->user_comparator->Compare(Slice(key_ptr, key_length-8),
+					    saver->key->user_key()) != 0) {
+		return false;
+	}
+	// 获取tag， tag等于(sequence<<8)|type
+	const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
+	if ((tag >> 8) < saver->covering_seq) {
+		// 这个版本在范围删除之前写入，已经被删除了
+		*saver->status = Status::kNotFound;
+		saver->found = true;
+		return false;
+	}
+	// 取出type并判断
+	switch (static_cast<ValueType>(tag & 0xff)) {
+		case kTypeValue : {
+			// 取出value的大小和内容
+			Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+			saver->value->assign(v.data(), v.size());
+			saver->found = true;
+			return false;
+		}
+		case kTypeDeletion:
+			*saver->status = Status::kNotFound;
+			saver->found = true;
+			return false;
+		case kTypeMerge:
+			// 遇到merge操作数时把它收集起来，继续往后找同一个用户键更旧的版本
+			saver->merge_context->PushOperand(GetLengthPrefixedSlice(key_ptr + key_length));
+			return true;
+		default:
+			return true;
+	}
+}
+
 // 从MemTable获取对象，此时的键是LookupKey类型
 // 如果能找到key对应的value, 将该value存储到*value参数中，返回值为true。
 // 如果这个key中的有删除标识,存放一个NotFound()错误到*status参数中，返回值为true。
 // 否则返回值为false
-bool MemTable::Get(const LookupKey& key, std::string* value, DBStatus* s) {
-	// 获取MemTable的键
-	// 得到memkey，memkey中实际上包含了klength|userkey|tag，也就是说它包含了internal_key_size和internal_key
-	Slice memKey = key.memtable_key();
-	// 构造MemTable的迭代器
-	Table::Iterator iter(&table_);
-	// 定位到键的位置，那么问题来了，我们知道存储在MemTabled的键是InternalKey，而InternalKey里面包含顺序号
-	// 在前面代码中我们知道，InternalKey的比较顺序号是参与比较的，那么获取对象的时候如何知道对象的顺序号的呢？
-	// 其实LookupKey里面的保存的顺序号是“顺序号最大值”,而MemTable迭代器Seek定位的是第一个比指定键大或者等于的对象
-	// InternalKey的比较顺序号越大越靠前，所以需要找的对象肯定会排在迭代器指的位置，所以需要接下来就要校验用户键
-	// 找到SkipList中大于等于memkey的第一个节点
-	iter.Seek(memKey.data());
-	if (iter.Valid()) {
-		// 获取对象值
-		// 一个结点的结构如下所示
-		// entry format is:
-		//    klength  varint32
-		//    userkey  char[klength]
-		//    tag      uint64
-		//    vlength  varint32
-		//    value    char[vlength]
-		// Check that it belongs to same user key.  We do not check the
-		// sequence number since the Seek() call above should have skipped
-		// all entries with overly large sequence numbers.
-		const char* entry = iter.key();
-		// 通过Varint32解码InternalKey的长度
-		uint32_t key_length;
-		// 取出klength，并将key_ptr指到klength之后
-		const char* key_ptr = GetVarint32Ptr(entry, entry+5, &key_length);
-		// 接下来就用用户提供的键比较器(BytewiseComparator)比较用户键，因为SkipList的Seek不是准确定位
-        	// 毕竟他也没法准确定位，因为他不知道顺序号，所以要比较一下用户键是否相同
-		// 比较结点中的userkey和LookupKey中的userkey是否相等，如果相等，说明找到了这个结点
-		if (comparator_.comparator.user_comparator()->Compare(
-			Slice(key_ptr, key_length-8),
-			key.user_key()) == 0) {
-			// 获取tag， tag等于(sequence<<8)|type
-			const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
-			// 取出type并判断
-			switch (static_cast<ValueType>(tag & 0xff)) {
-				case kTypeValue : {
-					// 取出value的大小和内容
-					Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
-					value->assign(v.data(), v.size());
-					return true;
-				}
-				case kTypeDeletion:
-					// *s = Status::NotFound(Slice());
-					*s = Status::kNotFound;
-					return true;
-			}
-		}
+// 比找到的版本更新的merge操作数按从新到旧的顺序加入merge_context，由调用者合并
+bool MemTable::Get(const LookupKey& key, std::string* value, DBStatus* s,
+		   MergeContext* merge_context) {
+	Saver saver;
+	saver.key = &key;
+	saver.user_comparator = comparator_.comparator.user_comparator();
+	saver.covering_seq = 0;
+	saver.value = value;
+	saver.status = s;
+	saver.merge_context = merge_context;
+	saver.found = false;
+	if (num_range_del_.load(std::memory_order_acquire) > 0) {
+		saver.covering_seq = GetRangeTombstones()->MaxCoveringSeq(key.user_key(), key.sequence());
+	}
+	// 我们知道存储在MemTable的键是InternalKey，而InternalKey里面包含顺序号
+	// InternalKey的比较顺序号是参与比较的，那么获取对象的时候如何知道对象的顺序号的呢？
+	// 其实LookupKey里面的保存的顺序号是“顺序号最大值”,而MemTableRep::Get从第一个大于等于memtable_key的记录开始
+	// InternalKey的比较顺序号越大越靠前，所以需要找的对象肯定会排在这个位置之后，所以SaveValue中要校验用户键
+	table_->Get(key, &saver, &SaveValue);
+	if (saver.found) {
+		return true;
+	}
+	if (saver.covering_seq > 0) {
+		*s = Status::kNotFound;
+		return true;
 	}
 	return false;
 }
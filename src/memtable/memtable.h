@@ -2,18 +2,30 @@
 
 // #include "memtable_iterator.h"
 #include "../db/dbformat.h"
-#include "../memory/alloc.h"
+#include "../db/range_tombstone.h"
+#include "../memory/arena.h"
 #include "../include/tinykv/iterator.h"
-#include "skiplist.h"
+#include "memtable_rep.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
 
 namespace tinykv {
+class MergeContext;
+
 class MemTable {
 public:
 	// 构造函数，需要提供IternalKeyComparator的对象，
 	// 这说明在MemTable中是通过InternalKey进行排序的
-	explicit MemTable(const InternalKeyComparator& Comparator);
+	// huge_page_size大于0时arena_用大页映射，见Options::memtable_huge_page_size
+	// rep_factory决定普通记录的存放方式(见Options::memtable_factory)，为nullptr时用跳表，
+	// prefix_extractor交给rep_factory，可以为nullptr
+	explicit MemTable(const InternalKeyComparator& Comparator, size_t huge_page_size = 0,
+			  MemTableRepFactory* rep_factory = nullptr,
+			  const SliceTransform* prefix_extractor = nullptr);
 	MemTable(MemTable&) = delete;
-	MemTable& opertor=(const MemTable&) = delete;
+	MemTable& operator=(const MemTable&) = delete;
 	// 自己实现智能指针 => 此处注意面试
 	void Ref() { ++refs_; }
 	void Unref() {
@@ -25,14 +37,32 @@ public:
 		}
 	}
 	// 评估一下当前的内存使用量， 不能无限制的使用下去， 到了一定量就要写入sst了
+	// 记录和跳表节点都从arena_中分配，统计的是实际分配出去的全部内存，加上MemTableRep在arena_之外的内存
 	size_t ApproximateMemoryUsage();
+	// 用MAP_HUGETLB映射的内存大小
+	size_t HugePageUsage() const { return arena_.HugePageUsage(); }
+	// 已经写入的记录条数(包括范围删除)，为0时memtable是空的
+	uint64_t NumEntries() const { return num_entries_.load(std::memory_order_acquire); }
 	// 创建迭代器，用来遍历MemTable中的对象
 	Iterator* NewIterator();
 	// 向MemTable中添加对象，提供了用户指定的键和值，同时还提供了顺序号和值类型，说明顺序号是上级别产生的
 	// 如果是删除操作，value应该没有任何值
-	void Add(SequenceNumber seq, ValueType type, const Slice& key, const Slice& value);
+	// concurrent为true时可以和其他concurrent为true的Add在多个线程中同时调用
+	void Add(SequenceNumber seq, ValueType type, const Slice& key, const Slice& value,
+		 bool concurrent = false);
+	// 不会再有写入的memtable在刷盘之前调用，MemTableRep可以在这里把记录排好序(见NewVectorRepFactory)
+	// 可以和Get、NewIterator同时调用，重复调用没有影响
+	void MarkImmutable() { table_->MarkReadOnly(); }
 	// 有写就得有读，提供的是查询键，输出对象值和状态，并返回是否成功
-	bool Get(const LookupKey& key, std::string* value, DBStatus* s);
+	// key被这个memtable中的范围删除覆盖时也返回true，*s为kNotFound，因为更旧的数据都已经被删除了
+	// 找到的版本之前的merge操作数加入merge_context，返回true时由调用者合并到找到的value上(kNotFound时没有旧值)，
+	// 返回false时更旧的版本要继续到immutable memtable和sst中找
+	bool Get(const LookupKey& key, std::string* value, DBStatus* s,
+		 MergeContext* merge_context);
+	// 范围删除和普通数据分开存放，没有范围删除时返回nullptr
+	Iterator* NewRangeTombstoneIterator();
+	// 切分好的范围删除，只在有新的范围删除写入之后才重新切分，没有范围删除时返回nullptr
+	std::shared_ptr<const FragmentedRangeTombstoneList> GetRangeTombstones();
 
 private:
 	// 设计模式，迭代器模式，C++ STL中容器和迭代器就是使用了迭代器模式，参考https://blog.csdn.net/weixin_45465612/article/details/118076401
@@ -40,19 +70,22 @@ private:
 	// 私有的析构函数，要求使用者只能通过Unref()释放对象
 	~MemTable();
 	// 自定义比较器， 说明在InternalKey基础上又进行了扩展，但最终还是通过InternalKeyComparator实现的比较
-	struct KeyComparator {
-		const InternalKeyComparator comparator;
-		explicit KeyComparator(const InternalKeyComparator& c) : comparator(c) {}
-		// 重载operator()，说明KeyComparator是一个函数对象
-		int operator()(const char* a, const char* b) const;
-	};
-	// 表是用SkipList(跳表)实现的
-	typedef SkipList<const char*, KeyComparator, SimpleFreeListAlloc> Table;
-	// 成员变量包括：比较器、引用计数、内存管理和跳表
+	typedef MemTableKeyComparator KeyComparator;
+	// 成员变量包括：比较器、引用计数、内存管理和存放记录的MemTableRep
 	KeyComparator comparator_;
 	int refs_;
-	SimpleFreeListAlloc alloc_;
-	Table table_;
+	// 必须在MemTableRep之前构造、之后析构，MemTableRep在构造时就会从arena_中分配内存
+	ConcurrentArena arena_;
+	// 多个写线程可能同时插入，MemTableRep必须支持InsertConcurrently
+	std::unique_ptr<MemTableRep> table_;
+	// kTypeRangeDeletion的记录单独放在一个跳表中，点查和迭代普通数据时不需要跳过它们
+	std::unique_ptr<MemTableRep> range_del_table_;
+	std::atomic<size_t> num_range_del_;
+	std::atomic<uint64_t> num_entries_{0};
+	// 保护下面两个成员，缓存最近一次切分的结果
+	std::mutex range_del_mutex_;
+	std::shared_ptr<const FragmentedRangeTombstoneList> range_del_fragments_;
+	size_t range_del_fragments_count_ = 0;
 };
 
 }
\ No newline at end of file
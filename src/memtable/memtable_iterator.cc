@@ -18,16 +18,16 @@ static Slice GetLengthPrefixedSlice(const char* data) {
 }
 
 void MemTableIterator::Seek(const Slice& k)  { 
-	iter_.Seek(EncodeKey(&tmp_, k)); 
+	iter_->Seek(EncodeKey(&tmp_, k)); 
 }
 
 // 获取值
 Slice MemTableIterator::key() const { 
-	return GetLengthPrefixedSlice(iter_.key()); 
+	return GetLengthPrefixedSlice(iter_->key()); 
 }
 	// 获取值
 Slice MemTableIterator::value() const {
-	Slice key_slice = GetLengthPrefixedSlice(iter_.key());
+	Slice key_slice = GetLengthPrefixedSlice(iter_->key());
 	return GetLengthPrefixedSlice(key_slice.data() + key_slice.size());
 }
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "memtable.h"
 #include "../include/tinykv/iterator.h"
 
+#include <memory>
 #include <string>
 
 namespace tinykv {
@@ -25,28 +26,29 @@ namespace tinykv {
 
 class MemTableIterator : public Iterator {
 public:
-	explicit MemTableIterator(MemTable::Table* table) : iter_(table) {};
+	// 接管iter的所有权
+	explicit MemTableIterator(MemTableRep::Iterator* iter) : iter_(iter) {};
 
 	MemTableIterator(const MemTableIterator&) = delete;
 	MemTableIterator& operator=(const MemTableIterator&) = delete;
 
 	~MemTableIterator() override = default;
 
-	bool Valid() const override { return iter_.Valid(); }
+	bool Valid() const override { return iter_->Valid(); }
 	void Seek(const Slice& k) override;
-	void SeekToFirst() override { iter_.SeekToFirst(); }
-	void SeekToLast() override { iter_.SeekToLast(); }
-	void Next() override { iter_.Next(); }
-	void Prev() override { iter_.Prev(); }
+	void SeekToFirst() override { iter_->SeekToFirst(); }
+	void SeekToLast() override { iter_->SeekToLast(); }
+	void Next() override { iter_->Next(); }
+	void Prev() override { iter_->Prev(); }
 	// 获取值
-	Slice key() const;
+	Slice key() const override;
 	// 获取值
-	Slice value() const;
+	Slice value() const override;
 	// 这个迭代器永远返回争取是怎么个意思？估计这个接口没用
-    	virtual Status status() const { return Status::OK(); }
+	DBStatus status() const override { return Status::kSuccess; }
 
 private:
-	MemTable::Table::Iterator iter_;
+	std::unique_ptr<MemTableRep::Iterator> iter_;
 	std::string tmp_;
 };
 
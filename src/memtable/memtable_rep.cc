@@ -0,0 +1,114 @@
+#include "memtable_rep.h"
+#include "skiplist.h"
+
+#include <algorithm>
+
+namespace tinykv {
+// 提取记录中的内部键，data的格式是[内部键长度(varint32)][internalkey]...
+static Slice GetLengthPrefixedSlice(const char* data) {
+	uint32_t len;
+	const char* p = data;
+	p = GetVarint32Ptr(p, p + 5, &len);  // +5是因为Varint32最长是5个字节
+	return Slice(p, len);
+}
+
+// 比较前先提取内部键，然后再用InternalKeyComparator比较
+int MemTableKeyComparator::operator()(const char* aptr, const char* bptr) const {
+	Slice a = GetLengthPrefixedSlice(aptr);
+	Slice b = GetLengthPrefixedSlice(bptr);
+	return comparator.Compare(a, b);
+}
+
+namespace {
+class SkipListRep final : public MemTableRep {
+public:
+	SkipListRep(const MemTableKeyComparator& comparator, ConcurrentArena* arena)
+		: table_(comparator, arena) {}
+
+	void Insert(const char* entry) override { table_.Insert(entry); }
+	void InsertConcurrently(const char* entry) override { table_.InsertConcurrently(entry); }
+
+	void Get(const LookupKey& key, void* arg,
+		 bool (*callback)(void* arg, const char* entry)) override {
+		Table::Iterator iter(&table_);
+		for (iter.Seek(key.memtable_key().data()); iter.Valid() && callback(arg, iter.key());
+		     iter.Next()) {
+		}
+	}
+
+	MemTableRep::Iterator* GetIterator() override { return new Iterator(&table_); }
+
+private:
+	typedef SkipList<const char*, MemTableKeyComparator, ConcurrentArena> Table;
+
+	class Iterator final : public MemTableRep::Iterator {
+	public:
+		explicit Iterator(const Table* table) : iter_(table) {}
+		bool Valid() const override { return iter_.Valid(); }
+		const char* key() const override { return iter_.key(); }
+		void Next() override { iter_.Next(); }
+		void Prev() override { iter_.Prev(); }
+		void Seek(const char* memtable_key) override { iter_.Seek(memtable_key); }
+		void SeekToFirst() override { iter_.SeekToFirst(); }
+		void SeekToLast() override { iter_.SeekToLast(); }
+
+	private:
+		Table::Iterator iter_;
+	};
+
+	Table table_;
+};
+
+class SortedVectorIterator final : public MemTableRep::Iterator {
+public:
+	SortedVectorIterator(std::shared_ptr<const std::vector<const char*>> entries,
+			     const MemTableKeyComparator& comparator)
+		: entries_(std::move(entries))
+		, comparator_(comparator)
+		, pos_(entries_->size()) {}
+
+	bool Valid() const override { return pos_ < entries_->size(); }
+	const char* key() const override {
+		assert(Valid());
+		return (*entries_)[pos_];
+	}
+	void Next() override {
+		assert(Valid());
+		pos_++;
+	}
+	void Prev() override {
+		assert(Valid());
+		// 已经是第一条记录时变为无效
+		pos_ = (pos_ == 0) ? entries_->size() : pos_ - 1;
+	}
+	void Seek(const char* memtable_key) override {
+		pos_ = std::lower_bound(entries_->begin(), entries_->end(), memtable_key,
+					[this](const char* a, const char* b) {
+						return comparator_(a, b) < 0;
+					}) - entries_->begin();
+	}
+	void SeekToFirst() override { pos_ = 0; }
+	void SeekToLast() override {
+		pos_ = entries_->empty() ? 0 : entries_->size() - 1;
+	}
+
+private:
+	const std::shared_ptr<const std::vector<const char*>> entries_;
+	const MemTableKeyComparator comparator_;
+	size_t pos_;	// 等于entries_->size()时无效
+};
+}  // namespace
+
+MemTableRep* SkipListRepFactory::CreateMemTableRep(const MemTableKeyComparator& comparator,
+						   ConcurrentArena* arena,
+						   const SliceTransform* /*prefix_extractor*/) {
+	return new SkipListRep(comparator, arena);
+}
+
+MemTableRep::Iterator* NewSortedVectorIterator(
+	std::shared_ptr<const std::vector<const char*>> entries,
+	const MemTableKeyComparator& comparator) {
+	return new SortedVectorIterator(std::move(entries), comparator);
+}
+
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <memory>
+#include <vector>
+
+#include "../db/dbformat.h"
+#include "../memory/arena.h"
+
+namespace tinykv {
+class SliceTransform;
+
+// 比较两条memtable记录，记录的格式是[内部键长度(varint32)][internalkey][值长度(varint32)][value]，
+// 按其中的InternalKey排序
+struct MemTableKeyComparator {
+	const InternalKeyComparator comparator;
+	explicit MemTableKeyComparator(const InternalKeyComparator& c) : comparator(c) {}
+	// 重载operator()，说明MemTableKeyComparator是一个函数对象
+	int operator()(const char* a, const char* b) const;
+};
+
+/**
+ * @brief
+ * memtable中记录的存放方式，记录由MemTable编码好并从它的arena中分配，MemTableRep只保存指针。
+ * 默认是跳表，点查多的场景可以换成按用户键哈希分桶的HashSkipListRep。
+ */
+class MemTableRep {
+public:
+	// 按InternalKey的顺序遍历记录
+	class Iterator {
+	public:
+		virtual ~Iterator() = default;
+		virtual bool Valid() const = 0;
+		// 当前的记录，REQUIRES: Valid()
+		virtual const char* key() const = 0;
+		virtual void Next() = 0;
+		virtual void Prev() = 0;
+		// 定位到第一个大于等于memtable_key的记录，memtable_key是LookupKey::memtable_key()的格式
+		virtual void Seek(const char* memtable_key) = 0;
+		virtual void SeekToFirst() = 0;
+		virtual void SeekToLast() = 0;
+	};
+
+	virtual ~MemTableRep() = default;
+
+	virtual void Insert(const char* entry) = 0;
+	// 和Insert相同，但是可以在多个线程中同时调用
+	virtual void InsertConcurrently(const char* entry) = 0;
+	// 从第一个大于等于key.memtable_key()的记录开始按顺序把记录交给callback，直到callback返回false或者没有记录
+	// 只保证能遍历到和key的用户键相同的记录，之后的记录可能被跳过
+	virtual void Get(const LookupKey& key, void* arg,
+			 bool (*callback)(void* arg, const char* entry)) = 0;
+	// 遍历全部记录，使用者负责delete
+	virtual Iterator* GetIterator() = 0;
+	// memtable变成只读，之后不会再有Insert，刷盘之前调用，可以在这里把记录整理好
+	virtual void MarkReadOnly() {}
+	// 不在arena中分配的内存，计入memtable的内存使用量
+	virtual size_t ApproximateMemoryUsage() { return 0; }
+};
+
+// 创建MemTableRep，通过Options::memtable_factory设置，所有memtable共用
+class MemTableRepFactory {
+public:
+	virtual ~MemTableRepFactory() = default;
+	virtual const char* Name() const = 0;
+	// 记录和MemTableRep自己的内存都从arena中分配，arena比返回的MemTableRep活得更久
+	// prefix_extractor是Options::prefix_extractor，可能为nullptr
+	virtual MemTableRep* CreateMemTableRep(const MemTableKeyComparator& comparator,
+					       ConcurrentArena* arena,
+					       const SliceTransform* prefix_extractor) = 0;
+};
+
+// 默认的跳表，点查、插入和有序遍历都是O(log n)
+class SkipListRepFactory final : public MemTableRepFactory {
+public:
+	const char* Name() const override { return "SkipListRepFactory"; }
+	MemTableRep* CreateMemTableRep(const MemTableKeyComparator& comparator,
+				       ConcurrentArena* arena,
+				       const SliceTransform* prefix_extractor) override;
+};
+
+/**
+ * @brief
+ * 按用户键的哈希分成bucket_count个桶，只保存哈希到这个桶的记录。
+ * 设置了prefix_extractor时按前缀哈希，前缀相同的key在同一个桶中；否则按完整的用户键哈希，
+ * 同一个用户键的所有版本在同一个桶中，点查只需要在很小的桶中查找，平均O(1)。
+ * 每个桶先是一个有序链表，超过32条记录之后，之后的记录写入这个桶的低高度跳表，点查时两边归并。
+ * 有序遍历(包括刷盘)时把所有桶中的记录合并排好序，代价是O(n log n)，适合点查多、范围查询少的场景。
+ * 内存开销都从arena中分配，计入memtable的内存使用量(即写满write_buffer_size的速度)：
+ * 桶数组在memtable创建时分配，每个桶8字节，默认50000个桶是400KB，空的memtable也要占用；
+ * 每个非空的桶24字节，链表中的每条记录16字节，每个桶的跳表(超过32条记录才创建)约130字节。
+ * bucket_count取每个memtable中不同用户键(或前缀)数量的量级，太大时桶数组挤占写缓冲，太小时链表变长。
+ */
+std::shared_ptr<MemTableRepFactory> NewHashSkipListRepFactory(size_t bucket_count = 50000);
+
+/**
+ * @brief
+ * 记录直接追加到一个无序的数组中，插入只是加锁后push_back，适合批量导入时只写不读的场景。
+ * memtable变成只读(MarkReadOnly)时最多用sort_threads个线程排序一次(为0时取CPU核数)，
+ * 每个线程至少分到16K条记录，刷盘时直接按顺序遍历排好序的数组。
+ * 排序之前的点查持有锁扫描整个数组，每次O(n)并且期间阻塞所有写入；迭代器需要复制一份再排序，
+ * 都不适合边写边读。
+ * 数组本身的内存不在arena中，通过MemTableRep::ApproximateMemoryUsage计入memtable的大小。
+ */
+std::shared_ptr<MemTableRepFactory> NewVectorRepFactory(size_t sort_threads = 0);
+
+// 遍历排好序的记录，HashSkipListRep等有序遍历时先把记录排好序的MemTableRep使用
+MemTableRep::Iterator* NewSortedVectorIterator(
+	std::shared_ptr<const std::vector<const char*>> entries,
+	const MemTableKeyComparator& comparator);
+
+}
@@ -5,7 +5,9 @@
 #include <atomic>
 #include <assert.h>
 #include <stdint.h>
+#include <functional>
 #include <iostream>
+#include <thread>
 
 namespace tinykv{
 struct SkipListOption {
@@ -18,12 +20,18 @@ class SkipList final{
 private: 
 	struct Node;
 public:
-	explicit SkipList(_KeyComparator comparator);
+	// 节点的内存从arena中分配，arena由使用者持有，生命周期要比SkipList长
+	// max_height限制节点的最大高度，头节点有max_height个指针，记录少的跳表可以用更小的高度节省内存
+	SkipList(_KeyComparator comparator, _Allocator* arena,
+		 int32_t max_height = SkipListOption::kMaxHeight);
 
 	SkipList(const SkipList&) = delete;
 	SkipList& operator=(const SkipList&) = delete;
 
 	void Insert(const _Key& key);
+	// 和Insert相同，但是可以在多个线程中同时调用，每一层都用CAS把新节点接到链表上
+	// 同一个SkipList不能同时使用Insert和InsertConcurrently，_Allocator必须是线程安全的
+	void InsertConcurrently(const _Key& key);
 
 	bool Contains(const _Key& key) const;
 	// 判断两个键是否相等，实现比较简单
@@ -89,11 +97,11 @@ private:
 	// 随机的获取一个高度，本文不打算对这个"随机"做分析，所以暂时做到了解就可以
 	int32_t RandomHeight();
 	// 获取当前跳跃表的当前最大高度
-	inline int32_t GetMaxHeight() { return cur_height_.load(std::memory_order_relaxed); }
+	inline int32_t GetMaxHeight() const { return cur_height_.load(std::memory_order_relaxed); }
 	// 判断key是不是大于节点n的key，也就意味着如果存在key的节点，那么就会在节点n的后面
-	bool KeyIsAfterNode(const _Key& key, Node* n) {
+	bool KeyIsAfterNode(const _Key& key, Node* n) const {
 		// 所以实现方式就是键的比较
-		return (nullptr != n && comparator_.Compare(n->key, key) < 0);
+		return (nullptr != n && comparator_(n->key, key) < 0);
 	}
 	/**
 	 * 该函数的含义为：在跳表中查找不小于给定 Key 的第一个值，如果没有找到，则返回 nullptr。
@@ -102,7 +110,10 @@ private:
 	 * 若要插入数据，则需传入一个合适尺寸的 prev 参数。
 	 */
 	// 找到第一个大于等于给定的键的节点，通过跳跃的方式查找
-	Node* FindGreaterOrEqual(const _Key& key, Node**prev);
+	Node* FindGreaterOrEqual(const _Key& key, Node**prev) const;
+	// 从before开始在第level层查找key的插入位置，before必须比key小，*out_prev < key <= *out_next
+	void FindSpliceForLevel(const _Key& key, Node* before, int level,
+				Node** out_prev, Node** out_next) const;
 	// 返回第一个比key小的节点，通过跳跃的方式查找
 	Node* FindLessThan(const _Key& key) const;
 	// 返回skiplist的最后一个节点
@@ -110,10 +121,10 @@ private:
 
 private: 
 	_KeyComparator comparator_;	// 比较器
-	_Allocator arena_;		// 内存管理对象
+	_Allocator* const arena_;	// 内存管理对象，和MemTable共用，节点占用的内存也计入memtable的内存使用量
+	const int32_t max_height_;	// 节点的最大高度，不超过SkipListOption::kMaxHeight
 	Node* head_ = nullptr;		// skiplist头节点
 	std::atomic<int32_t> cur_height_;// 跳跃表的当前最大高度
-	RandomUtil rnd_;		// 随机数生成器
 };
 
 // 实现SkipList的Node结构
@@ -138,7 +149,7 @@ struct SkipList<_Key, _KeyComparator, _Allocator>::Node
 		assert(n >= 0);
 		// std::memory_order_release：用在 store 时，保证同线程中该 store 之后的对相关内存的读写语句不会被重排到 store 之前，
 		// 并且该线程的所有修改对用了 load acquire 的其他线程都可见。
-		next_[n].store(std::memory_order_release);
+		next_[n].store(x, std::memory_order_release);
 	}
 
 	// 不带内存屏障版本的访问器。内存屏障（Barrier）是个形象的说法，也即加一块挡板，阻止重排/进行同步
@@ -153,6 +164,11 @@ struct SkipList<_Key, _KeyComparator, _Allocator>::Node
 		assert(n >= 0);
 		next_[n].store(x, std::memory_order_relaxed);
 	}
+	// 高度为n的下一个节点仍然是expected时才设置成x，并发插入时用来检测其他线程是否已经修改了链表
+	bool CASNext(int n, Node* expected, Node* x) {
+		assert(n >= 0);
+		return next_[n].compare_exchange_strong(expected, x);
+	}
 private:
 	// 指针数组的长度即为该节点的 level，next_[0] 是最低层指针.
 	// 很多人看到这里懵逼了把？怎么只有一个元素的数组，上面的访问可都是按照最高高度访问的，这个是一个非常有意思的地方了
@@ -169,10 +185,10 @@ template <typename _Key, typename _KeyComparator, typename _Allocator>
 typename SkipList<_Key, _KeyComparator, _Allocator>::Node* 
 	SkipList<_Key, _KeyComparator, _Allocator>::NewNode(const _Key& key, int32_t height)
 {
-	// TODO: 将Allocate替换成AllocateAligned
 	// 首先内存申请不是malloc，而是通过arena申请的，每个Node的大小很小，非常适合arena
+	// Node中是std::atomic<Node*>，必须按指针大小对齐，所以用AllocateAligned
     	// sizeof(port::AtomicPointer) * (height - 1)就是为了扩展指针数组用的
-	char* node_memory = (char*)arena_.Allocate(
+	char* node_memory = (char*)arena_->AllocateAligned(
 		sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1));
 	// 使用定位new，在刚分配好的空间node_memory处构造一个Node对象
 	return new (node_memory) Node(key);
@@ -184,10 +200,13 @@ typename SkipList<_Key, _KeyComparator, _Allocator>::Node*
 template <typename _Key, typename _KeyComparator, typename _Allocator>
 int32_t SkipList<_Key, _KeyComparator, _Allocator>::RandomHeight()
 {
+	// 并发插入时每个线程使用自己的随机数生成器，种子取线程id的哈希，避免各个线程生成相同的高度序列
+	static thread_local RandomUtil rnd(static_cast<uint32_t>(
+		std::hash<std::thread::id>()(std::this_thread::get_id())));
 	// // 每次以 1/SkipListOption::kBranching 的概率增加层数
 	int32_t height = 1;
-	while (height < SkipListOption::kMaxHeight &&
-		((rnd_.GetSimpleRandomNum() % SkipListOption::kBranching) == 0)) {
+	while (height < max_height_ &&
+		((rnd.GetRandomNum() % SkipListOption::kBranching) == 0)) {
 	height++;
 	}
 	return height;
@@ -195,7 +214,7 @@ int32_t SkipList<_Key, _KeyComparator, _Allocator>::RandomHeight()
 // 找到第一个大于等于给定的键的节点，通过跳跃的方式查找
 template <typename _Key, typename _KeyComparator, typename _Allocator>
 typename SkipList<_Key, _KeyComparator, _Allocator>::Node* 
-	SkipList<_Key, _KeyComparator, _Allocator>::FindGreaterOrEqual(const _Key& key, Node**prev)
+	SkipList<_Key, _KeyComparator, _Allocator>::FindGreaterOrEqual(const _Key& key, Node**prev) const
 {
 	Node* cur = head_;		// 从头节点开始查找
 	int level = GetMaxHeight() - 1; //从最高层开始查找
@@ -217,6 +236,23 @@ typename SkipList<_Key, _KeyComparator, _Allocator>::Node*
 		}
 	}
 }
+template <typename _Key, typename _KeyComparator, typename _Allocator>
+void SkipList<_Key, _KeyComparator, _Allocator>::FindSpliceForLevel(const _Key& key, Node* before,
+								     int level, Node** out_prev,
+								     Node** out_next) const
+{
+	Node* cur = before;
+	while (true) {
+		Node* next = cur->Next(level);
+		if (KeyIsAfterNode(key, next)) {
+			cur = next;
+		} else {
+			*out_prev = cur;
+			*out_next = next;
+			return;
+		}
+	}
+}
 // 返回第一个比key小的节点，通过跳跃的方式查找
 template <typename _Key, typename _KeyComparator, typename _Allocator>
 typename SkipList<_Key, _KeyComparator, _Allocator>::Node* 
@@ -228,7 +264,7 @@ typename SkipList<_Key, _KeyComparator, _Allocator>::Node*
 		// 相应高度的下一个节点
 		Node* next = cur->Next(level);
 		// 如果没有节点或者节点比给定的键大，那就降低一个高度
-		int cmp = (next == nullptr) ? 1 : comparator_.Compare(next->key, key);
+		int cmp = (next == nullptr) ? 1 : comparator_(next->key, key);
 		if(cmp >= 0){
 			// 如果已经是最低高度了，那当前的节点就是要找的节点了
 			if(level == 0){
@@ -268,11 +304,15 @@ typename SkipList<_Key, _KeyComparator, _Allocator>::Node*
 }
 
 template <typename _Key, typename _KeyComparator, typename _Allocator>
-	SkipList<_Key, _KeyComparator, _Allocator>::SkipList(_KeyComparator comparator)
+	SkipList<_Key, _KeyComparator, _Allocator>::SkipList(_KeyComparator comparator, _Allocator* arena,
+							     int32_t max_height)
 	: comparator_(comparator)
-	, cur_height_(1)
-	, head_(NewNode(0, SkipListOption::kMaxHeight)) {
-		for(int i = 0; i < SkipListOption::kMaxHeight; i++) {
+	, arena_(arena)
+	, max_height_(max_height)
+	, head_(NewNode(0, max_height))
+	, cur_height_(1) {
+		assert(max_height > 0 && max_height <= SkipListOption::kMaxHeight);
+		for(int i = 0; i < max_height_; i++) {
 			head_->SetNext(i, nullptr);
 		}
 }
@@ -325,6 +365,44 @@ void SkipList<_Key, _KeyComparator, _Allocator>::Insert(const _Key& key)
 		prev[index]->SetNext(index, new_node);
 	}
 }
+
+template <typename _Key, typename _KeyComparator, typename _Allocator>
+void SkipList<_Key, _KeyComparator, _Allocator>::InsertConcurrently(const _Key& key)
+{
+	int new_level = RandomHeight();
+	// 最大高度只能增加，CAS失败时max_level被更新成其他线程设置的高度，直到不需要再增加为止
+	int max_level = GetMaxHeight();
+	while (new_level > max_level) {
+		if (cur_height_.compare_exchange_weak(max_level, new_level)) {
+			max_level = new_level;
+			break;
+		}
+	}
+	// 从高到低逐层找插入位置，下一层从上一层的前驱节点开始找
+	Node* prev[SkipListOption::kMaxHeight];
+	Node* next[SkipListOption::kMaxHeight];
+	Node* before = head_;
+	for (int level = max_level - 1; level >= 0; level--) {
+		FindSpliceForLevel(key, before, level, &prev[level], &next[level]);
+		before = prev[level];
+	}
+	// 顺序号保证memtable中不会有重复的key，这里只是防御，不在无锁的路径上打印
+	if (next[0] != nullptr && Equal(key, next[0]->key)) {
+		return;
+	}
+	Node* new_node = NewNode(key, new_level);
+	// 和Insert一样从最底层开始连接，保证在某一层能看到的节点在下面所有层都能看到
+	for (int level = 0; level < new_level; level++) {
+		while (true) {
+			new_node->NoBarrier_SetNext(level, next[level]);
+			if (prev[level]->CASNext(level, next[level], new_node)) {
+				break;
+			}
+			// 其他线程在prev和next之间插入了节点，节点不会被删除，所以prev仍然比key小，从prev开始重新找
+			FindSpliceForLevel(key, prev[level], level, &prev[level], &next[level]);
+		}
+	}
+}
  // 判断跳跃表中是否有指定的数据，等同于std::map.find()
 template <typename _Key, typename _KeyComparator, typename _Allocator>
 bool SkipList<_Key, _KeyComparator, _Allocator>::Contains(const _Key& key) const
@@ -348,7 +426,7 @@ inline bool SkipList<_Key, _KeyComparator, _Allocator>::Iterator::Valid() const
 }
 
 template <typename _Key, typename _KeyComparator, typename _Allocator>
-inline _Key& SkipList<_Key, _KeyComparator, _Allocator>::Iterator::key() const 
+inline const _Key& SkipList<_Key, _KeyComparator, _Allocator>::Iterator::key() const 
 {
 	// 从这里来看，需要使用者再使用前必须通过Valid()判断一下，否则就要接受崩溃的后果了
 	assert(Valid());
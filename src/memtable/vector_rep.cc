@@ -0,0 +1,177 @@
+#include "memtable_rep.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace tinykv {
+namespace {
+// 每个排序线程至少分到这么多条记录，记录少时线程的开销比排序本身还大
+static const size_t kMinEntriesPerThread = 16 * 1024;
+
+class VectorRep final : public MemTableRep {
+public:
+	VectorRep(const MemTableKeyComparator& comparator, size_t sort_threads)
+		: comparator_(comparator)
+		, sort_threads_(sort_threads > 0 ? sort_threads
+						 : std::max(1u, std::thread::hardware_concurrency()))
+		, entries_(std::make_shared<Entries>()) {}
+
+	void Insert(const char* entry) override {
+		std::lock_guard<std::mutex> l(mutex_);
+		assert(!sorted_);
+		entries_->push_back(entry);
+		memory_usage_.store(entries_->capacity() * sizeof(const char*),
+				    std::memory_order_relaxed);
+	}
+
+	void InsertConcurrently(const char* entry) override { Insert(entry); }
+
+	void Get(const LookupKey& key, void* arg,
+		 bool (*callback)(void* arg, const char* entry)) override {
+		std::unique_ptr<MemTableRep::Iterator> iter;
+		{
+			std::lock_guard<std::mutex> l(mutex_);
+			if (sorted_) {
+				iter.reset(NewSortedVectorIterator(entries_, comparator_));
+			} else {
+				// 还没有排序，持有锁扫描整个数组，把用户键相同的记录挑出来，排好序之后再查找
+				// 扫描期间所有的Insert都要等待，所以这个memtable只适合只写不读的批量导入
+				const Comparator* user_comparator = comparator_.comparator.user_comparator();
+				auto matched = std::make_shared<Entries>();
+				for (const char* entry : *entries_) {
+					if (user_comparator->Compare(ExtractUserKey(GetInternalKey(entry)),
+								     key.user_key()) == 0) {
+						matched->push_back(entry);
+					}
+				}
+				iter.reset(SortedIterator(std::move(matched)));
+			}
+		}
+		for (iter->Seek(key.memtable_key().data()); iter->Valid() && callback(arg, iter->key());
+		     iter->Next()) {
+		}
+	}
+
+	// 排好序之后迭代器直接共享数组；之前的迭代器复制一份自己排序，之后写入的记录不会出现在迭代器中
+	MemTableRep::Iterator* GetIterator() override {
+		std::shared_ptr<Entries> entries;
+		{
+			std::lock_guard<std::mutex> l(mutex_);
+			if (sorted_) {
+				return NewSortedVectorIterator(entries_, comparator_);
+			}
+			entries = std::make_shared<Entries>(*entries_);
+		}
+		return SortedIterator(std::move(entries));
+	}
+
+	void MarkReadOnly() override {
+		std::shared_ptr<Entries> sorted;
+		{
+			std::lock_guard<std::mutex> l(mutex_);
+			if (sorted_) {
+				return;
+			}
+			sorted = std::make_shared<Entries>(*entries_);
+		}
+		// 在副本上排序，排序期间的点查还可以用原来的数组，不会被阻塞
+		ParallelSort(sorted.get());
+		std::lock_guard<std::mutex> l(mutex_);
+		entries_ = std::move(sorted);
+		sorted_ = true;
+	}
+
+	size_t ApproximateMemoryUsage() override {
+		return memory_usage_.load(std::memory_order_relaxed);
+	}
+
+private:
+	typedef std::vector<const char*> Entries;
+
+	static Slice GetInternalKey(const char* entry) {
+		uint32_t len;
+		const char* p = GetVarint32Ptr(entry, entry + 5, &len);
+		return Slice(p, len);
+	}
+
+	bool Less(const char* a, const char* b) const { return comparator_(a, b) < 0; }
+
+	MemTableRep::Iterator* SortedIterator(std::shared_ptr<Entries> entries) const {
+		std::sort(entries->begin(), entries->end(),
+			  [this](const char* a, const char* b) { return Less(a, b); });
+		return NewSortedVectorIterator(std::move(entries), comparator_);
+	}
+
+	// 先把数组切成若干段，每段由一个线程排序，再两两归并，归并同样由多个线程同时进行
+	void ParallelSort(Entries* entries) const {
+		auto less = [this](const char* a, const char* b) { return Less(a, b); };
+		const size_t n = entries->size();
+		size_t parts = std::min(sort_threads_, n / kMinEntriesPerThread);
+		if (parts <= 1) {
+			std::sort(entries->begin(), entries->end(), less);
+			return;
+		}
+		std::vector<size_t> bounds;
+		for (size_t i = 0; i <= parts; i++) {
+			bounds.push_back(n * i / parts);
+		}
+		auto begin = entries->begin();
+		std::vector<std::thread> threads;
+		for (size_t i = 1; i < parts; i++) {
+			threads.emplace_back([&, i]() {
+				std::sort(begin + bounds[i], begin + bounds[i + 1], less);
+			});
+		}
+		std::sort(begin + bounds[0], begin + bounds[1], less);
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		// 每一轮把相邻的两段归并成一段，段数减半
+		for (size_t width = 1; width < parts; width *= 2) {
+			threads.clear();
+			for (size_t i = 0; i + width < parts; i += 2 * width) {
+				const size_t last = std::min(i + 2 * width, parts);
+				threads.emplace_back([&, i, width, last]() {
+					std::inplace_merge(begin + bounds[i], begin + bounds[i + width],
+							   begin + bounds[last], less);
+				});
+			}
+			for (auto& thread : threads) {
+				thread.join();
+			}
+		}
+	}
+
+	const MemTableKeyComparator comparator_;
+	// 排序最多使用的线程数
+	const size_t sort_threads_;
+	// 保护entries_和sorted_，排序之后entries_不再修改，读者拿到shared_ptr之后不需要加锁
+	std::mutex mutex_;
+	std::shared_ptr<Entries> entries_;
+	bool sorted_ = false;
+	std::atomic<size_t> memory_usage_{0};
+};
+
+class VectorRepFactory final : public MemTableRepFactory {
+public:
+	explicit VectorRepFactory(size_t sort_threads) : sort_threads_(sort_threads) {}
+
+	const char* Name() const override { return "VectorRepFactory"; }
+	MemTableRep* CreateMemTableRep(const MemTableKeyComparator& comparator,
+				       ConcurrentArena* /*arena*/,
+				       const SliceTransform* /*prefix_extractor*/) override {
+		return new VectorRep(comparator, sort_threads_);
+	}
+
+private:
+	const size_t sort_threads_;
+};
+}  // namespace
+
+std::shared_ptr<MemTableRepFactory> NewVectorRepFactory(size_t sort_threads) {
+	return std::make_shared<VectorRepFactory>(sort_threads);
+}
+
+}
@@ -3,6 +3,7 @@
 #include "data_block.h"
 
 #include <memory>
+#include <string.h>
 
 namespace tinykv {
 
@@ -16,6 +17,32 @@ DataBlock::DataBlock(const std::string_view& contents)
 	: data_(contents.data())
 	, size_(contents.size())
 	, owned_(false) {
+	Init();
+}
+
+DataBlock::DataBlock(std::string&& contents)
+	: owned_(true)
+	, contents_(std::move(contents)) {
+	data_ = contents_.data();
+	size_ = contents_.size();
+	Init();
+}
+
+DataBlock::DataBlock(const std::string_view& contents, std::shared_ptr<MemoryAllocator> allocator)
+	: data_(nullptr)
+	, size_(contents.size())
+	, owned_(true)
+	, allocator_(std::move(allocator)) {
+	if (size_ > 0) {
+		alloc_size_ = size_;
+		char* buf = allocator_->Allocate(size_);
+		memcpy(buf, contents.data(), size_);
+		data_ = buf;
+	}
+	Init();
+}
+
+void DataBlock::Init() {
 	if (size_ < sizeof(uint32_t)) {
 		size_ = 0; // Error marker
 	} else {
@@ -32,7 +59,12 @@ DataBlock::DataBlock(const std::string_view& contents)
 	}
 }
 
-DataBlock::~DataBlock() {};
+DataBlock::~DataBlock() {
+	// Init()可能把size_改成0表示block损坏，这里要用分配时的大小
+	if (allocator_ != nullptr && data_ != nullptr) {
+		allocator_->Deallocate(const_cast<char*>(data_), alloc_size_);
+	}
+}
 
 static inline const char* DecodeEntry(const char* p, const char* limit,
 					uint32_t* shared, uint32_t* non_shared, uint32_t* value_length) {
@@ -88,10 +120,11 @@ private:
 	// 因为有共享前缀，需要存储中间恢复的 Key，而 value_ 可以直接从 data_ 中截取。
 	std::string key_;
 	std::string value_;	
-	DBStatus status_;
+	DBStatus status_ = Status::kSuccess;
 
+	// key中可能含有'\0'(比如InternalKey的顺序号部分)，所以必须带上长度构造Slice
 	inline int Compare(const std::string_view& a, const std::string_view& b) {
-		return comparator_->Compare(a.data(), b.data());
+		return comparator_->Compare(Slice(a.data(), a.size()), Slice(b.data(), b.size()));
 	}
 
 	// Return the offset in data_ just past the end of the current entry.
@@ -277,6 +310,61 @@ private:
 	}
 };
 
+bool DataBlock::Seek(const Comparator* comparator, const Slice& target,
+		     std::string* key, Slice* value, DBStatus* status) const {
+	if (size_ < sizeof(uint32_t)) {
+		*status = Status::kCorruption;
+		return false;
+	}
+	const uint32_t num_restarts = NumRestarts();
+	if (num_restarts == 0) {
+		return false;
+	}
+	const char* const limit = data_ + restart_offset_;
+	auto restart_point = [this](uint32_t index) {
+		return DecodeFixed32(data_ + restart_offset_ + index * sizeof(uint32_t));
+	};
+
+	// 在重启点中二分查找最后一个key < target的重启点，重启点处的key是完整保存的
+	uint32_t left = 0;
+	uint32_t right = num_restarts - 1;
+	uint32_t shared, non_shared, value_length;
+	while (left < right) {
+		const uint32_t mid = (left + right + 1) / 2;
+		const char* key_ptr = DecodeEntry(data_ + restart_point(mid), limit, &shared,
+						  &non_shared, &value_length);
+		if (key_ptr == nullptr || shared != 0) {
+			*status = Status::kCorruption;
+			return false;
+		}
+		if (comparator->Compare(Slice(key_ptr, non_shared), target) < 0) {
+			left = mid;
+		} else {
+			right = mid - 1;
+		}
+	}
+
+	// 从重启点开始顺序查找第一个key >= target的entry
+	key->clear();
+	const char* p = data_ + restart_point(left);
+	while (p < limit) {
+		p = DecodeEntry(p, limit, &shared, &non_shared, &value_length);
+		if (p == nullptr || key->size() < shared) {
+			*status = Status::kCorruption;
+			return false;
+		}
+		key->resize(shared);
+		key->append(p, non_shared);
+		p += non_shared;
+		if (comparator->Compare(*key, target) >= 0) {
+			*value = Slice(p, value_length);
+			return true;
+		}
+		p += value_length;
+	}
+	return false;
+}
+
 Iterator* DataBlock::NewIterator(std::shared_ptr<Comparator> comparator) {
 	if (size_ < sizeof(uint32_t)) {
 		return NewErrorIterator(Status::kInterupt);
@@ -2,9 +2,11 @@
 
 #include <stdint.h>
 #include <string>
+#include <string_view>
 #include <memory>
 
 #include "../include/tinykv/iterator.h"
+#include "../memory/memory_allocator.h"
 
 namespace tinykv
 {
@@ -12,6 +14,10 @@ class Comparator;
 class DataBlock {
 public:
 	explicit DataBlock(const std::string_view& contents);
+	// 从文件中读出来的block由DataBlock自己持有，避免读取时的临时buffer析构后data_悬空
+	explicit DataBlock(std::string&& contents);
+	// 把contents复制到allocator分配的内存中，block cache设置了MemoryAllocator时使用
+	DataBlock(const std::string_view& contents, std::shared_ptr<MemoryAllocator> allocator);
 
 	DataBlock(const DataBlock&) = delete;
 	DataBlock& operator=(const DataBlock&) = delete;
@@ -19,6 +25,13 @@ public:
 	size_t size() const { return size_; }
 	Iterator* NewIterator(std::shared_ptr<Comparator> comparator);
 
+	// 点查使用: 找到第一个key >= target的entry，找到时返回true
+	// *key保存还原之后的完整key，*value直接指向block中的数据，block析构之后失效
+	// 和迭代器的Seek相比不需要在堆上分配迭代器，比较时也不会拷贝key
+	// 没找到或者block损坏时返回false，损坏时*status为kCorruption
+	bool Seek(const Comparator* comparator, const Slice& target,
+		  std::string* key, Slice* value, DBStatus* status) const;
+
 private:
 	// 为了实现在block内查找target entry，block定义了一个Iter的嵌套类，继承自虚基类Iterator
 	class Iter;
@@ -42,10 +55,15 @@ private:
 	 */
 
 	uint32_t NumRestarts() const;
+	void Init();
 
 	const char* data_;	// 包含了entrys、重启点数组和写在最后4bytes的重启点个数
 	size_t size_;	// 大小
 	uint32_t restart_offset_;    // offset in data_ of restart array
 	bool owned_;	// block是否存有数据的标志位，析构函数delete data时会判断
+	std::string contents_;	// owned_为true时，data_指向的就是这块内存
+	// 不为nullptr时data_从它分配，析构时归还
+	std::shared_ptr<MemoryAllocator> allocator_;
+	size_t alloc_size_ = 0;	// 从allocator_分配的大小
 };
 } // namespace tinykv
\ No newline at end of file
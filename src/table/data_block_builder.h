@@ -68,6 +68,9 @@ public:
 		return buffer_.size() + restarts_.size() * sizeof(uint32_t) + sizeof(uint32_t);
 	}
 
+	// 还没有写入任何record
+	bool Empty() const { return buffer_.empty(); }
+
 	const std::string& Data() { return buffer_; }
 	void Reset() {
 		restarts_.clear();
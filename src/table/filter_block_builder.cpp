@@ -5,6 +5,7 @@ namespace tinykv {
 FilterBlockBuilder::FilterBlockBuilder(const Options& options){
 	if(options.filter_policy) {
 		policy_filter_ = options.filter_policy.get();
+		prefix_extractor_ = options.prefix_extractor.get();
 	}
 }
 void FilterBlockBuilder::Add(const std::string_view& key) {
@@ -12,12 +13,13 @@ void FilterBlockBuilder::Add(const std::string_view& key) {
 		return;
 	}
 	datas_.emplace_back(key);
-}
-void FilterBlockBuilder::CreateFilter() {
-	if (!Available() || datas_.empty()) {
-		return;
+	const Slice k(key.data(), key.size());
+	if (prefix_extractor_ != nullptr && prefix_extractor_->InDomain(k)) {
+		const Slice prefix = prefix_extractor_->Transform(k);
+		if (prefixes_.empty() || Slice(prefixes_.back()) != prefix) {
+			prefixes_.push_back(prefix.ToString());
+		}
 	}
-  	policy_filter_->CreateFilter(&datas_[0], datas_.size());
 }
 bool FilterBlockBuilder::MayMatch(const std::string& key) {
 	if (key.empty() || !Available()) {
@@ -36,11 +38,15 @@ const std::string& FilterBlockBuilder::Data() {
 }
 void FilterBlockBuilder::Finish() {
 	if (Available() && !datas_.empty()) {
-		// 先构建布隆过滤器
-		CreateFilter();
-		// 序列化hash个数和bf本身数据
-		buffer_ = policy_filter_->Data();
-		PutFixed32(&buffer_, policy_filter_->GetMeta().hash_num);
+		// 每个sst单独构建过滤器，buffer_中是位图和hash个数
+		// FilterPolicy被所有sst共用，不能用它内部保存的位图
+		buffer_.clear();
+		if (prefixes_.empty()) {
+			policy_filter_->CreateFilter(&datas_[0], datas_.size(), &buffer_);
+		} else {
+			policy_filter_->CreateFilter(&datas_[0], datas_.size(), &prefixes_[0],
+						     prefixes_.size(), &buffer_);
+		}
 	}
 }
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include "../include/tinykv/filter_policy.h"
+#include "../include/tinykv/slice_transform.h"
 #include "../db/options.h"
 
 namespace tinykv {
@@ -10,8 +11,8 @@ class FilterBlockBuilder final {
 public: 
 	FilterBlockBuilder(const Options& options);
 	bool Available() { return policy_filter_ != nullptr; }
+	// 加入key，设置了prefix_extractor时同时加入key的前缀，key需要按顺序加入
 	void Add(const std::string_view& key);
-	void CreateFilter();
 	bool MayMatch(const std::string& key);
 	bool MayMatch(const std::string& key, const std::string& bf_datas);
 	const std::string& Data();
@@ -19,6 +20,9 @@ public:
 private:
 	std::string buffer_;
 	std::vector<std::string> datas_;
+	// key是有序的，前缀相同的key相邻，只需要和上一个前缀比较去重
+	std::vector<std::string> prefixes_;
 	FilterPolicy* policy_filter_ = nullptr;
+	const SliceTransform* prefix_extractor_ = nullptr;
 };
 }
\ No newline at end of file
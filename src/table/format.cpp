@@ -10,8 +10,20 @@ DBStatus ReadBlock(const FileReader* file, const ReadOptions& options, const Off
 	// 同时也要读取type和crc到buf中
 	buf.resize(offset_info.length + kBlockTrailerSize);
 	// kBlockTrailerSize就是每个block末端的五字节信息，包括压缩标志位和用于CRC校验的开销。
-	file->Read(offset_info.offset, offset_info.length + kBlockTrailerSize, &buf);
-	const char* data = buf.data();
+	DBStatus s = file->Read(offset_info.offset, offset_info.length + kBlockTrailerSize, &buf[0]);
+	if (s != Status::kSuccess) {
+		return s;
+	}
+	s = VerifyBlock(buf.data(), offset_info);
+	if (s != Status::kSuccess) {
+		return s;
+	}
+	// 校验完成后去掉trailer，调用方拿到的只有block本身的内容
+	buf.resize(offset_info.length);
+	return Status::kSuccess;
+}
+
+DBStatus VerifyBlock(const char* data, const OffSetInfo& offset_info) {
 	const uint32_t crc = crc32c::Unmask(DecodeFixed32(data + offset_info.length + 1));
 	const uint32_t actual = crc32c::Value(data, offset_info.length + 1);
 	if (crc != actual) {
@@ -23,7 +35,6 @@ DBStatus ReadBlock(const FileReader* file, const ReadOptions& options, const Off
       			LOG(tinykv::LogLevel::ERROR, "kSnappyCompression");
       			break;
     		default:
-     			LOG(tinykv::LogLevel::ERROR, "kNonCompress");
       			break;
   	}
 	return Status::kSuccess;
@@ -9,4 +9,6 @@
 
 namespace tinykv {
 DBStatus ReadBlock(const FileReader* file, const ReadOptions& options, const OffSetInfo& offset_info, std::string& buf);
+// 校验已经读到内存中的block，data指向block的开头，后面紧跟着kBlockTrailerSize字节的trailer
+DBStatus VerifyBlock(const char* data, const OffSetInfo& offset_info);
 }
\ No newline at end of file
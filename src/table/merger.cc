@@ -0,0 +1,204 @@
+#include "merger.h"
+#include "../include/tinykv/comparator.h"
+
+#include <utility>
+#include <vector>
+
+namespace tinykv {
+// 用败者树(tournament tree)维护所有child当前的key，n个child需要n-1个内部节点，
+// 每次Next/Prev之后只需要沿着移动的child到根的路径重新比较一遍，代价是log(n)次比较
+// 正向迭代时key小的胜出，反向迭代时key大的胜出，无效的child总是失败
+class MergingIterator : public Iterator {
+public:
+	MergingIterator(const Comparator* comparator, Iterator** children, int n)
+		: comparator_(comparator)
+		, children_(children, children + n)
+		, tree_(n)
+		, winners_(2 * n)
+		, current_(nullptr)
+		, direction_(kForward) {
+		assert(n >= 2);
+	}
+
+	~MergingIterator() override {
+		for (Iterator* child : children_) {
+			delete child;
+		}
+	}
+
+	bool Valid() const override { return current_ != nullptr; }
+
+	void SeekToFirst() override {
+		for (Iterator* child : children_) {
+			child->SeekToFirst();
+		}
+		direction_ = kForward;
+		Rebuild();
+	}
+
+	void SeekToLast() override {
+		for (Iterator* child : children_) {
+			child->SeekToLast();
+		}
+		direction_ = kReverse;
+		Rebuild();
+	}
+
+	void Seek(const Slice& target) override {
+		for (Iterator* child : children_) {
+			child->Seek(target);
+		}
+		direction_ = kForward;
+		Rebuild();
+	}
+
+	void Next() override {
+		assert(Valid());
+		// 保证所有的child都位于key()之后，如果之前是反向迭代的，
+		// 那么除了current_之外的child都要重新定位到第一个大于key()的位置，
+		// 之后所有child都变了，需要重建败者树
+		if (direction_ != kForward) {
+			for (Iterator* child : children_) {
+				if (child != current_) {
+					child->Seek(key());
+					if (child->Valid() && comparator_->Compare(key(), child->key()) == 0) {
+						child->Next();
+					}
+				}
+			}
+			direction_ = kForward;
+			current_->Next();
+			Rebuild();
+			return;
+		}
+		current_->Next();
+		Replay(tree_[0]);
+	}
+
+	void Prev() override {
+		assert(Valid());
+		// 和Next相反，保证所有的child都位于key()之前
+		if (direction_ != kReverse) {
+			for (Iterator* child : children_) {
+				if (child != current_) {
+					child->Seek(key());
+					if (child->Valid()) {
+						// child位于第一个>=key()的位置，向前走一步就是<key()
+						child->Prev();
+					} else {
+						// child中所有的key都比key()小，定位到最后一个
+						child->SeekToLast();
+					}
+				}
+			}
+			direction_ = kReverse;
+			current_->Prev();
+			Rebuild();
+			return;
+		}
+		current_->Prev();
+		Replay(tree_[0]);
+	}
+
+	Slice key() const override {
+		assert(Valid());
+		return current_->key();
+	}
+
+	Slice value() const override {
+		assert(Valid());
+		return current_->value();
+	}
+
+	DBStatus status() const override {
+		for (Iterator* child : children_) {
+			DBStatus s = child->status();
+			if (s != Status::kSuccess) {
+				return s;
+			}
+		}
+		return Status::kSuccess;
+	}
+
+private:
+	enum Direction { kForward, kReverse };
+
+	// child a是否胜过child b，key相同时正向取下标小的，反向取下标大的，
+	// 这样新的数据(memtable在前)总是先于旧的数据出现
+	bool Beats(int a, int b) const {
+		Iterator* x = children_[a];
+		Iterator* y = children_[b];
+		if (!x->Valid()) {
+			return false;
+		}
+		if (!y->Valid()) {
+			return true;
+		}
+		const int r = comparator_->Compare(x->key(), y->key());
+		if (direction_ == kForward) {
+			return r < 0 || (r == 0 && a < b);
+		} else {
+			return r > 0 || (r == 0 && a > b);
+		}
+	}
+
+	// 所有child都重新定位之后自底向上重建整棵树，需要n-1次比较
+	// 叶子i对应节点n+i，节点j的父节点是j/2，tree_[j]保存节点j上的败者，tree_[0]保存最终的胜者
+	void Rebuild() {
+		const int n = static_cast<int>(children_.size());
+		for (int i = 0; i < n; i++) {
+			winners_[n + i] = i;
+		}
+		for (int j = n - 1; j >= 1; j--) {
+			const int left = winners_[2 * j];
+			const int right = winners_[2 * j + 1];
+			if (Beats(right, left)) {
+				winners_[j] = right;
+				tree_[j] = left;
+			} else {
+				winners_[j] = left;
+				tree_[j] = right;
+			}
+		}
+		tree_[0] = winners_[1];
+		UpdateCurrent();
+	}
+
+	// 只有child i移动了，沿着它到根的路径和每个节点上的败者比较
+	void Replay(int i) {
+		const int n = static_cast<int>(children_.size());
+		int winner = i;
+		for (int j = (n + i) / 2; j >= 1; j /= 2) {
+			if (Beats(tree_[j], winner)) {
+				std::swap(tree_[j], winner);
+			}
+		}
+		tree_[0] = winner;
+		UpdateCurrent();
+	}
+
+	void UpdateCurrent() {
+		Iterator* winner = children_[tree_[0]];
+		current_ = winner->Valid() ? winner : nullptr;
+	}
+
+	const Comparator* comparator_;
+	std::vector<Iterator*> children_;
+	std::vector<int> tree_;
+	// 只在Rebuild时使用，保存每个节点上的胜者
+	std::vector<int> winners_;
+	Iterator* current_;
+	Direction direction_;
+};
+
+Iterator* NewMergingIterator(const Comparator* comparator, Iterator** children, int n) {
+	assert(n >= 0);
+	if (n == 0) {
+		return NewEmptyIterator();
+	} else if (n == 1) {
+		return children[0];
+	} else {
+		return new MergingIterator(comparator, children, n);
+	}
+}
+}
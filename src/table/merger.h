@@ -0,0 +1,13 @@
+#pragma once
+
+#include "../include/tinykv/iterator.h"
+
+namespace tinykv {
+class Comparator;
+
+// 把n个有序的迭代器合并成一个有序的迭代器，用于把memtable、immutable memtable
+// 和多个sst的迭代器合并在一起对外提供统一的视图
+// 返回的迭代器拥有children[0,n-1]的所有权，析构时会一起释放
+// 合并的结果不会去重，如果一个key在多个child中都存在，会出现多次
+Iterator* NewMergingIterator(const Comparator* comparator, Iterator** children, int n);
+}
@@ -6,19 +6,27 @@
 #include "../logger/log.h"
 #include "filter_block_builder.h"
 #include "../include/tinykv/comparator.h"
+#include "../include/tinykv/slice_transform.h"
 #include "../cache/cache.h"
 #include "two_level_iterator.h"
 #include "format.h"
 
 
+#include <atomic>
 #include <memory>
+#include <vector>
 
 namespace tinykv {
+// 每个打开的Table分配一个唯一的cache_id，保证不同sst文件中相同offset的block在block cache中不会冲突
+static std::atomic<uint64_t> g_next_cache_id{1};
+
 Table::Table(const Options* options, const FileReader* file_reader)
 	: options_(options)
 	, file_reader_(file_reader)
 {}
 
+Table::~Table() = default;
+
 // 打开SSTable时， 首先将index block读取出来
 // 用于后期查询key时，先通过内存中的index block来
 // 判断key在不在这个SSTable，然后再决定是否去读取对应的data block
@@ -30,7 +38,7 @@ DBStatus Table::Open(const Options& options, FileReader* file, uint64_t file_siz
 	std::string footer_space;
 	footer_space.resize(kEncodedLength);
 	// 将footer读出来， 用于解析其中的metaindex_block_handle和index_block_handle
-	auto status = file->Read(file_size - kEncodedLength, kEncodedLength, &footer_space);
+	auto status = file->Read(file_size - kEncodedLength, kEncodedLength, &footer_space[0]);
 	if (status != Status::kSuccess) {
 		return status;
 	}
@@ -39,12 +47,18 @@ DBStatus Table::Open(const Options& options, FileReader* file, uint64_t file_siz
 	FooterBuilder footer;
 	std::string st = footer_space;
 	status = footer.DecodeFrom(&st);
+	if (status != Status::kSuccess) {
+		return status;
+	}
 	std::string index_meta_data;
 	ReadOptions opt;
-	ReadBlock(file, opt, footer.GetIndexBlockMetaData(), index_meta_data);
-	// std::unique_ptr<DataBlock>index_block = std::make_unique<DataBlock>(index_meta_data);
+	status = ReadBlock(file, opt, footer.GetIndexBlockMetaData(), index_meta_data);
+	if (status != Status::kSuccess) {
+		return status;
+	}
 	*table = new Table(&options, file);
-	(*table)->index_block_ = std::make_unique<DataBlock>(index_meta_data);
+	(*table)->cache_id_ = g_next_cache_id.fetch_add(1, std::memory_order_relaxed);
+	(*table)->index_block_ = std::make_unique<DataBlock>(std::move(index_meta_data));
 	(*table)->ReadMeta(&footer);
 	return status;
 }
@@ -77,36 +91,55 @@ DBStatus Table::Open(const Options& options, FileReader* file, uint64_t file_siz
 // 2、取出meta block index
 // 3、读出meta block的真正内容
 void Table::ReadMeta(const FooterBuilder* footer) {
-	// 如果没有filter，那么也就不用读取了
-	if (options_->filter_policy == nullptr) {
+	// 没有任何meta block(没有filter也没有范围删除)时meta block index的长度为0
+	if (footer->GetFilterBlockMetaData().length == 0) {
 		return;
 	}
 	ReadOptions opt;
 	std::string filter_meta_data;
 	// 从meta block index index的位置读出meta block index
 	// 并把内容放到filer_meta_data中
-	ReadBlock(file_reader_, opt, footer->GetFilterBlockMetaData(), filter_meta_data);
-	//ReadBlock(footer->GetFilterBlockMetaData(), filter_meta_data);
-	std::string_view real_data(filter_meta_data.data(),
-                             footer->GetFilterBlockMetaData().length);
-	// 利用filter_meta_data生成meta block index
+	if (ReadBlock(file_reader_, opt, footer->GetFilterBlockMetaData(), filter_meta_data) !=
+	    Status::kSuccess) {
+		return;
+	}
 	// meta block index 的格式是
 	// ｜ filter.name | BlockHandle |
+	// ｜ tinykv.range_del | BlockHandle |
 	// ｜ 	compresstype 1 byte	|
 	// ｜	crc32 4 byte		|
-  	std::unique_ptr<DataBlock> meta = std::make_unique<DataBlock>(real_data);
+	std::unique_ptr<DataBlock> meta = std::make_unique<DataBlock>(std::move(filter_meta_data));
 
 	Iterator* iter = meta->NewIterator(std::make_shared<ByteComparator>());
-	std::string key = options_->filter_policy->Name();
-	// 这里key就是filter_policy的名字
-	// value就是BlockHandle
-	iter->Seek(key);
-	// 这里必须是iter->key() == key
-	if (iter->Valid() && iter->key() == key) {
-		// 得到BlockHandle之后，去读出filter block
-   		// filter block也就是meta block
-		LOG(tinykv::LogLevel::ERROR, "Hit Key=%s", key.data());
-		ReadFilter(iter->value().ToString());
+	if (options_->filter_policy != nullptr) {
+		std::string key = options_->filter_policy->Name();
+		// 这里key就是filter_policy的名字
+		// value就是BlockHandle
+		iter->Seek(key);
+		// 这里必须是iter->key() == key
+		if (iter->Valid() && iter->key() == key) {
+			// 得到BlockHandle之后，去读出filter block
+			// filter block也就是meta block
+			ReadFilter(iter->value().ToString());
+		}
+	}
+	if (options_->prefix_extractor != nullptr && !bf_.empty()) {
+		// 构建sst时的前缀规则和现在的相同，过滤器中的前缀才能用
+		iter->Seek(kPrefixExtractorName);
+		prefix_filtered_ = iter->Valid() && iter->key() == Slice(kPrefixExtractorName) &&
+				   iter->value() == Slice(options_->prefix_extractor->Name());
+	}
+	iter->Seek(kRangeDelBlockName);
+	if (iter->Valid() && iter->key() == Slice(kRangeDelBlockName)) {
+		OffSetInfo offset_size;
+		OffsetBuilder offset_builder;
+		offset_builder.Decode(iter->value().data(), offset_size);
+		std::string contents;
+		if (ReadBlock(file_reader_, opt, offset_size, contents) == Status::kSuccess) {
+			range_del_block_ = std::make_unique<DataBlock>(std::move(contents));
+		} else {
+			LOG(tinykv::LogLevel::ERROR, "read range del block failed");
+		}
 	}
 	delete iter;
 }
@@ -118,7 +151,6 @@ void Table::ReadFilter(const std::string& filter_handle_value) {
 	offset_builder.Decode(filter_handle_value.data(), offset_size);
 	ReadOptions opt;
 	ReadBlock(file_reader_, opt, offset_size, bf_);
-	bf_.resize(offset_size.length);
 }
 
 /**
@@ -142,23 +174,99 @@ static void DeleteBlock(void* arg, void* ignored) {
 
 // 删除cache中的block内存
 // 这个主要是用在当cache中的item被删除的时候，会被自动调用
-static void DeleteCachedBlock(const Slice& key, void* value) {
-	DataBlock* block = reinterpret_cast<DataBlock*>(value);
-	delete block;
+static void DeleteCachedBlock(const std::string& /*key*/, DataBlock* value) {
+	delete value;
 }
 
 // 从cache中移出去
 // 相当于是从map<x,Y>中移除一个item
 static void ReleaseBlock(void* arg, void* h) {
-	CacheNode<uint64_t, DataBlock>* node = reinterpret_cast<CacheNode<uint64_t, DataBlock>*>(arg);
-	Cache<uint64_t, DataBlock>* cache = reinterpret_cast<Cache<uint64_t, DataBlock>*>(arg);
+	Cache<std::string, DataBlock>* cache = reinterpret_cast<Cache<std::string, DataBlock>*>(arg);
+	CacheNode<std::string, DataBlock>* node = reinterpret_cast<CacheNode<std::string, DataBlock>*>(h);
 	cache->Release(node);
 }
+Iterator* Table::NewRangeTombstoneIterator() const {
+	if (range_del_block_ == nullptr) {
+		return nullptr;
+	}
+	return range_del_block_->NewIterator(options_->comparator);
+}
+
+namespace {
+// 前缀迭代时的sst迭代器，Seek的目标前缀不在过滤器中时不再交给底层的两级迭代器
+class PrefixCheckingIterator : public Iterator {
+public:
+	PrefixCheckingIterator(const Table* table, Iterator* iter) : table_(table), iter_(iter) {}
+	~PrefixCheckingIterator() override { delete iter_; }
+
+	bool Valid() const override { return !skipped_ && iter_->Valid(); }
+	void Seek(const Slice& target) override {
+		skipped_ = !table_->PrefixMayMatch(target);
+		if (!skipped_) {
+			iter_->Seek(target);
+		}
+	}
+	void SeekToFirst() override {
+		skipped_ = false;
+		iter_->SeekToFirst();
+	}
+	void SeekToLast() override {
+		skipped_ = false;
+		iter_->SeekToLast();
+	}
+	void Next() override {
+		assert(Valid());
+		iter_->Next();
+	}
+	void Prev() override {
+		assert(Valid());
+		iter_->Prev();
+	}
+	Slice key() const override { return iter_->key(); }
+	Slice value() const override { return iter_->value(); }
+	DBStatus status() const override { return iter_->status(); }
+
+private:
+	const Table* const table_;
+	Iterator* const iter_;
+	// 最近一次Seek被前缀过滤器排除了
+	bool skipped_ = false;
+};
+}  // namespace
+
 // Table::NewIterator 中会构造一个二级迭代器，第一级自然是 index_block 的迭代器，并且提供了第二级迭代器的创建函数 Table::BlockReader
 Iterator* Table::NewIterator(const ReadOptions& options) const {
-	return NewTwoLevelIterator(
+	Iterator* iter = NewTwoLevelIterator(
 		index_block_->NewIterator(options_->comparator),
 		&Table::BlockReader, const_cast<Table*>(this), options);
+	if (options.prefix_same_as_start && prefix_filtered_) {
+		iter = new PrefixCheckingIterator(this, iter);
+	}
+	return iter;
+}
+
+bool Table::PrefixMayMatch(const Slice& key) const {
+	const SliceTransform* prefix_extractor = options_->prefix_extractor.get();
+	if (!prefix_filtered_ || !prefix_extractor->InDomain(key)) {
+		return true;
+	}
+	const Slice prefix = prefix_extractor->Transform(key);
+	return options_->filter_policy->PrefixMayMatch(
+		std::string_view(prefix.data(), prefix.size()), bf_);
+}
+
+void Table::AddIndexKeys(std::vector<std::string>* keys) const {
+	std::unique_ptr<Iterator> iter(index_block_->NewIterator(options_->comparator));
+	for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+		keys->push_back(iter->key().ToString());
+	}
+}
+
+std::string Table::BlockCacheKey(uint64_t offset) const {
+	char cache_key_buffer[16];
+	EncodeFixed64(cache_key_buffer, cache_id_);
+	EncodeFixed64(cache_key_buffer + 8, offset);
+	return std::string(cache_key_buffer, sizeof(cache_key_buffer));
 }
 
 /**
@@ -167,62 +275,213 @@ Iterator* Table::NewIterator(const ReadOptions& options) const {
  * 当考虑缓存时: 使用 cache_id 和 handle.offset 构建一个缓存的 Key，将 block 作为缓存的 Value，后者的清理函数为 DeleteCachedBlock；
  * 	       当前使用 block 创建迭代器增加了 block 的引用计数，当迭代器析构时需要调用 ReleaseBlock 以减少缓存的 block 的引用计数。
  */
-// 根据一个Index读取一个Data Block
-Iterator* Table::BlockReader(void* arg, const ReadOptions& options, const std::string& index_value) {
-	Table* table = reinterpret_cast<Table*>(arg);
-	auto* block_cache = table->options_->block_cache;
-	DataBlock* block = nullptr;
-	CacheNode<Slice, DataBlock>* cache_handle = nullptr;
+DBStatus Table::ReadDataBlock(const ReadOptions& options, const Slice& index_value,
+			     DataBlock** block,
+			     CacheNode<std::string, DataBlock>** cache_handle) const {
+	auto* block_cache = options_->block_cache;
+	*block = nullptr;
+	*cache_handle = nullptr;
 
 	OffSetInfo offset_size; // 保存索引项
 	OffsetBuilder offset_builder;
 	offset_builder.Decode(index_value.data(), offset_size);
 
-	DBStatus s;
+	DBStatus s = Status::kSuccess;
 	std::string contents;
 	// 使用缓存，则先读缓存
 	if (block_cache != nullptr) {
 		// 构造缓存键，使用chache_id和offset
-		char cache_key_buffer[16];
-		EncodeFixed64(cache_key_buffer, table->cache_id_);
-		EncodeFixed64(cache_key_buffer + 8, offset_size.offset);
-		Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+		std::string key = BlockCacheKey(offset_size.offset);
 		// 查找缓存是否存在
-		cache_handle = block_cache->Get(key);
+		*cache_handle = block_cache->Get(key);
 		// 存在则直接获取到block
-		if (cache_handle != nullptr) {
-			block = cache_handle->value;
+		if (*cache_handle != nullptr) {
+			*block = (*cache_handle)->value;
 		} else {
 			// 否则从文件里读取Data Block
-			s = ReadBlock(table->file_reader_, options, offset_size, contents);
+			s = ReadBlock(file_reader_, options, offset_size, contents);
 			if (s == Status::kSuccess) {
-				block = new DataBlock(contents);
-				{
+				const auto& allocator = block_cache->memory_allocator();
+				*block = allocator != nullptr ? new DataBlock(contents, allocator)
+							      : new DataBlock(std::move(contents));
 				block_cache->RegistCleanHandle(DeleteCachedBlock);
-				block_cache->Insert(key, block);
-				}
+				block_cache->Insert(key, *block);
+				// Insert之后block归cache所有，这里再Get一次持有引用，使用完之后Release
+				*cache_handle = block_cache->Get(key);
 			}
 		}
 	} else {
 		// 不使用缓存， 直接读取数据
-		s = ReadBlock(table->file_reader_, options, offset_size, contents);
+		s = ReadBlock(file_reader_, options, offset_size, contents);
 		if (s == Status::kSuccess) {
-			block = new DataBlock(contents);
+			*block = new DataBlock(std::move(contents));
 		}
 	}
-	Iterator* iter;
-	if (block != nullptr) {
-		iter = block->NewIterator(table->options_->comparator);
-		if (cache_handle == nullptr) {
-			iter->RegisterCleanup(&DeleteBlock, block, nullptr);
-		} else {
-			iter->RegisterCleanup(&ReleaseBlock, block_cache, cache_handle);
+	return s;
+}
+
+// 根据一个Index读取一个Data Block
+Iterator* Table::BlockReader(void* arg, const ReadOptions& options, const std::string& index_value) {
+	Table* table = reinterpret_cast<Table*>(arg);
+	DataBlock* block = nullptr;
+	CacheNode<std::string, DataBlock>* cache_handle = nullptr;
+	DBStatus s = table->ReadDataBlock(options, index_value, &block, &cache_handle);
+	if (s != Status::kSuccess) {
+		return NewErrorIterator(s);
+	}
+	Iterator* iter = block->NewIterator(table->options_->comparator);
+	if (cache_handle == nullptr) {
+		iter->RegisterCleanup(&DeleteBlock, block, nullptr);
+	} else {
+		iter->RegisterCleanup(&ReleaseBlock, table->options_->block_cache, cache_handle);
+	}
+	return iter;
+}
+
+DBStatus Table::InternalGet(const ReadOptions& options, const Slice& target, void* arg,
+			    void (*handle_result)(void* arg, const Slice& key,
+						  const Slice& value)) const {
+	// 过滤器说不存在就一定不存在，不需要读任何data block
+	FilterPolicy* filter = options_->filter_policy.get();
+	if (filter != nullptr && !bf_.empty() &&
+	    !filter->MayMatch(std::string_view(target.data(), target.size()), bf_)) {
+		return Status::kSuccess;
+	}
+
+	// index block中每个data block对应一项，key不小于这个block中的最大key
+	const Comparator* comparator = options_->comparator.get();
+	std::string index_key;
+	Slice index_value;
+	DBStatus s = Status::kSuccess;
+	if (!index_block_->Seek(comparator, target, &index_key, &index_value, &s)) {
+		return s;
+	}
+
+	DataBlock* block = nullptr;
+	CacheNode<std::string, DataBlock>* cache_handle = nullptr;
+	s = ReadDataBlock(options, index_value, &block, &cache_handle);
+	if (s != Status::kSuccess) {
+		return s;
+	}
+	std::string key;
+	Slice value;
+	if (block->Seek(comparator, target, &key, &value, &s)) {
+		(*handle_result)(arg, key, value);
+	}
+	if (cache_handle != nullptr) {
+		options_->block_cache->Release(cache_handle);
+	} else {
+		delete block;
+	}
+	return s;
+}
+
+DBStatus Table::MultiGet(const ReadOptions& /*options*/, const Slice* targets, int n, void* arg,
+			 void (*handle_result)(void* arg, int index, const Slice& key,
+					       const Slice& value)) const {
+	// 一个data block以及落在其中的target，targets有序，所以同一个block的target是连续的
+	struct BlockRequest {
+		OffSetInfo handle;
+		std::vector<int> targets;
+		DataBlock* block = nullptr;
+		CacheNode<std::string, DataBlock>* cache_handle = nullptr;
+	};
+	std::vector<BlockRequest> requests;
+	FilterPolicy* filter = options_->filter_policy.get();
+	const Comparator* comparator = options_->comparator.get();
+	auto* block_cache = options_->block_cache;
+	OffsetBuilder offset_builder;
+	std::string index_key;
+	Slice index_value;
+	DBStatus s = Status::kSuccess;
+	for (int i = 0; i < n; i++) {
+		if (filter != nullptr && !bf_.empty() &&
+		    !filter->MayMatch(std::string_view(targets[i].data(), targets[i].size()), bf_)) {
+			continue;
 		}
-		} else {
-			iter = NewErrorIterator(s);
+		if (!index_block_->Seek(comparator, targets[i], &index_key, &index_value, &s)) {
+			if (s != Status::kSuccess) {
+				return s;
+			}
+			// 后面的target更大，也不会在这个sst中
+			break;
+		}
+		OffSetInfo handle;
+		offset_builder.Decode(index_value.data(), handle);
+		if (requests.empty() || requests.back().handle.offset != handle.offset) {
+			requests.emplace_back();
+			requests.back().handle = handle;
 		}
-		return iter;
+		requests.back().targets.push_back(i);
 	}
 
+	// 先从cache中取，没有命中的block按offset排列，在文件中首尾相接的合并成一次读取
+	std::vector<BlockRequest*> missing;
+	for (BlockRequest& request : requests) {
+		if (block_cache != nullptr) {
+			request.cache_handle = block_cache->Get(BlockCacheKey(request.handle.offset));
+			if (request.cache_handle != nullptr) {
+				request.block = request.cache_handle->value;
+				continue;
+			}
+		}
+		missing.push_back(&request);
+	}
+	std::string buffer;
+	for (size_t begin = 0; begin < missing.size() && s == Status::kSuccess;) {
+		size_t end = begin + 1;
+		uint64_t limit = missing[begin]->handle.offset + missing[begin]->handle.length +
+				 kBlockTrailerSize;
+		while (end < missing.size() && missing[end]->handle.offset == limit) {
+			limit += missing[end]->handle.length + kBlockTrailerSize;
+			end++;
+		}
+		const uint64_t start = missing[begin]->handle.offset;
+		buffer.resize(limit - start);
+		s = file_reader_->Read(start, buffer.size(), &buffer[0]);
+		for (size_t k = begin; k < end && s == Status::kSuccess; k++) {
+			BlockRequest* request = missing[k];
+			const char* data = buffer.data() + (request->handle.offset - start);
+			s = VerifyBlock(data, request->handle);
+			if (s != Status::kSuccess) {
+				break;
+			}
+			if (block_cache != nullptr && block_cache->memory_allocator() != nullptr) {
+				request->block = new DataBlock(std::string_view(data, request->handle.length),
+							       block_cache->memory_allocator());
+			} else {
+				request->block = new DataBlock(std::string(data, request->handle.length));
+			}
+			if (block_cache != nullptr) {
+				const std::string key = BlockCacheKey(request->handle.offset);
+				block_cache->RegistCleanHandle(DeleteCachedBlock);
+				block_cache->Insert(key, request->block);
+				request->cache_handle = block_cache->Get(key);
+			}
+		}
+		begin = end;
+	}
 
+	std::string key;
+	Slice value;
+	for (BlockRequest& request : requests) {
+		if (request.block == nullptr) {
+			continue;
+		}
+		for (int i : request.targets) {
+			if (s != Status::kSuccess) {
+				break;
+			}
+			if (request.block->Seek(comparator, targets[i], &key, &value, &s)) {
+				(*handle_result)(arg, i, key, value);
+			}
+		}
+		if (request.cache_handle != nullptr) {
+			block_cache->Release(request.cache_handle);
+		} else {
+			delete request.block;
+		}
+	}
+	return s;
+}
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "../db/options.h"
 #include "../include/tinykv/iterator.h"
@@ -20,19 +21,56 @@ public:
 
 	~Table();
 
+	// options.prefix_same_as_start为true时，返回的迭代器Seek(target)之前先用前缀过滤器判断，
+	// sst中没有target的前缀时直接变为无效，不查找index block也不读取data block
 	Iterator* NewIterator(const ReadOptions&) const;
-	
+	// 遍历sst中的范围删除，key是InternalKey(start, seq, kTypeRangeDeletion)，value是end
+	// 没有范围删除时返回nullptr，迭代器不能比Table活得更久
+	Iterator* NewRangeTombstoneIterator() const;
+
+	// 点查: 找到第一个key >= target的entry时调用(*handle_result)(arg, key, value)，没找到时不调用
+	// 先用布隆过滤器排除不存在的key，再在index block中二分查找，只读取(或从cache中取出)一个data block，
+	// 整个过程不创建迭代器。key和value只在handle_result中有效
+	DBStatus InternalGet(const ReadOptions& options, const Slice& target, void* arg,
+			     void (*handle_result)(void* arg, const Slice& key,
+						   const Slice& value)) const;
+
+	// 批量点查: targets[0,n-1]必须按照internal key递增排列，对于每个找到的targets[i]调用
+	// (*handle_result)(arg, i, key, value)，key为第一个>=targets[i]的entry
+	// 落在同一个data block中的target共用一次读取，cache中没有的相邻block合并成一次FileReader::Read
+	DBStatus MultiGet(const ReadOptions& options, const Slice* targets, int n, void* arg,
+			  void (*handle_result)(void* arg, int index, const Slice& key,
+						const Slice& value)) const;
+
+	// 把index block中的key(每个data block的最后一个internal key)追加到keys中
+	// 相邻两个key之间大约是一个data block的数据，用于把compaction按数据量切成多个范围
+	void AddIndexKeys(std::vector<std::string>* keys) const;
+
+	// sst中可能有和key前缀相同的key时返回true，没有前缀过滤器或者key没有前缀时总是返回true
+	bool PrefixMayMatch(const Slice& key) const;
+
 private:
 	Table(const Options* options, const FileReader* file_reader);
 	//DBStatus ReadBlock(const OffSetInfo&, std::string&);
 	void ReadMeta(const FooterBuilder* footer);
 	void ReadFilter(const std::string& filter_handle_value);
 	static Iterator* BlockReader(void*, const ReadOptions&, const std::string&);
+	// 读取index_value指向的data block，有block cache时优先从cache中取
+	// *cache_handle不为nullptr时block归cache所有，用完之后Release；否则由调用者delete
+	DBStatus ReadDataBlock(const ReadOptions& options, const Slice& index_value,
+			       DataBlock** block,
+			       CacheNode<std::string, DataBlock>** cache_handle) const;
+	// block cache中的key，由cache_id_和block在文件中的offset组成
+	std::string BlockCacheKey(uint64_t offset) const;
 	const Options* options_;
 	const FileReader* file_reader_;
 	uint64_t cache_id_ = 0;
 	std::string bf_;
+	// bf_中是否有用options_->prefix_extractor取出的前缀
+	bool prefix_filtered_ = false;
 	// index_block对象，用于两层迭代器使用
 	std::unique_ptr<DataBlock> index_block_;
+	// 范围删除，打开sst时一次读入内存
+	std::unique_ptr<DataBlock> range_del_block_;
 };
 }
\ No newline at end of file
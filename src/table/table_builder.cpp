@@ -3,6 +3,11 @@
 #include "../utils/codec.h"
 #include "../include/tinykv/comparator.h"
 #include "footer_builder.h"
+#include "table_options.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 namespace tinykv {
 TableBuilder::TableBuilder(const Options& options, FileWriter* file_handler) 
@@ -11,6 +16,7 @@ TableBuilder::TableBuilder(const Options& options, FileWriter* file_handler)
 	, data_block_builder_(&options)
 	, index_block_builder_(&index_options_)
 	, filter_block_builder_(options) 
+	, range_del_block_builder_(&options)
 {
 	// index block部分不需要进行差值压缩，因为本身数据就很少
 	// 也就是把block_restart_interval设置为1
@@ -49,9 +55,16 @@ void TableBuilder::Add(const std::string& key,
 	}
 }
 
+void TableBuilder::AddRangeTombstone(const std::string& key, const std::string& value) {
+	range_del_block_builder_.Add(key, value);
+	++range_del_count_;
+}
+
 // Flush()只是开启新的DataBlock，并没有真的进行刷盘操作
 void TableBuilder::Flush() {
-	if (data_block_builder_.CurrentSize() == 0) {
+	// CurrentSize()包含了重启点，即使没有record也不为0
+	// 不能写出空的DataBlock，否则上一个DataBlock还没有加入index block的索引会被覆盖
+	if (data_block_builder_.Empty()) {
 		return;
 	}
 	// 先写data block数据
@@ -121,6 +134,9 @@ void TableBuilder::Finish() {
 	OffSetInfo meta_filter_block_offset; // meta_index_block的offset和size，需要记录在footer中
 	OffSetInfo  index_block_offset;	// index block 的offset和 size，需要记录在footer中
 	// 开始构建meta_block和meta_index_block
+	// meta_index_block中每个meta block一项，key是meta block的名字，需要按名字从小到大排列
+	std::vector<std::pair<std::string, std::string>> meta_entries;
+	OffsetBuilder meta_offset_builder;
 	if(filter_block_builder_.Available()) {
 		filter_block_builder_.Finish();	// 构建布隆过滤器，并将得到的结果和哈希函数的数量序列化到buffer中
 		const auto& filter_block_data = filter_block_builder_.Data();
@@ -130,11 +146,27 @@ void TableBuilder::Finish() {
 		WriteBytesBlock(filter_block_data, BlockCompressType::kNonCompress, filter_block_offset);
 		// 这部分是获取布隆过滤器部分的数据在整个sst中的位置，然后将这部分数据写入sst文件
 		// 这部分的目的是针对不同的块可以使用不同的filter_policy
-		DataBlockBuilder meta_filter_block(&options_);
-		OffsetBuilder filter_block_offset_builder;
 		std::string handle_encoding_str;
-		filter_block_offset_builder.Encode(filter_block_offset, handle_encoding_str);
-		meta_filter_block.Add(options_.filter_policy->Name(), handle_encoding_str);
+		meta_offset_builder.Encode(filter_block_offset, handle_encoding_str);
+		meta_entries.emplace_back(options_.filter_policy->Name(), handle_encoding_str);
+		if (options_.prefix_extractor != nullptr) {
+			// 读取时只有前缀规则相同才能用过滤器判断前缀
+			meta_entries.emplace_back(kPrefixExtractorName, options_.prefix_extractor->Name());
+		}
+	}
+	if (!range_del_block_builder_.Empty()) {
+		OffSetInfo range_del_block_offset;
+		WriteDataBlock(range_del_block_builder_, range_del_block_offset);
+		std::string handle_encoding_str;
+		meta_offset_builder.Encode(range_del_block_offset, handle_encoding_str);
+		meta_entries.emplace_back(kRangeDelBlockName, handle_encoding_str);
+	}
+	if (!meta_entries.empty()) {
+		std::sort(meta_entries.begin(), meta_entries.end());
+		DataBlockBuilder meta_filter_block(&options_);
+		for (const auto& entry : meta_entries) {
+			meta_filter_block.Add(entry.first, entry.second);
+		}
 		WriteDataBlock(meta_filter_block, meta_filter_block_offset);
 	}
 	// 处理index_block
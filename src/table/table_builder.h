@@ -20,10 +20,14 @@ public:
 	TableBuilder& operator=(const TableBuilder&) = delete;
 
 	void Add(const std::string& key, const std::string& value);
+	// 范围删除单独写在range del block中，key是InternalKey(start, seq, kTypeRangeDeletion)，value是end
+	// 必须按照key从小到大的顺序添加
+	void AddRangeTombstone(const std::string& key, const std::string& value);
 	void Finish();
 	bool Success() { return status_ == Status::kSuccess; }
 	uint32_t GetFileSize() { return block_offset_; }
 	uint32_t GetEntryNum() { return entry_count_; }
+	uint32_t GetRangeTombstoneNum() { return range_del_count_; }
 
 private:
 	void Flush();
@@ -39,6 +43,7 @@ private:
 	DataBlockBuilder data_block_builder_;
 	DataBlockBuilder index_block_builder_;
 	FilterBlockBuilder filter_block_builder_;
+	DataBlockBuilder range_del_block_builder_;
 	OffsetBuilder index_block_offset_info_builder_;
 	FileWriter* file_handler_ = nullptr;
 	// 该成员变量用于索引的构建
@@ -53,12 +58,13 @@ private:
 	uint32_t block_offset_ = 0;
 	// 记录一共有多少个记录了
 	uint32_t entry_count_ = 0;
+	uint32_t range_del_count_ = 0;
 	// 是否创建index block
 	// 因为TableBuilder的Add操作是一个循环操作，
 	// 但是并不是每一次add数据的时候都会创建index block
 	// 只有当DataBlock到一定容量后才会创建index block
 	bool need_create_index_block_ = false;
-	DBStatus status_;
+	DBStatus status_ = Status::kSuccess;
 };
 
 }
\ No newline at end of file
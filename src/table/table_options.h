@@ -1,4 +1,5 @@
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
 namespace tinykv {
 static constexpr uint64_t kTableMagicNumber = 0x04452b9527c24933ull;
@@ -10,4 +11,8 @@ static constexpr uint32_t kMaxOffSetSizeLength = 2 * kMaxVarInt64Length;
 static constexpr uint64_t kEncodedLength = 40;
 // 1-byte type + 32-bit crc
 static constexpr size_t kBlockTrailerSize = 5;
+// meta index block中range del block对应的名字
+static constexpr char kRangeDelBlockName[] = "tinykv.range_del";
+// meta index block中记录构建前缀过滤器用的SliceTransform的名字，value是名字本身而不是BlockHandle
+static constexpr char kPrefixExtractorName[] = "tinykv.prefix_extractor";
 }  // namespace tinykv
\ No newline at end of file
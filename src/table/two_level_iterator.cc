@@ -25,7 +25,7 @@ public:
 	void Next() override;
 	void Prev() override;
 
-	bool Valid() const override { return data_iter_->Valid(); }
+	bool Valid() const override { return data_iter_ != nullptr && data_iter_->Valid(); }
 	Slice key() const override {
 		assert(Valid());
 		return data_iter_->key();
@@ -34,8 +34,14 @@ public:
 		assert(Valid());
 		return data_iter_->value();
  	}
-	DBStatus status() const override{
-
+	DBStatus status() const override {
+		// 先看一级迭代器，再看二级迭代器，最后是之前保存下来的错误
+		if (index_iter_->status() != Status::kSuccess) {
+			return index_iter_->status();
+		} else if (data_iter_ != nullptr && data_iter_->status() != Status::kSuccess) {
+			return data_iter_->status();
+		}
+		return status_;
 	}
 
 private:
@@ -62,11 +68,15 @@ TwoLevelIterator::TwoLevelIterator(Iterator* index_iter,
                                    const ReadOptions& options)
     : block_function_(block_function),
       arg_(arg),
+      status_(Status::kSuccess),
       options_(options),
       index_iter_(index_iter),
       data_iter_(nullptr) {}
 
-TwoLevelIterator::~TwoLevelIterator() = default;
+TwoLevelIterator::~TwoLevelIterator() {
+	delete data_iter_;
+	delete index_iter_;
+}
 
 //1、seek到target对应的一级迭代器位置;
 //2、初始化二级迭代器;
@@ -144,7 +154,10 @@ void TwoLevelIterator::SkipEmptyDataBlocksBackward() {
 
 //设置二级迭代器
 void TwoLevelIterator::SetDataIterator(Iterator* data_iter) {
-  if (data_iter_ != nullptr) SaveError(data_iter_->status());
+  if (data_iter_ != nullptr) {
+    SaveError(data_iter_->status());
+    delete data_iter_;
+  }
   data_iter_ = data_iter;
 }
 
@@ -0,0 +1,33 @@
+#include "../include/tinykv/compaction_filter.h"
+
+#include <time.h>
+
+#include "codec.h"
+
+namespace tinykv {
+
+CompactionFilter::~CompactionFilter() = default;
+
+bool TtlCompactionFilter::Filter(int /*level*/, const Slice& /*key*/,
+                                 const Slice& existing_value, std::string* /*new_value*/,
+                                 bool* /*value_changed*/) const {
+    if (existing_value.size() < kTimestampSize) {
+        return false;
+    }
+    const uint32_t written =
+        DecodeFixed32(existing_value.data() + existing_value.size() - kTimestampSize);
+    const uint32_t now = static_cast<uint32_t>(time(nullptr));
+    return now > written && now - written > ttl_;
+}
+
+void TtlCompactionFilter::AppendTimestamp(std::string* value) {
+    PutFixed32(value, static_cast<uint32_t>(time(nullptr)));
+}
+
+Slice TtlCompactionFilter::StripTimestamp(const Slice& value) {
+    if (value.size() < kTimestampSize) {
+        return value;
+    }
+    return Slice(value.data(), value.size() - kTimestampSize);
+}
+}
@@ -67,4 +67,9 @@ public:
         // 能到这里说明*key全部都是0xff，也就找不到相应的字符串了
     }
 };
-}
\ No newline at end of file
+
+const Comparator* BytewiseComparator() {
+    static BytewiseComparatorImpl singleton;
+    return &singleton;
+}
+}
@@ -233,7 +233,6 @@ const uint32_t kStrideExtensionTable3[256] = {
     0xf4335f23, 0x063f52dd, 0x5a26b1e2, 0xa82abc1c, 0xbbd2dcef, 0x49ded111,
     0x9c221d09, 0x6e2e10f7, 0x7dd67004, 0x8fda7dfa};
 
-#define constexpr const
 // CRCs are pre- and post- conditioned by xoring with all ones.
 static constexpr const uint32_t kCRC32Xor = static_cast<uint32_t>(0xffffffffU);
 
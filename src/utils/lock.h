@@ -20,7 +20,7 @@ public:
 
 	void Lock() {
 		if(!is_locked_) {
-			lock_.lock();
+			lock_.Lock();
 			is_locked_ = true;
 		}
 	}
@@ -63,13 +63,13 @@ public:
 	SpinLock(const SpinLock&) = delete;
 	SpinLock& operator=(const SpinLock&) = delete;
 	void Lock() {
-		while (flag_.test_and_set());
+		while (flag_.test_and_set(std::memory_order_acquire));
 	}
-	void unlock() {
-		flag_.clear();
+	void UnLock() {
+		flag_.clear(std::memory_order_release);
 	}
 private:
-	std::atomic_flag flag_ = 0;
+	std::atomic_flag flag_ = ATOMIC_FLAG_INIT;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,35 @@
+#include "../include/tinykv/merge_operator.h"
+
+#include "codec.h"
+
+namespace tinykv {
+
+MergeOperator::~MergeOperator() = default;
+
+bool UInt64AddOperator::Merge(const Slice& /*key*/, const Slice* existing_value,
+                              const Slice& value, std::string* new_value) const {
+    if (value.size() != sizeof(uint64_t) ||
+        (existing_value != nullptr && existing_value->size() != sizeof(uint64_t))) {
+        return false;
+    }
+    uint64_t sum = DecodeFixed64(value.data());
+    if (existing_value != nullptr) {
+        sum += DecodeFixed64(existing_value->data());
+    }
+    new_value->clear();
+    PutFixed64(new_value, sum);
+    return true;
+}
+
+bool StringAppendOperator::Merge(const Slice& /*key*/, const Slice* existing_value,
+                                 const Slice& value, std::string* new_value) const {
+    new_value->clear();
+    if (existing_value != nullptr) {
+        new_value->reserve(existing_value->size() + 1 + value.size());
+        new_value->assign(existing_value->data(), existing_value->size());
+        new_value->push_back(delimiter_);
+    }
+    new_value->append(value.data(), value.size());
+    return true;
+}
+}
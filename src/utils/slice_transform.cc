@@ -0,0 +1,18 @@
+#include "../include/tinykv/slice_transform.h"
+
+namespace tinykv {
+
+SliceTransform::~SliceTransform() = default;
+
+FixedPrefixTransform::FixedPrefixTransform(size_t prefix_len)
+    : prefix_len_(prefix_len),
+      name_("tinykv.FixedPrefix." + std::to_string(prefix_len)) {}
+
+Slice FixedPrefixTransform::Transform(const Slice& key) const {
+    return Slice(key.data(), prefix_len_);
+}
+
+bool FixedPrefixTransform::InDomain(const Slice& key) const {
+    return key.size() >= prefix_len_;
+}
+}
@@ -0,0 +1,146 @@
+#include "memory/arena.h"
+#include "memory/memory_allocator.h"
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace tinykv;
+
+TEST(arenaTest, Allocate) {
+  Arena arena(4096);
+  ASSERT_EQ(arena.MemoryUsage(), 0);
+  vector<pair<size_t, char*>> allocated;
+  size_t bytes = 0;
+  for (int i = 0; i < 10000; i++) {
+    // 大部分是小的分配，偶尔有超过block 1/4的大分配
+    size_t size = (i % 1000 == 0) ? 2000 + i : (i % 131) + 1;
+    char* p = (i % 2 == 0) ? arena.AllocateAligned(size) : arena.Allocate(size);
+    if (i % 2 == 0) {
+      ASSERT_EQ(reinterpret_cast<uintptr_t>(p) % sizeof(void*), 0);
+    }
+    // 写入可以区分的内容，最后检查没有互相覆盖
+    memset(p, i % 256, size);
+    allocated.emplace_back(size, p);
+    bytes += size;
+    ASSERT_GE(arena.MemoryUsage(), bytes);
+    // 小的分配浪费的只是block的尾巴
+    ASSERT_LE(arena.MemoryUsage(), bytes * 1.2 + 4096 + 64);
+  }
+  for (size_t i = 0; i < allocated.size(); i++) {
+    for (size_t j = 0; j < allocated[i].first; j++) {
+      ASSERT_EQ(allocated[i].second[j] & 0xff, i % 256);
+    }
+  }
+}
+
+TEST(arenaTest, ConcurrentAllocate) {
+  ConcurrentArena arena(4096);
+  ASSERT_EQ(arena.MemoryUsage(), 0);
+  const int kThreads = 4;
+  const int kNumPerThread = 10000;
+  vector<vector<pair<size_t, char*>>> allocated(kThreads);
+  vector<thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&arena, &allocated, t]() {
+      for (int i = 0; i < kNumPerThread; i++) {
+        size_t size = (i % 500 == 0) ? 3000 : (i % 67) + 1;
+        char* p = (i % 2 == 0) ? arena.AllocateAligned(size) : arena.Allocate(size);
+        memset(p, t, size);
+        allocated[t].emplace_back(size, p);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  size_t bytes = 0;
+  for (int t = 0; t < kThreads; t++) {
+    for (const auto& item : allocated[t]) {
+      for (size_t j = 0; j < item.first; j++) {
+        ASSERT_EQ(item.second[j], t);
+      }
+      bytes += item.first;
+    }
+  }
+  // 分配出去的内存不少于申请的字节数，也不超过从系统申请的内存
+  ASSERT_GE(arena.MemoryUsage(), bytes);
+  ASSERT_LE(arena.MemoryUsage(), arena.MemoryReserved());
+}
+
+TEST(arenaTest, HugePage) {
+  // 系统没有预留大页时退回透明大页或者普通内存，分配出来的内存同样可以使用
+  Arena arena(4096, kDefaultHugePageSize);
+  char* p = arena.AllocateAligned(100);
+  memset(p, 1, 100);
+  ASSERT_GE(arena.MemoryUsage(), kDefaultHugePageSize);
+  ASSERT_LE(arena.HugePageUsage(), arena.MemoryUsage());
+  // 一个block是一个大页
+  for (size_t i = 0; i < kDefaultHugePageSize / 1024; i++) {
+    memset(arena.Allocate(1000), 2, 1000);
+  }
+  ASSERT_LT(arena.MemoryUsage(), 2 * kDefaultHugePageSize + 4096);
+
+  auto allocator = NewHugePageAllocator();
+  char* a = allocator->Allocate(4000);
+  memset(a, 3, 4000);
+  allocator->Deallocate(a, 4000);
+  // 大小相近的block复用释放的内存
+  char* b = allocator->Allocate(4010);
+  ASSERT_EQ(a, b);
+  allocator->Deallocate(b, 4010);
+  ASSERT_LE(allocator->HugePageUsage(), allocator->MemoryUsage());
+}
+
+TEST(arenaTest, HugePageAllocatorSizeClasses) {
+  auto allocator = NewHugePageAllocator();
+  // 同一级中大小不同的block复用同一个slot
+  char* a = allocator->Allocate(3900);
+  allocator->Deallocate(a, 3900);
+  char* b = allocator->Allocate(4096);
+  ASSERT_EQ(a, b);
+  allocator->Deallocate(b, 4096);
+
+  // 占满好几个slab，写入可以区分的内容，检查没有互相覆盖
+  vector<pair<size_t, char*>> allocated;
+  size_t bytes = 0;
+  for (int i = 0; i < 3000; i++) {
+    // 3072、3584、4096三级
+    size_t size = 3000 + (i * 37) % 1096;
+    char* p = allocator->Allocate(size);
+    memset(p, i % 256, size);
+    allocated.emplace_back(size, p);
+    bytes += size;
+  }
+  ASSERT_GE(allocator->MemoryUsage() - allocator->FreeBytes(), bytes);
+  // 取整最多浪费1/4，每一级最多有一个没有用满的slab
+  ASSERT_LE(allocator->MemoryUsage() - allocator->FreeBytes(), bytes * 5 / 4);
+  ASSERT_LE(allocator->FreeBytes(), 3 * kDefaultHugePageSize);
+  for (size_t i = 0; i < allocated.size(); i++) {
+    for (size_t j = 0; j < allocated[i].first; j += 97) {
+      ASSERT_EQ(allocated[i].second[j] & 0xff, i % 256);
+    }
+  }
+  const size_t peak = allocator->MemoryUsage();
+  for (const auto& block : allocated) {
+    allocator->Deallocate(block.second, block.first);
+  }
+  // 空的slab只保留每级一个，其余的还给系统
+  ASSERT_EQ(allocator->FreeBytes(), allocator->MemoryUsage());
+  ASSERT_LE(allocator->MemoryUsage(), 3 * kDefaultHugePageSize);
+  ASSERT_LT(allocator->MemoryUsage(), peak);
+
+  // 大的block单独申请，释放之后立即归还
+  const size_t before = allocator->MemoryUsage();
+  char* large = allocator->Allocate(kDefaultHugePageSize / 2);
+  memset(large, 1, kDefaultHugePageSize / 2);
+  ASSERT_GE(allocator->MemoryUsage(), before + kDefaultHugePageSize / 2);
+  allocator->Deallocate(large, kDefaultHugePageSize / 2);
+  ASSERT_EQ(allocator->MemoryUsage(), before);
+}
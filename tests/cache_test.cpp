@@ -0,0 +1,75 @@
+#include "cache/lru.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace tinykv;
+
+class lruCacheTest : public testing::Test {
+protected:
+  void SetUp() override {
+    cache_.RegistCleanHandle([this](const int& key, string* value) {
+      destroyed_.push_back(key);
+      delete value;
+    });
+  }
+
+  LruCachePolicy<int, string, MutexLock> cache_{3};
+  vector<int> destroyed_;
+};
+
+// 替换已经存在的key时，旧的值在使用者Release之后才销毁
+TEST_F(lruCacheTest, ReplaceWhileHeld) {
+  cache_.Insert(1, new string("a"));
+  auto* old_handle = cache_.Get(1);
+  ASSERT_EQ(*old_handle->value, "a");
+
+  cache_.Insert(1, new string("b"));
+  ASSERT_TRUE(destroyed_.empty());
+  ASSERT_FALSE(old_handle->in_cache);
+  auto* new_handle = cache_.Get(1);
+  ASSERT_EQ(*new_handle->value, "b");
+  // 旧值仍然可以读
+  ASSERT_EQ(*old_handle->value, "a");
+
+  // 再替换一次，两个被替换的节点都还有人持有
+  cache_.Insert(1, new string("c"));
+  cache_.Release(old_handle);
+  ASSERT_EQ(destroyed_, vector<int>({1}));
+  cache_.Release(new_handle);
+  ASSERT_EQ(destroyed_, vector<int>({1, 1}));
+
+  auto* handle = cache_.Get(1);
+  ASSERT_EQ(*handle->value, "c");
+  cache_.Release(handle);
+  ASSERT_EQ(destroyed_.size(), 2u);
+}
+
+// 容量满时淘汰最久没有访问的节点，Get会刷新节点的位置
+TEST_F(lruCacheTest, Evict) {
+  for (int i = 0; i < 3; i++) {
+    cache_.Insert(i, new string(to_string(i)));
+  }
+  cache_.Release(cache_.Get(0));
+  cache_.Insert(3, new string("3"));
+  ASSERT_EQ(destroyed_, vector<int>({1}));
+  ASSERT_EQ(cache_.Get(1), nullptr);
+
+  // 被持有的节点淘汰之后不能再Get到，但要等Release之后才销毁
+  auto* handle = cache_.Get(2);
+  cache_.Insert(4, new string("4"));
+  cache_.Insert(5, new string("5"));
+  cache_.Insert(6, new string("6"));
+  ASSERT_EQ(cache_.Get(2), nullptr);
+  ASSERT_EQ(destroyed_, vector<int>({1, 0, 3}));
+  ASSERT_EQ(*handle->value, "2");
+  cache_.Release(handle);
+  ASSERT_EQ(destroyed_, vector<int>({1, 0, 3, 2}));
+
+  cache_.Erase(5);
+  ASSERT_EQ(destroyed_, vector<int>({1, 0, 3, 2, 5}));
+  ASSERT_EQ(cache_.Get(5), nullptr);
+}
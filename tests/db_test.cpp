@@ -0,0 +1,1416 @@
+#include "db/db.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "db/write_batch.h"
+#include "filter/bloomfilter.h"
+#include "file/file_writer.h"
+#include "file/rate_limiter.h"
+#include "include/tinykv/compaction_filter.h"
+#include "include/tinykv/iterator.h"
+#include "include/tinykv/merge_operator.h"
+#include "include/tinykv/slice_transform.h"
+#include "logger/log.h"
+#include "memory/memory_allocator.h"
+#include "memtable/memtable_rep.h"
+#include "utils/codec.h"
+
+using namespace std;
+using namespace tinykv;
+
+static const string kDBName = "/tmp/tinykv_db_test";
+
+static void InitLog() {
+  tinykv::LogConfig log_config;
+  log_config.log_type = tinykv::LogType::CONSOLE;
+  log_config.rotate_size = 100;
+  tinykv::Log::GetInstance()->InitLog(log_config);
+}
+
+static void DestroyDB(const string& dbname) {
+  vector<string> filenames;
+  FileTool::GetChildren(dbname, &filenames);
+  for (auto& filename : filenames) {
+    if (filename.compare(0, 3, "cf-") == 0) {
+      // 非默认column family的目录
+      DestroyDB(dbname + "/" + filename);
+    } else {
+      FileTool::RemoveFile(dbname + "/" + filename);
+    }
+  }
+  FileTool::RemoveDir(dbname);
+}
+
+// 每个用例打开自己目录下的DB，用例结束时关闭并删除，ctest并行运行用例时互不影响
+class dbTest : public testing::Test {
+protected:
+  void SetUp() override {
+    InitLog();
+    dbname_ = kDBName + "_" + testing::UnitTest::GetInstance()->current_test_info()->name();
+    DestroyDB(dbname_);
+  }
+
+  void TearDown() override {
+    Close();
+    DestroyDB(dbname_);
+  }
+
+  DBStatus Open() { return DB::Open(options_, dbname_, &db_); }
+
+  void Close() {
+    delete db_;
+    db_ = nullptr;
+  }
+
+  string dbname_;
+  Options options_;
+  DB* db_ = nullptr;
+  // options_.block_cache指向它，比db_活得更久
+  unique_ptr<Cache<string, DataBlock>> block_cache_;
+};
+
+TEST_F(dbTest, PutGetDelete) {
+  ASSERT_EQ(Open(), Status::kSuccess);
+  ASSERT_EQ(db_->Put(WriteOptions(), "tinykv", "v1"), Status::kSuccess);
+  ASSERT_EQ(db_->Put(WriteOptions(), "tinykv", "v2"), Status::kSuccess);
+  string value;
+  ASSERT_EQ(db_->Get(ReadOptions(), "tinykv", &value), Status::kSuccess);
+  ASSERT_EQ(value, "v2");
+  ASSERT_EQ(db_->Delete(WriteOptions(), "tinykv"), Status::kSuccess);
+  ASSERT_EQ(db_->Get(ReadOptions(), "tinykv", &value), Status::kNotFound);
+}
+
+TEST_F(dbTest, FlushAndRecover) {
+  // 很小的memtable，写入过程中会不断刷成sst
+  options_.write_buffer_size = 4096;
+  ASSERT_EQ(Open(), Status::kSuccess);
+  const int kNum = 2000;
+  for (int i = 0; i < kNum; i++) {
+    ASSERT_EQ(db_->Put(WriteOptions(), to_string(i), "value" + to_string(i)),
+              Status::kSuccess);
+  }
+  for (int i = 0; i < kNum; i += 2) {
+    ASSERT_EQ(db_->Delete(WriteOptions(), to_string(i)), Status::kSuccess);
+  }
+  Close();
+
+  // 重新打开之后sst和WAL中的数据都要能读到
+  ASSERT_EQ(Open(), Status::kSuccess);
+  string value;
+  for (int i = 0; i < kNum; i++) {
+    if (i % 2 == 0) {
+      ASSERT_EQ(db_->Get(ReadOptions(), to_string(i), &value), Status::kNotFound);
+    } else {
+      ASSERT_EQ(db_->Get(ReadOptions(), to_string(i), &value), Status::kSuccess);
+      ASSERT_EQ(value, "value" + to_string(i));
+    }
+  }
+
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_EQ(count, kNum / 2);
+  delete iter;
+}
+
+TEST_F(dbTest, ConcurrentWrite) {
+  options_.write_buffer_size = 64 * 1024;
+  ASSERT_EQ(Open(), Status::kSuccess);
+  // 多个线程同时写入，每个batch写两个key，group commit之后batch依然是原子的
+  const int kThreads = 8;
+  const int kNumPerThread = 500;
+  vector<thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([this, t]() {
+      for (int i = 0; i < kNumPerThread; i++) {
+        WriteBatch batch;
+        string key = to_string(t) + "_" + to_string(i);
+        batch.Put(key + "_a", key);
+        batch.Put(key + "_b", key);
+        WriteOptions write_options;
+        write_options.sync = (i % 100 == 0);
+        ASSERT_EQ(db_->Write(write_options, &batch), Status::kSuccess);
+      }
+    });
+  }
+  for (auto& th : threads) {
+    th.join();
+  }
+  Close();
+
+  ASSERT_EQ(Open(), Status::kSuccess);
+  string value;
+  for (int t = 0; t < kThreads; t++) {
+    for (int i = 0; i < kNumPerThread; i++) {
+      string key = to_string(t) + "_" + to_string(i);
+      ASSERT_EQ(db_->Get(ReadOptions(), key + "_a", &value), Status::kSuccess);
+      ASSERT_EQ(value, key);
+      ASSERT_EQ(db_->Get(ReadOptions(), key + "_b", &value), Status::kSuccess);
+      ASSERT_EQ(value, key);
+    }
+  }
+}
+
+TEST_F(dbTest, ParallelRecovery) {
+  // memtable足够大，关闭之前所有数据都只在WAL中
+  options_.write_buffer_size = 64 * 1024 * 1024;
+  ASSERT_EQ(Open(), Status::kSuccess);
+  // 第二轮覆盖第一轮，两轮的数据会落在WAL不同的段中
+  const int kNum = 20000;
+  string padding(100, 'x');
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < kNum; i++) {
+      ASSERT_EQ(db_->Put(WriteOptions(), to_string(i),
+                        to_string(round) + padding),
+                Status::kSuccess);
+    }
+  }
+  // 一条记录跨越多个block和段的边界
+  const string big(3 * 1024 * 1024, 'b');
+  ASSERT_EQ(db_->Put(WriteOptions(), "big", big), Status::kSuccess);
+  ASSERT_EQ(db_->Put(WriteOptions(), "last", "v"), Status::kSuccess);
+  Close();
+
+  // 多个线程回放，memtable写满时直接刷成sst
+  options_.write_buffer_size = 256 * 1024;
+  options_.recovery_threads = 4;
+  ASSERT_EQ(Open(), Status::kSuccess);
+  string value;
+  for (int i = 0; i < kNum; i++) {
+    ASSERT_EQ(db_->Get(ReadOptions(), to_string(i), &value), Status::kSuccess);
+    ASSERT_EQ(value, "1" + padding);
+  }
+  ASSERT_EQ(db_->Get(ReadOptions(), "big", &value), Status::kSuccess);
+  ASSERT_TRUE(value == big);
+  ASSERT_EQ(db_->Get(ReadOptions(), "last", &value), Status::kSuccess);
+  ASSERT_EQ(value, "v");
+  // 新的写入的顺序号必须比回放出来的都大
+  ASSERT_EQ(db_->Put(WriteOptions(), "0", "new"), Status::kSuccess);
+  ASSERT_EQ(db_->Get(ReadOptions(), "0", &value), Status::kSuccess);
+  ASSERT_EQ(value, "new");
+}
+
+TEST_F(dbTest, Compaction) {
+  options_.write_buffer_size = 16 * 1024;
+  options_.max_file_size = 32 * 1024;
+  ASSERT_EQ(Open(), Status::kSuccess);
+  // 反复覆盖写同一批key，再删掉一半，compaction之后旧版本和删除标记都会被清理
+  const int kNum = 2000;
+  string padding(100, 'x');
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < kNum; i++) {
+      ASSERT_EQ(db_->Put(WriteOptions(), to_string(i),
+                        to_string(round) + padding),
+                Status::kSuccess);
+    }
+  }
+  for (int i = 0; i < kNum; i += 2) {
+    ASSERT_EQ(db_->Delete(WriteOptions(), to_string(i)), Status::kSuccess);
+  }
+  // 等待L0的文件被compaction到下层
+  string num_files;
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(db_->GetProperty("tinykv.num-files-at-level0", &num_files));
+    if (stoi(num_files) < 4) {
+      break;
+    }
+    this_thread::sleep_for(chrono::milliseconds(10));
+  }
+  ASSERT_LT(stoi(num_files), 4);
+  ASSERT_TRUE(db_->GetProperty("tinykv.num-files-at-level1", &num_files));
+  ASSERT_GT(stoi(num_files), 0);
+  // 不存在的层和溢出的层号都返回false
+  ASSERT_FALSE(db_->GetProperty("tinykv.num-files-at-level" + to_string(options_.max_level_num),
+                                &num_files));
+  ASSERT_FALSE(db_->GetProperty("tinykv.num-files-at-level99999999999999999999", &num_files));
+  ASSERT_FALSE(db_->GetProperty("tinykv.num-files-at-level", &num_files));
+
+  string value;
+  for (int i = 0; i < kNum; i++) {
+    if (i % 2 == 0) {
+      ASSERT_EQ(db_->Get(ReadOptions(), to_string(i), &value), Status::kNotFound);
+    } else {
+      ASSERT_EQ(db_->Get(ReadOptions(), to_string(i), &value), Status::kSuccess);
+      ASSERT_EQ(value, "2" + padding);
+    }
+  }
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ASSERT_EQ(iter->value().ToString(), "2" + padding);
+    count++;
+  }
+  ASSERT_EQ(count, kNum / 2);
+  delete iter;
+  Close();
+
+  // 重新打开之后从MANIFEST恢复出每一层的文件，读到的数据不能变
+  ASSERT_EQ(Open(), Status::kSuccess);
+  ASSERT_TRUE(db_->GetProperty("tinykv.num-files-at-level1", &num_files));
+  ASSERT_GT(stoi(num_files), 0);
+  for (int i = 0; i < kNum; i++) {
+    if (i % 2 == 0) {
+      ASSERT_EQ(db_->Get(ReadOptions(), to_string(i), &value), Status::kNotFound);
+    } else {
+      ASSERT_EQ(db_->Get(ReadOptions(), to_string(i), &value), Status::kSuccess);
+      ASSERT_EQ(value, "2" + padding);
+    }
+  }
+}
+
+TEST_F(dbTest, UniversalCompaction) {
+  options_.write_buffer_size = 16 * 1024;
+  options_.compaction_style = kCompactionStyleUniversal;
+  ASSERT_EQ(Open(), Status::kSuccess);
+  const int kNum = 2000;
+  string padding(100, 'x');
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < kNum; i++) {
+      ASSERT_EQ(db_->Put(WriteOptions(), to_string(i),
+                        to_string(round) + padding),
+                Status::kSuccess);
+    }
+  }
+  for (int i = 0; i < kNum; i += 2) {
+    ASSERT_EQ(db_->Delete(WriteOptions(), to_string(i)), Status::kSuccess);
+  }
+  // 有序段的个数降到阈值以下，而且所有数据都留在L0
+  string num_files;
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(db_->GetProperty("tinykv.num-files-at-level0", &num_files));
+    if (stoi(num_files) < 4) {
+      break;
+    }
+    this_thread::sleep_for(chrono::milliseconds(10));
+  }
+  ASSERT_LT(stoi(num_files), 4);
+  ASSERT_TRUE(db_->GetProperty("tinykv.num-files-at-level1", &num_files));
+  ASSERT_EQ(num_files, "0");
+
+  string value;
+  for (int i = 0; i < kNum; i++) {
+    if (i % 2 == 0) {
+      ASSERT_EQ(db_->Get(ReadOptions(), to_string(i), &value), Status::kNotFound);
+    } else {
+      ASSERT_EQ(db_->Get(ReadOptions(), to_string(i), &value), Status::kSuccess);
+      ASSERT_EQ(value, "2" + padding);
+    }
+  }
+  Close();
+
+  // 重新打开之后有序段按顺序号排列，新旧关系不能乱
+  ASSERT_EQ(Open(), Status::kSuccess);
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ASSERT_EQ(iter->value().ToString(), "2" + padding);
+    count++;
+  }
+  ASSERT_EQ(count, kNum / 2);
+  delete iter;
+}
+
+TEST_F(dbTest, Snapshot) {
+  options_.write_buffer_size = 16 * 1024;
+  options_.max_file_size = 32 * 1024;
+  ASSERT_EQ(Open(), Status::kSuccess);
+  ASSERT_EQ(db_->Put(WriteOptions(), "foo", "v1"), Status::kSuccess);
+  ASSERT_EQ(db_->Put(WriteOptions(), "bar", "v1"), Status::kSuccess);
+  const Snapshot* s1 = db_->GetSnapshot();
+  ASSERT_EQ(db_->Put(WriteOptions(), "foo", "v2"), Status::kSuccess);
+  ASSERT_EQ(db_->Delete(WriteOptions(), "bar"), Status::kSuccess);
+  const Snapshot* s2 = db_->GetSnapshot();
+  ASSERT_EQ(db_->Put(WriteOptions(), "foo", "v3"), Status::kSuccess);
+
+  ReadOptions read_s1, read_s2;
+  read_s1.snapshot = s1;
+  read_s2.snapshot = s2;
+  // 写入大量数据触发刷盘和compaction，对快照可见的旧版本不能被丢弃
+  const int kNum = 2000;
+  string padding(100, 'x');
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < kNum; i++) {
+      ASSERT_EQ(db_->Put(WriteOptions(), "key" + to_string(i),
+                        to_string(round) + padding),
+                Status::kSuccess);
+    }
+  }
+  string num_files;
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(db_->GetProperty("tinykv.num-files-at-level0", &num_files));
+    if (stoi(num_files) < 4) {
+      break;
+    }
+    this_thread::sleep_for(chrono::milliseconds(10));
+  }
+
+  string value;
+  ASSERT_EQ(db_->Get(read_s1, "foo", &value), Status::kSuccess);
+  ASSERT_EQ(value, "v1");
+  ASSERT_EQ(db_->Get(read_s1, "bar", &value), Status::kSuccess);
+  ASSERT_EQ(value, "v1");
+  ASSERT_EQ(db_->Get(read_s2, "foo", &value), Status::kSuccess);
+  ASSERT_EQ(value, "v2");
+  ASSERT_EQ(db_->Get(read_s2, "bar", &value), Status::kNotFound);
+  ASSERT_EQ(db_->Get(ReadOptions(), "foo", &value), Status::kSuccess);
+  ASSERT_EQ(value, "v3");
+
+  // 快照时刻还没有写入的key不可见
+  Iterator* iter = db_->NewIterator(read_s1);
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ASSERT_EQ(iter->value().ToString(), "v1");
+    count++;
+  }
+  ASSERT_EQ(count, 2);
+  delete iter;
+
+  db_->ReleaseSnapshot(s1);
+  db_->ReleaseSnapshot(s2);
+}
+
+TEST_F(dbTest, BlobFiles) {
+  options_.write_buffer_size = 64 * 1024;
+  options_.compaction_style = kCompactionStyleUniversal;
+  options_.max_key_value_split_threshold = 1024;
+  ASSERT_EQ(Open(), Status::kSuccess);
+  // 奇数key的value超过阈值，写到blob文件中；偶数key的value留在sst中
+  auto make_value = [](int i, int round) {
+    return string(i % 2 == 1 ? 4096 : 16, 'a' + (i + round) % 26);
+  };
+  const int kNum = 200;
+  const int kRounds = 5;
+  for (int round = 0; round < kRounds; round++) {
+    for (int i = 0; i < kNum; i++) {
+      ASSERT_EQ(db_->Put(WriteOptions(), to_string(i), make_value(i, round)),
+                Status::kSuccess);
+    }
+  }
+  string num_files;
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(db_->GetProperty("tinykv.num-files-at-level0", &num_files));
+    if (stoi(num_files) < 4) {
+      break;
+    }
+    this_thread::sleep_for(chrono::milliseconds(10));
+  }
+  // 后台的刷盘和compaction可能还在写新的blob文件，等到磁盘上的文件和版本中的一致
+  string num_blob_files;
+  int blob_files_on_disk = 0;
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(db_->GetProperty("tinykv.num-blob-files", &num_blob_files));
+    vector<string> filenames;
+    FileTool::GetChildren(dbname_, &filenames);
+    blob_files_on_disk = 0;
+    for (const auto& filename : filenames) {
+      if (filename.size() > 5 && filename.substr(filename.size() - 5) == ".blob") {
+        blob_files_on_disk++;
+      }
+    }
+    if (blob_files_on_disk == stoi(num_blob_files)) {
+      break;
+    }
+    this_thread::sleep_for(chrono::milliseconds(10));
+  }
+  ASSERT_EQ(blob_files_on_disk, stoi(num_blob_files));
+  ASSERT_GT(stoi(num_blob_files), 0);
+  // 被覆盖的value变成垃圾之后，旧的blob文件会被删掉
+  ASSERT_LT(stoi(num_blob_files), kNum * kRounds * 4096 / options_.write_buffer_size);
+
+  auto check = [&]() {
+    string value;
+    for (int i = 0; i < kNum; i++) {
+      ASSERT_EQ(db_->Get(ReadOptions(), to_string(i), &value), Status::kSuccess);
+      ASSERT_EQ(value, make_value(i, kRounds - 1));
+    }
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      const int i = stoi(iter->key().ToString());
+      ASSERT_EQ(iter->value().ToString(), make_value(i, kRounds - 1));
+      count++;
+    }
+    ASSERT_EQ(count, kNum);
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+      const int i = stoi(iter->key().ToString());
+      ASSERT_EQ(iter->value().ToString(), make_value(i, kRounds - 1));
+      count--;
+    }
+    ASSERT_EQ(count, 0);
+    ASSERT_EQ(iter->status(), Status::kSuccess);
+    delete iter;
+  };
+  check();
+  Close();
+
+  // blob文件和其中的垃圾统计都记录在MANIFEST中
+  ASSERT_EQ(Open(), Status::kSuccess);
+  check();
+}
+
+TEST_F(dbTest, PointLookupWithFilter) {
+  options_.write_buffer_size = 16 * 1024;
+  options_.filter_policy = make_shared<BloomFilter>(10);
+  block_cache_.reset(new Cache<string, DataBlock>(1000));
+  options_.block_cache = block_cache_.get();
+  ASSERT_EQ(Open(), Status::kSuccess);
+  const int kNum = 2000;
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < kNum; i += 2) {
+      ASSERT_EQ(db_->Put(WriteOptions(), "key" + to_string(i),
+                        "value" + to_string(i + round)),
+                Status::kSuccess);
+    }
+  }
+  ASSERT_EQ(db_->Delete(WriteOptions(), "key0"), Status::kSuccess);
+  Close();
+
+  // 重新打开之后所有数据都在sst中，奇数key会被过滤器直接排除
+  ASSERT_EQ(Open(), Status::kSuccess);
+  string value;
+  for (int k = 0; k < 2; k++) {
+    ASSERT_EQ(db_->Get(ReadOptions(), "key0", &value), Status::kNotFound);
+    for (int i = 1; i < kNum; i++) {
+      DBStatus s = db_->Get(ReadOptions(), "key" + to_string(i), &value);
+      if (i % 2 == 1) {
+        ASSERT_EQ(s, Status::kNotFound);
+      } else {
+        ASSERT_EQ(s, Status::kSuccess);
+        ASSERT_EQ(value, "value" + to_string(i + 1));
+      }
+    }
+  }
+}
+
+TEST_F(dbTest, MultiGet) {
+  options_.write_buffer_size = 16 * 1024;
+  options_.filter_policy = make_shared<BloomFilter>(10);
+  block_cache_.reset(new Cache<string, DataBlock>(1000));
+  ASSERT_EQ(Open(), Status::kSuccess);
+  const int kNum = 3000;
+  for (int i = 0; i < kNum; i += 2) {
+    ASSERT_EQ(db_->Put(WriteOptions(), "key" + to_string(i), "value" + to_string(i)),
+              Status::kSuccess);
+  }
+  for (int i = 0; i < kNum; i += 10) {
+    ASSERT_EQ(db_->Delete(WriteOptions(), "key" + to_string(i)), Status::kSuccess);
+  }
+  Close();
+
+  // 第二轮打开时带上block cache，一部分数据在memtable中，一部分在sst中
+  options_.block_cache = block_cache_.get();
+  ASSERT_EQ(Open(), Status::kSuccess);
+  for (int i = 0; i < kNum; i += 7) {
+    ASSERT_EQ(db_->Put(WriteOptions(), "key" + to_string(i), "new" + to_string(i)),
+              Status::kSuccess);
+  }
+  // 无序、有重复、有不存在的key
+  vector<string> key_data;
+  for (int i = kNum + 10; i >= 0; i -= 3) {
+    key_data.push_back("key" + to_string(i));
+  }
+  key_data.push_back("key4");
+  key_data.push_back("key4");
+  for (int round = 0; round < 2; round++) {
+    vector<Slice> keys(key_data.begin(), key_data.end());
+    vector<string> values;
+    vector<DBStatus> statuses = db_->MultiGet(ReadOptions(), keys, &values);
+    ASSERT_EQ(statuses.size(), keys.size());
+    ASSERT_EQ(values.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      string expected;
+      DBStatus s = db_->Get(ReadOptions(), keys[i], &expected);
+      ASSERT_EQ(statuses[i], s) << key_data[i];
+      if (s == Status::kSuccess) {
+        ASSERT_EQ(values[i], expected) << key_data[i];
+      }
+    }
+  }
+}
+
+// 检查[0, num)中的key: deleted为true的key不存在，其他key的值为value_of(i)
+template <typename Deleted, typename ValueOf>
+static void CheckRange(DB* db, const ReadOptions& options, int num,
+                       Deleted deleted, ValueOf value_of) {
+  auto key_of = [](int i) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "k%05d", i);
+    return string(buf);
+  };
+  string value;
+  int expected = 0;
+  for (int i = 0; i < num; i++) {
+    DBStatus s = db->Get(options, key_of(i), &value);
+    if (deleted(i)) {
+      ASSERT_EQ(s, Status::kNotFound) << key_of(i);
+    } else {
+      ASSERT_EQ(s, Status::kSuccess) << key_of(i);
+      ASSERT_EQ(value, value_of(i));
+      expected++;
+    }
+  }
+  Iterator* iter = db->NewIterator(options);
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ASSERT_EQ(iter->value().ToString(), value_of(stoi(iter->key().ToString().substr(1))));
+    count++;
+  }
+  ASSERT_EQ(count, expected);
+  count = 0;
+  for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+    count++;
+  }
+  ASSERT_EQ(count, expected);
+  // 从被删除的范围中间开始Seek
+  iter->Seek(key_of(1200));
+  int first = 1200;
+  while (first < num && deleted(first)) {
+    first++;
+  }
+  if (first < num) {
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(iter->key().ToString(), key_of(first));
+  }
+  delete iter;
+}
+
+TEST_F(dbTest, DeleteRange) {
+  options_.write_buffer_size = 16 * 1024;
+  options_.max_file_size = 32 * 1024;
+  ASSERT_EQ(Open(), Status::kSuccess);
+  const int kNum = 3000;
+  string padding(50, 'x');
+  auto key_of = [](int i) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "k%05d", i);
+    return string(buf);
+  };
+  for (int i = 0; i < kNum; i++) {
+    ASSERT_EQ(db_->Put(WriteOptions(), key_of(i), "v" + padding), Status::kSuccess);
+  }
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_EQ(db_->DeleteRange(WriteOptions(), key_of(2000), key_of(1000)),
+            Status::kInvalidArgument);
+  ASSERT_EQ(db_->DeleteRange(WriteOptions(), key_of(1000), key_of(2000)), Status::kSuccess);
+  ASSERT_EQ(db_->Put(WriteOptions(), key_of(1500), "new"), Status::kSuccess);
+
+  auto deleted = [](int i) { return i >= 1000 && i < 2000 && i != 1500; };
+  auto value_of = [&padding](int i) { return i == 1500 ? string("new") : "v" + padding; };
+  // 范围删除还在memtable中
+  CheckRange(db_, ReadOptions(), kNum, deleted, value_of);
+  ReadOptions snapshot_options;
+  snapshot_options.snapshot = snapshot;
+  CheckRange(db_, snapshot_options, kNum, [](int) { return false; },
+             [&padding](int) { return "v" + padding; });
+  db_->ReleaseSnapshot(snapshot);
+  Close();
+
+  // 重新打开之后范围删除被刷到了sst中
+  ASSERT_EQ(Open(), Status::kSuccess);
+  CheckRange(db_, ReadOptions(), kNum, deleted, value_of);
+
+  // 不断写入其他的key触发compaction，被覆盖的数据会被丢弃
+  for (int round = 0; round < 3; round++) {
+    for (int i = 2000; i < kNum; i++) {
+      ASSERT_EQ(db_->Put(WriteOptions(), key_of(i), "v" + padding), Status::kSuccess);
+    }
+  }
+  string num_files;
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(db_->GetProperty("tinykv.num-files-at-level0", &num_files));
+    if (stoi(num_files) < 4) {
+      break;
+    }
+    this_thread::sleep_for(chrono::milliseconds(10));
+  }
+  CheckRange(db_, ReadOptions(), kNum, deleted, value_of);
+  Close();
+
+  ASSERT_EQ(Open(), Status::kSuccess);
+  CheckRange(db_, ReadOptions(), kNum, deleted, value_of);
+  vector<Slice> keys;
+  vector<string> key_data = {key_of(999), key_of(1000), key_of(1500), key_of(1999)};
+  keys.assign(key_data.begin(), key_data.end());
+  vector<string> values;
+  vector<DBStatus> statuses = db_->MultiGet(ReadOptions(), keys, &values);
+  ASSERT_EQ(statuses[0], Status::kSuccess);
+  ASSERT_EQ(statuses[1], Status::kNotFound);
+  ASSERT_EQ(statuses[2], Status::kSuccess);
+  ASSERT_EQ(values[2], "new");
+  ASSERT_EQ(statuses[3], Status::kNotFound);
+}
+
+TEST_F(dbTest, Subcompactions) {
+  options_.write_buffer_size = 16 * 1024;
+  options_.max_file_size = 32 * 1024;
+  options_.max_key_value_split_threshold = 200;
+  options_.max_subcompactions = 4;
+  ASSERT_EQ(Open(), Status::kSuccess);
+  const int kNum = 3000;
+  auto key_of = [](int i) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "k%05d", i);
+    return string(buf);
+  };
+  // 每10个key中有一个大value，会被写到blob文件中
+  auto value_of = [](int i) {
+    return to_string(i) + string(i % 10 == 0 ? 300 : 50, 'x');
+  };
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < kNum; i++) {
+      ASSERT_EQ(db_->Put(WriteOptions(), key_of(i), round == 2 ? value_of(i) : "old"),
+                Status::kSuccess);
+    }
+  }
+  for (int i = 0; i < kNum; i += 3) {
+    ASSERT_EQ(db_->Delete(WriteOptions(), key_of(i)), Status::kSuccess);
+  }
+  ASSERT_EQ(db_->DeleteRange(WriteOptions(), key_of(1000), key_of(1200)), Status::kSuccess);
+  auto deleted = [](int i) { return i % 3 == 0 || (i >= 1000 && i < 1200); };
+
+  // L0的多个文件和L1合并时按key范围切成多个subcompaction同时执行
+  string num_files;
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(db_->GetProperty("tinykv.num-files-at-level0", &num_files));
+    if (stoi(num_files) < 4) {
+      break;
+    }
+    this_thread::sleep_for(chrono::milliseconds(10));
+  }
+  ASSERT_LT(stoi(num_files), 4);
+  ASSERT_TRUE(db_->GetProperty("tinykv.num-files-at-level1", &num_files));
+  ASSERT_GT(stoi(num_files), 1);
+  CheckRange(db_, ReadOptions(), kNum, deleted, value_of);
+  Close();
+
+  // 所有subcompaction的输出一起写入了MANIFEST
+  ASSERT_EQ(Open(), Status::kSuccess);
+  CheckRange(db_, ReadOptions(), kNum, deleted, value_of);
+}
+
+TEST_F(dbTest, RateLimiter) {
+  options_.write_buffer_size = 16 * 1024;
+  options_.max_file_size = 32 * 1024;
+  options_.rate_limiter = make_shared<RateLimiter>(64 * 1024 * 1024, 10 * 1000);
+  ASSERT_EQ(Open(), Status::kSuccess);
+  const int kNum = 2000;
+  string padding(100, 'x');
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < kNum; i++) {
+      ASSERT_EQ(db_->Put(WriteOptions(), to_string(i), to_string(round) + padding),
+                Status::kSuccess);
+    }
+  }
+  string num_files;
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(db_->GetProperty("tinykv.num-files-at-level0", &num_files));
+    if (stoi(num_files) < 4) {
+      break;
+    }
+    this_thread::sleep_for(chrono::milliseconds(10));
+  }
+  ASSERT_TRUE(db_->GetProperty("tinykv.num-files-at-level1", &num_files));
+  ASSERT_GT(stoi(num_files), 0);
+  Close();
+
+  // WAL、memtable刷盘和compaction的写入都经过了限速器
+  const RateLimiter& limiter = *options_.rate_limiter;
+  ASSERT_GT(limiter.GetTotalBytesThrough(kIOHigh), kNum * 2 * 100);
+  ASSERT_GT(limiter.GetTotalBytesThrough(kIOMid), 0);
+  ASSERT_GT(limiter.GetTotalBytesThrough(kIOLow), 0);
+  ASSERT_EQ(limiter.GetTotalBytesThrough(),
+            limiter.GetTotalBytesThrough(kIOHigh) + limiter.GetTotalBytesThrough(kIOMid) +
+                limiter.GetTotalBytesThrough(kIOLow));
+
+  ASSERT_EQ(Open(), Status::kSuccess);
+  string value;
+  for (int i = 0; i < kNum; i++) {
+    ASSERT_EQ(db_->Get(ReadOptions(), to_string(i), &value), Status::kSuccess);
+    ASSERT_EQ(value, "1" + padding);
+  }
+}
+
+TEST_F(dbTest, TableCache) {
+  options_.write_buffer_size = 16 * 1024;
+  options_.max_file_size = 16 * 1024;
+  // 远小于sst的个数，读取时sst会被反复淘汰和重新打开
+  options_.max_open_files = 5;
+  ASSERT_EQ(Open(), Status::kSuccess);
+  const int kNum = 3000;
+  auto key_of = [](int i) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "k%05d", i);
+    return string(buf);
+  };
+  auto old_value_of = [](int i) { return "old" + to_string(i) + string(50, 'x'); };
+  auto value_of = [](int i) { return to_string(i) + string(50, 'x'); };
+  for (int i = 0; i < kNum; i++) {
+    ASSERT_EQ(db_->Put(WriteOptions(), key_of(i), old_value_of(i)), Status::kSuccess);
+  }
+  auto none = [](int) { return false; };
+  CheckRange(db_, ReadOptions(), kNum, none, old_value_of);
+
+  // 迭代器持有的sst在compaction之后被删除了，仍然可以继续读
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->SeekToFirst();
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < kNum; i++) {
+      ASSERT_EQ(db_->Put(WriteOptions(), key_of(i), value_of(i)), Status::kSuccess);
+    }
+  }
+  string num_files;
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(db_->GetProperty("tinykv.num-files-at-level0", &num_files));
+    if (stoi(num_files) < 4) {
+      break;
+    }
+    this_thread::sleep_for(chrono::milliseconds(10));
+  }
+  ASSERT_TRUE(db_->GetProperty("tinykv.num-files-at-level1", &num_files));
+  ASSERT_GT(stoi(num_files), 5);
+  int count = 0;
+  for (; iter->Valid(); iter->Next()) {
+    ASSERT_EQ(iter->value().ToString(), old_value_of(count));
+    count++;
+  }
+  ASSERT_EQ(count, kNum);
+  delete iter;
+  CheckRange(db_, ReadOptions(), kNum, none, value_of);
+  Close();
+
+  ASSERT_EQ(Open(), Status::kSuccess);
+  CheckRange(db_, ReadOptions(), kNum, none, value_of);
+}
+
+TEST_F(dbTest, ConcurrentMemTableWrite) {
+  options_.write_buffer_size = 256 * 1024;
+  options_.allow_concurrent_memtable_write = true;
+  ASSERT_EQ(Open(), Status::kSuccess);
+  // 同一组的batch由各自的线程同时插入memtable，每个batch写两个key
+  const int kThreads = 8;
+  const int kNumPerThread = 1000;
+  atomic<bool> stop{false};
+  // 快照中能看到一个batch的第二个key时，第一个key也一定能看到
+  thread reader([this, &stop]() {
+    string value;
+    while (!stop.load()) {
+      ReadOptions read_options;
+      read_options.snapshot = db_->GetSnapshot();
+      for (int t = 0; t < kThreads; t++) {
+        const string key = to_string(t) + "_" + to_string(kNumPerThread / 2);
+        if (db_->Get(read_options, key + "_b", &value) == Status::kSuccess) {
+          ASSERT_EQ(db_->Get(read_options, key + "_a", &value), Status::kSuccess);
+        }
+      }
+      db_->ReleaseSnapshot(read_options.snapshot);
+    }
+  });
+  vector<thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([this, t]() {
+      for (int i = 0; i < kNumPerThread; i++) {
+        WriteBatch batch;
+        string key = to_string(t) + "_" + to_string(i);
+        batch.Put(key + "_a", key);
+        batch.Put(key + "_b", key);
+        ASSERT_EQ(db_->Write(WriteOptions(), &batch), Status::kSuccess);
+      }
+    });
+  }
+  for (auto& th : threads) {
+    th.join();
+  }
+  stop = true;
+  reader.join();
+
+  auto check = [&]() {
+    string value;
+    for (int t = 0; t < kThreads; t++) {
+      for (int i = 0; i < kNumPerThread; i++) {
+        string key = to_string(t) + "_" + to_string(i);
+        ASSERT_EQ(db_->Get(ReadOptions(), key + "_a", &value), Status::kSuccess);
+        ASSERT_EQ(value, key);
+        ASSERT_EQ(db_->Get(ReadOptions(), key + "_b", &value), Status::kSuccess);
+        ASSERT_EQ(value, key);
+      }
+    }
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      count++;
+    }
+    ASSERT_EQ(count, kThreads * kNumPerThread * 2);
+    delete iter;
+  };
+  check();
+  Close();
+
+  // WAL中记录的顺序号和memtable中的一致
+  ASSERT_EQ(Open(), Status::kSuccess);
+  check();
+}
+
+TEST_F(dbTest, PipelinedWrite) {
+  for (bool concurrent : {false, true}) {
+    DestroyDB(dbname_);
+    // memtable很小，写入期间会多次切换memtable和WAL
+    options_.write_buffer_size = 32 * 1024;
+    options_.enable_pipelined_write = true;
+    options_.allow_concurrent_memtable_write = concurrent;
+    ASSERT_EQ(Open(), Status::kSuccess);
+    const int kThreads = 8;
+    const int kNumPerThread = 500;
+    atomic<bool> stop{false};
+    // 顺序号按顺序发布，快照中能看到一个batch的第二个key时，第一个key也一定能看到
+    thread reader([this, &stop]() {
+      string value;
+      while (!stop.load()) {
+        ReadOptions read_options;
+        read_options.snapshot = db_->GetSnapshot();
+        for (int t = 0; t < kThreads; t++) {
+          const string key = to_string(t) + "_" + to_string(kNumPerThread / 2);
+          if (db_->Get(read_options, key + "_b", &value) == Status::kSuccess) {
+            ASSERT_EQ(db_->Get(read_options, key + "_a", &value), Status::kSuccess);
+          }
+        }
+        db_->ReleaseSnapshot(read_options.snapshot);
+      }
+    });
+    vector<thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+      threads.emplace_back([this, t]() {
+        for (int i = 0; i < kNumPerThread; i++) {
+          WriteBatch batch;
+          string key = to_string(t) + "_" + to_string(i);
+          batch.Put(key + "_a", key);
+          batch.Put(key + "_b", key);
+          WriteOptions write_options;
+          write_options.sync = (i % 100 == 0);
+          ASSERT_EQ(db_->Write(write_options, &batch), Status::kSuccess);
+        }
+      });
+    }
+    for (auto& th : threads) {
+      th.join();
+    }
+    stop = true;
+    reader.join();
+
+    auto check = [&]() {
+      string value;
+      for (int t = 0; t < kThreads; t++) {
+        for (int i = 0; i < kNumPerThread; i++) {
+          string key = to_string(t) + "_" + to_string(i);
+          ASSERT_EQ(db_->Get(ReadOptions(), key + "_a", &value), Status::kSuccess);
+          ASSERT_EQ(value, key);
+          ASSERT_EQ(db_->Get(ReadOptions(), key + "_b", &value), Status::kSuccess);
+          ASSERT_EQ(value, key);
+        }
+      }
+    };
+    check();
+    Close();
+
+    ASSERT_EQ(Open(), Status::kSuccess);
+    check();
+    Close();
+  }
+}
+
+TEST_F(dbTest, ColumnFamilies) {
+  Options hot_options;
+  // 很小的memtable，写入过程中会单独刷盘，不影响其他column family
+  hot_options.write_buffer_size = 4096;
+  ASSERT_EQ(Open(), Status::kSuccess);
+  ColumnFamilyHandle* hot = nullptr;
+  ASSERT_EQ(db_->CreateColumnFamily(hot_options, "hot", &hot), Status::kSuccess);
+  ColumnFamilyHandle* dup = nullptr;
+  ASSERT_EQ(db_->CreateColumnFamily(options_, "hot", &dup), Status::kInvalidArgument);
+  ASSERT_EQ(hot->GetName(), "hot");
+  ASSERT_NE(hot->GetID(), db_->DefaultColumnFamily()->GetID());
+
+  // 同一个key在不同的column family中互不影响，一个batch原子地写入两个column family
+  const int kNum = 1000;
+  for (int i = 0; i < kNum; i++) {
+    WriteBatch batch;
+    batch.Put(to_string(i), "default" + to_string(i));
+    batch.Put(hot, to_string(i), "hot" + to_string(i));
+    ASSERT_EQ(db_->Write(WriteOptions(), &batch), Status::kSuccess);
+  }
+  ASSERT_EQ(db_->Delete(WriteOptions(), hot, "0"), Status::kSuccess);
+
+  auto check = [&](ColumnFamilyHandle* hot) {
+    string value;
+    ASSERT_EQ(db_->Get(ReadOptions(), "0", &value), Status::kSuccess);
+    ASSERT_EQ(value, "default0");
+    ASSERT_EQ(db_->Get(ReadOptions(), hot, "0", &value), Status::kNotFound);
+    for (int i = 1; i < kNum; i++) {
+      ASSERT_EQ(db_->Get(ReadOptions(), to_string(i), &value), Status::kSuccess);
+      ASSERT_EQ(value, "default" + to_string(i));
+      ASSERT_EQ(db_->Get(ReadOptions(), hot, to_string(i), &value), Status::kSuccess);
+      ASSERT_EQ(value, "hot" + to_string(i));
+    }
+    Iterator* iter = db_->NewIterator(ReadOptions(), hot);
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      ASSERT_EQ(iter->value().ToString(), "hot" + iter->key().ToString());
+      count++;
+    }
+    ASSERT_EQ(count, kNum - 1);
+    delete iter;
+  };
+  check(hot);
+  // 只有hot的memtable写满过
+  string num_files;
+  ASSERT_TRUE(db_->GetProperty("tinykv.num-files-at-level0", &num_files));
+  ASSERT_EQ(num_files, "0");
+  Close();
+
+  // 已经存在的column family没有列出来时不能打开
+  ASSERT_EQ(Open(), Status::kInvalidArgument);
+  vector<ColumnFamilyDescriptor> column_families;
+  column_families.emplace_back("hot", hot_options);
+  column_families.emplace_back("cold", options_);
+  vector<ColumnFamilyHandle*> handles;
+  ASSERT_EQ(DB::Open(options_, dbname_, column_families, &handles, &db_), Status::kSuccess);
+  ASSERT_EQ(handles.size(), 2u);
+  check(handles[0]);
+  string value;
+  ASSERT_EQ(db_->Get(ReadOptions(), handles[1], "1", &value), Status::kNotFound);
+}
+
+TEST_F(dbTest, PrefixSeek) {
+  options_.write_buffer_size = 16 * 1024;
+  options_.filter_policy = make_shared<BloomFilter>(10);
+  options_.prefix_extractor = make_shared<FixedPrefixTransform>(4);
+  ASSERT_EQ(Open(), Status::kSuccess);
+  // 偶数前缀p000、p002...，每个前缀的key分散在多个sst中
+  const int kPrefixes = 20;
+  const int kNumPerPrefix = 100;
+  for (int i = 0; i < kNumPerPrefix; i++) {
+    for (int p = 0; p < kPrefixes; p += 2) {
+      char key[32];
+      snprintf(key, sizeof(key), "p%03d_%04d", p, i);
+      ASSERT_EQ(db_->Put(WriteOptions(), key, string(100, 'v')), Status::kSuccess);
+    }
+  }
+  Close();
+
+  ASSERT_EQ(Open(), Status::kSuccess);
+  ReadOptions read_options;
+  read_options.prefix_same_as_start = true;
+  Iterator* iter = db_->NewIterator(read_options);
+  // 只返回前缀相同的key
+  int count = 0;
+  for (iter->Seek("p004_0050"); iter->Valid(); iter->Next()) {
+    ASSERT_TRUE(iter->key().starts_with("p004"));
+    count++;
+  }
+  ASSERT_EQ(count, kNumPerPrefix - 50);
+  ASSERT_EQ(iter->status(), Status::kSuccess);
+  // 没有写入过的前缀，不会越过前缀边界返回p006的key
+  iter->Seek("p005");
+  ASSERT_FALSE(iter->Valid());
+  ASSERT_EQ(iter->status(), Status::kSuccess);
+  // 比前缀短的key没有前缀，和普通迭代器一样
+  count = 0;
+  for (iter->Seek("p01"); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_EQ(count, kNumPerPrefix * 5);
+  // 前缀迭代不支持Prev
+  iter->Seek("p008");
+  ASSERT_TRUE(iter->Valid());
+  iter->Prev();
+  ASSERT_FALSE(iter->Valid());
+  ASSERT_EQ(iter->status(), Status::kInvalidArgument);
+  delete iter;
+
+  // 不开启前缀模式时Seek会越过前缀边界
+  iter = db_->NewIterator(ReadOptions());
+  iter->Seek("p005");
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ(iter->key().ToString(), "p006_0000");
+  delete iter;
+}
+
+// value为"drop"的key被丢弃，为"change"的key改写成"changed"
+class DropAndChangeFilter : public CompactionFilter {
+public:
+  const char* Name() const override { return "DropAndChangeFilter"; }
+  bool Filter(int /*level*/, const Slice& /*key*/, const Slice& existing_value,
+              string* new_value, bool* value_changed) const override {
+    if (existing_value == Slice("drop")) {
+      return true;
+    }
+    if (existing_value == Slice("change")) {
+      new_value->assign("changed");
+      *value_changed = true;
+    }
+    return false;
+  }
+};
+
+// 写入足够多和之前的key交错的数据，等到L0的文件都被compaction到L1
+static void WriteFillerAndWaitCompaction(DB* db) {
+  for (int i = 0; i < 2000; i++) {
+    char key[32];
+    snprintf(key, sizeof(key), "k%04d_filler", i % 1000);
+    ASSERT_EQ(db->Put(WriteOptions(), key, "f" + string(100, 'x')), Status::kSuccess);
+  }
+  string num_files;
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(db->GetProperty("tinykv.num-files-at-level0", &num_files));
+    if (stoi(num_files) < 4) {
+      break;
+    }
+    this_thread::sleep_for(chrono::milliseconds(10));
+  }
+  ASSERT_LT(stoi(num_files), 4);
+}
+
+TEST_F(dbTest, CompactionFilter) {
+  options_.write_buffer_size = 16 * 1024;
+  options_.compaction_filter = make_shared<DropAndChangeFilter>();
+  ASSERT_EQ(Open(), Status::kSuccess);
+  // 快照能读到的版本不会被过滤
+  ASSERT_EQ(db_->Put(WriteOptions(), "k0000", "drop"), Status::kSuccess);
+  const Snapshot* snapshot = db_->GetSnapshot();
+  const char* values[] = {"drop", "change", "keep"};
+  for (int i = 1; i < 1000; i++) {
+    char key[32];
+    snprintf(key, sizeof(key), "k%04d", i);
+    ASSERT_EQ(db_->Put(WriteOptions(), key, values[i % 3]), Status::kSuccess);
+  }
+  WriteFillerAndWaitCompaction(db_);
+
+  string value;
+  ASSERT_EQ(db_->Get(ReadOptions(), "k0000", &value), Status::kSuccess);
+  ASSERT_EQ(value, "drop");
+  for (int i = 1; i < 1000; i++) {
+    char key[32];
+    snprintf(key, sizeof(key), "k%04d", i);
+    DBStatus s = db_->Get(ReadOptions(), key, &value);
+    if (i % 3 == 0) {
+      ASSERT_EQ(s, Status::kNotFound);
+    } else {
+      ASSERT_EQ(s, Status::kSuccess);
+      ASSERT_EQ(value, i % 3 == 1 ? "changed" : "keep");
+    }
+  }
+  db_->ReleaseSnapshot(snapshot);
+}
+
+TEST_F(dbTest, Ttl) {
+  options_.write_buffer_size = 16 * 1024;
+  options_.ttl = 1;
+  ASSERT_EQ(Open(), Status::kSuccess);
+  for (int i = 0; i < 1000; i++) {
+    char key[32];
+    snprintf(key, sizeof(key), "k%04d", i);
+    ASSERT_EQ(db_->Put(WriteOptions(), key, "v" + to_string(i)), Status::kSuccess);
+  }
+  // 过期之前读到的value不带写入时间
+  string value;
+  ASSERT_EQ(db_->Get(ReadOptions(), "k0001", &value), Status::kSuccess);
+  ASSERT_EQ(value, "v1");
+  // 没有开启TTL的column family写入时不追加写入时间，也不会过期
+  ColumnFamilyHandle* plain = nullptr;
+  ASSERT_EQ(db_->CreateColumnFamily(Options(), "plain", &plain), Status::kSuccess);
+  ASSERT_EQ(db_->Put(WriteOptions(), plain, "p", "plain"), Status::kSuccess);
+
+  this_thread::sleep_for(chrono::milliseconds(2500));
+  WriteFillerAndWaitCompaction(db_);
+  ASSERT_EQ(db_->Get(ReadOptions(), plain, "p", &value), Status::kSuccess);
+  ASSERT_EQ(value, "plain");
+  // 过期的key在compaction时被丢弃
+  for (int i = 0; i < 1000; i++) {
+    char key[32];
+    snprintf(key, sizeof(key), "k%04d", i);
+    ASSERT_EQ(db_->Get(ReadOptions(), key, &value), Status::kNotFound);
+  }
+  ASSERT_EQ(db_->Put(WriteOptions(), "fresh", "value"), Status::kSuccess);
+  ASSERT_EQ(db_->Get(ReadOptions(), "fresh", &value), Status::kSuccess);
+  ASSERT_EQ(value, "value");
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    if (iter->key() == Slice("fresh")) {
+      ASSERT_EQ(iter->value().ToString(), "value");
+    } else {
+      ASSERT_EQ(iter->value().ToString(), "f" + string(100, 'x'));
+    }
+  }
+  ASSERT_EQ(iter->status(), Status::kSuccess);
+  delete iter;
+}
+
+static string EncodeCounter(uint64_t n) {
+  string result;
+  PutFixed64(&result, n);
+  return result;
+}
+
+TEST_F(dbTest, MergeOperator) {
+  options_.write_buffer_size = 16 * 1024;
+  options_.merge_operator = make_shared<UInt64AddOperator>();
+  ASSERT_EQ(Open(), Status::kSuccess);
+  const int kCounters = 100;
+  const int kRounds = 50;
+  auto key_of = [](int i) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "counter%03d", i);
+    return string(buf);
+  };
+  // 计数器i初始值为i，之后每一轮加一，操作数分散在memtable和多层sst中
+  for (int i = 0; i < kCounters; i++) {
+    ASSERT_EQ(db_->Put(WriteOptions(), key_of(i), EncodeCounter(i)), Status::kSuccess);
+  }
+  const Snapshot* snapshot = nullptr;
+  for (int round = 0; round < kRounds; round++) {
+    if (round == kRounds / 2) {
+      snapshot = db_->GetSnapshot();
+    }
+    for (int i = 0; i < kCounters; i++) {
+      ASSERT_EQ(db_->Merge(WriteOptions(), key_of(i), EncodeCounter(1)), Status::kSuccess);
+    }
+    // 填充数据，让memtable刷盘并触发compaction
+    ASSERT_EQ(db_->Put(WriteOptions(), "filler" + to_string(round), string(2000, 'x')),
+              Status::kSuccess);
+  }
+  // 删除之后再merge，从0开始计数
+  ASSERT_EQ(db_->Delete(WriteOptions(), key_of(0)), Status::kSuccess);
+  ASSERT_EQ(db_->Merge(WriteOptions(), key_of(0), EncodeCounter(7)), Status::kSuccess);
+
+  auto expected = [&](int i, int rounds) {
+    return EncodeCounter(i == 0 && rounds == kRounds ? 7 : i + rounds);
+  };
+  auto check = [&]() {
+    string value;
+    for (int i = 0; i < kCounters; i++) {
+      ASSERT_EQ(db_->Get(ReadOptions(), key_of(i), &value), Status::kSuccess);
+      ASSERT_EQ(value, expected(i, kRounds));
+    }
+    vector<Slice> keys;
+    vector<string> key_strs;
+    for (int i = 0; i < kCounters; i++) {
+      key_strs.push_back(key_of(i));
+    }
+    for (const string& k : key_strs) {
+      keys.push_back(k);
+    }
+    vector<string> values;
+    vector<DBStatus> statuses = db_->MultiGet(ReadOptions(), keys, &values);
+    for (int i = 0; i < kCounters; i++) {
+      ASSERT_EQ(statuses[i], Status::kSuccess);
+      ASSERT_EQ(values[i], expected(i, kRounds));
+    }
+    // 正向和反向迭代都能看到合并之后的值
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    int i = 0;
+    for (iter->Seek("counter"); iter->Valid() && iter->key().starts_with("counter");
+         iter->Next(), i++) {
+      ASSERT_EQ(iter->key().ToString(), key_of(i));
+      ASSERT_EQ(iter->value().ToString(), expected(i, kRounds));
+    }
+    ASSERT_EQ(i, kCounters);
+    iter->Seek(key_of(kCounters - 1));
+    for (i = kCounters - 1; iter->Valid() && iter->key().starts_with("counter");
+         iter->Prev(), i--) {
+      ASSERT_EQ(iter->key().ToString(), key_of(i));
+      ASSERT_EQ(iter->value().ToString(), expected(i, kRounds));
+    }
+    ASSERT_EQ(i, -1);
+    ASSERT_EQ(iter->status(), Status::kSuccess);
+    delete iter;
+  };
+  check();
+
+  // 快照看到的是创建快照时的值，compaction提前合并操作数时不会影响快照
+  ReadOptions snapshot_options;
+  snapshot_options.snapshot = snapshot;
+  string value;
+  for (int i = 0; i < kCounters; i++) {
+    ASSERT_EQ(db_->Get(snapshot_options, key_of(i), &value), Status::kSuccess);
+    ASSERT_EQ(value, expected(i, kRounds / 2));
+  }
+  db_->ReleaseSnapshot(snapshot);
+
+  // 没有设置merge_operator时不能写入merge
+  Options no_merge;
+  ColumnFamilyHandle* cf = nullptr;
+  ASSERT_EQ(db_->CreateColumnFamily(no_merge, "no_merge", &cf), Status::kSuccess);
+  ASSERT_EQ(db_->Merge(WriteOptions(), cf, "key", EncodeCounter(1)),
+            Status::kInvalidArgument);
+  Close();
+
+  // 重新打开之后WAL中的操作数也能合并
+  vector<ColumnFamilyDescriptor> descriptors;
+  descriptors.emplace_back("no_merge", no_merge);
+  vector<ColumnFamilyHandle*> handles;
+  ASSERT_EQ(DB::Open(options_, dbname_, descriptors, &handles, &db_), Status::kSuccess);
+  check();
+}
+
+TEST_F(dbTest, HugePages) {
+  options_.memtable_huge_page_size = 2 * 1024 * 1024;
+  // 系统没有预留大页时退回透明大页或普通内存，读写结果不受影响
+  block_cache_.reset(new Cache<string, DataBlock>(1000, NewHugePageAllocator()));
+  options_.block_cache = block_cache_.get();
+  ASSERT_EQ(Open(), Status::kSuccess);
+  const int kNum = 1000;
+  for (int i = 0; i < kNum; i++) {
+    ASSERT_EQ(db_->Put(WriteOptions(), "key" + to_string(i), "value" + to_string(i)),
+              Status::kSuccess);
+  }
+  string size;
+  string huge_page_bytes;
+  ASSERT_TRUE(db_->GetProperty("tinykv.cur-size-all-mem-tables", &size));
+  ASSERT_TRUE(db_->GetProperty("tinykv.mem-table-huge-page-bytes", &huge_page_bytes));
+  ASSERT_GT(stoull(size), kNum * 10);
+  ASSERT_LE(stoull(size), options_.memtable_huge_page_size);
+  // 用MAP_HUGETLB映射时是整个大页，没有预留大页时为0
+  ASSERT_EQ(stoull(huge_page_bytes) % options_.memtable_huge_page_size, 0);
+  Close();
+
+  // 重新打开之后数据在sst中，第二遍从block cache中读
+  ASSERT_EQ(Open(), Status::kSuccess);
+  string value;
+  for (int k = 0; k < 2; k++) {
+    for (int i = 0; i < kNum; i++) {
+      ASSERT_EQ(db_->Get(ReadOptions(), "key" + to_string(i), &value), Status::kSuccess);
+      ASSERT_EQ(value, "value" + to_string(i));
+    }
+  }
+  ASSERT_GT(block_cache_->memory_allocator()->MemoryUsage(), 0);
+
+  // memtable的内存统计所有column family，从哪个column family查询结果都一样
+  string before;
+  ASSERT_TRUE(db_->GetProperty("tinykv.cur-size-all-mem-tables", &before));
+  ColumnFamilyHandle* other = nullptr;
+  ASSERT_EQ(db_->CreateColumnFamily(options_, "other", &other), Status::kSuccess);
+  for (int i = 0; i < kNum; i++) {
+    ASSERT_EQ(db_->Put(WriteOptions(), other, "key" + to_string(i), "value" + to_string(i)),
+              Status::kSuccess);
+  }
+  ASSERT_TRUE(db_->GetProperty("tinykv.cur-size-all-mem-tables", &size));
+  ASSERT_GT(stoull(size), stoull(before) + kNum * 10);
+  string other_size;
+  ASSERT_TRUE(db_->GetProperty(other, "tinykv.cur-size-all-mem-tables", &other_size));
+  ASSERT_EQ(other_size, size);
+}
+
+TEST_F(dbTest, HashSkipListMemTable) {
+  options_.write_buffer_size = 256 * 1024;
+  options_.memtable_factory = NewHashSkipListRepFactory(1000);
+  options_.allow_concurrent_memtable_write = true;
+  ASSERT_EQ(Open(), Status::kSuccess);
+  // 多个线程同时写入，每个key写两遍，第二遍的值覆盖第一遍
+  const int kThreads = 4;
+  const int kNumPerThread = 2000;
+  vector<thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([this, t]() {
+      for (int round = 0; round < 2; round++) {
+        for (int i = t; i < kThreads * kNumPerThread; i += kThreads) {
+          ASSERT_EQ(db_->Put(WriteOptions(), "key" + to_string(i),
+                            "value" + to_string(i + round)),
+                    Status::kSuccess);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(db_->Delete(WriteOptions(), "key0"), Status::kSuccess);
+
+  auto check = [&]() {
+    string value;
+    ASSERT_EQ(db_->Get(ReadOptions(), "key0", &value), Status::kNotFound);
+    for (int i = 1; i < kThreads * kNumPerThread; i++) {
+      ASSERT_EQ(db_->Get(ReadOptions(), "key" + to_string(i), &value), Status::kSuccess);
+      ASSERT_EQ(value, "value" + to_string(i + 1));
+    }
+    // 迭代时把各个桶中的记录合并成有序的
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    int count = 0;
+    string last;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      ASSERT_LT(last, iter->key().ToString());
+      last = iter->key().ToString();
+      count++;
+    }
+    ASSERT_EQ(count, kThreads * kNumPerThread - 1);
+    iter->Seek("key5");
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(iter->key().ToString(), "key5");
+    delete iter;
+  };
+  check();
+  Close();
+
+  // 重新打开之后memtable中的数据被刷成sst，刷盘时同样是有序的
+  ASSERT_EQ(Open(), Status::kSuccess);
+  check();
+}
+
+TEST_F(dbTest, VectorMemTable) {
+  options_.write_buffer_size = 4 * 1024 * 1024;
+  // 固定用4个线程排序，和机器的核数无关；每个4MB的memtable有几万条记录，排序时分成4段
+  options_.memtable_factory = NewVectorRepFactory(4);
+  options_.allow_concurrent_memtable_write = true;
+  ASSERT_EQ(Open(), Status::kSuccess);
+  // 写入足够多的记录，中途会有memtable写满刷盘，重新打开时回放WAL的memtable同样在刷盘前排序
+  const int kThreads = 4;
+  const int kNum = 200000;
+  vector<thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([this, t]() {
+      for (int i = t; i < kNum; i += kThreads) {
+        ASSERT_EQ(db_->Put(WriteOptions(), "key" + to_string(i), "value" + to_string(i)),
+                  Status::kSuccess);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  // 覆盖写和删除，memtable中同一个key有多个版本，排序之前点查也要找到最新的版本
+  ASSERT_EQ(db_->Put(WriteOptions(), "key1", "new1"), Status::kSuccess);
+  ASSERT_EQ(db_->Delete(WriteOptions(), "key0"), Status::kSuccess);
+
+  auto check = [&]() {
+    string value;
+    ASSERT_EQ(db_->Get(ReadOptions(), "key0", &value), Status::kNotFound);
+    ASSERT_EQ(db_->Get(ReadOptions(), "key1", &value), Status::kSuccess);
+    ASSERT_EQ(value, "new1");
+    for (int i = 2; i < kNum; i += 997) {
+      ASSERT_EQ(db_->Get(ReadOptions(), "key" + to_string(i), &value), Status::kSuccess);
+      ASSERT_EQ(value, "value" + to_string(i));
+    }
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    int count = 0;
+    string last;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      ASSERT_LT(last, iter->key().ToString());
+      last = iter->key().ToString();
+      count++;
+    }
+    ASSERT_EQ(count, kNum - 1);
+    delete iter;
+  };
+  check();
+  Close();
+
+  ASSERT_EQ(Open(), Status::kSuccess);
+  check();
+}
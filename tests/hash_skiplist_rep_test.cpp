@@ -0,0 +1,104 @@
+#include "memtable/memtable_rep.h"
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "db/merge_context.h"
+#include "include/tinykv/comparator.h"
+#include "include/tinykv/iterator.h"
+#include "memtable/memtable.h"
+
+using namespace std;
+using namespace tinykv;
+
+static string KeyOf(int i) {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "key%07d", i);
+  return string(buf);
+}
+
+static size_t FillMemTable(MemTableRepFactory* factory, int num) {
+  const InternalKeyComparator comparator(BytewiseComparator());
+  MemTable* mem = new MemTable(comparator, 0, factory);
+  mem->Ref();
+  for (int i = 0; i < num; i++) {
+    mem->Add(i + 1, kTypeValue, KeyOf(i), "value" + to_string(i));
+  }
+  const size_t usage = mem->ApproximateMemoryUsage();
+  mem->Unref();
+  return usage;
+}
+
+// 除了桶数组，每条记录的额外开销要和跳表相当，不能每个桶都带一个完整高度的跳表头节点
+TEST(hashSkipListRepTest, MemoryOverhead) {
+  const int kNum = 10000;
+  const size_t kBuckets = 10000;
+  const size_t skiplist_usage = FillMemTable(nullptr, kNum);
+  auto factory = NewHashSkipListRepFactory(kBuckets);
+  const size_t hash_usage = FillMemTable(factory.get(), kNum);
+  const size_t bucket_array = kBuckets * sizeof(void*);
+  ASSERT_GT(hash_usage, bucket_array);
+  // 链表节点16字节，非空的桶24字节，跳表平均每条记录约19字节
+  const size_t extra = hash_usage - bucket_array > skiplist_usage
+                           ? hash_usage - bucket_array - skiplist_usage
+                           : 0;
+  ASSERT_LT(extra / kNum, 32u) << "hash: " << hash_usage << " skiplist: " << skiplist_usage;
+}
+
+// 只有一个桶，记录超过链表的阈值之后写入跳表，点查和遍历要把两边归并起来
+TEST(hashSkipListRepTest, SingleBucketConcurrentInsert) {
+  const InternalKeyComparator comparator(BytewiseComparator());
+  auto factory = NewHashSkipListRepFactory(1);
+  MemTable* mem = new MemTable(comparator, 0, factory.get());
+  mem->Ref();
+  const int kThreads = 4;
+  const int kNumPerThread = 500;
+  const int kNum = kThreads * kNumPerThread;
+  // 每个key写两个版本，顺序号由key和版本决定，第二个版本更新
+  vector<thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([mem, t]() {
+      for (int round = 0; round < 2; round++) {
+        for (int i = t; i < kNum; i += kThreads) {
+          mem->Add(round * kNum + i + 1, kTypeValue, KeyOf(i),
+                   "value" + to_string(i + round), true);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  string value;
+  DBStatus s = Status::kSuccess;
+  MergeContext merge_context;
+  for (int i = 0; i < kNum; i++) {
+    ASSERT_TRUE(mem->Get(LookupKey(KeyOf(i), 2 * kNum), &value, &s, &merge_context));
+    ASSERT_EQ(value, "value" + to_string(i + 1));
+    // 只能看到第一个版本的快照
+    ASSERT_TRUE(mem->Get(LookupKey(KeyOf(i), i + 1), &value, &s, &merge_context));
+    ASSERT_EQ(value, "value" + to_string(i));
+  }
+  ASSERT_FALSE(mem->Get(LookupKey("key", 2 * kNum), &value, &s, &merge_context));
+
+  Iterator* iter = mem->NewIterator();
+  int count = 0;
+  string last;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    if (!last.empty()) {
+      ASSERT_LT(comparator.Compare(Slice(last), iter->key()), 0);
+    }
+    last = iter->key().ToString();
+    count++;
+  }
+  ASSERT_EQ(count, 2 * kNum);
+  delete iter;
+  mem->Unref();
+}
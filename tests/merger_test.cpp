@@ -0,0 +1,102 @@
+#include "table/merger.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "include/tinykv/comparator.h"
+
+using namespace std;
+using namespace tinykv;
+
+// 基于有序vector的迭代器，用来作为MergingIterator的child
+class VectorIterator : public Iterator {
+ public:
+  explicit VectorIterator(const vector<string>& keys)
+      : keys_(keys), index_(keys.size()) {}
+
+  bool Valid() const override { return index_ < keys_.size(); }
+  void SeekToFirst() override { index_ = 0; }
+  void SeekToLast() override {
+    index_ = keys_.empty() ? keys_.size() : keys_.size() - 1;
+  }
+  void Seek(const Slice& target) override {
+    index_ = lower_bound(keys_.begin(), keys_.end(), target.ToString()) -
+             keys_.begin();
+  }
+  void Next() override { index_++; }
+  void Prev() override {
+    index_ = (index_ == 0) ? keys_.size() : index_ - 1;
+  }
+  Slice key() const override { return keys_[index_]; }
+  Slice value() const override { return keys_[index_]; }
+  DBStatus status() const override { return Status::kSuccess; }
+
+ private:
+  vector<string> keys_;
+  size_t index_;
+};
+
+TEST(mergerTest, MatchesSortedMerge) {
+  mt19937 rnd(301);
+  for (int n = 2; n <= 9; n++) {
+    // internal key不会重复，随机生成一批不同的key分给n个child
+    vector<string> expected;
+    for (int j = 0; j < n * 30; j++) {
+      expected.push_back("key" + to_string(rnd() % 1000 + 1000));
+    }
+    sort(expected.begin(), expected.end());
+    expected.erase(unique(expected.begin(), expected.end()), expected.end());
+    vector<vector<string>> keys(n);
+    for (const string& key : expected) {
+      keys[rnd() % n].push_back(key);
+    }
+    vector<Iterator*> children;
+    for (int i = 0; i < n; i++) {
+      children.push_back(new VectorIterator(keys[i]));
+    }
+    Iterator* iter =
+        NewMergingIterator(BytewiseComparator(), children.data(), n);
+
+    vector<string> forward;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      forward.push_back(iter->key().ToString());
+    }
+    ASSERT_EQ(forward, expected);
+
+    vector<string> backward;
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+      backward.push_back(iter->key().ToString());
+    }
+    reverse(backward.begin(), backward.end());
+    ASSERT_EQ(backward, expected);
+
+    // 随机地Seek，并且在正向和反向之间切换
+    for (int k = 0; k < 100; k++) {
+      const string target = "key" + to_string(rnd() % 1000 + 1000);
+      size_t pos =
+          lower_bound(expected.begin(), expected.end(), target) -
+          expected.begin();
+      iter->Seek(target);
+      for (int step = 0; step < 10; step++) {
+        if (pos >= expected.size()) {
+          ASSERT_FALSE(iter->Valid());
+          break;
+        }
+        ASSERT_TRUE(iter->Valid());
+        ASSERT_EQ(iter->key().ToString(), expected[pos]);
+        if (rnd() % 2 == 0) {
+          iter->Next();
+          pos++;
+        } else {
+          iter->Prev();
+          pos = (pos == 0) ? expected.size() : pos - 1;
+        }
+      }
+    }
+    delete iter;
+  }
+}
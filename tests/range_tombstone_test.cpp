@@ -0,0 +1,41 @@
+#include "db/range_tombstone.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "include/tinykv/comparator.h"
+
+using namespace std;
+using namespace tinykv;
+
+TEST(rangeTombstoneTest, Fragment) {
+  vector<RangeTombstone> tombstones;
+  tombstones.emplace_back("a", "e", 10);
+  tombstones.emplace_back("c", "g", 20);
+  tombstones.emplace_back("c", "d", 5);
+  tombstones.emplace_back("x", "x", 30);  // 空的范围
+  FragmentedRangeTombstoneList list(BytewiseComparator(), tombstones);
+
+  // [a,c) {10} [c,d) {20,10,5} [d,e) {20,10} [e,g) {20}
+  ASSERT_EQ(list.fragments().size(), 4u);
+  ASSERT_EQ(list.MaxCoveringSeq("a", 100), 10u);
+  ASSERT_EQ(list.MaxCoveringSeq("b", 9), 0u);
+  ASSERT_EQ(list.MaxCoveringSeq("c", 100), 20u);
+  ASSERT_EQ(list.MaxCoveringSeq("c", 19), 10u);
+  ASSERT_EQ(list.MaxCoveringSeq("c", 9), 5u);
+  ASSERT_EQ(list.MaxCoveringSeq("d", 9), 0u);
+  ASSERT_EQ(list.MaxCoveringSeq("f", 100), 20u);
+  // 终点不包含在范围内
+  ASSERT_EQ(list.MaxCoveringSeq("g", 100), 0u);
+  ASSERT_EQ(list.MaxCoveringSeq("0", 100), 0u);
+  ASSERT_EQ(list.MaxCoveringSeq("x", 100), 0u);
+
+  // 还原之后再切分，结果不变
+  vector<RangeTombstone> restored;
+  list.AppendTo(15, &restored);
+  FragmentedRangeTombstoneList list2(BytewiseComparator(), restored);
+  ASSERT_EQ(list2.MaxCoveringSeq("c", 100), 10u);
+  ASSERT_EQ(list2.MaxCoveringSeq("f", 100), 0u);
+}
@@ -0,0 +1,84 @@
+#include "file/rate_limiter.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace tinykv;
+
+TEST(rateLimiterTest, Rate) {
+  // 每10ms补充10KB，即1MB/s
+  RateLimiter limiter(1024 * 1024, 10 * 1000);
+  ASSERT_EQ(limiter.GetBytesPerSecond(), 1024 * 1024);
+  ASSERT_EQ(limiter.GetSingleBurstBytes(), 10485);
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < 30; i++) {
+    limiter.Request(limiter.GetSingleBurstBytes(), kIOLow);
+  }
+  auto elapsed = chrono::duration_cast<chrono::milliseconds>(
+      chrono::steady_clock::now() - start).count();
+  // 第一次申请不需要等待，之后每个周期通过一次
+  ASSERT_GE(elapsed, 250);
+  ASSERT_EQ(limiter.GetTotalBytesThrough(kIOLow), 30 * 10485);
+  ASSERT_EQ(limiter.GetTotalBytesThrough(), 30 * 10485);
+  ASSERT_EQ(limiter.GetTotalBytesThrough(kIOHigh), 0);
+  ASSERT_EQ(limiter.GetTotalRequests(kIOLow), 30);
+  ASSERT_GT(limiter.GetTotalWaits(kIOLow), 0);
+
+  // 超过单个周期令牌数的申请按一个周期计算
+  limiter.Request(1 << 30, kIOMid);
+  ASSERT_EQ(limiter.GetTotalBytesThrough(kIOMid), 10485);
+}
+
+TEST(rateLimiterTest, Priority) {
+  // 每个周期只够一个请求通过
+  RateLimiter limiter(100 * 1024, 10 * 1000);
+  const int64_t burst = limiter.GetSingleBurstBytes();
+  atomic<int> low_done{0};
+  vector<thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&limiter, &low_done, burst]() {
+      for (int i = 0; i < 20; i++) {
+        limiter.Request(burst, kIOLow);
+      }
+      low_done++;
+    });
+  }
+  this_thread::sleep_for(chrono::milliseconds(30));
+  // 低优先级的请求已经在排队了，高优先级的请求仍然每个周期都能通过
+  // 低优先级的线程还没有join，这里不能用ASSERT提前返回
+  for (int i = 0; i < 5; i++) {
+    limiter.Request(burst, kIOHigh);
+  }
+  EXPECT_EQ(low_done.load(), 0);
+  EXPECT_EQ(limiter.GetTotalBytesThrough(kIOHigh), 5 * burst);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(limiter.GetTotalBytesThrough(kIOLow), 80 * burst);
+  ASSERT_EQ(limiter.GetTotalRequests(), 85);
+}
+
+TEST(rateLimiterTest, AutoTune) {
+  const int64_t kMaxRate = 10 * 1024 * 1024;
+  RateLimiter limiter(kMaxRate, 1000, true);
+  ASSERT_EQ(limiter.GetBytesPerSecond(), kMaxRate);
+  // 空闲了超过100个周期，没有积压，降速
+  limiter.Request(1, kIOLow);
+  this_thread::sleep_for(chrono::milliseconds(150));
+  limiter.Request(1, kIOLow);
+  const int64_t idle_rate = limiter.GetBytesPerSecond();
+  ASSERT_LT(idle_rate, kMaxRate);
+  ASSERT_GE(idle_rate, kMaxRate / 20);
+
+  // 每个周期都有请求排队，提速，但是不会超过上限
+  for (int i = 0; i < 300; i++) {
+    limiter.Request(limiter.GetSingleBurstBytes(), kIOLow);
+  }
+  ASSERT_GT(limiter.GetBytesPerSecond(), idle_rate);
+  ASSERT_LE(limiter.GetBytesPerSecond(), kMaxRate);
+}
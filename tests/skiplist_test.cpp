@@ -1,34 +1,92 @@
-#include "db/skiplist.h"
+#include "memtable/skiplist.h"
 
 #include <gtest/gtest.h>
 
+#include <string.h>
+
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 
-#include "db/comparator.h"
 #include "logger/log.h"
-#include "memory/area.h"
+#include "memory/arena.h"
 
 using namespace std;
 using namespace tinykv;
+
+struct ByteComparator {
+  int operator()(const char* a, const char* b) const { return strcmp(a, b); }
+};
+
 static  vector<string> kTestKeys = {"tinykv", "tinykv1", "tinykv2", "tinykv3", "tinykv4", "tinykv5"};
 TEST(skiplistTest, Insert) {
   tinykv::LogConfig log_config;
   log_config.log_type = tinykv::LogType::CONSOLE;
   log_config.rotate_size = 100;
   tinykv::Log::GetInstance()->InitLog(log_config);
-  using Table = SkipList<const char*, ByteComparator, SimpleVectorAlloc>;
+  using Table = SkipList<const char*, ByteComparator, Arena>;
   ByteComparator byte_comparator;
-  Table tb(byte_comparator);
+  Arena arena;
+  Table tb(byte_comparator, &arena);
   for (int i = 0; i < 100; i++) {
     kTestKeys.emplace_back(std::to_string(i));
   }
-  for (auto item : kTestKeys) {
+  for (auto& item : kTestKeys) {
     tb.Insert(item.c_str());
   }
   for (auto& item : kTestKeys) {
     cout << "[ key:" << item << ", has_existed:" << tb.Contains(item.c_str())
          << " ]" << endl;
   }
-}
\ No newline at end of file
+}
+
+TEST(skiplistTest, InsertConcurrently) {
+  using Table = SkipList<const char*, ByteComparator, ConcurrentArena>;
+  ByteComparator byte_comparator;
+  ConcurrentArena arena;
+  Table tb(byte_comparator, &arena);
+  const int kThreads = 4;
+  const int kNumPerThread = 5000;
+  // 每个线程插入自己的一组key，各组交错，插入时经常需要和其他线程竞争同一个位置
+  vector<string> keys;
+  for (int i = 0; i < kThreads * kNumPerThread; i++) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%08d", i);
+    keys.emplace_back(buf);
+  }
+  vector<thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&tb, &keys, t]() {
+      for (int i = t; i < kThreads * kNumPerThread; i += kThreads) {
+        tb.InsertConcurrently(keys[i].c_str());
+      }
+    });
+  }
+  // 插入期间读到的key始终是有序的；写线程还没有join，这里不能用ASSERT提前返回
+  for (int round = 0; round < 10; round++) {
+    Table::Iterator iter(&tb);
+    const char* last = nullptr;
+    for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+      if (last != nullptr) {
+        EXPECT_LT(strcmp(last, iter.key()), 0);
+      }
+      last = iter.key();
+    }
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  Table::Iterator iter(&tb);
+  iter.SeekToFirst();
+  for (const auto& key : keys) {
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(string(iter.key()), key);
+    iter.Next();
+  }
+  ASSERT_FALSE(iter.Valid());
+  for (const auto& key : keys) {
+    ASSERT_TRUE(tb.Contains(key.c_str()));
+  }
+}
@@ -0,0 +1,69 @@
+#include "memtable/memtable_rep.h"
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+
+#include <string>
+
+#include "db/dbformat.h"
+#include "db/merge_context.h"
+#include "include/tinykv/comparator.h"
+#include "include/tinykv/iterator.h"
+#include "memtable/memtable.h"
+
+using namespace std;
+using namespace tinykv;
+
+static string KeyOf(int i) {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "key%07d", i);
+  return string(buf);
+}
+
+// 排序线程数分别为1、2、3、7，记录足够多，每个线程都能分到一段，覆盖段数不是2的幂次时的归并
+TEST(vectorRepTest, ParallelSortOnMarkImmutable) {
+  const InternalKeyComparator comparator(BytewiseComparator());
+  // 每个线程至少分到16K条记录
+  const int kNum = 7 * 16 * 1024 + 123;
+  for (size_t threads : {1, 2, 3, 7}) {
+    auto factory = NewVectorRepFactory(threads);
+    MemTable* mem = new MemTable(comparator, 0, factory.get());
+    mem->Ref();
+    // 7919和kNum互质，按打乱的顺序写入；每隔一个key再写一个更新的版本
+    SequenceNumber seq = 1;
+    for (int k = 0; k < kNum; k++) {
+      const int i = static_cast<int>((static_cast<int64_t>(k) * 7919) % kNum);
+      mem->Add(seq++, kTypeValue, KeyOf(i), "old" + to_string(i));
+      if (i % 2 == 0) {
+        mem->Add(seq++, kTypeValue, KeyOf(i), "new" + to_string(i));
+      }
+    }
+    // 排序之前的点查扫描整个数组
+    string value;
+    DBStatus s = Status::kSuccess;
+    MergeContext merge_context;
+    ASSERT_TRUE(mem->Get(LookupKey(KeyOf(42), seq), &value, &s, &merge_context));
+    ASSERT_EQ(value, "new42");
+
+    mem->MarkImmutable();
+    Iterator* iter = mem->NewIterator();
+    int count = 0;
+    string last;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      if (!last.empty()) {
+        ASSERT_LT(comparator.Compare(Slice(last), iter->key()), 0);
+      }
+      last = iter->key().ToString();
+      count++;
+    }
+    ASSERT_EQ(count, kNum + (kNum + 1) / 2);
+    delete iter;
+
+    for (int i = 0; i < kNum; i += 997) {
+      ASSERT_TRUE(mem->Get(LookupKey(KeyOf(i), seq), &value, &s, &merge_context));
+      ASSERT_EQ(value, (i % 2 == 0 ? "new" : "old") + to_string(i));
+    }
+    mem->Unref();
+  }
+}
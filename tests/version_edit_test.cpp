@@ -0,0 +1,64 @@
+#include "db/version_edit.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using namespace std;
+using namespace tinykv;
+
+// 编码之后再解码，再次编码的结果必须和第一次完全一样
+static void TestEncodeDecode(const VersionEdit& edit) {
+  string encoded, encoded2;
+  edit.EncodeTo(&encoded);
+  VersionEdit parsed;
+  ASSERT_EQ(parsed.DecodeFrom(encoded), Status::kSuccess);
+  parsed.EncodeTo(&encoded2);
+  ASSERT_EQ(encoded, encoded2);
+}
+
+TEST(versionEditTest, EncodeDecode) {
+  static const uint64_t kBig = 1ull << 50;
+
+  VersionEdit edit;
+  for (int i = 0; i < 4; i++) {
+    TestEncodeDecode(edit);
+    FileMetaData f;
+    f.number = kBig + 300 + i;
+    f.file_size = kBig + 400 + i;
+    f.smallest = InternalKey("foo", kBig + 500 + i, kTypeValue);
+    f.largest = InternalKey("zoo", kBig + 600 + i, kTypeDeletion);
+    f.smallest_seq = kBig + 500 + i;
+    f.largest_seq = kBig + 600 + i;
+    edit.AddFile(3, f);
+    edit.RemoveFile(4, kBig + 700 + i);
+    edit.SetCompactPointer(i, InternalKey("x", kBig + 900 + i, kTypeValue));
+    BlobFileMetaData blob;
+    blob.number = kBig + 1100 + i;
+    blob.total_count = kBig + 1200 + i;
+    blob.total_bytes = kBig + 1300 + i;
+    blob.garbage_count = i;
+    blob.garbage_bytes = i * 100;
+    edit.AddBlobFile(blob);
+    edit.AddBlobGarbage(kBig + 1400 + i, 10, 1000);
+  }
+
+  edit.SetComparatorName("foo");
+  edit.SetLogNumber(kBig + 100);
+  edit.SetNextFile(kBig + 200);
+  edit.SetLastSequence(kBig + 1000);
+  TestEncodeDecode(edit);
+}
+
+TEST(versionEditTest, Corruption) {
+  VersionEdit edit;
+  edit.SetLogNumber(100);
+  string encoded;
+  edit.EncodeTo(&encoded);
+  // 截断之后无法解析
+  encoded.resize(encoded.size() - 1);
+  VersionEdit parsed;
+  ASSERT_EQ(parsed.DecodeFrom(encoded), Status::kCorruption);
+  // 不认识的tag
+  ASSERT_EQ(parsed.DecodeFrom(string("\x63", 1)), Status::kCorruption);
+}
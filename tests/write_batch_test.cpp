@@ -0,0 +1,118 @@
+#include "db/write_batch.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "db/column_family.h"
+#include "db/write_batch_internal.h"
+
+using namespace std;
+using namespace tinykv;
+
+// 把batch中的操作按顺序打印出来
+class BatchPrinter : public WriteBatch::Handler {
+ public:
+  void Put(const Slice& key, const Slice& value) override {
+    result_ += "Put(" + key.ToString() + ", " + value.ToString() + ")";
+  }
+  void Delete(const Slice& key) override {
+    result_ += "Delete(" + key.ToString() + ")";
+  }
+  void DeleteRange(const Slice& begin_key, const Slice& end_key) override {
+    result_ += "DeleteRange(" + begin_key.ToString() + ", " + end_key.ToString() + ")";
+  }
+  void Merge(const Slice& key, const Slice& value) override {
+    result_ += "Merge(" + key.ToString() + ", " + value.ToString() + ")";
+  }
+  string result_;
+};
+
+// 同时打印column family的编号
+class ColumnFamilyBatchPrinter : public BatchPrinter {
+ public:
+  void PutCF(uint32_t column_family_id, const Slice& key, const Slice& value) override {
+    result_ += to_string(column_family_id) + ":";
+    Put(key, value);
+  }
+  void DeleteCF(uint32_t column_family_id, const Slice& key) override {
+    result_ += to_string(column_family_id) + ":";
+    Delete(key);
+  }
+};
+
+static string PrintContents(const WriteBatch* batch) {
+  BatchPrinter printer;
+  DBStatus s = batch->Iterate(&printer);
+  if (s != Status::kSuccess) {
+    printer.result_ += "ParseError()";
+  }
+  return printer.result_;
+}
+
+TEST(writeBatchTest, Empty) {
+  WriteBatch batch;
+  ASSERT_EQ(PrintContents(&batch), "");
+  ASSERT_EQ(WriteBatchInternal::Count(&batch), 0);
+}
+
+TEST(writeBatchTest, Multiple) {
+  WriteBatch batch;
+  batch.Put("foo", "bar");
+  batch.Delete("box");
+  batch.Put("baz", "boo");
+  batch.DeleteRange("a", "f");
+  WriteBatchInternal::SetSequence(&batch, 100);
+  ASSERT_EQ(WriteBatchInternal::Sequence(&batch), 100);
+  ASSERT_EQ(WriteBatchInternal::Count(&batch), 4);
+  ASSERT_EQ(PrintContents(&batch),
+            "Put(foo, bar)Delete(box)Put(baz, boo)DeleteRange(a, f)");
+}
+
+TEST(writeBatchTest, Merge) {
+  WriteBatch batch;
+  batch.Put("foo", "bar");
+  batch.Merge("foo", "baz");
+  batch.Merge("box", "");
+  ASSERT_EQ(WriteBatchInternal::Count(&batch), 3);
+  ASSERT_EQ(PrintContents(&batch), "Put(foo, bar)Merge(foo, baz)Merge(box, )");
+}
+
+TEST(writeBatchTest, Corruption) {
+  WriteBatch batch;
+  batch.Put("foo", "bar");
+  batch.Delete("box");
+  Slice contents = WriteBatchInternal::Contents(&batch);
+  WriteBatchInternal::SetContents(&batch,
+                                  Slice(contents.data(), contents.size() - 1));
+  ASSERT_EQ(PrintContents(&batch), "Put(foo, bar)ParseError()");
+}
+
+TEST(writeBatchTest, Append) {
+  WriteBatch b1, b2;
+  b1.Append(b2);
+  ASSERT_EQ(PrintContents(&b1), "");
+  b2.Put("a", "va");
+  b1.Append(b2);
+  ASSERT_EQ(PrintContents(&b1), "Put(a, va)");
+  b2.Clear();
+  b2.Put("b", "vb");
+  b2.Delete("a");
+  b1.Append(b2);
+  ASSERT_EQ(PrintContents(&b1), "Put(a, va)Put(b, vb)Delete(a)");
+  ASSERT_EQ(WriteBatchInternal::Count(&b1), 3);
+}
+
+TEST(writeBatchTest, ColumnFamily) {
+  ColumnFamilyData cfd(300, "cf", "/tmp", Options());
+  WriteBatch batch;
+  batch.Put("foo", "bar");
+  batch.Put(&cfd.handle, "foo", "baz");
+  batch.Delete(&cfd.handle, "box");
+  ASSERT_EQ(WriteBatchInternal::Count(&batch), 3);
+  // 不关心column family的Handler看到的是所有操作
+  ASSERT_EQ(PrintContents(&batch), "Put(foo, bar)Put(foo, baz)Delete(box)");
+  ColumnFamilyBatchPrinter printer;
+  ASSERT_EQ(batch.Iterate(&printer), Status::kSuccess);
+  ASSERT_EQ(printer.result_, "0:Put(foo, bar)300:Put(foo, baz)300:Delete(box)");
+}